@@ -57,6 +57,7 @@
         '../net/instaweb/instaweb_apr.gyp:*',
         '../net/instaweb/test.gyp:mod_pagespeed_test',
         '../net/instaweb/test.gyp:mod_pagespeed_speed_test',
+        '../net/instaweb/test.gyp:rewrite_driver_allocation_speed_test',
         'install.gyp:*',
       ]
     },
@@ -26,6 +26,7 @@
 #include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -34,6 +35,7 @@
 #include "pagespeed/kernel/http/google_url.h"
 #include "pagespeed/kernel/http/http_names.h"
 #include "pagespeed/kernel/http/response_headers.h"
+#include "pagespeed/opt/http/request_context.h"
 #include "pagespeed/opt/logging/request_timing_info.h"
 
 namespace net_instaweb {
@@ -136,9 +138,15 @@ class HTTPCacheCallback : public CacheInterface::Callback {
         fragment_(fragment),
         handler_(handler),
         callback_(callback),
-        http_cache_(http_cache) {
+        http_cache_(http_cache),
+        span_(SpanTrace::kNoSpan) {
     start_us_ = http_cache_->timer()->NowUs();
     start_ms_ = start_us_ / 1000;
+    SpanTrace* trace = span_trace();
+    if (trace != NULL) {
+      span_ = trace->BeginSpan("HTTPCache::Find", SpanTrace::kRootSpan);
+      trace->AddTag(span_, "key", key_);
+    }
   }
 
   virtual void Done(CacheInterface::KeyState backend_state) {
@@ -261,11 +269,34 @@ class HTTPCacheCallback : public CacheInterface::Callback {
       headers->Clear();
       callback_->http_value()->Clear();
     }
+    SpanTrace* trace = span_trace();
+    if (trace != NULL) {
+      trace->AddTag(span_, "result", FindResultName(result));
+      trace->EndSpan(span_);
+    }
     callback_->Done(result);
     delete this;
   }
 
  private:
+  // The trace of the request this lookup is for, if it's being traced.
+  SpanTrace* span_trace() {
+    const RequestContextPtr& request_context = callback_->request_context();
+    return (request_context.get() == NULL) ? NULL :
+        request_context->span_trace();
+  }
+
+  static const char* FindResultName(HTTPCache::FindResult result) {
+    switch (result) {
+      case HTTPCache::kFound: return "found";
+      case HTTPCache::kNotFound: return "not_found";
+      case HTTPCache::kRecentFetchFailed: return "recent_fetch_failed";
+      case HTTPCache::kRecentFetchNotCacheable:
+        return "recent_fetch_not_cacheable";
+    }
+    return "unknown";
+  }
+
   GoogleString key_;
   GoogleString fragment_;
   RequestHeaders::Properties req_properties_;
@@ -274,6 +305,7 @@ class HTTPCacheCallback : public CacheInterface::Callback {
   HTTPCache* http_cache_;
   int64 start_us_;
   int64 start_ms_;
+  SpanTrace::SpanId span_;
 
   DISALLOW_COPY_AND_ASSIGN(HTTPCacheCallback);
 };
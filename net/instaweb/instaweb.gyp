@@ -1464,6 +1464,7 @@
         'rewriter/cache_html_info_finder.cc',
         'rewriter/critical_images_finder.cc',
         'rewriter/critical_line_info_finder.cc',
+        'rewriter/css_fragment_cache.cc',
         'rewriter/device_properties.cc',
         'rewriter/domain_lawyer.cc',
         'rewriter/downstream_cache_purger.cc',
@@ -1503,6 +1504,7 @@
         '<(DEPTH)/pagespeed/kernel.gyp:pagespeed_image_processing',
       ],
       'sources': [
+        'rewriter/decoded_image_cache.cc',
         'rewriter/image.cc',
         'rewriter/image_url_encoder.cc',
         'rewriter/resource_tag_scanner.cc',
@@ -1702,6 +1704,7 @@
         '<(DEPTH)/third_party/css_parser/css_parser.gyp:css_parser',
       ],
       'sources': [
+        'rewriter/adaptive_rewrite_deadline.cc',
         'rewriter/add_head_filter.cc',
         'rewriter/add_ids_filter.cc',
         'rewriter/add_instrumentation_filter.cc',
@@ -1861,6 +1864,7 @@
         '<(DEPTH)/pagespeed/system/in_place_resource_recorder.cc',
         '<(DEPTH)/pagespeed/system/loopback_route_fetcher.cc',
         '<(DEPTH)/pagespeed/system/serf_url_async_fetcher.cc',
+        '<(DEPTH)/pagespeed/system/span_trace_buffer.cc',
         '<(DEPTH)/pagespeed/system/system_cache_path.cc',
         '<(DEPTH)/pagespeed/system/system_caches.cc',
         '<(DEPTH)/pagespeed/system/system_message_handler.cc',
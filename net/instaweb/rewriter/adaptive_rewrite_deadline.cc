@@ -0,0 +1,96 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/adaptive_rewrite_deadline.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/timer.h"
+
+namespace net_instaweb {
+
+const char AdaptiveRewriteDeadline::kPropertyName[] =
+    "adaptive_rewrite_deadline_us";
+
+const int64 AdaptiveRewriteDeadline::kMinDeadlineMs;
+
+const double AdaptiveRewriteDeadline::kLearningRate = 0.2;
+
+const double AdaptiveRewriteDeadline::kSaveThreshold = 0.1;
+
+AdaptiveRewriteDeadline::AdaptiveRewriteDeadline(int64 max_deadline_ms,
+                                                 int target_percent)
+    : max_deadline_us_(std::max(max_deadline_ms, kMinDeadlineMs) *
+                       Timer::kMsUs),
+      target_fraction_(std::max(1, std::min(99, target_percent)) / 100.0),
+      estimate_us_(max_deadline_us_),
+      decoded_estimate_us_(0),
+      num_windows_recorded_(0) {
+}
+
+AdaptiveRewriteDeadline::~AdaptiveRewriteDeadline() {
+}
+
+int64 AdaptiveRewriteDeadline::deadline_ms() const {
+  return static_cast<int64>(std::ceil(estimate_us_ / Timer::kMsUs));
+}
+
+void AdaptiveRewriteDeadline::RecordWindow(bool all_rewrites_completed) {
+  double step = all_rewrites_completed
+      ? target_fraction_ - 1.0 : target_fraction_;
+  SetEstimateUs(estimate_us_ * std::exp(kLearningRate * step));
+  ++num_windows_recorded_;
+}
+
+bool AdaptiveRewriteDeadline::DecodeEstimate(StringPiece value) {
+  int64 estimate_us;
+  if (!StringToInt64(value.as_string(), &estimate_us) || estimate_us <= 0) {
+    return false;
+  }
+  SetEstimateUs(estimate_us);
+  decoded_estimate_us_ = estimate_us_;
+  return true;
+}
+
+GoogleString AdaptiveRewriteDeadline::EncodeEstimate() const {
+  return Integer64ToString(static_cast<int64>(estimate_us_));
+}
+
+bool AdaptiveRewriteDeadline::ChangedSignificantly() const {
+  return (decoded_estimate_us_ <= 0) ||
+      (std::abs(estimate_us_ - decoded_estimate_us_) >
+       kSaveThreshold * decoded_estimate_us_);
+}
+
+void AdaptiveRewriteDeadline::ScaleChangeSinceDecode(int factor) {
+  if (decoded_estimate_us_ > 0) {
+    SetEstimateUs(decoded_estimate_us_ *
+                  std::pow(estimate_us_ / decoded_estimate_us_, factor));
+  }
+}
+
+void AdaptiveRewriteDeadline::SetEstimateUs(double estimate_us) {
+  estimate_us_ = std::max(
+      static_cast<double>(kMinDeadlineMs * Timer::kMsUs),
+      std::min(static_cast<double>(max_deadline_us_), estimate_us));
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/adaptive_rewrite_deadline.h"
+
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/string.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const int64 kMaxDeadlineMs = 20;
+
+// Simulates windows which all take completion_ms to complete their rewrites,
+// returning the fraction that met the deadline they were given.
+double Simulate(AdaptiveRewriteDeadline* deadline, const int64* completion_ms,
+                int num_completion_ms, int num_windows) {
+  int completed = 0;
+  for (int i = 0; i < num_windows; ++i) {
+    bool met = completion_ms[i % num_completion_ms] <= deadline->deadline_ms();
+    completed += met ? 1 : 0;
+    deadline->RecordWindow(met);
+  }
+  return static_cast<double>(completed) / num_windows;
+}
+
+TEST(AdaptiveRewriteDeadlineTest, StartsAtMaximum) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 90);
+  EXPECT_EQ(kMaxDeadlineMs, deadline.deadline_ms());
+  for (int i = 0; i < 10; ++i) {
+    deadline.RecordWindow(false);
+  }
+  EXPECT_EQ(kMaxDeadlineMs, deadline.deadline_ms());
+}
+
+TEST(AdaptiveRewriteDeadlineTest, ShrinksForFastSite) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 90);
+  const int64 kCompletionMs[] = { 1, 2, 2, 3 };
+  Simulate(&deadline, kCompletionMs, arraysize(kCompletionMs), 1000);
+  EXPECT_LE(3, deadline.deadline_ms());
+  EXPECT_GE(5, deadline.deadline_ms());
+}
+
+TEST(AdaptiveRewriteDeadlineTest, TracksTargetQuantile) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 70);
+  // One window in five has a slow rewrite, which is not worth waiting for.
+  const int64 kCompletionMs[] = { 2, 3, 4, 5, 15 };
+  Simulate(&deadline, kCompletionMs, arraysize(kCompletionMs), 1000);
+  double rate = Simulate(&deadline, kCompletionMs, arraysize(kCompletionMs),
+                         1000);
+  EXPECT_NEAR(0.7, rate, 0.05);
+  EXPECT_GE(5, deadline.deadline_ms());
+}
+
+TEST(AdaptiveRewriteDeadlineTest, GrowsBackWhenWindowsMiss) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 90);
+  const int64 kFastMs[] = { 1 };
+  Simulate(&deadline, kFastMs, 1, 1000);
+  EXPECT_EQ(AdaptiveRewriteDeadline::kMinDeadlineMs, deadline.deadline_ms());
+  const int64 kSlowMs[] = { 12 };
+  Simulate(&deadline, kSlowMs, 1, 1000);
+  EXPECT_LE(12, deadline.deadline_ms());
+}
+
+TEST(AdaptiveRewriteDeadlineTest, EncodeDecode) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 90);
+  for (int i = 0; i < 100; ++i) {
+    deadline.RecordWindow(true);
+  }
+  int64 learned_ms = deadline.deadline_ms();
+  EXPECT_GT(kMaxDeadlineMs, learned_ms);
+
+  AdaptiveRewriteDeadline restored(kMaxDeadlineMs, 90);
+  EXPECT_TRUE(restored.DecodeEstimate(deadline.EncodeEstimate()));
+  EXPECT_EQ(learned_ms, restored.deadline_ms());
+
+  EXPECT_FALSE(restored.DecodeEstimate("junk"));
+  EXPECT_FALSE(restored.DecodeEstimate("-5"));
+  EXPECT_EQ(learned_ms, restored.deadline_ms());
+
+  // An estimate saved under a larger configured deadline is clamped.
+  EXPECT_TRUE(restored.DecodeEstimate("1000000"));
+  EXPECT_EQ(kMaxDeadlineMs, restored.deadline_ms());
+}
+
+TEST(AdaptiveRewriteDeadlineTest, ChangedSignificantly) {
+  AdaptiveRewriteDeadline deadline(kMaxDeadlineMs, 90);
+  // Nothing has been saved yet.
+  EXPECT_TRUE(deadline.ChangedSignificantly());
+  ASSERT_TRUE(deadline.DecodeEstimate("10000"));
+  EXPECT_FALSE(deadline.ChangedSignificantly());
+
+  // A window which completes shrinks the estimate by only about 2%, but ten
+  // of them shrink it by about 18%.
+  deadline.RecordWindow(true);
+  EXPECT_FALSE(deadline.ChangedSignificantly());
+  deadline.ScaleChangeSinceDecode(10);
+  EXPECT_TRUE(deadline.ChangedSignificantly());
+  EXPECT_EQ(9, deadline.deadline_ms());
+
+  // A window which misses grows it by about 20%.
+  ASSERT_TRUE(deadline.DecodeEstimate("10000"));
+  deadline.RecordWindow(false);
+  EXPECT_TRUE(deadline.ChangedSignificantly());
+  EXPECT_EQ(12, deadline.deadline_ms());
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -28,6 +28,7 @@
 #include "base/logging.h"
 #include "net/instaweb/http/public/log_record.h"
 #include "net/instaweb/rewriter/cached_result.pb.h"
+#include "net/instaweb/rewriter/public/css_fragment_cache.h"
 #include "net/instaweb/rewriter/public/css_tag_scanner.h"
 #include "net/instaweb/rewriter/public/output_resource.h"
 #include "net/instaweb/rewriter/public/output_resource_kind.h"
@@ -40,11 +41,14 @@
 #include "net/instaweb/rewriter/public/rewrite_result.h"
 #include "net/instaweb/rewriter/public/server_context.h"
 #include "pagespeed/kernel/base/charset_util.h"
+#include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/proto_util.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/base/writer.h"
 #include "pagespeed/kernel/html/html_element.h"
 #include "pagespeed/kernel/html/html_name.h"
@@ -64,6 +68,10 @@ const char CssCombineFilter::kCssCombineOpportunities[] =
     "css_combine_opportunities";
 const char CssCombineFilter::kCssFileCountReduction[] =
     "css_file_count_reduction";
+const char CssCombineFilter::kCssCombineFragmentReuses[] =
+    "css_combine_fragment_reuses";
+const char CssCombineFilter::kCssCombineFragmentMisses[] =
+    "css_combine_fragment_misses";
 
 // Combining helper. Takes care of checking that media matches, that we do not
 // produce @import's in the middle and of URL absolutification.
@@ -75,16 +83,34 @@ class CssCombineFilter::CssCombiner : public ResourceCombiner {
         combined_css_size_(0) {
     Statistics* stats = server_context_->statistics();
     css_file_count_reduction_ = stats->GetVariable(kCssFileCountReduction);
+    css_fragment_reuses_ = stats->GetVariable(kCssCombineFragmentReuses);
+    css_fragment_misses_ = stats->GetVariable(kCssCombineFragmentMisses);
   }
 
+  // The verdict depends only on the contents, and every partitioning of a
+  // page's stylesheets asks again, so it is kept in the fragment cache.
   bool CleanParse(const StringPiece& contents) {
+    CssFragmentCache* fragment_cache = server_context_->css_fragment_cache();
+    GoogleString key;
+    if (fragment_cache != NULL) {
+      key = StrCat(
+          "parse/", server_context_->contents_hasher()->Hash(contents));
+      SharedString verdict;
+      if (fragment_cache->Lookup(key, &verdict)) {
+        return (verdict.Value() == "1");
+      }
+    }
     Css::Parser parser(contents);
     parser.set_preservation_mode(true);
     // Among other issues, quirks-mode allows unbalanced {}s in some cases.
     parser.set_quirks_mode(false);
     // TODO(sligocki): Do parsing on low-priority worker thread.
     scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
-    return (parser.errors_seen_mask() == Css::Parser::kNoError);
+    bool clean = (parser.errors_seen_mask() == Css::Parser::kNoError);
+    if (fragment_cache != NULL) {
+      fragment_cache->Insert(key, SharedString(clean ? "1" : "0"));
+    }
+    return clean;
   }
 
   virtual bool ResourceCombinable(Resource* resource,
@@ -160,8 +186,16 @@ class CssCombineFilter::CssCombiner : public ResourceCombiner {
                           OutputResource* combination, Writer* writer,
                           MessageHandler* handler);
 
+  // Writes input's contents with their URLs resolved against the
+  // combination's base, which is what WritePiece caches.
+  bool ResolvePiece(int index, const Resource* input,
+                    OutputResource* combination, Writer* writer,
+                    MessageHandler* handler);
+
   GoogleString media_;
   Variable* css_file_count_reduction_;
+  Variable* css_fragment_reuses_;
+  Variable* css_fragment_misses_;
   int64 combined_css_size_;
 };
 
@@ -366,6 +400,8 @@ CssCombineFilter::~CssCombineFilter() {
 void CssCombineFilter::InitStats(Statistics* statistics) {
   statistics->AddVariable(kCssCombineOpportunities);
   statistics->AddVariable(kCssFileCountReduction);
+  statistics->AddVariable(kCssCombineFragmentReuses);
+  statistics->AddVariable(kCssCombineFragmentMisses);
 }
 
 void CssCombineFilter::StartDocumentImpl() {
@@ -492,6 +528,41 @@ void CssCombineFilter::Flush() {
 bool CssCombineFilter::CssCombiner::WritePiece(
     int index, const Resource* input, OutputResource* combination,
     Writer* writer, MessageHandler* handler) {
+  // A combination that differs from an earlier one only by an input or two
+  // is still made mostly of pieces written before.  A piece depends on the
+  // input's contents and URL, the base it is resolved against, whether its
+  // BOM is stripped, and the options ResolveCssUrls consults, such as the
+  // domain mappings.
+  CssFragmentCache* fragment_cache = server_context_->css_fragment_cache();
+  if (fragment_cache == NULL) {
+    return ResolvePiece(index, input, combination, writer, handler);
+  }
+  const Hasher* hasher = server_context_->contents_hasher();
+  GoogleString key = StrCat(
+      "css/", hasher->Hash(StrCat(
+          hasher->Hash(input->contents()), "\n", input->url(), "\n",
+          combination->resolved_base(), "\n",
+          rewrite_driver_->options()->signature())),
+      (index == 0) ? "" : "/nobom");
+  SharedString fragment;
+  if (fragment_cache->Lookup(key, &fragment)) {
+    css_fragment_reuses_->Add(1);
+  } else {
+    css_fragment_misses_->Add(1);
+    GoogleString resolved;
+    StringWriter resolved_writer(&resolved);
+    if (!ResolvePiece(index, input, combination, &resolved_writer, handler)) {
+      return false;
+    }
+    fragment.SwapWithString(&resolved);
+    fragment_cache->Insert(key, fragment);
+  }
+  return writer->Write(fragment.Value(), handler);
+}
+
+bool CssCombineFilter::CssCombiner::ResolvePiece(
+    int index, const Resource* input, OutputResource* combination,
+    Writer* writer, MessageHandler* handler) {
   StringPiece contents = input->contents();
   GoogleUrl input_url(input->url());
   // Strip the BOM off of the contents (if it's there) if this is not the
@@ -660,6 +660,40 @@ TEST_F(CssCombineFilterTest, CombineCssRecombine) {
   EXPECT_EQ(0, lru_cache()->num_identical_reinserts());
 }
 
+// Adding a stylesheet to a combination produces a new combined resource, but
+// the inputs it shares with the old one are copied from the fragment cache.
+TEST_F(CssCombineFilterTest, CombineCssReusesFragments) {
+  SetHtmlMimetype();
+  SetupCssResources("a.css", "b.css");
+  Variable* reuses = statistics()->GetVariable(
+      CssCombineFilter::kCssCombineFragmentReuses);
+  Variable* misses = statistics()->GetVariable(
+      CssCombineFilter::kCssCombineFragmentMisses);
+
+  ParseUrl(StrCat(kDomain, "two.html"),
+           StrCat("<head>", Link("a.css"), Link("b.css"), "</head>"));
+  EXPECT_EQ(0, reuses->Get());
+  EXPECT_EQ(2, misses->Get());
+
+  ParseUrl(StrCat(kDomain, "three.html"),
+           StrCat("<head>", Link("a.css"), Link("b.css"), Link("c.css"),
+                  "</head>"));
+  EXPECT_EQ(2, reuses->Get());
+  EXPECT_EQ(3, misses->Get());
+}
+
+// With CssFragmentCacheMaxBytes set to 0 the factory supplies no fragment
+// cache, and every piece is resolved again.
+TEST_F(CssCombineFilterTest, CombineCssWithoutFragmentCache) {
+  server_context()->set_css_fragment_cache(NULL);
+  SetHtmlMimetype();
+  CombineCss("combine_css_no_fragment_cache", "", "", false);
+  EXPECT_EQ(0, statistics()->GetVariable(
+      CssCombineFilter::kCssCombineFragmentReuses)->Get());
+  EXPECT_EQ(0, statistics()->GetVariable(
+      CssCombineFilter::kCssCombineFragmentMisses)->Get());
+}
+
 
 // http://code.google.com/p/modpagespeed/issues/detail?q=css&id=39
 TEST_F(CssCombineFilterTest, DealWithParams) {
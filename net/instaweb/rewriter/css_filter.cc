@@ -57,6 +57,7 @@
 #include "pagespeed/kernel/base/charset_util.h"
 #include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/null_writer.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
@@ -132,6 +133,7 @@ const char* const kRelatedOptions[] = {
   RewriteOptions::kCssFlattenMaxBytes,
   RewriteOptions::kCssImageInlineMaxBytes,
   RewriteOptions::kCssPreserveURLs,
+  RewriteOptions::kCssStreamingRewrite,
   RewriteOptions::kImagePreserveURLs,
   RewriteOptions::kMaxUrlSegmentSize,
   RewriteOptions::kMaxUrlSize,
@@ -156,6 +158,7 @@ const char CssFilter::kBlocksRewritten[] = "css_filter_blocks_rewritten";
 const char CssFilter::kParseFailures[] = "css_filter_parse_failures";
 const char CssFilter::kFallbackRewrites[] = "css_filter_fallback_rewrites";
 const char CssFilter::kFallbackFailures[] = "css_filter_fallback_failures";
+const char CssFilter::kStreamingRewrites[] = "css_filter_streaming_rewrites";
 const char CssFilter::kRewritesDropped[] = "css_filter_rewrites_dropped";
 const char CssFilter::kTotalBytesSaved[] = "css_filter_total_bytes_saved";
 const char CssFilter::kTotalOriginalBytes[] = "css_filter_total_original_bytes";
@@ -184,6 +187,7 @@ CssFilter::Context::Context(CssFilter* filter, RewriteDriver* driver,
       css_rewritten_(false),
       has_utf8_bom_(false),
       fallback_mode_(false),
+      streaming_mode_(false),
       rewrite_element_(NULL),
       rewrite_inline_element_(NULL),
       rewrite_inline_char_node_(NULL),
@@ -401,12 +405,18 @@ bool CssFilter::Context::RewriteCssText(const GoogleUrl& css_base_gurl,
                                         int64 in_text_size,
                                         bool text_is_declarations,
                                         MessageHandler* handler) {
+  if (StreamingRewriteEnabled() &&
+      StreamingRewriteUrls(css_base_gurl, css_trim_gurl, in_text)) {
+    return true;
+  }
+
   // Load stylesheet w/o expanding background attributes and preserving as
   // much content as possible from the original document.
   Css::Parser parser(in_text);
   parser.set_preservation_mode(true);
   // We avoid quirks-mode so that we do not "fix" something we shouldn't have.
   parser.set_quirks_mode(false);
+  parser.set_arena(&arena_);
   // Create a stylesheet even if given declarations so that we don't need
   // two versions of everything, though they do need to handle a stylesheet
   // with no selectors in it, which they currently do.
@@ -414,8 +424,8 @@ bool CssFilter::Context::RewriteCssText(const GoogleUrl& css_base_gurl,
   if (text_is_declarations) {
     Css::Declarations* declarations = parser.ParseRawDeclarations();
     if (declarations != NULL) {
-      stylesheet.reset(new Css::Stylesheet());
-      Css::Ruleset* ruleset = new Css::Ruleset();
+      stylesheet.reset(new(&arena_) Css::Stylesheet());
+      Css::Ruleset* ruleset = new(&arena_) Css::Ruleset();
       stylesheet->mutable_rulesets().push_back(ruleset);
       ruleset->set_declarations(declarations);
     }
@@ -497,13 +507,6 @@ bool CssFilter::Context::FallbackRewriteUrls(
     const StringPiece& in_text) {
   fallback_mode_ = true;
 
-  // We need permanent copies of these since fallback transformers
-  // keep pointers.
-  base_gurl_for_fallback_.reset(new GoogleUrl());
-  base_gurl_for_fallback_->Reset(css_base_gurl);
-  trim_gurl_for_fallback_.reset(new GoogleUrl());
-  trim_gurl_for_fallback_->Reset(css_trim_gurl);
-
   bool ret = false;
   // In order to rewrite CSS using only the CssTagScanner, we run two scans.
   // Here we just record all URLs found with the CssUrlCounter.
@@ -515,52 +518,104 @@ bool CssFilter::Context::FallbackRewriteUrls(
     // were parseable. If we encounter any unparseable URLs, we will not
     // be able to absolutify them and so should not rewrite the CSS.
     ret = true;
+    RewriteCountedUrls(css_base_gurl, css_trim_gurl, url_counter);
+  }
+  return ret;
+}
 
-    // Setup absolutifier used by fallback_transformer_. Only enable it if
-    // we need to absolutify resources. Otherwise leave it as NULL.
-    bool proxy_mode;
-    if (Driver()->ShouldAbsolutifyUrl(css_base_gurl, css_trim_gurl,
-                                      &proxy_mode)) {
-      absolutifier_.reset(new RewriteDomainTransformer(
-          base_gurl_for_fallback_.get(), trim_gurl_for_fallback_.get(),
-          Driver()));
-      if (proxy_mode) {
-        absolutifier_->set_trim_urls(false);
-      }
+bool CssFilter::Context::StreamingRewriteEnabled() const {
+  const RewriteOptions* options = Driver()->options();
+  return (options->css_streaming_rewrite() &&
+          !Driver()->FlattenCssImportsEnabled() &&
+          (ImageInlineMaxBytes() == 0) &&
+          !options->Enabled(RewriteOptions::kSpriteImages) &&
+          !options->Enabled(RewriteOptions::kPrioritizeCriticalCss));
+}
+
+// Like the fallback path, this takes two scans: here we check that the CSS
+// is simple enough to minify without parsing and record all its URLs, and
+// Harvest() minifies and rewrites the URLs once the subresources have been
+// rewritten.
+bool CssFilter::Context::StreamingRewriteUrls(
+    const GoogleUrl& css_base_gurl, const GoogleUrl& css_trim_gurl,
+    const StringPiece& in_text) {
+  CssUrlCounter url_counter(&css_base_gurl, Driver()->message_handler());
+  NullWriter null_writer;
+  if (!CssTagScanner::TransformUrlsAndMinify(in_text, &null_writer,
+                                             &url_counter,
+                                             Driver()->message_handler())) {
+    return false;
+  }
+  streaming_mode_ = true;
+  RewriteCountedUrls(css_base_gurl, css_trim_gurl, url_counter);
+  return true;
+}
+
+void CssFilter::Context::RewriteCountedUrls(const GoogleUrl& css_base_gurl,
+                                            const GoogleUrl& css_trim_gurl,
+                                            const CssUrlCounter& url_counter) {
+  // We need permanent copies of these since fallback transformers
+  // keep pointers.
+  base_gurl_for_fallback_.reset(new GoogleUrl());
+  base_gurl_for_fallback_->Reset(css_base_gurl);
+  trim_gurl_for_fallback_.reset(new GoogleUrl());
+  trim_gurl_for_fallback_->Reset(css_trim_gurl);
+
+  // Setup absolutifier used by fallback_transformer_. Only enable it if
+  // we need to absolutify resources. Otherwise leave it as NULL.
+  bool proxy_mode;
+  if (Driver()->ShouldAbsolutifyUrl(css_base_gurl, css_trim_gurl,
+                                    &proxy_mode)) {
+    absolutifier_.reset(new RewriteDomainTransformer(
+        base_gurl_for_fallback_.get(), trim_gurl_for_fallback_.get(),
+        Driver()));
+    if (proxy_mode) {
+      absolutifier_->set_trim_urls(false);
+    }
+  }
+  // fallback_transformer_ will be used in the second pass (in Harvest())
+  // to rewrite the URLs.
+  // We instantiate it here so that all the slots below can be set to render
+  // into it. When they are rendered they will set the map used by
+  // AssociationTransformer.
+  fallback_transformer_.reset(new AssociationTransformer(
+      base_gurl_for_fallback_.get(), Driver()->options(), absolutifier_.get(),
+      Driver()->message_handler()));
+
+  const StringIntMap& url_counts = url_counter.url_counts();
+  for (StringIntMap::const_iterator it = url_counts.begin();
+       it != url_counts.end(); ++it) {
+    const GoogleUrl url(it->first);
+    // TODO(sligocki): Use count of occurrences to decide which URLs to
+    // inline. it->second has the count of how many occurrences of this
+    // URL there were.
+    // This is guaranteed by CssUrlCounter.
+    CHECK(url.IsAnyValid()) << it->first;
+    // Add slot.
+    bool is_authorized;
+    ResourcePtr resource = Driver()->CreateInputResource(url, &is_authorized);
+    if (resource.get()) {
+      ResourceSlotPtr slot(new AssociationSlot(
+          resource, fallback_transformer_->map(), url.Spec()));
+      css_image_rewriter_->RewriteSlot(slot, ImageInlineMaxBytes(), this);
+    } else if (!is_authorized) {
+      output_partition(0)->add_debug_message(
+          StrCat("A resource was not rewritten because ", url.Host(),
+                 " is not an authorized domain"));
     }
-    // fallback_transformer_ will be used in the second pass (in Harvest())
-    // to rewrite the URLs.
-    // We instantiate it here so that all the slots below can be set to render
-    // into it. When they are rendered they will set the map used by
-    // AssociationTransformer.
-    fallback_transformer_.reset(new AssociationTransformer(
-        base_gurl_for_fallback_.get(), Driver()->options(), absolutifier_.get(),
-        Driver()->message_handler()));
-
-    const StringIntMap& url_counts = url_counter.url_counts();
-    for (StringIntMap::const_iterator it = url_counts.begin();
-         it != url_counts.end(); ++it) {
-      const GoogleUrl url(it->first);
-      // TODO(sligocki): Use count of occurrences to decide which URLs to
-      // inline. it->second has the count of how many occurrences of this
-      // URL there were.
-      // This is guaranteed by CssUrlCounter.
-      CHECK(url.IsAnyValid()) << it->first;
-      // Add slot.
-      bool is_authorized;
-      ResourcePtr resource = Driver()->CreateInputResource(url, &is_authorized);
-      if (resource.get()) {
-        ResourceSlotPtr slot(new AssociationSlot(
-            resource, fallback_transformer_->map(), url.Spec()));
-        css_image_rewriter_->RewriteSlot(slot, ImageInlineMaxBytes(), this);
-      } else if (!is_authorized) {
-        output_partition(0)->add_debug_message(
-            StrCat("A resource was not rewritten because ", url.Host(),
-                   " is not an authorized domain"));
+  }
+}
+
+bool CssFilter::Context::NestedRewritesOptimized() {
+  for (int i = 0; i < num_nested(); ++i) {
+    RewriteContext* nested_context = nested(i);
+    for (int j = 0; j < nested_context->num_slots(); ++j) {
+      if (nested_context->slot(j)->was_optimized()) {
+        return true;
       }
     }
   }
-  return ret;
+  return false;
 }
 
 void CssFilter::Context::Harvest() {
@@ -589,6 +644,35 @@ void CssFilter::Context::Harvest() {
           css_base_gurl.Spec()));
     }
 
+  } else if (streaming_mode_) {
+    // If CSS was validated for the streaming path instead of being parsed.
+    MessageHandler* handler = Driver()->message_handler();
+    StringPiece contents = input_resource_->contents();
+    StripUtf8Bom(&contents);
+    StringWriter out(&out_text);
+    if (has_utf8_bom_) {
+      out.Write(kUtf8Bom, handler);
+    }
+    GoogleUrl css_base_gurl;
+    GetCssBaseUrlToUse(input_resource_, &css_base_gurl);
+    ok = CssTagScanner::TransformUrlsAndMinify(
+        contents, &out, fallback_transformer_.get(), handler);
+    if (!ok) {
+      output_partition(0)->add_debug_message(StrCat(
+          "CSS rewrite failed: Streaming transformer error in ",
+          css_base_gurl.Spec()));
+    } else {
+      // Moving URLs to another domain or base is worth keeping even if it
+      // did not shrink the CSS.
+      bool previously_optimized =
+          NestedRewritesOptimized() ||
+          (absolutifier_.get() != NULL && absolutifier_->changed_any_url());
+      ok = KeepRewrite(in_text_size_, out_text.size(), previously_optimized,
+                       css_base_gurl);
+      if (ok) {
+        filter_->num_streaming_rewrites_->Add(1);
+      }
+    }
   } else {
     // If we are limiting the size of the flattened result, work that out now;
     // simply rolling up the contents does that nicely.
@@ -600,16 +684,7 @@ void CssFilter::Context::Harvest() {
     // If CSS was successfully parsed.
     hierarchy_.RollUpStylesheets();
 
-    bool previously_optimized = false;
-    for (int i = 0; !previously_optimized && i < num_nested(); ++i) {
-      RewriteContext* nested_context = nested(i);
-      for (int j = 0; j < nested_context->num_slots(); ++j) {
-        if (nested_context->slot(j)->was_optimized()) {
-          previously_optimized = true;
-          break;
-        }
-      }
-    }
+    bool previously_optimized = NestedRewritesOptimized();
 
     GoogleUrl css_base_gurl_to_use;
     GetCssBaseUrlToUse(input_resource_, &css_base_gurl_to_use);
@@ -691,8 +766,6 @@ bool CssFilter::Context::SerializeCss(int64 in_text_size,
                                       bool add_utf8_bom,
                                       GoogleString* out_text,
                                       MessageHandler* handler) {
-  bool ret = true;
-
   // Re-serialize stylesheet.
   StringWriter writer(out_text);
   if (add_utf8_bom) {
@@ -706,16 +779,22 @@ bool CssFilter::Context::SerializeCss(int64 in_text_size,
     CssMinify::Stylesheet(*stylesheet, &writer, handler);
   }
 
-  // Get signed versions so that we can subtract them.
-  int64 out_text_size = static_cast<int64>(out_text->size());
+  return KeepRewrite(in_text_size, out_text->size(), previously_optimized,
+                     css_base_gurl);
+}
+
+bool CssFilter::Context::KeepRewrite(int64 in_text_size, int64 out_text_size,
+                                     bool previously_optimized,
+                                     const GoogleUrl& css_base_gurl) {
+  bool ret = true;
   int64 bytes_saved = in_text_size - out_text_size;
 
   if (!Driver()->options()->always_rewrite_css()) {
     // Don't rewrite if we didn't edit it or make it any smaller.
     if (!previously_optimized && bytes_saved <= 0) {
       ret = false;
-      Driver()->InfoAt(this, "CSS parser increased size of CSS file %s by %s "
-                      "bytes.", css_base_gurl.spec_c_str(),
+      Driver()->InfoAt(this, "CSS rewriting increased size of CSS file %s by "
+                       "%s bytes.", css_base_gurl.spec_c_str(),
                       Integer64ToString(-bytes_saved).c_str());
       filter_->num_rewrites_dropped_->Add(1);
       output_partition(0)->add_debug_message(StrCat(
@@ -842,6 +921,7 @@ CssFilter::CssFilter(RewriteDriver* driver,
   num_parse_failures_ = stats->GetVariable(CssFilter::kParseFailures);
   num_fallback_rewrites_ = stats->GetVariable(CssFilter::kFallbackRewrites);
   num_fallback_failures_ = stats->GetVariable(CssFilter::kFallbackFailures);
+  num_streaming_rewrites_ = stats->GetVariable(CssFilter::kStreamingRewrites);
   num_rewrites_dropped_ = stats->GetVariable(CssFilter::kRewritesDropped);
   total_bytes_saved_ = stats->GetUpDownCounter(CssFilter::kTotalBytesSaved);
   total_original_bytes_ = stats->GetVariable(CssFilter::kTotalOriginalBytes);
@@ -861,6 +941,7 @@ void CssFilter::InitStats(Statistics* statistics) {
   statistics->AddVariable(CssFilter::kParseFailures);
   statistics->AddVariable(CssFilter::kFallbackRewrites);
   statistics->AddVariable(CssFilter::kFallbackFailures);
+  statistics->AddVariable(CssFilter::kStreamingRewrites);
   statistics->AddVariable(CssFilter::kRewritesDropped);
   statistics->AddUpDownCounter(CssFilter::kTotalBytesSaved);
   statistics->AddVariable(CssFilter::kTotalOriginalBytes);
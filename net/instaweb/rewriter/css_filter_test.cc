@@ -1770,6 +1770,30 @@ TEST_F(CssFilterTest, RemoveComments) {
                   " /* This comment will be removed. */ ", "", kExpectSuccess);
 }
 
+TEST_F(CssFilterTest, StreamingRewrite) {
+  const char in_css[] = " a { color : red ; } /* comment */ ";
+  Variable* streaming_rewrites =
+      statistics()->GetVariable(CssFilter::kStreamingRewrites);
+
+  // The streaming path minifies without parsing, so it cannot tell that the
+  // space before the colon is insignificant.
+  options()->ClearSignatureForTesting();
+  options()->set_css_streaming_rewrite(true);
+  server_context()->ComputeSignature(options());
+  ValidateRewriteExternalCss("streaming", in_css, "a{color :red}",
+                             kExpectSuccess);
+  EXPECT_EQ(1, streaming_rewrites->Get());
+
+  // Spriting needs the parsed stylesheet, so it turns the streaming path off.
+  options()->ClearSignatureForTesting();
+  options()->EnableFilter(RewriteOptions::kSpriteImages);
+  server_context()->ComputeSignature(options());
+  streaming_rewrites->Clear();
+  ValidateRewriteExternalCss("not_streaming", in_css, "a{color:red}",
+                             kExpectSuccess);
+  EXPECT_EQ(0, streaming_rewrites->Get());
+}
+
 TEST_F(CssFilterTest, NoQuirksModeFixes) {
   const char in_css[]  = "body {color:DECAFB}";
   const char out_css[] = "body{color:DECAFB}";
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/css_fragment_cache.h"
+
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/thread_system.h"
+
+namespace net_instaweb {
+
+CssFragmentCache::CssFragmentCache(size_t max_bytes,
+                                   ThreadSystem* thread_system)
+    : mutex_(thread_system->NewMutex()),
+      lru_(max_bytes, &helper_) {
+}
+
+CssFragmentCache::~CssFragmentCache() {
+}
+
+bool CssFragmentCache::Lookup(const GoogleString& key,
+                              SharedString* fragment) {
+  ScopedMutex lock(mutex_.get());
+  SharedString* cached = lru_.GetFreshen(key);
+  if (cached == NULL) {
+    return false;
+  }
+  *fragment = *cached;
+  return true;
+}
+
+void CssFragmentCache::Insert(const GoogleString& key,
+                              const SharedString& fragment) {
+  SharedString value(fragment);
+  ScopedMutex lock(mutex_.get());
+  lru_.Put(key, &value);
+}
+
+size_t CssFragmentCache::size_bytes() const {
+  ScopedMutex lock(mutex_.get());
+  return lru_.size_bytes();
+}
+
+size_t CssFragmentCache::num_elements() const {
+  ScopedMutex lock(mutex_.get());
+  return lru_.num_elements();
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit tests for CssFragmentCache.
+
+#include "net/instaweb/rewriter/public/css_fragment_cache.h"
+
+#include <cstddef>
+
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/util/platform.h"
+
+namespace net_instaweb {
+
+namespace {
+
+class CssFragmentCacheTest : public testing::Test {
+ protected:
+  CssFragmentCacheTest()
+      : thread_system_(Platform::CreateThreadSystem()) {
+  }
+
+  scoped_ptr<ThreadSystem> thread_system_;
+};
+
+TEST_F(CssFragmentCacheTest, LookupSharesInsertedBytes) {
+  CssFragmentCache cache(1024, thread_system_.get());
+  SharedString fragment;
+  EXPECT_FALSE(cache.Lookup("a", &fragment));
+
+  SharedString inserted(".a{color:red}");
+  cache.Insert("a", inserted);
+  ASSERT_TRUE(cache.Lookup("a", &fragment));
+  EXPECT_EQ(".a{color:red}", fragment.Value());
+  EXPECT_EQ(inserted.data(), fragment.data());
+  EXPECT_EQ(static_cast<size_t>(1), cache.num_elements());
+}
+
+TEST_F(CssFragmentCacheTest, EvictsLeastRecentlyUsed) {
+  // Room for two entries of a one-byte key and a nine-byte fragment.
+  CssFragmentCache cache(20, thread_system_.get());
+  cache.Insert("a", SharedString(".a{x:1;}\n"));
+  cache.Insert("b", SharedString(".b{x:1;}\n"));
+  SharedString fragment;
+  ASSERT_TRUE(cache.Lookup("a", &fragment));
+
+  cache.Insert("c", SharedString(".c{x:1;}\n"));
+  EXPECT_TRUE(cache.Lookup("a", &fragment));
+  EXPECT_FALSE(cache.Lookup("b", &fragment));
+  EXPECT_TRUE(cache.Lookup("c", &fragment));
+  EXPECT_EQ(static_cast<size_t>(20), cache.size_bytes());
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -40,13 +40,28 @@
 // BM_EscapeStringSuperSpecial/64        1941       1947     361238
 // BM_EscapeStringSuperSpecial/512      13333      13375      51935
 // BM_EscapeStringSuperSpecial/4k      105527     105909       6768
+//
+// BM_MinifyCss and BM_MinifyCssArena also report MB/s.  The parse trees of
+// their inputs take this many allocations: one per node on the heap, versus
+// one per 32KB block in an arena:
+//                  64    512     4k    32k   256k
+// heap              1     27    482   3562  31094
+// arena             1      1      2      9     79
+//
+// BM_ParseAndMinifyConsoleCss and BM_StreamMinifyConsoleCss compare CssFilter's
+// two ways of minifying a whole stylesheet; on a Xeon the streaming path is
+// about 7x faster than just parsing (~130 MB/s vs. ~19 MB/s).
 
+#include "base/logging.h"
 #include "net/instaweb/rewriter/public/css_minify.h"
+#include "net/instaweb/rewriter/public/css_tag_scanner.h"
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/benchmark.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_writer.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/parser.h"
 #include "webutil/css/tostring.h"
 
@@ -56,7 +71,9 @@ extern const char* CSS_console_css;
 
 namespace {
 
-static void BM_MinifyCss(int iters, int size) {
+// Parses and minifies size bytes of CSS iters times, with the parse tree
+// either on the heap or in an arena.
+static void MinifyCss(int iters, int size, bool use_arena) {
   GoogleString in_text;
   for (int i = 0; i < size; i += strlen(CSS_console_css)) {
     in_text += CSS_console_css;
@@ -65,18 +82,77 @@ static void BM_MinifyCss(int iters, int size) {
 
   NullMessageHandler handler;
   for (int i = 0; i < iters; ++i) {
+    Css::Arena arena;
     Css::Parser parser(in_text);
     parser.set_preservation_mode(true);
     parser.set_quirks_mode(false);
+    if (use_arena) {
+      parser.set_arena(&arena);
+    }
     scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
 
     GoogleString result;
     StringWriter writer(&result);
     CssMinify::Stylesheet(*stylesheet, &writer, &handler);
   }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * size);
+}
+
+static void BM_MinifyCss(int iters, int size) {
+  MinifyCss(iters, size, false);
 }
 BENCHMARK_RANGE(BM_MinifyCss, 1<<6, 1<<18);
 
+static void BM_MinifyCssArena(int iters, int size) {
+  MinifyCss(iters, size, true);
+}
+BENCHMARK_RANGE(BM_MinifyCssArena, 1<<6, 1<<18);
+
+// Leaves all URLs alone, so that only scanning and minification are timed.
+class NoChangeTransformer : public CssTagScanner::Transformer {
+ public:
+  NoChangeTransformer() {}
+  virtual TransformStatus Transform(GoogleString* str) { return kNoChange; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NoChangeTransformer);
+};
+
+// Parses and minifies the whole console stylesheet, as CssFilter does.
+static void BM_ParseAndMinifyConsoleCss(int iters) {
+  StringPiece in_text(CSS_console_css);
+  NullMessageHandler handler;
+  for (int i = 0; i < iters; ++i) {
+    Css::Arena arena;
+    Css::Parser parser(in_text);
+    parser.set_preservation_mode(true);
+    parser.set_quirks_mode(false);
+    parser.set_arena(&arena);
+    scoped_ptr<Css::Stylesheet> stylesheet(parser.ParseRawStylesheet());
+
+    GoogleString result;
+    StringWriter writer(&result);
+    CssMinify::Stylesheet(*stylesheet, &writer, &handler);
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * in_text.size());
+}
+BENCHMARK(BM_ParseAndMinifyConsoleCss);
+
+// Minifies the same stylesheet in CssFilter's streaming mode.
+static void BM_StreamMinifyConsoleCss(int iters) {
+  StringPiece in_text(CSS_console_css);
+  NullMessageHandler handler;
+  NoChangeTransformer transformer;
+  for (int i = 0; i < iters; ++i) {
+    GoogleString result;
+    StringWriter writer(&result);
+    CHECK(CssTagScanner::TransformUrlsAndMinify(in_text, &writer, &transformer,
+                                                &handler));
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * in_text.size());
+}
+BENCHMARK(BM_StreamMinifyConsoleCss);
+
 // Common-case, all chars are normal alpha-num that don't need to be escaped.
 static void BM_EscapeStringNormal(int iters, int size) {
   GoogleString ident(size, 'A');
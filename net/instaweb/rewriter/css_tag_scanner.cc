@@ -256,6 +256,159 @@ bool WriteRange(const char* out_begin, const char* out_end,
   }
 }
 
+inline bool IsCssSpace(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') ||
+      (c == '\f');
+}
+
+// Can c start something other than a run of bytes TransformUrlsAndMinify
+// copies through as-is?
+inline bool IsMinifierSpecialChar(char c) {
+  switch (c) {
+    case '{': case '}': case ';': case ',': case '>': case ':':
+    case '(': case ')': case '"': case '\'': case '\\': case '/':
+    case '@': case 'u':
+      return true;
+    default:
+      return IsCssSpace(c);
+  }
+}
+
+inline bool IsCssNameChar(char c) {
+  return IsAsciiAlphaNumeric(c) || (c == '-') || (c == '_') ||
+      (static_cast<unsigned char>(c) >= 0x80);
+}
+
+// Finds the end of the string starting with the quote at the front of in,
+// returning the length of the string including both quotes, or 0 if the
+// string is not terminated on the same line.
+size_t CssStringLength(const StringPiece& in) {
+  char quote = in[0];
+  for (size_t i = 1, n = in.size(); i < n; ++i) {
+    char c = in[i];
+    if (c == quote) {
+      return i + 1;
+    } else if (c == '\\') {
+      ++i;  // Skip the escaped character, which may be a newline.
+    } else if ((c == '\n') || (c == '\r') || (c == '\f')) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+// Writes a stream of CSS tokens with the whitespace and comments between
+// them reduced to the minimum needed to keep the tokens apart.  Output is
+// buffered in chunks of at most kBufferSize bytes.
+class MinifyingCssWriter {
+ public:
+  MinifyingCssWriter(Writer* writer, MessageHandler* handler)
+      : writer_(writer),
+        handler_(handler),
+        ok_(true),
+        at_start_(true),
+        after_delimiter_(false),
+        pending_space_(false),
+        pending_semicolon_(false) {
+  }
+
+  // Whitespace or a comment separates the previous token from the next one.
+  void Space() { pending_space_ = true; }
+  void Comment(const StringPiece& comment) {
+    // A comment directly between two tokens keeps them from running
+    // together without making them whitespace-separated, so in that one
+    // case we must keep it.  Otherwise it can go.
+    if (!pending_space_ && pending_comment_.empty()) {
+      pending_comment_ = comment;
+    }
+  }
+
+  // One of { } ; , > -- whitespace is never needed on either side of these.
+  // A ; right before a } is redundant and is dropped.
+  void Delimiter(char c) {
+    FlushSemicolon(c == '}');
+    ClearSeparators();
+    if (c == ';') {
+      pending_semicolon_ = true;
+    } else {
+      Emit(StringPiece(&c, 1));
+    }
+    after_delimiter_ = true;
+  }
+
+  // Whitespace is never needed after a colon, but may be before one:
+  // "a :hover" is not the same selector as "a:hover".
+  void Colon() {
+    Token(":");
+    after_delimiter_ = true;
+  }
+
+  // Any other token, written verbatim.
+  void Token(const StringPiece& token) {
+    FlushSemicolon(false);
+    if (!at_start_ && !after_delimiter_) {
+      if (pending_space_) {
+        Emit(" ");
+      } else if (!pending_comment_.empty()) {
+        Emit(pending_comment_);
+      }
+    }
+    ClearSeparators();
+    Emit(token);
+    after_delimiter_ = false;
+  }
+
+  // Writes out any buffered output.  Trailing whitespace is dropped.
+  bool Finish() {
+    FlushSemicolon(false);
+    ok_ = ok_ && writer_->Write(buffer_, handler_);
+    buffer_.clear();
+    return ok_;
+  }
+
+ private:
+  static const size_t kBufferSize = 8192;
+
+  void ClearSeparators() {
+    pending_space_ = false;
+    pending_comment_.clear();
+  }
+
+  void FlushSemicolon(bool drop) {
+    if (pending_semicolon_) {
+      pending_semicolon_ = false;
+      if (!drop) {
+        Emit(";");
+      }
+    }
+  }
+
+  void Emit(const StringPiece& bytes) {
+    at_start_ = false;
+    if (buffer_.size() + bytes.size() > kBufferSize) {
+      ok_ = ok_ && writer_->Write(buffer_, handler_);
+      buffer_.clear();
+      if (bytes.size() > kBufferSize) {
+        ok_ = ok_ && writer_->Write(bytes, handler_);
+        return;
+      }
+    }
+    bytes.AppendToString(&buffer_);
+  }
+
+  Writer* writer_;
+  MessageHandler* handler_;
+  GoogleString buffer_;
+  bool ok_;
+  bool at_start_;
+  bool after_delimiter_;
+  bool pending_space_;
+  bool pending_semicolon_;
+  StringPiece pending_comment_;
+
+  DISALLOW_COPY_AND_ASSIGN(MinifyingCssWriter);
+};
+
 }  // namespace
 
 bool CssTagScanner::TransformUrls(
@@ -372,6 +525,196 @@ bool CssTagScanner::TransformUrls(
   return ok;
 }
 
+bool CssTagScanner::TransformUrlsAndMinify(
+    const StringPiece& contents, Writer* writer, Transformer* transformer,
+    MessageHandler* handler) {
+  MinifyingCssWriter out(writer, handler);
+  GoogleString url;
+  int brace_depth = 0;
+  int paren_depth = 0;
+
+  // Bytes which are copied through as-is accumulate in [run_begin, p).
+  const char* run_begin = contents.data();
+  const char* p = contents.data();
+  const char* end = contents.data() + contents.size();
+  while (p < end) {
+    char c = *p;
+    if (!IsMinifierSpecialChar(c)) {
+      ++p;
+      continue;
+    }
+    if (p > run_begin) {
+      out.Token(StringPiece(run_begin, p - run_begin));
+    }
+    StringPiece remaining(p, end - p);
+    size_t consumed = 1;
+    switch (c) {
+      case '{':
+        ++brace_depth;
+        out.Delimiter(c);
+        break;
+      case '}':
+        if (--brace_depth < 0) {
+          return false;
+        }
+        out.Delimiter(c);
+        break;
+      case ';':
+      case ',':
+      case '>':
+        out.Delimiter(c);
+        break;
+      case ':':
+        out.Colon();
+        break;
+      case '(':
+        ++paren_depth;
+        out.Token(remaining.substr(0, 1));
+        break;
+      case ')':
+        if (--paren_depth < 0) {
+          return false;
+        }
+        out.Token(remaining.substr(0, 1));
+        break;
+      case '"':
+      case '\'':
+        consumed = CssStringLength(remaining);
+        if (consumed == 0) {
+          return false;
+        }
+        out.Token(remaining.substr(0, consumed));
+        break;
+      case '\\':
+        if (remaining.size() < 2) {
+          return false;
+        }
+        consumed = 2;
+        out.Token(remaining.substr(0, consumed));
+        break;
+      case '/':
+        if (remaining.starts_with("/*")) {
+          size_t close = remaining.find("*/", 2);
+          if (close == StringPiece::npos) {
+            return false;
+          }
+          consumed = close + 2;
+          out.Comment(remaining.substr(0, consumed));
+        } else {
+          out.Token(remaining.substr(0, 1));
+        }
+        break;
+      default: {
+        if (IsCssSpace(c)) {
+          out.Space();
+          break;
+        }
+        // At @import or url( we may have a URL to transform; the rest is
+        // copied through as in TransformUrls.  Anything that isn't one of
+        // those is a run of ordinary bytes, which continues below.
+        enum { kNone, kImport, kUrl } have_url = kNone;
+        char quote = '\0';
+        StringPiece rest = remaining;
+        StringPiece import_string;
+        if ((c == '@') && EatLiteral("@import", &rest)) {
+          // As in TransformUrls, only @import "foo" is handled here;
+          // @import url(foo) is handled as a url( when we get to it.
+          StringPiece after_import = rest;
+          TrimLeadingWhitespace(&after_import);
+          if (!after_import.empty() &&
+              ((after_import[0] == '"') || (after_import[0] == '\''))) {
+            const char* string_begin = after_import.data();
+            bool have_term_quote;
+            if (!CssExtractString(&after_import, &url, &quote,
+                                  &have_term_quote) ||
+                !have_term_quote) {
+              return false;
+            }
+            import_string = StringPiece(
+                string_begin, after_import.data() - string_begin);
+            rest = after_import;
+            have_url = kImport;
+          }
+        } else if ((c == 'u') &&
+                   ((p == contents.data()) || !IsCssNameChar(p[-1])) &&
+                   EatLiteral("url(", &rest)) {
+          TrimLeadingWhitespace(&rest);
+          bool have_term;
+          if (!rest.empty() && ((rest[0] == '"') || (rest[0] == '\''))) {
+            if (!CssExtractString(&rest, &url, &quote, &have_term) ||
+                !have_term) {
+              return false;
+            }
+            TrimLeadingWhitespace(&rest);
+            if (!EatLiteral(")", &rest)) {
+              return false;
+            }
+          } else {
+            GoogleString wrapped_url;
+            if (!CssExtractUntil(false, ')', &rest, &wrapped_url,
+                                 &have_term)) {
+              return false;
+            }
+            TrimWhitespace(wrapped_url, &url);
+          }
+          have_url = kUrl;
+        }
+
+        if (have_url == kNone) {
+          // Not a URL after all, just the start of a run of ordinary bytes.
+          run_begin = p;
+          ++p;
+          continue;
+        }
+        consumed = rest.data() - p;
+        switch (transformer->Transform(&url)) {
+          case Transformer::kSuccess: {
+            GoogleString quoted_url;
+            if (quote != '\0') {
+              quoted_url.push_back(quote);
+            }
+            quoted_url += Css::EscapeUrl(url);
+            if (quote != '\0') {
+              quoted_url.push_back(quote);
+            }
+            if (have_url == kImport) {
+              out.Token("@import");
+              out.Space();
+              out.Token(quoted_url);
+            } else {
+              out.Token(StrCat("url(", quoted_url, ")"));
+            }
+            break;
+          }
+          case Transformer::kFailure:
+            handler->Message(kWarning,
+                             "Transform failed for url %s", url.c_str());
+            return false;
+          case Transformer::kNoChange:
+            if (have_url == kImport) {
+              out.Token("@import");
+              out.Space();
+              out.Token(import_string);
+            } else {
+              out.Token(remaining.substr(0, consumed));
+            }
+            break;
+        }
+        break;
+      }
+    }
+    p += consumed;
+    run_begin = p;
+  }
+  if (p > run_begin) {
+    out.Token(StringPiece(run_begin, p - run_begin));
+  }
+  if ((brace_depth != 0) || (paren_depth != 0)) {
+    return false;
+  }
+  return out.Finish();
+}
+
 bool CssTagScanner::HasImport(const StringPiece& contents,
                               MessageHandler* handler) {
   // Search for case insensitive @import.
@@ -427,6 +770,7 @@ RewriteDomainTransformer::RewriteDomainTransformer(
       url_trim_filter_(driver->url_trim_filter()),
       handler_(driver->message_handler()),
       trim_urls_(true),
+      changed_any_url_(false),
       driver_(driver) {
 }
 
@@ -463,6 +807,7 @@ CssTagScanner::Transformer::TransformStatus RewriteDomainTransformer::Transform(
     return kNoChange;
   } else {
     str->swap(out);
+    changed_any_url_ = true;
     return kSuccess;
   }
 }
@@ -294,6 +294,26 @@ class RewriteDomainTransformerTest : public RewriteTestBase {
     return output_buffer;
   }
 
+  // As Transform, but with TransformUrlsAndMinify, which may fail.
+  bool TransformAndMinify(const StringPiece& input, GoogleString* output) {
+    StringWriter output_writer(output);
+    RewriteDomainTransformer transformer(&old_base_url_, &new_base_url_,
+                                         rewrite_driver());
+    return CssTagScanner::TransformUrlsAndMinify(
+        input, &output_writer, &transformer, message_handler());
+  }
+
+  GoogleString Minify(const StringPiece& input) {
+    GoogleString output;
+    EXPECT_TRUE(TransformAndMinify(input, &output)) << input;
+    return output;
+  }
+
+  void ExpectMinifyFails(const StringPiece& input) {
+    GoogleString output;
+    EXPECT_FALSE(TransformAndMinify(input, &output)) << input;
+  }
+
  private:
   GoogleUrl old_base_url_;
   GoogleUrl new_base_url_;
@@ -431,6 +451,66 @@ TEST_F(RewriteDomainTransformerTest, ImportSQuoteDQuote) {
       Transform("a @import 'style.css'\"screen\";"));
 }
 
+TEST_F(RewriteDomainTransformerTest, MinifyWhitespaceAndComments) {
+  EXPECT_STREQ("", Minify("  /* nothing */  "));
+  EXPECT_STREQ("a,b>c{color:red;margin:0 auto}",
+               Minify("  a , b > c {\n  color: red;\n  margin:0  auto;\n}\n"));
+  EXPECT_STREQ("@media screen{a{b:c}}",
+               Minify("@media screen { a { b: c ; } }"));
+  EXPECT_STREQ("a b{c:d}", Minify("a /* x */ b /* y */ { c:d }"));
+  EXPECT_STREQ("a :hover{}", Minify("a :hover {}"));
+}
+
+TEST_F(RewriteDomainTransformerTest, MinifyKeepsSignificantBytes) {
+  // Strings and escapes are copied verbatim, and a comment that is all that
+  // separates two tokens is kept.
+  EXPECT_STREQ("p{content:'  ;  } /* '}",
+               Minify("p { content: '  ;  } /* ' }"));
+  EXPECT_STREQ("a\\, b{c:d}", Minify("a\\, b { c:d }"));
+  EXPECT_STREQ("a/**/b{}", Minify("a/**/b {}"));
+  EXPECT_STREQ("a{b:c;}", Minify("a{b:c;;}"));
+}
+
+TEST_F(RewriteDomainTransformerTest, MinifyTransformsUrls) {
+  EXPECT_STREQ("a{b:url(http://old-base.com/x.png) 0 0}",
+               Minify("a { b: url( x.png ) 0 0; }"));
+  EXPECT_STREQ("a{b:url('http://old-base.com/x.png')}",
+               Minify("a { b: url( 'x.png' ) }"));
+  EXPECT_STREQ("@import 'http://old-base.com/a.css' screen;"
+               "@import url(http://old-base.com/b.css);",
+               Minify("@import  'a.css'  screen ;\n@import url(b.css);"));
+  // Not a URL: inside a string or comment, or part of a longer name.
+  EXPECT_STREQ("a{b:'url(x.png)'}", Minify("a { b: 'url(x.png)' /*url(y)*/}"));
+  EXPECT_STREQ("a{b:myurl(x.png)}", Minify("a { b: myurl(x.png) }"));
+}
+
+TEST_F(RewriteDomainTransformerTest, ChangedAnyUrl) {
+  GoogleUrl old_base_url("http://old-base.com/");
+  GoogleUrl new_base_url("http://new-base.com/");
+  RewriteDomainTransformer transformer(&old_base_url, &new_base_url,
+                                       rewrite_driver());
+  GoogleString out;
+  StringWriter writer(&out);
+  EXPECT_TRUE(CssTagScanner::TransformUrls(
+      "a url(http://other_base/image.png) b", &writer, &transformer,
+      message_handler()));
+  EXPECT_FALSE(transformer.changed_any_url());
+  EXPECT_TRUE(CssTagScanner::TransformUrls(
+      "a url(image.png) b", &writer, &transformer, message_handler()));
+  EXPECT_TRUE(transformer.changed_any_url());
+}
+
+TEST_F(RewriteDomainTransformerTest, MinifyRejectsUnsafeCss) {
+  ExpectMinifyFails("a { b: c");
+  ExpectMinifyFails("a } b {");
+  ExpectMinifyFails("a { b: rgb(1, 2 }");
+  ExpectMinifyFails("a { b: 'c }\n");
+  ExpectMinifyFails("a { b: c } /* d");
+  ExpectMinifyFails("a { b: url(c }");
+  ExpectMinifyFails("a { b: url('c' d) }");
+  ExpectMinifyFails("a\\");
+}
+
 class FailTransformer : public CssTagScanner::Transformer {
  public:
   FailTransformer() {}
@@ -451,6 +531,8 @@ TEST(FailTransformerTest, TransformUrlsFails) {
   FailTransformer fail_transformer;
   EXPECT_FALSE(CssTagScanner::TransformUrls("url(foo)", &writer,
                                             &fail_transformer, &handler));
+  EXPECT_FALSE(CssTagScanner::TransformUrlsAndMinify(
+      "a{b:url(foo)}", &writer, &fail_transformer, &handler));
 }
 
 }  // namespace
@@ -0,0 +1,269 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/instaweb/rewriter/public/decoded_image_cache.h"
+
+#include <cstdlib>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/condvar.h"
+#include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/timer.h"
+#include "pagespeed/kernel/image/read_image.h"
+#include "pagespeed/kernel/image/scanline_interface.h"
+#include "pagespeed/kernel/image/scanline_status.h"
+#include "pagespeed/kernel/image/scanline_utils.h"
+
+namespace net_instaweb {
+
+using pagespeed::image_compression::GetNumChannelsFromPixelFormat;
+using pagespeed::image_compression::ImageFormat;
+using pagespeed::image_compression::PixelFormat;
+using pagespeed::image_compression::ReadImage;
+using pagespeed::image_compression::SCANLINE_STATUS_INVOCATION_ERROR;
+using pagespeed::image_compression::SCANLINE_STATUS_SUCCESS;
+using pagespeed::image_compression::SCANLINE_UTIL;
+using pagespeed::image_compression::ScanlineReaderInterface;
+using pagespeed::image_compression::ScanlineStatus;
+
+namespace {
+
+// Scans a DecodedImage one row at a time, handing out pointers into the
+// shared raster rather than copies.
+class DecodedImageReader : public ScanlineReaderInterface {
+ public:
+  DecodedImageReader(DecodedImage* image, MessageHandler* handler)
+      : image_(image), row_(0), handler_(handler) {}
+  virtual ~DecodedImageReader() {}
+
+  virtual bool Reset() {
+    row_ = 0;
+    return true;
+  }
+
+  virtual size_t GetBytesPerScanline() {
+    return image_->width() *
+        GetNumChannelsFromPixelFormat(image_->pixel_format(), handler_);
+  }
+
+  virtual bool HasMoreScanLines() {
+    return row_ < image_->height();
+  }
+
+  virtual ScanlineStatus InitializeWithStatus(const void* image_buffer,
+                                              size_t buffer_length) {
+    return PS_LOGGED_STATUS(PS_LOG_DFATAL, handler_,
+                            SCANLINE_STATUS_INVOCATION_ERROR,
+                            SCANLINE_UTIL,
+                            "Unexpected call to InitializeWithStatus()");
+  }
+
+  virtual ScanlineStatus ReadNextScanlineWithStatus(
+      void** out_scanline_bytes) {
+    if (!HasMoreScanLines()) {
+      return PS_LOGGED_STATUS(PS_LOG_DFATAL, handler_,
+                              SCANLINE_STATUS_INVOCATION_ERROR,
+                              SCANLINE_UTIL,
+                              "The decoded image has no more scanlines.");
+    }
+    // The writers which consume this take a non-const pointer but do not
+    // modify the scanline.
+    *out_scanline_bytes = const_cast<uint8*>(
+        image_->pixels() + row_ * image_->stride());
+    ++row_;
+    return ScanlineStatus(SCANLINE_STATUS_SUCCESS);
+  }
+
+  virtual size_t GetImageHeight() { return image_->height(); }
+  virtual size_t GetImageWidth() { return image_->width(); }
+  virtual PixelFormat GetPixelFormat() { return image_->pixel_format(); }
+
+  // Progressiveness is a property of the encoding, which is gone by now.
+  virtual bool IsProgressive() { return false; }
+
+ private:
+  DecodedImagePtr image_;
+  size_t row_;
+  MessageHandler* handler_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedImageReader);
+};
+
+}  // namespace
+
+const char DecodedImageCache::kDecodedImageCacheHits[] =
+    "decoded_image_cache_hits";
+const char DecodedImageCache::kDecodedImageCacheMisses[] =
+    "decoded_image_cache_misses";
+const char DecodedImageCache::kDecodedImageCacheWaits[] =
+    "decoded_image_cache_waits";
+const char DecodedImageCache::kDecodedImageCacheWaitTimeouts[] =
+    "decoded_image_cache_wait_timeouts";
+
+DecodedImage::DecodedImage(void* pixels, PixelFormat pixel_format,
+                           size_t width, size_t height, size_t stride,
+                           int64 decoded_ms)
+    : pixels_(static_cast<uint8*>(pixels)),
+      pixel_format_(pixel_format),
+      width_(width),
+      height_(height),
+      stride_(stride),
+      decoded_ms_(decoded_ms) {
+}
+
+DecodedImage::~DecodedImage() {
+  free(pixels_);
+}
+
+ScanlineReaderInterface* DecodedImage::NewReader(MessageHandler* handler) {
+  return new DecodedImageReader(this, handler);
+}
+
+DecodedImageCache::DecodedImageCache(size_t max_bytes, int64 ttl_ms,
+                                     ThreadSystem* thread_system, Timer* timer,
+                                     Statistics* stats)
+    : ttl_ms_(ttl_ms),
+      timer_(timer),
+      mutex_(thread_system->NewMutex()),
+      decode_done_(mutex_->NewCondvar()),
+      lru_(max_bytes, &helper_),
+      hits_(stats->GetVariable(kDecodedImageCacheHits)),
+      misses_(stats->GetVariable(kDecodedImageCacheMisses)),
+      waits_(stats->GetVariable(kDecodedImageCacheWaits)),
+      wait_timeouts_(stats->GetVariable(kDecodedImageCacheWaitTimeouts)) {
+}
+
+DecodedImageCache::~DecodedImageCache() {
+  DCHECK(decodes_in_progress_.empty());
+}
+
+void DecodedImageCache::InitStats(Statistics* statistics) {
+  statistics->AddVariable(kDecodedImageCacheHits);
+  statistics->AddVariable(kDecodedImageCacheMisses);
+  statistics->AddVariable(kDecodedImageCacheWaits);
+  statistics->AddVariable(kDecodedImageCacheWaitTimeouts);
+}
+
+DecodedImagePtr DecodedImageCache::LookupLocked(const GoogleString& key) {
+  DecodedImagePtr* cached = lru_.GetFreshen(key);
+  if (cached == NULL) {
+    return DecodedImagePtr();
+  }
+  if (IsExpired(*cached, timer_->NowMs())) {
+    lru_.Delete(key);
+    return DecodedImagePtr();
+  }
+  return *cached;
+}
+
+bool DecodedImageCache::WaitForDecodeLocked(const GoogleString& key,
+                                            int64 max_wait_ms) {
+  if (decodes_in_progress_.find(key) == decodes_in_progress_.end()) {
+    return true;
+  }
+  waits_->Add(1);
+  int64 now_ms = timer_->NowMs();
+  const int64 end_ms = now_ms + max_wait_ms;
+  while (decodes_in_progress_.find(key) != decodes_in_progress_.end()) {
+    if (max_wait_ms < 0) {
+      decode_done_->Wait();
+    } else if (now_ms >= end_ms) {
+      return false;
+    } else {
+      decode_done_->TimedWait(end_ms - now_ms);
+      now_ms = timer_->NowMs();
+    }
+  }
+  return true;
+}
+
+void DecodedImageCache::DropExpiredLocked() {
+  const int64 now_ms = timer_->NowMs();
+  StringVector expired;
+  for (Lru::Iterator p = lru_.Begin(), e = lru_.End(); p != e; ++p) {
+    if (IsExpired(p.Value(), now_ms)) {
+      expired.push_back(p.Key());
+    }
+  }
+  for (int i = 0, n = expired.size(); i < n; ++i) {
+    lru_.Delete(expired[i]);
+  }
+}
+
+DecodedImagePtr DecodedImageCache::Decode(const GoogleString& key,
+                                          ImageFormat format,
+                                          const StringPiece& contents,
+                                          int64 max_wait_ms,
+                                          MessageHandler* handler) {
+  bool shared = true;
+  {
+    ScopedMutex lock(mutex_.get());
+    if (WaitForDecodeLocked(key, max_wait_ms)) {
+      DecodedImagePtr image = LookupLocked(key);
+      if (image.get() != NULL) {
+        hits_->Add(1);
+        return image;
+      }
+      // Either nobody decoded this yet, or the decode we waited for failed
+      // or was too large to keep.  Decode it ourselves.
+      decodes_in_progress_.insert(key);
+    } else {
+      // The decode under way is taking longer than our caller can wait, so
+      // decode a private copy, leaving the cache to that decode.
+      wait_timeouts_->Add(1);
+      shared = false;
+    }
+    misses_->Add(1);
+  }
+
+  void* pixels = NULL;
+  PixelFormat pixel_format = pagespeed::image_compression::UNSUPPORTED;
+  size_t width = 0;
+  size_t height = 0;
+  size_t stride = 0;
+  DecodedImagePtr image;
+  if (ReadImage(format, contents.data(), contents.size(), &pixels,
+                &pixel_format, &width, &height, &stride, handler)) {
+    image.reset(new DecodedImage(pixels, pixel_format, width, height, stride,
+                                 timer_->NowMs()));
+  }
+  if (!shared) {
+    return image;
+  }
+
+  ScopedMutex lock(mutex_.get());
+  DropExpiredLocked();
+  if (image.get() != NULL) {
+    lru_.Put(key, &image);
+  }
+  decodes_in_progress_.erase(key);
+  decode_done_->Broadcast();
+  return image;
+}
+
+size_t DecodedImageCache::size_bytes() const {
+  ScopedMutex lock(mutex_.get());
+  return lru_.size_bytes();
+}
+
+size_t DecodedImageCache::num_elements() const {
+  ScopedMutex lock(mutex_.get());
+  return lru_.num_elements();
+}
+
+}  // namespace net_instaweb
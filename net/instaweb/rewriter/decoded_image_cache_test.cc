@@ -0,0 +1,224 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit tests for DecodedImageCache.
+
+#include "net/instaweb/rewriter/public/decoded_image_cache.h"
+
+#include "net/instaweb/rewriter/cached_result.pb.h"
+#include "net/instaweb/rewriter/public/image.h"
+#include "net/instaweb/rewriter/public/image_test_base.h"
+#include "net/instaweb/rewriter/public/rewrite_options.h"
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/base/timer.h"
+#include "pagespeed/kernel/image/image_util.h"
+#include "pagespeed/kernel/image/scanline_interface.h"
+#include "pagespeed/kernel/util/platform.h"
+#include "pagespeed/kernel/util/simple_stats.h"
+
+namespace net_instaweb {
+
+namespace {
+
+using pagespeed::image_compression::IMAGE_JPEG;
+using pagespeed::image_compression::IMAGE_PNG;
+using pagespeed::image_compression::ScanlineReaderInterface;
+
+const char kPuzzleKey[] = "puzzle-hash";
+const int64 kNoWaitLimit = -1;
+
+class DecodedImageCacheTest : public ImageTestBase {
+ protected:
+  DecodedImageCacheTest()
+      : thread_system_(Platform::CreateThreadSystem()),
+        stats_(thread_system_.get()) {
+    DecodedImageCache::InitStats(&stats_);
+    cache_.reset(NewCache(RewriteOptions::kDefaultDecodedImageCacheMaxBytes));
+  }
+
+  DecodedImageCache* NewCache(size_t max_bytes) {
+    return new DecodedImageCache(max_bytes,
+                                 RewriteOptions::kDefaultDecodedImageCacheTtlMs,
+                                 thread_system_.get(), &timer_, &stats_);
+  }
+
+  void ReadTestImage(const char* name, GoogleString* contents) {
+    ASSERT_TRUE(file_system_.ReadFile(
+        StrCat(GTestSrcDir(), kTestData, name).c_str(), contents,
+        &message_handler_));
+  }
+
+  // Resizes the Puzzle image to width x height and returns the output,
+  // going through cache_ if use_cache is set.
+  GoogleString ResizePuzzle(int width, int height, bool use_cache) {
+    Image::CompressionOptions* options = new Image::CompressionOptions;
+    if (use_cache) {
+      options->decoded_image_cache = cache_.get();
+      options->decoded_image_key = kPuzzleKey;
+    }
+    GoogleString contents;
+    scoped_ptr<Image> image(
+        ReadFromFileWithOptions(kPuzzle, &contents, options));
+    ImageDim new_dim;
+    new_dim.set_width(width);
+    new_dim.set_height(height);
+    EXPECT_TRUE(image->ResizeTo(new_dim));
+    return image->Contents().as_string();
+  }
+
+  int64 Hits() {
+    return stats_.GetVariable(DecodedImageCache::kDecodedImageCacheHits)->
+        Get();
+  }
+
+  int64 Misses() {
+    return stats_.GetVariable(DecodedImageCache::kDecodedImageCacheMisses)->
+        Get();
+  }
+
+  scoped_ptr<ThreadSystem> thread_system_;
+  SimpleStats stats_;
+  scoped_ptr<DecodedImageCache> cache_;
+};
+
+TEST_F(DecodedImageCacheTest, DecodeOnce) {
+  GoogleString contents;
+  ReadTestImage(kPuzzle, &contents);
+  DecodedImagePtr first(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, contents, kNoWaitLimit,
+                     &message_handler_));
+  ASSERT_TRUE(first.get() != NULL);
+  EXPECT_EQ(1, Misses());
+  EXPECT_EQ(0, Hits());
+  EXPECT_EQ(1, cache_->num_elements());
+  EXPECT_EQ(first->size_bytes(), cache_->size_bytes());
+
+  DecodedImagePtr second(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, contents, kNoWaitLimit,
+                     &message_handler_));
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_EQ(1, Misses());
+  EXPECT_EQ(1, Hits());
+}
+
+TEST_F(DecodedImageCacheTest, ReaderScansWholeImage) {
+  GoogleString contents;
+  ReadTestImage(kBikeCrash, &contents);
+  DecodedImagePtr image(
+      cache_->Decode("bike", IMAGE_PNG, contents, kNoWaitLimit,
+                     &message_handler_));
+  ASSERT_TRUE(image.get() != NULL);
+
+  scoped_ptr<ScanlineReaderInterface> reader(
+      image->NewReader(&message_handler_));
+  EXPECT_EQ(image->width(), reader->GetImageWidth());
+  EXPECT_EQ(image->height(), reader->GetImageHeight());
+  EXPECT_EQ(image->pixel_format(), reader->GetPixelFormat());
+  size_t rows = 0;
+  void* scanline = NULL;
+  while (reader->HasMoreScanLines()) {
+    ASSERT_TRUE(reader->ReadNextScanline(&scanline));
+    EXPECT_EQ(image->pixels() + rows * image->stride(), scanline);
+    ++rows;
+  }
+  EXPECT_EQ(image->height(), rows);
+
+  // The reader keeps the raster alive after it is gone from the cache.
+  cache_.reset(NULL);
+  image.clear();
+  ASSERT_TRUE(reader->Reset());
+  EXPECT_TRUE(reader->ReadNextScanline(&scanline));
+}
+
+TEST_F(DecodedImageCacheTest, EntriesExpire) {
+  GoogleString contents;
+  ReadTestImage(kPuzzle, &contents);
+  DecodedImagePtr first(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, contents, kNoWaitLimit,
+                     &message_handler_));
+  timer_.AdvanceMs(RewriteOptions::kDefaultDecodedImageCacheTtlMs);
+  DecodedImagePtr second(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, contents, kNoWaitLimit,
+                     &message_handler_));
+  EXPECT_NE(first.get(), second.get());
+  EXPECT_EQ(2, Misses());
+  EXPECT_EQ(0, Hits());
+}
+
+TEST_F(DecodedImageCacheTest, DecodeDropsOtherExpiredEntries) {
+  GoogleString puzzle, bike;
+  ReadTestImage(kPuzzle, &puzzle);
+  ReadTestImage(kBikeCrash, &bike);
+  DecodedImagePtr first(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, puzzle, kNoWaitLimit,
+                     &message_handler_));
+  ASSERT_TRUE(first.get() != NULL);
+  EXPECT_EQ(1, cache_->num_elements());
+
+  // The puzzle is never looked up again, but decoding something else once
+  // it has expired still frees its raster.
+  timer_.AdvanceMs(RewriteOptions::kDefaultDecodedImageCacheTtlMs);
+  DecodedImagePtr second(
+      cache_->Decode("bike", IMAGE_PNG, bike, kNoWaitLimit,
+                     &message_handler_));
+  ASSERT_TRUE(second.get() != NULL);
+  EXPECT_EQ(1, cache_->num_elements());
+  EXPECT_EQ(second->size_bytes(), cache_->size_bytes());
+}
+
+TEST_F(DecodedImageCacheTest, SizeBound) {
+  GoogleString contents;
+  ReadTestImage(kPuzzle, &contents);
+  cache_.reset(NewCache(1024));
+  DecodedImagePtr image(
+      cache_->Decode(kPuzzleKey, IMAGE_JPEG, contents, kNoWaitLimit,
+                     &message_handler_));
+  ASSERT_TRUE(image.get() != NULL);
+  EXPECT_LT(1024, image->size_bytes());
+  EXPECT_EQ(0, cache_->num_elements());
+  EXPECT_EQ(0, cache_->size_bytes());
+}
+
+TEST_F(DecodedImageCacheTest, UndecodableImage) {
+  DecodedImagePtr image(
+      cache_->Decode("junk", IMAGE_JPEG, "not a jpeg", kNoWaitLimit,
+                     &message_handler_));
+  EXPECT_TRUE(image.get() == NULL);
+  EXPECT_EQ(0, cache_->num_elements());
+}
+
+TEST_F(DecodedImageCacheTest, VariantResizesShareDecode) {
+  const GoogleString uncached_small = ResizePuzzle(50, 40, false);
+  const GoogleString uncached_large = ResizePuzzle(100, 80, false);
+  EXPECT_EQ(0, Misses());
+
+  // Both variants come out byte-for-byte the same as when each decodes the
+  // original itself, but the original is decoded only once.
+  EXPECT_EQ(uncached_small, ResizePuzzle(50, 40, true));
+  EXPECT_EQ(uncached_large, ResizePuzzle(100, 80, true));
+  EXPECT_EQ(1, Misses());
+  EXPECT_EQ(1, Hits());
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
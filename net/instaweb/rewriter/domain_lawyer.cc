@@ -379,11 +379,10 @@ DomainLawyer::Domain* DomainLawyer::AddDomainHelper(
     authorize_all_domains_ = true;
   }
 
-  // TODO(matterbury): need better data structures to eliminate the O(N) logic:
-  // 1) Use a trie for domain_map_ as we need to find the domain whose trie
-  //    path matches the beginning of the given domain_name since we no longer
-  //    match just the domain name.
-  // 2) Use a better lookup structure for wildcard searching.
+  // TODO(matterbury): Use a trie for domain_map_ as we need to find the domain
+  // whose trie path matches the beginning of the given domain_name since we no
+  // longer match just the domain name.  Wildcards are indexed by
+  // IndexWildcardedDomain.
   GoogleString domain_name_str = NormalizeDomainName(domain_name);
   Domain* domain = NULL;
   std::pair<DomainMap::iterator, bool> p = domain_map_.insert(
@@ -394,6 +393,7 @@ DomainLawyer::Domain* DomainLawyer::AddDomainHelper(
     iter->second = domain;
     if (domain->IsWildcarded()) {
       wildcarded_domains_.push_back(domain);
+      IndexWildcardedDomain(wildcarded_domains_.size() - 1);
     }
   } else {
     domain = iter->second;
@@ -475,16 +475,67 @@ DomainLawyer::Domain* DomainLawyer::FindDomain(const GoogleUrl& gurl) const {
   }
 
   if (domain == NULL) {
-    for (int i = 0, n = wildcarded_domains_.size(); i < n; ++i) {
-      domain = wildcarded_domains_[i];
-      if (domain->Match(domain_path)) {
+    domain = FindWildcardedDomain(domain_path);
+  }
+  return domain;
+}
+
+DomainLawyer::Domain* DomainLawyer::FindWildcardedDomain(
+    const StringPiece& domain_path) const {
+  // Collect the candidates by walking the trie from the end of domain_path,
+  // and keep the earliest-added one that matches, which is the one a linear
+  // scan of wildcarded_domains_ would have found.
+  int best = -1;
+  int node = 0;
+  for (int i = domain_path.size(); ; --i) {
+    const std::vector<int>& wildcards = wildcard_suffix_trie_[node].wildcards;
+    for (int j = 0, n = wildcards.size(); j < n; ++j) {
+      const int index = wildcards[j];
+      if ((best >= 0) && (index > best)) {
+        break;  // wildcards is sorted, so the rest are later still.
+      } else if (wildcarded_domains_[index]->Match(domain_path)) {
+        best = index;
         break;
-      } else {
-        domain = NULL;
       }
     }
+    if (i == 0) {
+      break;
+    }
+    const std::map<char, int>& children = wildcard_suffix_trie_[node].children;
+    std::map<char, int>::const_iterator child = children.find(
+        domain_path[i - 1]);
+    if (child == children.end()) {
+      break;
+    }
+    node = child->second;
+  }
+  return (best >= 0) ? wildcarded_domains_[best] : NULL;
+}
+
+void DomainLawyer::IndexWildcardedDomain(int index) {
+  const GoogleString& name = wildcarded_domains_[index]->name();
+  const GoogleString::size_type last_wildcard = name.find_last_of("*?");
+  DCHECK_NE(GoogleString::npos, last_wildcard);
+  int node = 0;
+  for (int i = name.size() - 1; i > static_cast<int>(last_wildcard); --i) {
+    std::pair<std::map<char, int>::iterator, bool> inserted =
+        wildcard_suffix_trie_[node].children.insert(
+            std::make_pair(name[i], 0));
+    if (inserted.second) {
+      inserted.first->second = wildcard_suffix_trie_.size();
+      wildcard_suffix_trie_.push_back(WildcardSuffixNode());
+    }
+    node = inserted.first->second;
+  }
+  wildcard_suffix_trie_[node].wildcards.push_back(index);
+}
+
+void DomainLawyer::ReindexWildcardedDomains() {
+  wildcard_suffix_trie_.clear();
+  wildcard_suffix_trie_.push_back(WildcardSuffixNode());
+  for (int i = 0, n = wildcarded_domains_.size(); i < n; ++i) {
+    IndexWildcardedDomain(i);
   }
-  return domain;
 }
 
 void DomainLawyer::FindDomainsRewrittenTo(
@@ -952,6 +1003,7 @@ void DomainLawyer::Merge(const DomainLawyer& src) {
       }
     }
   }
+  ReindexWildcardedDomains();
 
   can_rewrite_domains_ |= src.can_rewrite_domains_;
   authorize_all_domains_ |= src.authorize_all_domains_;
@@ -1078,6 +1130,7 @@ void DomainLawyer::Clear() {
   can_rewrite_domains_ = false;
   authorize_all_domains_ = false;
   wildcarded_domains_.clear();
+  ReindexWildcardedDomains();
   proxy_suffix_.clear();
 }
 
@@ -25,6 +25,8 @@
 #include "net/instaweb/rewriter/public/domain_lawyer.h"
 #include "pagespeed/kernel/base/benchmark.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/http/google_url.h"
 
 void RunIsDomainAuthorizedIters(const net_instaweb::DomainLawyer& lawyer,
@@ -50,5 +52,35 @@ static void BM_DomainLawyerIsAuthorizedAllowAll(int iters) {
   RunIsDomainAuthorizedIters(lawyer, iters);
 }
 
+// Models a multi-tenant configuration with a wildcarded rewrite mapping and
+// shard per tenant, looking up resources from the last tenant, which a linear
+// scan of the wildcards would reach last.
+static void BM_DomainLawyerMapRequestManyWildcards(int iters,
+                                                   int num_tenants) {
+  StopBenchmarkTiming();
+  net_instaweb::NullMessageHandler handler;
+  net_instaweb::DomainLawyer lawyer;
+  for (int i = 0; i < num_tenants; ++i) {
+    GoogleString n = net_instaweb::IntegerToString(i);
+    GoogleString cdn = net_instaweb::StrCat("cdn", n, ".example.com");
+    lawyer.AddRewriteDomainMapping(
+        cdn, net_instaweb::StrCat("*.tenant", n, ".com"), &handler);
+    lawyer.AddShard(cdn, net_instaweb::StrCat("s1.", cdn, ",s2.", cdn),
+                    &handler);
+  }
+  GoogleString last = net_instaweb::IntegerToString(num_tenants - 1);
+  net_instaweb::GoogleUrl base_url(
+      net_instaweb::StrCat("http://www.tenant", last, ".com/index.html"));
+  GoogleString mapped_domain_name;
+  net_instaweb::GoogleUrl resolved_request;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    lawyer.MapRequestToDomain(base_url, "images/a/b/c/puzzle.jpg",
+                              &mapped_domain_name, &resolved_request,
+                              &handler);
+  }
+}
+
 BENCHMARK(BM_DomainLawyerIsAuthorizedAllowStar);
 BENCHMARK(BM_DomainLawyerIsAuthorizedAllowAll);
+BENCHMARK_RANGE(BM_DomainLawyerMapRequestManyWildcards, 1, 1<<10);
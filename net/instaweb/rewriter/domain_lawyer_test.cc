@@ -1509,6 +1509,43 @@ TEST_F(DomainLawyerTest, WildcardOrder) {
   EXPECT_FALSE(is_proxy);
 }
 
+TEST_F(DomainLawyerTest, WildcardOrderIgnoresSuffixLength) {
+  // Wildcards are indexed by their literal suffixes, but the first one
+  // declared must still win over a later one with a longer suffix.
+  ASSERT_TRUE(AddOriginDomainMapping("host1", "*.com"));
+  ASSERT_TRUE(AddOriginDomainMapping("host2", "*.example.com"));
+  ASSERT_TRUE(AddOriginDomainMapping("host3", "*.example.org"));
+  ASSERT_TRUE(AddOriginDomainMapping("host4", "a?.example.org"));
+  ASSERT_TRUE(AddOriginDomainMapping("host5", "*"));
+
+  GoogleString mapped;
+  ASSERT_TRUE(MapOrigin("http://www.example.com/x", &mapped));
+  EXPECT_STREQ("http://host1/x", mapped);
+  ASSERT_TRUE(MapOrigin("http://ab.example.org/x", &mapped));
+  EXPECT_STREQ("http://host3/x", mapped);
+  ASSERT_TRUE(MapOrigin("http://example.org/x", &mapped));
+  EXPECT_STREQ("http://host5/x", mapped);
+
+  // The index survives copying, which reorders the domains internally.
+  DomainLawyer copy(domain_lawyer_);
+  EXPECT_EQ(5, copy.num_wildcarded_domains());
+  bool is_proxy = true;
+  GoogleString host_header;
+  ASSERT_TRUE(copy.MapOrigin("http://www.example.com/x", &mapped,
+                             &host_header, &is_proxy));
+  EXPECT_STREQ("http://host1/x", mapped);
+  ASSERT_TRUE(copy.MapOrigin("http://www.example.org/x", &mapped,
+                             &host_header, &is_proxy));
+  EXPECT_STREQ("http://host3/x", mapped);
+
+  // Once cleared, nothing matches.
+  copy.Clear();
+  EXPECT_EQ(0, copy.num_wildcarded_domains());
+  ASSERT_TRUE(copy.MapOrigin("http://www.example.com/x", &mapped,
+                             &host_header, &is_proxy));
+  EXPECT_STREQ("http://www.example.com/x", mapped);
+}
+
 TEST_F(DomainLawyerTest, ComputeSignatureTest) {
   DomainLawyer first_lawyer, second_lawyer;
   ASSERT_TRUE(first_lawyer.AddOriginDomainMapping("host1", "*abc*.com", "",
@@ -24,6 +24,7 @@
 
 #include "base/logging.h"
 #include "net/instaweb/rewriter/cached_result.pb.h"
+#include "net/instaweb/rewriter/public/decoded_image_cache.h"
 #include "net/instaweb/rewriter/public/image_data_lookup.h"
 #include "net/instaweb/rewriter/public/image_url_encoder.h"
 #include "net/instaweb/rewriter/public/webp_optimizer.h"
@@ -34,11 +35,13 @@
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/http/content_type.h"
 #include "pagespeed/kernel/image/gif_reader.h"
 #include "pagespeed/kernel/image/image_analysis.h"
 #include "pagespeed/kernel/image/image_converter.h"
 #include "pagespeed/kernel/image/image_resizer.h"
+#include "pagespeed/kernel/image/image_similarity.h"
 #include "pagespeed/kernel/image/image_util.h"
 #include "pagespeed/kernel/image/jpeg_optimizer.h"
 #include "pagespeed/kernel/image/jpeg_utils.h"
@@ -65,7 +68,9 @@ using pagespeed::image_compression::AnalyzeImage;
 using pagespeed::image_compression::ComputeImageFormat;
 using pagespeed::image_compression::ConversionTimeoutHandler;
 using pagespeed::image_compression::CreateScanlineReader;
+using pagespeed::image_compression::ComputeSsim;
 using pagespeed::image_compression::CreateScanlineWriter;
+using pagespeed::image_compression::DecodeLumaPlane;
 using pagespeed::image_compression::GifReader;
 using pagespeed::image_compression::GRAY_8;
 using pagespeed::image_compression::ImageConverter;
@@ -74,6 +79,7 @@ using pagespeed::image_compression::ImageFormatToString;
 using pagespeed::image_compression::JpegCompressionOptions;
 using pagespeed::image_compression::JpegScanlineWriter;
 using pagespeed::image_compression::JpegUtils;
+using pagespeed::image_compression::LumaPlane;
 using pagespeed::image_compression::OptimizeJpegWithOptions;
 using pagespeed::image_compression::PixelFormat;
 using pagespeed::image_compression::PngCompressParams;
@@ -122,6 +128,12 @@ const char kGifString[] = "gif";
 const char kPngString[] = "png";
 const uint8 kAlphaOpaque = 255;
 
+// Bounds for the target_ssim quality search. Images are compared on their
+// luma plane downsampled to at most kQualitySearchMaxDimension pixels on a
+// side, which keeps each comparison cheap relative to the encode.
+const int kQualitySearchMinQuality = 50;
+const int kQualitySearchMaxDimension = 256;
+
 void UpdateWebpStats(bool ok, bool was_timed_out, int64 time_elapsed_ms,
                      Image::ConversionVariables::VariableType var_type,
                      Image::ConversionVariables* conversion_vars) {
@@ -282,6 +294,40 @@ class ImageImpl : public Image {
       const GoogleString& original_jpeg, int configured_quality,
       GoogleString* compressed_webp);
 
+  // Does the work of ConvertJpegToWebp, giving up after timeout_ms (or
+  // never, if it is negative), but leaves the conversion stats alone so that
+  // callers making several attempts can record just the one they keep.
+  bool EncodeJpegToWebp(
+      const GoogleString& original_jpeg, int quality, int64 timeout_ms,
+      GoogleString* compressed_webp, bool* was_timed_out,
+      int64* time_elapsed_ms);
+
+  void RecordJpegToWebpStats(bool ok, bool was_timed_out,
+                             int64 time_elapsed_ms);
+
+  // Lossily encodes the JPEG in original_jpeg at the given quality, as WebP
+  // if to_webp is set and otherwise as JPEG using jpeg_options. Like
+  // EncodeJpegToWebp, this records no stats; timeout_ms only bounds WebP
+  // encodes.
+  bool EncodeJpegAtQuality(
+      const GoogleString& original_jpeg, bool to_webp,
+      const JpegCompressionOptions& jpeg_options, int quality,
+      int64 timeout_ms, GoogleString* output, bool* was_timed_out);
+
+  // Binary-searches qualities in [kQualitySearchMinQuality, max_quality] for
+  // the lowest one whose encoding of original_jpeg still meets
+  // options_->target_ssim, and stores that encoding in output. If even
+  // max_quality misses the target, the max_quality encoding is used. The
+  // whole search shares one options_->webp_conversion_timeout_ms budget;
+  // once it is spent the best encoding so far is kept. If
+  // options_->searched_quality_hint is in range, that quality is used
+  // without searching. Records the outcome in options_->searched_quality
+  // and, if a search ran, options_->fixed_quality_bytes.
+  bool SearchQualityForTargetSsim(
+      const GoogleString& original_jpeg, bool to_webp,
+      const JpegCompressionOptions& jpeg_options, int max_quality,
+      GoogleString* output);
+
   static bool ContinueWebpConversion(
       int percent,
       void* user_data);
@@ -693,11 +739,23 @@ bool ImageImpl::ResizeTo(const ImageDim& new_dim) {
     return false;
   }
 
-  scoped_ptr<ScanlineReaderInterface> image_reader(
-      CreateScanlineReader(original_format,
-                           original_contents_.data(),
-                           original_contents_.length(),
-                           handler_.get()));
+  scoped_ptr<ScanlineReaderInterface> image_reader;
+  if (options_->decoded_image_cache != NULL &&
+      !options_->decoded_image_key.empty()) {
+    // Other variants of this image are likely being resized too; share the
+    // decode with them.
+    DecodedImagePtr decoded(options_->decoded_image_cache->Decode(
+        options_->decoded_image_key, original_format, original_contents_,
+        options_->decoded_image_max_wait_ms, handler_.get()));
+    if (decoded.get() != NULL) {
+      image_reader.reset(decoded->NewReader(handler_.get()));
+    }
+  } else {
+    image_reader.reset(CreateScanlineReader(original_format,
+                                            original_contents_.data(),
+                                            original_contents_.length(),
+                                            handler_.get()));
+  }
   if (image_reader == NULL) {
     resize_debug_message_ = "Cannot resize: Cannot open the image to resize";
     PS_LOG_INFO(handler_, "Cannot open the image to resize.");
@@ -875,8 +933,15 @@ bool ImageImpl::ComputeOutputContents() {
         if (MayConvert() &&
             options_->convert_jpeg_to_webp &&
             (options_->preferred_webp != WEBP_NONE)) {
-          ok = ConvertJpegToWebp(string_for_image, options_->webp_quality,
-                                 &output_contents_);
+          if (options_->target_ssim > 0 && options_->webp_quality > 0) {
+            ok = SearchQualityForTargetSsim(
+                string_for_image, true /* to_webp */,
+                JpegCompressionOptions(), options_->webp_quality,
+                &output_contents_);
+          } else {
+            ok = ConvertJpegToWebp(string_for_image, options_->webp_quality,
+                                   &output_contents_);
+          }
           VLOG(1) << "Image conversion: " << ok << " jpeg->webp for " << url_;
           if (!ok) {
             // Image is not going to be webp-converted!
@@ -890,8 +955,14 @@ bool ImageImpl::ComputeOutputContents() {
                    (resized || options_->recompress_jpeg)) {
           JpegCompressionOptions jpeg_options;
           ConvertToJpegOptions(*options_.get(), &jpeg_options);
-          ok = OptimizeJpegWithOptions(string_for_image, &output_contents_,
-                                       jpeg_options, handler_.get());
+          if (options_->target_ssim > 0 && jpeg_options.lossy) {
+            ok = SearchQualityForTargetSsim(
+                string_for_image, false /* to_webp */, jpeg_options,
+                jpeg_options.lossy_options.quality, &output_contents_);
+          } else {
+            ok = OptimizeJpegWithOptions(string_for_image, &output_contents_,
+                                         jpeg_options, handler_.get());
+          }
           VLOG(1) << "Image conversion: " << ok << " jpeg->jpeg for " << url_;
         }
         break;
@@ -934,17 +1005,35 @@ bool ImageImpl::ComputeOutputContents() {
 inline bool ImageImpl::ConvertJpegToWebp(
     const GoogleString& original_jpeg, int configured_quality,
     GoogleString* compressed_webp) {
-  ConversionTimeoutHandler timeout_handler(options_->webp_conversion_timeout_ms,
-                                           timer_, handler_.get());
+  bool was_timed_out = false;
+  int64 time_elapsed_ms = 0;
+  bool ok = EncodeJpegToWebp(original_jpeg, configured_quality,
+                             options_->webp_conversion_timeout_ms,
+                             compressed_webp, &was_timed_out,
+                             &time_elapsed_ms);
+  RecordJpegToWebpStats(ok, was_timed_out, time_elapsed_ms);
+  return ok;
+}
+
+bool ImageImpl::EncodeJpegToWebp(
+    const GoogleString& original_jpeg, int quality, int64 timeout_ms,
+    GoogleString* compressed_webp, bool* was_timed_out,
+    int64* time_elapsed_ms) {
+  ConversionTimeoutHandler timeout_handler(timeout_ms, timer_,
+                                           handler_.get());
   timeout_handler.Start(compressed_webp);
-  bool ok = OptimizeWebp(original_jpeg, configured_quality,
+  bool ok = OptimizeWebp(original_jpeg, quality,
                          ConversionTimeoutHandler::Continue, &timeout_handler,
                          compressed_webp, handler_.get());
   timeout_handler.Stop();
 
-  bool was_timed_out = timeout_handler.was_timed_out();
-  int64 time_elapsed_ms = timeout_handler.time_elapsed_ms();
+  *was_timed_out = timeout_handler.was_timed_out();
+  *time_elapsed_ms = timeout_handler.time_elapsed_ms();
+  return ok;
+}
 
+void ImageImpl::RecordJpegToWebpStats(bool ok, bool was_timed_out,
+                                      int64 time_elapsed_ms) {
   UpdateWebpStats(ok, was_timed_out, time_elapsed_ms,
                  Image::ConversionVariables::FROM_JPEG,
                  options_->webp_conversion_variables);
@@ -952,7 +1041,122 @@ inline bool ImageImpl::ConvertJpegToWebp(
   UpdateWebpStats(ok, was_timed_out, time_elapsed_ms,
                  Image::ConversionVariables::OPAQUE,
                  options_->webp_conversion_variables);
-  return ok;
+}
+
+bool ImageImpl::EncodeJpegAtQuality(
+    const GoogleString& original_jpeg, bool to_webp,
+    const JpegCompressionOptions& jpeg_options, int quality,
+    int64 timeout_ms, GoogleString* output, bool* was_timed_out) {
+  output->clear();
+  *was_timed_out = false;
+  if (to_webp) {
+    int64 time_elapsed_ms;
+    return EncodeJpegToWebp(original_jpeg, quality, timeout_ms, output,
+                            was_timed_out, &time_elapsed_ms);
+  }
+  JpegCompressionOptions options = jpeg_options;
+  options.lossy = true;
+  options.lossy_options.quality = quality;
+  return OptimizeJpegWithOptions(original_jpeg, output, options,
+                                 handler_.get());
+}
+
+bool ImageImpl::SearchQualityForTargetSsim(
+    const GoogleString& original_jpeg, bool to_webp,
+    const JpegCompressionOptions& jpeg_options, int max_quality,
+    GoogleString* output) {
+  const ImageFormat output_format = to_webp ?
+      pagespeed::image_compression::IMAGE_WEBP :
+      pagespeed::image_compression::IMAGE_JPEG;
+  const int64 timeout_ms = options_->webp_conversion_timeout_ms;
+  const int64 start_ms = timer_->NowMs();
+  bool was_timed_out = false;
+
+  const int64 hint = options_->searched_quality_hint;
+  if (hint >= kQualitySearchMinQuality && hint <= max_quality) {
+    bool ok = EncodeJpegAtQuality(original_jpeg, to_webp, jpeg_options, hint,
+                                  timeout_ms, output, &was_timed_out);
+    if (to_webp) {
+      RecordJpegToWebpStats(ok, was_timed_out, timer_->NowMs() - start_ms);
+    }
+    if (ok) {
+      options_->searched_quality = hint;
+      debug_message_ = StringPrintf(
+          "Reused searched quality %d (configured %d) for target SSIM %.3f",
+          static_cast<int>(hint), max_quality, options_->target_ssim);
+    }
+    return ok;
+  }
+
+  // The configured quality is the upper bound of the search, so its output
+  // doubles as the fallback and as the baseline for reporting savings.
+  if (!EncodeJpegAtQuality(original_jpeg, to_webp, jpeg_options, max_quality,
+                           timeout_ms, output, &was_timed_out)) {
+    if (to_webp) {
+      RecordJpegToWebpStats(false, was_timed_out,
+                            timer_->NowMs() - start_ms);
+    }
+    return false;
+  }
+  const int64 fixed_quality_bytes = output->size();
+
+  LumaPlane reference;
+  int best_quality = max_quality;
+  const bool searched = DecodeLumaPlane(
+      pagespeed::image_compression::IMAGE_JPEG, original_jpeg.data(),
+      original_jpeg.size(), kQualitySearchMaxDimension, handler_.get(),
+      &reference);
+  if (searched) {
+    GoogleString candidate;
+    int low = kQualitySearchMinQuality;
+    int high = max_quality - 1;
+    while (low <= high) {
+      int64 remaining_ms = -1;
+      if (timeout_ms >= 0) {
+        remaining_ms = start_ms + timeout_ms - timer_->NowMs();
+        if (remaining_ms <= 0) {
+          break;
+        }
+      }
+      const int quality = low + (high - low) / 2;
+      LumaPlane decoded;
+      bool probe_timed_out;
+      if (!EncodeJpegAtQuality(original_jpeg, to_webp, jpeg_options, quality,
+                               remaining_ms, &candidate, &probe_timed_out) ||
+          !DecodeLumaPlane(output_format, candidate.data(), candidate.size(),
+                           kQualitySearchMaxDimension, handler_.get(),
+                           &decoded)) {
+        break;
+      }
+      if (ComputeSsim(reference, decoded) >= options_->target_ssim) {
+        // Quality and size are not strictly monotonic, so only keep a
+        // passing candidate if it is actually smaller.
+        if (candidate.size() < output->size()) {
+          output->swap(candidate);
+          best_quality = quality;
+        }
+        high = quality - 1;
+      } else {
+        low = quality + 1;
+      }
+    }
+  }
+  if (to_webp) {
+    // One conversion is served however many were tried, so it is recorded
+    // once, charged with the time of the whole search.
+    RecordJpegToWebpStats(true, false, timer_->NowMs() - start_ms);
+  }
+  if (!searched) {
+    // The original could not be decoded for comparison, so no quality was
+    // searched and there is nothing to report or remember.
+    return true;
+  }
+  options_->fixed_quality_bytes = fixed_quality_bytes;
+  options_->searched_quality = best_quality;
+  debug_message_ = StringPrintf(
+      "Quality search chose %d (configured %d) for target SSIM %.3f",
+      best_quality, max_quality, options_->target_ssim);
+  return true;
 }
 
 inline bool ImageImpl::ComputeOutputContentsFromPngReader(
@@ -656,7 +656,9 @@ class ImageCombineFilter::Combiner : public ResourceCombiner {
     spriter::SpriteOptions* options = input.mutable_options();
     options->set_output_base_path("");
     options->set_output_image_path("sprite");
-    options->set_placement_method(spriter::VERTICAL_STRIP);
+    options->set_placement_method(
+        rewrite_driver_->options()->image_sprite_packing() ?
+        spriter::SKYLINE : spriter::VERTICAL_STRIP);
 
     for (int i = 0, n = combine_resources.size(); i < n; ++i) {
       const ResourcePtr& resource = combine_resources[i];
@@ -21,7 +21,9 @@
 
 #include "net/instaweb/rewriter/public/css_rewrite_test_base.h"
 #include "net/instaweb/rewriter/public/rewrite_options.h"
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/posix_timer.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/html/html_parse_test_base.h"
@@ -466,6 +468,53 @@ TEST_F(CssImageCombineTest, SpritesGifsWithPngs) {
   ValidateExpected("sprite_with_gif", before, after);
 }
 
+// Sprites the same three images stacked and packed, checking the positions
+// and reporting the sprite size and the time taken to produce it.
+TEST_F(CssImageCombineTest, SpritePacking) {
+  const char kHtml[] = "<head><style>"
+      "#div1{background:url(%s) %s;width:10px;height:10px}"
+      "#div2{background:url(%s) %s;width:10px;height:10px}"
+      "#div3{background:url(%s) %s;width:10px;height:10px}"
+      "</style></head>";
+  const GoogleString before = StringPrintf(
+      kHtml, kBikePngFile, "0 0", kChefGifFile, "0 0", kCuppaPngFile, "0 0");
+  const StringVector sprited_urls =
+      MultiUrl(kBikePngFile, kChefGifFile, kCuppaPngFile);
+  const GoogleString sprite = Encode("", "is", "0", sprited_urls, "png");
+  const GoogleString sprite_url =
+      Encode(kTestDomain, "is", "0", sprited_urls, "png");
+
+  // Stacked, the sprite is 192x426.  Packed, the ChefGif (192x256) goes at
+  // the top, with the BikePng (100x100) and the CuppaPng (65x70) side by side
+  // beneath it, giving a 192x356 sprite.
+  const char* const kPositions[2][3] = {
+    {"0 0", "0 -100px", "0 -356px"},
+    {"0 -256px", "0 0", "-100px -256px"},
+  };
+  PosixTimer timer;
+  GoogleString contents[2];
+  for (int packed = 0; packed < 2; ++packed) {
+    options()->ClearSignatureForTesting();
+    options()->set_image_sprite_packing(packed == 1);
+    options()->ComputeSignature();
+
+    const GoogleString after = StringPrintf(
+        kHtml, sprite.c_str(), kPositions[packed][0],
+        sprite.c_str(), kPositions[packed][1],
+        sprite.c_str(), kPositions[packed][2]);
+    const int64 start_us = timer.NowUs();
+    ValidateExpected(packed ? "sprite_packed" : "sprite_stacked",
+                     before, after);
+    const int64 elapsed_us = timer.NowUs() - start_us;
+
+    EXPECT_TRUE(FetchResourceUrl(sprite_url, &contents[packed]));
+    LOG(INFO) << (packed ? "Packed" : "Stacked") << " sprite: "
+              << contents[packed].size() << " bytes, rewritten in "
+              << elapsed_us << "us";
+  }
+  EXPECT_NE(contents[0], contents[1]);
+}
+
 TEST_F(CssImageCombineTest, SpriteWrongMime) {
   // Make sure that a server messing up the content-type doesn't prevent
   // spriting.
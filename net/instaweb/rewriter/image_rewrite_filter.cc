@@ -38,6 +38,7 @@
 #include "net/instaweb/rewriter/public/critical_images_finder.h"
 #include "net/instaweb/rewriter/public/css_url_encoder.h"
 #include "net/instaweb/rewriter/public/css_util.h"
+#include "net/instaweb/rewriter/public/decoded_image_cache.h"
 #include "net/instaweb/rewriter/public/image.h"
 #include "net/instaweb/rewriter/public/local_storage_cache_filter.h"
 #include "net/instaweb/rewriter/public/output_resource.h"
@@ -54,9 +55,14 @@
 #include "net/instaweb/rewriter/public/single_rewrite_context.h"
 #include "net/instaweb/util/public/property_cache.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/escaping.h"
+#include "pagespeed/kernel/base/function.h"
+#include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/proto_util.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -68,6 +74,7 @@
 #include "pagespeed/kernel/http/data_url.h"
 #include "pagespeed/kernel/http/google_url.h"
 #include "pagespeed/kernel/http/semantic_type.h"
+#include "pagespeed/kernel/image/image_util.h"
 #include "pagespeed/kernel/util/simple_random.h"
 #include "pagespeed/kernel/util/statistics_work_bound.h"
 #include "pagespeed/kernel/util/work_bound.h"
@@ -165,6 +172,7 @@ const char* const kRelatedOptions[] = {
   RewriteOptions::kImageMaxRewritesAtOnce,
   RewriteOptions::kImagePreserveURLs,
   RewriteOptions::kImageRecompressionQuality,
+  RewriteOptions::kImageRecompressionTargetSsim,
   RewriteOptions::kImageResolutionLimitBytes,
   RewriteOptions::kImageWebpRecompressionQuality,
   RewriteOptions::kImageWebpRecompressionQualityForSmallScreens,
@@ -222,6 +230,10 @@ const char kImageRewriteUses[] = "image_rewrite_uses";
 const char kImageInline[] = "image_inline";
 const char ImageRewriteFilter::kImageOngoingRewrites[] =
     "image_ongoing_rewrites";
+const char ImageRewriteFilter::kImageQualitySearches[] =
+    "image_quality_searches";
+const char ImageRewriteFilter::kImageQualitySearchBytesSaved[] =
+    "image_quality_search_bytes_saved";
 const char ImageRewriteFilter::kImageResizedUsingRenderedDimensions[] =
     "image_resized_using_rendered_dimensions";
 const char ImageRewriteFilter::kImageWebpRewrites[] = "image_webp_rewrites";
@@ -362,7 +374,8 @@ class ImageRewriteFilter::Context : public SingleRewriteContext {
         html_index_(html_index),
         in_noscript_element_(in_noscript_element),
         is_resized_using_rendered_dimensions_(
-            is_resized_using_rendered_dimensions) {}
+            is_resized_using_rendered_dimensions),
+        searched_quality_hint_(-1) {}
   virtual ~Context() {}
 
   virtual void Render();
@@ -380,8 +393,28 @@ class ImageRewriteFilter::Context : public SingleRewriteContext {
   virtual void EncodeUserAgentIntoResourceContext(
       ResourceContext* context);
 
+ protected:
+  virtual bool DedupByInputContents() const {
+    return Options()->image_dedup_by_content_hash();
+  }
+
  private:
   friend class ImageRewriteFilter;
+  class QualityHintCallback;
+
+  void RewriteImage(const ResourcePtr& input,
+                    const OutputResourcePtr& output);
+
+  // Key for the quality a target SSIM search chose for the contents of
+  // input, kept apart from the rewrite's own metadata so that rewriting
+  // the same bytes again, at another size or after the old result has
+  // expired, can encode at that quality rather than search afresh.
+  GoogleString QualityHintKey(const ResourcePtr& input) const;
+
+  // Called in the low-priority rewrite thread once the hint lookup
+  // completes; 'quality' is -1 on a miss.
+  void QualityHintDone(int64 quality);
+  void QualityHintCancelled(int64 quality);
 
   int64 css_image_inline_max_bytes_;
   ImageRewriteFilter* filter_;
@@ -389,6 +422,9 @@ class ImageRewriteFilter::Context : public SingleRewriteContext {
   const int html_index_;
   bool in_noscript_element_;
   bool is_resized_using_rendered_dimensions_;
+  int64 searched_quality_hint_;
+  ResourcePtr hint_input_;
+  OutputResourcePtr hint_output_;
   DISALLOW_COPY_AND_ASSIGN(Context);
 };
 
@@ -429,9 +465,61 @@ void SetWebpCompressionOptions(
   image_options->webp_conversion_variables = webp_conversion_variables;
 }
 
+// Parses a quality hint in the cache thread, and hands it to the context
+// in the low-priority rewrite thread, where RewriteSingle would otherwise
+// have run.
+class ImageRewriteFilter::Context::QualityHintCallback
+    : public CacheInterface::Callback {
+ public:
+  explicit QualityHintCallback(Context* context) : context_(context) {}
+  virtual ~QualityHintCallback() {}
+
+  virtual void Done(CacheInterface::KeyState state) {
+    int64 quality = -1;
+    if (state == CacheInterface::kAvailable) {
+      CachedResult hint;
+      StringPiece val_str = value()->Value();
+      ArrayInputStream input(val_str.data(), val_str.size());
+      if (hint.ParseFromZeroCopyStream(&input) &&
+          hint.has_searched_image_quality()) {
+        quality = hint.searched_image_quality();
+      }
+    }
+    context_->Driver()->AddLowPriorityRewriteTask(MakeFunction(
+        context_, &Context::QualityHintDone, &Context::QualityHintCancelled,
+        quality));
+    delete this;
+  }
+
+ private:
+  Context* context_;
+
+  DISALLOW_COPY_AND_ASSIGN(QualityHintCallback);
+};
+
 void ImageRewriteFilter::Context::RewriteSingle(
     const ResourcePtr& input_resource,
     const OutputResourcePtr& output_resource) {
+  // Only lossy encodings of a JPEG, to JPEG or WebP, search for a quality,
+  // so only those can have a hint.
+  bool is_webp_lossless_alpha;
+  if (Options()->image_recompress_target_ssim() > 0 &&
+      !rewrite_uncacheable() &&
+      (pagespeed::image_compression::ComputeImageFormat(
+           input_resource->contents(), &is_webp_lossless_alpha) ==
+       pagespeed::image_compression::IMAGE_JPEG)) {
+    hint_input_ = input_resource;
+    hint_output_ = output_resource;
+    FindServerContext()->metadata_cache()->Get(
+        QualityHintKey(input_resource), new QualityHintCallback(this));
+  } else {
+    RewriteImage(input_resource, output_resource);
+  }
+}
+
+void ImageRewriteFilter::Context::RewriteImage(
+    const ResourcePtr& input_resource,
+    const OutputResourcePtr& output_resource) {
   bool is_ipro = IsNestedIn(RewriteOptions::kInPlaceRewriteId);
   AttachDependentRequestTrace(is_ipro ? "IproProcessImage" : "ProcessImage");
   RewriteDone(
@@ -439,6 +527,32 @@ void ImageRewriteFilter::Context::RewriteSingle(
       0);
 }
 
+GoogleString ImageRewriteFilter::Context::QualityHintKey(
+    const ResourcePtr& input) const {
+  // The user-agent key settles whether the output is WebP or JPEG, and the
+  // signature covers the target and the configured qualities.
+  const Hasher* hasher = FindServerContext()->lock_hasher();
+  return StrCat(ServerContext::kCacheKeyResourceNamePrefix, id(), "_",
+                hasher->Hash(Options()->signature()), "/quality/",
+                input->ContentsHash(), "@",
+                UserAgentCacheKey(resource_context()));
+}
+
+void ImageRewriteFilter::Context::QualityHintDone(int64 quality) {
+  searched_quality_hint_ = quality;
+  ResourcePtr input_resource(hint_input_);
+  OutputResourcePtr output_resource(hint_output_);
+  hint_input_.clear();
+  hint_output_.clear();
+  RewriteImage(input_resource, output_resource);
+}
+
+void ImageRewriteFilter::Context::QualityHintCancelled(int64 quality) {
+  hint_input_.clear();
+  hint_output_.clear();
+  RewriteDone(kTooBusy, 0);
+}
+
 void ImageRewriteFilter::Context::Render() {
   if (num_output_partitions() != 1) {
     // Partition failed since one of the inputs was unavailable; nothing to do.
@@ -548,6 +662,9 @@ ImageRewriteFilter::ImageRewriteFilter(RewriteDriver* driver)
   image_rewrite_uses_ = stats->GetVariable(kImageRewriteUses);
   image_inline_count_ = stats->GetVariable(kImageInline);
   image_webp_rewrites_ = stats->GetVariable(kImageWebpRewrites);
+  image_quality_searches_ = stats->GetVariable(kImageQualitySearches);
+  image_quality_search_bytes_saved_ =
+      stats->GetVariable(kImageQualitySearchBytesSaved);
   image_rewrite_latency_total_ms_ =
       stats->GetVariable(kImageRewriteLatencyTotalMs);
 
@@ -640,6 +757,8 @@ void ImageRewriteFilter::InitStats(Statistics* statistics) {
   statistics->AddVariable(kImageRewriteUses);
   statistics->AddVariable(kImageInline);
   statistics->AddVariable(kImageWebpRewrites);
+  statistics->AddVariable(kImageQualitySearches);
+  statistics->AddVariable(kImageQualitySearchBytesSaved);
   statistics->AddVariable(kImageRewriteLatencyTotalMs);
   // We want image_ongoing_rewrites to be global even if we do per-vhost
   // stats, as it's used for a StatisticsWorkBound.
@@ -666,6 +785,8 @@ void ImageRewriteFilter::InitStats(Statistics* statistics) {
   statistics->AddVariable(kImageWebpOpaqueTimeouts);
   statistics->AddHistogram(kImageWebpOpaqueSuccessMs);
   statistics->AddHistogram(kImageWebpOpaqueFailureMs);
+
+  DecodedImageCache::InitStats(statistics);
 }
 
 void ImageRewriteFilter::Initialize() {
@@ -790,6 +911,21 @@ Image::CompressionOptions* ImageRewriteFilter::ImageOptionsForLoadedResource(
       !options->Enabled(RewriteOptions::kJpegSubsampling);
   image_options->webp_conversion_timeout_ms =
       options->image_webp_timeout_ms();
+  if (options->image_recompress_target_ssim() > 0) {
+    image_options->target_ssim =
+        options->image_recompress_target_ssim() / 1000.0;
+  }
+  // Only resizing reads the decoded raster, so only hash the contents when
+  // we might resize.
+  DecodedImageCache* decoded_image_cache =
+      server_context()->decoded_image_cache();
+  if (decoded_image_cache != NULL &&
+      (options->Enabled(RewriteOptions::kResizeImages) ||
+       options->Enabled(RewriteOptions::kResizeToRenderedImageDimensions))) {
+    image_options->decoded_image_cache = decoded_image_cache;
+    image_options->decoded_image_key = input_resource->ContentsHash();
+    image_options->decoded_image_max_wait_ms = driver()->rewrite_deadline_ms();
+  }
 
   return image_options;
 }
@@ -922,6 +1058,20 @@ void ImageRewriteFilter::InfoAndTrace(
   va_end(args);
 }
 
+void ImageRewriteFilter::SaveSearchedQuality(
+    Context* rewrite_context, const ResourcePtr& input_resource,
+    int64 quality) {
+  CachedResult hint;
+  hint.set_searched_image_quality(quality);
+  GoogleString buf;
+  {
+    StringOutputStream sstream(&buf);  // finalizes buf in destructor
+    hint.SerializeToZeroCopyStream(&sstream);
+  }
+  server_context()->metadata_cache()->PutSwappingString(
+      rewrite_context->QualityHintKey(input_resource), &buf);
+}
+
 RewriteResult ImageRewriteFilter::RewriteLoadedResourceImpl(
       Context* rewrite_context, const ResourcePtr& input_resource,
       const OutputResourcePtr& result) {
@@ -960,6 +1110,8 @@ RewriteResult ImageRewriteFilter::RewriteLoadedResourceImpl(
   Image::CompressionOptions* image_options =
       ImageOptionsForLoadedResource(resource_context, input_resource,
                                     rewrite_context->is_css_);
+  image_options->searched_quality_hint =
+      rewrite_context->searched_quality_hint_;
   scoped_ptr<Image> image(
       NewImage(input_resource->contents(), input_resource->url(),
                server_context()->filename_prefix(), image_options,
@@ -1052,6 +1204,16 @@ RewriteResult ImageRewriteFilter::RewriteLoadedResourceImpl(
           if (result->type()->type() == ContentType::kWebp) {
             image_webp_rewrites_->Add(1);
           }
+          if (image_options->fixed_quality_bytes >= 0) {
+            image_quality_searches_->Add(1);
+            image_quality_search_bytes_saved_->Add(
+                image_options->fixed_quality_bytes - image->output_size());
+            if (image_options->searched_quality >= 0 &&
+                !rewrite_context->rewrite_uncacheable()) {
+              SaveSearchedQuality(rewrite_context, input_resource,
+                                  image_options->searched_quality);
+            }
+          }
 
           rewrite_result = kRewriteOk;
         } else {
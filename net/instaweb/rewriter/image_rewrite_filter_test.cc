@@ -1677,6 +1677,130 @@ TEST_F(ImageRewriteTest, OptimizeRequestedPrefetch) {
                     kPixelDims, kPixelDims, true, false);
 }
 
+TEST_F(ImageRewriteTest, RecompressJpegWithTargetSsim) {
+  // With a target SSIM the quality is searched per image, bounded above by
+  // the configured quality, and the savings against that are recorded.
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  options()->set_image_jpeg_recompress_quality(70);
+  options()->set_image_recompress_target_ssim(900);
+  rewrite_driver()->AddFilters();
+  TestSingleRewrite(kPuzzleJpgFile, kContentTypeJpeg, kContentTypeJpeg,
+                    "", "", true, false);
+  EXPECT_EQ(1, statistics()->GetVariable(
+      ImageRewriteFilter::kImageQualitySearches)->Get());
+  // A lower quality than the configured one passes so lax a target, and
+  // only smaller encodings are kept.
+  EXPECT_LT(0, statistics()->GetVariable(
+      ImageRewriteFilter::kImageQualitySearchBytesSaved)->Get());
+}
+
+TEST_F(ImageRewriteTest, ReuseSearchedQualityForResizedImage) {
+  // Rewriting the same bytes again, here to a smaller size, encodes at the
+  // quality the first search chose instead of searching again.
+  AddFileToMockFetcher(StrCat(kTestDomain, "a.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  options()->EnableFilter(RewriteOptions::kResizeImages);
+  options()->set_image_jpeg_recompress_quality(70);
+  options()->set_image_recompress_target_ssim(900);
+  rewrite_driver()->AddFilters();
+
+  ParseUrl(kTestDomain, "<img src=\"a.jpg\">");
+  ParseUrl(kTestDomain, "<img src=\"a.jpg\" width=\"256\" height=\"192\">");
+  EXPECT_EQ(2, statistics()->GetVariable(
+      ImageRewriteFilter::kImageRewrites)->Get());
+  EXPECT_EQ(1, statistics()->GetVariable(
+      ImageRewriteFilter::kImageQualitySearches)->Get());
+}
+
+TEST_F(ImageRewriteTest, RecompressJpegWithoutTargetSsim) {
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  options()->set_image_jpeg_recompress_quality(70);
+  rewrite_driver()->AddFilters();
+  TestSingleRewrite(kPuzzleJpgFile, kContentTypeJpeg, kContentTypeJpeg,
+                    "", "", true, false);
+  EXPECT_EQ(0, statistics()->GetVariable(
+      ImageRewriteFilter::kImageQualitySearches)->Get());
+}
+
+TEST_F(ImageRewriteTest, DedupImagesByContentHash) {
+  // The same bytes served under a second URL reuse the first URL's output
+  // rather than being recompressed again.
+  AddFileToMockFetcher(StrCat(kTestDomain, "a.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  AddFileToMockFetcher(StrCat(kTestDomain, "b.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  options()->set_image_dedup_by_content_hash(true);
+  rewrite_driver()->AddFilters();
+
+  StringVector img_srcs;
+  ImageCollector image_collect(rewrite_driver(), &img_srcs);
+  rewrite_driver()->AddFilter(&image_collect);
+
+  ParseUrl(kTestDomain, "<img src=\"a.jpg\">");
+  ParseUrl(kTestDomain, "<img src=\"b.jpg\">");
+  ASSERT_EQ(2, img_srcs.size());
+  EXPECT_NE(img_srcs[0], img_srcs[1]);
+  EXPECT_EQ(1, statistics()->GetVariable(
+      ImageRewriteFilter::kImageRewrites)->Get());
+  EXPECT_EQ(1, statistics()->GetVariable(
+      RewriteContext::kNumDedupedRewriteMisses)->Get());
+  EXPECT_EQ(1, statistics()->GetVariable(
+      RewriteContext::kNumDedupedRewriteHits)->Get());
+
+  // Both outputs are served, with identical contents.
+  GoogleString content_a, content_b;
+  EXPECT_TRUE(FetchResourceUrl(GoogleUrl(html_gurl(), img_srcs[0]).Spec(),
+                               &content_a));
+  EXPECT_TRUE(FetchResourceUrl(GoogleUrl(html_gurl(), img_srcs[1]).Spec(),
+                               &content_b));
+  EXPECT_EQ(content_a, content_b);
+}
+
+TEST_F(ImageRewriteTest, DedupImagesRewritesWhenOutputEvicted) {
+  // Only the metadata is shared; if the first output's bytes have left the
+  // HTTP cache, the second URL is rewritten afresh.
+  AddFileToMockFetcher(StrCat(kTestDomain, "a.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  AddFileToMockFetcher(StrCat(kTestDomain, "b.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  options()->set_image_dedup_by_content_hash(true);
+  rewrite_driver()->AddFilters();
+
+  StringVector img_srcs;
+  ImageCollector image_collect(rewrite_driver(), &img_srcs);
+  rewrite_driver()->AddFilter(&image_collect);
+
+  ParseUrl(kTestDomain, "<img src=\"a.jpg\">");
+  ASSERT_EQ(1, img_srcs.size());
+  http_cache()->Delete(GoogleUrl(html_gurl(), img_srcs[0]).Spec().as_string(),
+                       rewrite_driver()->CacheFragment());
+  ParseUrl(kTestDomain, "<img src=\"b.jpg\">");
+  ASSERT_EQ(2, img_srcs.size());
+  EXPECT_EQ(2, statistics()->GetVariable(
+      ImageRewriteFilter::kImageRewrites)->Get());
+  EXPECT_EQ(2, statistics()->GetVariable(
+      RewriteContext::kNumDedupedRewriteMisses)->Get());
+  EXPECT_EQ(0, statistics()->GetVariable(
+      RewriteContext::kNumDedupedRewriteHits)->Get());
+}
+
+TEST_F(ImageRewriteTest, NoDedupImagesByDefault) {
+  AddFileToMockFetcher(StrCat(kTestDomain, "a.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  AddFileToMockFetcher(StrCat(kTestDomain, "b.jpg"), kPuzzleJpgFile,
+                       kContentTypeJpeg, 100);
+  options()->EnableFilter(RewriteOptions::kRecompressJpeg);
+  rewrite_driver()->AddFilters();
+  ParseUrl(kTestDomain, "<img src=\"a.jpg\"><img src=\"b.jpg\">");
+  EXPECT_EQ(2, statistics()->GetVariable(
+      ImageRewriteFilter::kImageRewrites)->Get());
+  EXPECT_EQ(0, statistics()->GetVariable(
+      RewriteContext::kNumDedupedRewriteMisses)->Get());
+}
+
 TEST_F(ImageRewriteTest, ResizeHigherDimensionTest) {
   options()->EnableFilter(RewriteOptions::kResizeImages);
   rewrite_driver()->AddFilters();
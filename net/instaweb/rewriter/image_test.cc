@@ -937,6 +937,63 @@ TEST_F(ImageTest, UseJpegLossyIfInputQualityIsLowTest) {
                                               &message_handler_));
 }
 
+TEST_F(ImageTest, JpegQualitySearchTest) {
+  Image::CompressionOptions* options = new Image::CompressionOptions();
+  SetJpegRecompressionAndQuality(options);
+  options->target_ssim = 0.9;
+
+  GoogleString buffer;
+  ImagePtr image(ReadFromFileWithOptions(kPuzzle, &buffer, options));
+  EXPECT_GT(buffer.size(), image->output_size());
+  EXPECT_LE(50, options->searched_quality);
+  EXPECT_GT(85, options->searched_quality);
+  EXPECT_LT(image->output_size(), options->fixed_quality_bytes);
+}
+
+TEST_F(ImageTest, JpegQualitySearchUsesHintTest) {
+  Image::CompressionOptions* options = new Image::CompressionOptions();
+  SetJpegRecompressionAndQuality(options);
+  options->target_ssim = 0.9;
+  options->searched_quality_hint = 60;
+
+  GoogleString buffer;
+  ImagePtr image(ReadFromFileWithOptions(kPuzzle, &buffer, options));
+  EXPECT_GT(buffer.size(), image->output_size());
+  EXPECT_EQ(60, options->searched_quality);
+  // No search ran, so there is no fixed-quality size to compare against.
+  EXPECT_EQ(-1, options->fixed_quality_bytes);
+  EXPECT_EQ(
+      60, JpegUtils::GetImageQualityFromImage(image->Contents().data(),
+                                              image->Contents().size(),
+                                              &message_handler_));
+}
+
+TEST_F(ImageTest, JpegToWebpQualitySearchRecordsOneConversionTest) {
+  // FYI: Several WebP encodes are slow under Valgrind.
+  if (RunningOnValgrind()) {
+    return;
+  }
+  Image::CompressionOptions* options = new Image::CompressionOptions;
+  ConversionVarChecker conversion_var_checker(options);
+  options->recompress_jpeg = true;
+  options->convert_jpeg_to_webp = true;
+  options->preferred_webp = Image::WEBP_LOSSY;
+  options->webp_quality = 75;
+  options->target_ssim = 0.9;
+
+  GoogleString buffer;
+  ImagePtr image(ReadFromFileWithOptions(kPuzzle, &buffer, options));
+  image->output_size();
+  EXPECT_EQ(ContentType::kWebp, image->content_type()->type());
+  EXPECT_GT(75, options->searched_quality);
+
+  // However many qualities were probed, one conversion was served.
+  conversion_var_checker.Test(0, 0, 0,   // gif
+                              0, 0, 0,   // png
+                              0, 1, 0,   // jpeg
+                              true);
+}
+
 TEST_F(ImageTest, JpegRetainColorProfileTest) {
   Image::CompressionOptions* options = new Image::CompressionOptions();
   SetJpegRecompressionAndQuality(options);
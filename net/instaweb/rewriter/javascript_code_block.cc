@@ -61,10 +61,12 @@ const char JavascriptCodeBlock::kIntrospectionComment[] =
 
 JavascriptRewriteConfig::JavascriptRewriteConfig(
     Statistics* stats, bool minify, bool use_experimental_minifier,
+    bool rename_locals,
     const JavascriptLibraryIdentification* identification,
     const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns)
     : minify_(minify),
       use_experimental_minifier_(use_experimental_minifier),
+      rename_locals_(rename_locals),
       library_identification_(identification),
       js_tokenizer_patterns_(js_tokenizer_patterns),
       blocks_minified_(stats->GetVariable(kBlocksMinified)),
@@ -230,7 +232,10 @@ void JavascriptCodeBlock::SwapRewrittenString(GoogleString* other) {
 bool JavascriptCodeBlock::MinifyJs(
     StringPiece input, GoogleString* output,
     source_map::MappingVector* source_mappings) {
-  if (config_->use_experimental_minifier()) {
+  if (config_->use_experimental_minifier() && config_->rename_locals()) {
+    return pagespeed::js::MinifyUtf8JsRenamingLocals(
+        config_->js_tokenizer_patterns(), input, output, source_mappings);
+  } else if (config_->use_experimental_minifier()) {
     return pagespeed::js::MinifyUtf8JsWithSourceMap(
         config_->js_tokenizer_patterns(), input, output, source_mappings);
   } else {
@@ -184,7 +184,7 @@ class JsCodeBlockTest : public ::testing::Test,
                            : kAfterCompilationOld) {
     JavascriptRewriteConfig::InitStats(&stats_);
     config_.reset(new JavascriptRewriteConfig(
-        &stats_, true, use_experimental_minifier_, &libraries_,
+        &stats_, true, use_experimental_minifier_, false, &libraries_,
         &js_tokenizer_patterns_));
     // Register a bogus library with a made-up md5 and plausible canonical url
     // that doesn't occur in our tests, but has the same size as our canonical
@@ -207,17 +207,24 @@ class JsCodeBlockTest : public ::testing::Test,
 
   void DisableMinification() {
     config_.reset(new JavascriptRewriteConfig(
-        &stats_, false, use_experimental_minifier_, &libraries_,
+        &stats_, false, use_experimental_minifier_, false, &libraries_,
         &js_tokenizer_patterns_));
   }
 
   // Must be called after DisableMinification if we call both.
   void DisableLibraryIdentification() {
     config_.reset(new JavascriptRewriteConfig(
-        &stats_, config_->minify(), use_experimental_minifier_, NULL,
+        &stats_, config_->minify(), use_experimental_minifier_,
+        config_->rename_locals(), NULL,
         &js_tokenizer_patterns_));
   }
 
+  void EnableLocalRenaming() {
+    config_.reset(new JavascriptRewriteConfig(
+        &stats_, config_->minify(), use_experimental_minifier_, true,
+        config_->library_identification(), &js_tokenizer_patterns_));
+  }
+
   void RegisterLibrariesIn(JavascriptLibraryIdentification* libs) {
     MD5Hasher md5(JavascriptLibraryIdentification::kNumHashChars);
     GoogleString after_md5 = md5.Hash(after_compilation_);
@@ -275,6 +282,22 @@ TEST_P(JsCodeBlockTest, RewriteNoIdentification) {
   SingleBlockRewriteTest(kBeforeCompilation, after_compilation_);
 }
 
+TEST_P(JsCodeBlockTest, RenameLocals) {
+  static const char kOriginal[] =
+      "function sum(alpha, beta) {\n"
+      "  var total = alpha + beta;\n"
+      "  return total;\n"
+      "}\n";
+  EnableLocalRenaming();
+  EXPECT_TRUE(config_->rename_locals());
+  // Only the experimental minifier knows how to rename locals.
+  SingleBlockRewriteTest(
+      kOriginal,
+      use_experimental_minifier_
+      ? "function sum(a,b){var c=a+b;return c;}"
+      : "function sum(alpha,beta){var total=alpha+beta;return total;}");
+}
+
 TEST_P(JsCodeBlockTest, UnsafeToRename) {
   EXPECT_TRUE(JavascriptCodeBlock::UnsafeToRename(
       kJsWithGetElementsByTagNameScript));
@@ -412,6 +412,7 @@ JavascriptRewriteConfig* JavascriptFilter::InitializeConfig(
                  driver->server_context()->statistics(),
                  minify,
                  options->use_experimental_js_minifier(),
+                 options->rename_javascript_locals(),
                  options->javascript_library_identification(),
                  driver->server_context()->js_tokenizer_patterns());
 }
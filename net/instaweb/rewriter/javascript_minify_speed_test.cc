@@ -30,13 +30,22 @@
 // BM_MinifyJavascriptOld/4k        65045      65232      10000
 // BM_MinifyJavascriptOld/32k      666505     669240       1000
 // BM_MinifyJavascriptOld/256k    4989183    5005530        100
+//
+// BM_MinifyLibrary* and BM_TokenizeLibrary* run the new minifier and just its
+// tokenizer over real, unminified libraries, and report throughput in MB/s.
 
+#include "base/logging.h"
 #include "net/instaweb/rewriter/public/javascript_code_block.h"
 #include "net/instaweb/rewriter/public/javascript_library_identification.h"
 #include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/null_statistics.h"
+#include "pagespeed/kernel/base/stdio_file_system.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/js/js_minify.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
 namespace net_instaweb {
@@ -45,6 +54,8 @@ extern const char* JS_console_js;
 
 namespace {
 
+const char kLibraryDir[] = "/pagespeed/kernel/js/testdata/third_party/";
+
 void TestMinifyJavascript(bool use_experimental_minifier, int iters, int size) {
   GoogleString in_text;
   for (int i = 0; i < size; i += strlen(JS_console_js)) {
@@ -58,6 +69,7 @@ void TestMinifyJavascript(bool use_experimental_minifier, int iters, int size) {
   JavascriptLibraryIdentification js_lib_id;
   JavascriptRewriteConfig config(&stats, true /* minify */,
                                  use_experimental_minifier,
+                                 false /* rename_locals */,
                                  &js_lib_id, &js_tokenizer_patterns);
 
   NullMessageHandler handler;
@@ -77,6 +89,73 @@ static void BM_MinifyJavascriptOld(int iters, int size) {
 }
 BENCHMARK_RANGE(BM_MinifyJavascriptOld, 1<<6, 1<<18);
 
+GoogleString ReadLibrary(const char* filename) {
+  StdioFileSystem file_system;
+  NullMessageHandler handler;
+  GoogleString contents;
+  const GoogleString path = StrCat(GTestSrcDir(), kLibraryDir, filename);
+  CHECK(file_system.ReadFile(path.c_str(), &contents, &handler)) << path;
+  return contents;
+}
+
+void MinifyLibrary(const char* filename, int iters) {
+  StopBenchmarkTiming();
+  const GoogleString original = ReadLibrary(filename);
+  pagespeed::js::JsTokenizerPatterns patterns;
+  GoogleString minified;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    minified.clear();
+    CHECK(pagespeed::js::MinifyUtf8Js(&patterns, original, &minified));
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * original.size());
+}
+
+void TokenizeLibrary(const char* filename, int iters) {
+  StopBenchmarkTiming();
+  const GoogleString original = ReadLibrary(filename);
+  pagespeed::js::JsTokenizerPatterns patterns;
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    pagespeed::js::JsTokenizer tokenizer(&patterns, original);
+    StringPiece token;
+    while (tokenizer.NextToken(&token) != pagespeed::JsKeywords::kEndOfInput) {
+    }
+    CHECK(!tokenizer.has_error());
+  }
+  SetBenchmarkBytesProcessed(static_cast<int64>(iters) * original.size());
+}
+
+static void BM_MinifyLibraryAngular(int iters) {
+  MinifyLibrary("angular.original", iters);
+}
+BENCHMARK(BM_MinifyLibraryAngular);
+
+static void BM_MinifyLibraryJQuery(int iters) {
+  MinifyLibrary("jquery.original", iters);
+}
+BENCHMARK(BM_MinifyLibraryJQuery);
+
+static void BM_MinifyLibraryPrototype(int iters) {
+  MinifyLibrary("prototype.original", iters);
+}
+BENCHMARK(BM_MinifyLibraryPrototype);
+
+static void BM_TokenizeLibraryAngular(int iters) {
+  TokenizeLibrary("angular.original", iters);
+}
+BENCHMARK(BM_TokenizeLibraryAngular);
+
+static void BM_TokenizeLibraryJQuery(int iters) {
+  TokenizeLibrary("jquery.original", iters);
+}
+BENCHMARK(BM_TokenizeLibraryJQuery);
+
+static void BM_TokenizeLibraryPrototype(int iters) {
+  TokenizeLibrary("prototype.original", iters);
+}
+BENCHMARK(BM_TokenizeLibraryPrototype);
+
 }  // namespace
 
 }  // namespace net_instaweb
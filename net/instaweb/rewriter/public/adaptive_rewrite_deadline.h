@@ -0,0 +1,101 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NET_INSTAWEB_REWRITER_PUBLIC_ADAPTIVE_REWRITE_DEADLINE_H_
+#define NET_INSTAWEB_REWRITER_PUBLIC_ADAPTIVE_REWRITE_DEADLINE_H_
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace net_instaweb {
+
+// Learns how long a site's flush windows take to complete all their
+// rewrites, and suggests a per-window rewrite deadline under which about
+// target_percent of windows complete.  A window which would finish its
+// rewrites quickly then isn't held for the full configured deadline on
+// account of the site's occasional slow rewrite, and the deadline only
+// grows back towards the configured one when windows start missing it.
+//
+// The estimate is a stochastic approximation of the target quantile of
+// window completion times, updated multiplicatively from whether each window
+// met the deadline it was given.  That is all that can be observed of a
+// window which misses its deadline, and it is enough: at equilibrium the
+// fraction of windows completing is the target.  The estimate can be
+// persisted between requests with EncodeEstimate and DecodeEstimate.
+//
+// Not thread-safe.
+class AdaptiveRewriteDeadline {
+ public:
+  // Name of the property the estimate is stored under.
+  static const char kPropertyName[];
+
+  // No window is given less than this.
+  static const int64 kMinDeadlineMs = 1;
+
+  // How far a single window moves the estimate: a window which misses its
+  // deadline multiplies it by exp(kLearningRate * target_fraction), and one
+  // which completes divides it by exp(kLearningRate * (1 - target_fraction)).
+  static const double kLearningRate;
+
+  // The estimate is only worth saving on its own account once it has moved
+  // by more than this fraction from the one decoded.
+  static const double kSaveThreshold;
+
+  // The learned deadline never exceeds max_deadline_ms, the configured
+  // rewrite deadline, and starts out there.
+  AdaptiveRewriteDeadline(int64 max_deadline_ms, int target_percent);
+  ~AdaptiveRewriteDeadline();
+
+  // Rounded up to whole milliseconds.
+  int64 deadline_ms() const;
+
+  // Records the outcome of a window whose rewrites were given deadline_ms()
+  // (or longer) to complete.
+  void RecordWindow(bool all_rewrites_completed);
+  int num_windows_recorded() const { return num_windows_recorded_; }
+
+  // Restores an estimate saved by EncodeEstimate, clamped to the current
+  // bounds.  Returns false, leaving the estimate unchanged, if value is
+  // malformed.
+  bool DecodeEstimate(StringPiece value);
+  GoogleString EncodeEstimate() const;
+
+  // Returns whether the estimate has moved by more than kSaveThreshold since
+  // DecodeEstimate, or true if nothing was decoded.
+  bool ChangedSignificantly() const;
+
+  // Raises the factor by which the estimate has changed since DecodeEstimate
+  // to the power 'factor'.  A caller which saves only one in 'factor' small
+  // changes calls this before saving, so that the saved estimate moves, on
+  // average, as it would if every change were saved.
+  void ScaleChangeSinceDecode(int factor);
+
+ private:
+  void SetEstimateUs(double estimate_us);
+
+  const int64 max_deadline_us_;
+  const double target_fraction_;
+  double estimate_us_;
+  double decoded_estimate_us_;  // 0 if nothing was decoded.
+  int num_windows_recorded_;
+
+  DISALLOW_COPY_AND_ASSIGN(AdaptiveRewriteDeadline);
+};
+
+}  // namespace net_instaweb
+
+#endif  // NET_INSTAWEB_REWRITER_PUBLIC_ADAPTIVE_REWRITE_DEADLINE_H_
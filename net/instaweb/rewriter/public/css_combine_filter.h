@@ -45,6 +45,10 @@ class CssCombineFilter : public RewriteFilter {
   static const char kCssCombineOpportunities[];
   // CSS file reduction (Optimally this equals kCssCombineOpportunities).
   static const char kCssFileCountReduction[];
+  // Per-input pieces of combined CSS copied from, or added to, the
+  // server's CssFragmentCache.
+  static const char kCssCombineFragmentReuses[];
+  static const char kCssCombineFragmentMisses[];
 
   explicit CssCombineFilter(RewriteDriver* rewrite_driver);
   virtual ~CssCombineFilter();
@@ -40,6 +40,7 @@
 #include "pagespeed/kernel/html/html_node.h"
 #include "pagespeed/kernel/http/google_url.h"
 #include "pagespeed/kernel/util/url_segment_encoder.h"
+#include "webutil/css/arena.h"
 
 namespace Css {
 
@@ -52,6 +53,7 @@ namespace net_instaweb {
 class AssociationTransformer;
 class AsyncFetch;
 class CssImageRewriter;
+class CssUrlCounter;
 class CacheExtender;
 class ImageCombineFilter;
 class ImageRewriteFilter;
@@ -113,6 +115,7 @@ class CssFilter : public RewriteFilter {
   static const char kParseFailures[];
   static const char kFallbackRewrites[];
   static const char kFallbackFailures[];
+  static const char kStreamingRewrites[];
   static const char kRewritesDropped[];
   static const char kTotalBytesSaved[];
   static const char kTotalOriginalBytes[];
@@ -210,6 +213,8 @@ class CssFilter : public RewriteFilter {
   Variable* num_fallback_rewrites_;
   // # of CSS blocks that failed to be rewritten in the fallback path.
   Variable* num_fallback_failures_;
+  // # of CSS blocks rewritten by the streaming path, without being parsed.
+  Variable* num_streaming_rewrites_;
   // # of CSS rewrites which were not applied because they made the CSS larger
   // and did not rewrite any images in it/flatten any other CSS files into it.
   Variable* num_rewrites_dropped_;
@@ -336,6 +341,33 @@ class CssFilter::Context : public SingleRewriteContext {
                            const GoogleUrl& css_trim_gurl,
                            const StringPiece& in_text);
 
+  // Is the streaming path enabled for this rewrite?  It skips the parser and
+  // rewrites URLs and minifies using CssTagScanner::TransformUrlsAndMinify,
+  // so it is only used when no enabled filter needs the parsed stylesheet.
+  bool StreamingRewriteEnabled() const;
+
+  // Like FallbackRewriteUrls, but used instead of parsing rather than after
+  // a parse failure, and the output is minified.  Returns false if in_text
+  // is not simple enough for the streaming path, in which case it should be
+  // parsed as usual.
+  bool StreamingRewriteUrls(const GoogleUrl& css_base_gurl,
+                            const GoogleUrl& css_trim_gurl,
+                            const StringPiece& in_text);
+
+  // Sets up fallback_transformer_ and starts nested rewrites of the URLs
+  // found by url_counter.  Shared by the fallback and streaming paths.
+  void RewriteCountedUrls(const GoogleUrl& css_base_gurl,
+                          const GoogleUrl& css_trim_gurl,
+                          const CssUrlCounter& url_counter);
+
+  // Did any nested rewrite optimize the resource in its slot?
+  bool NestedRewritesOptimized();
+
+  // Decides whether rewriting in_text_size bytes of CSS to out_text_size
+  // bytes was worthwhile, updating statistics accordingly.
+  bool KeepRewrite(int64 in_text_size, int64 out_text_size,
+                   bool previously_optimized, const GoogleUrl& css_base_gurl);
+
   // Tries to write out a (potentially edited) stylesheet out to out_text,
   // and returns whether we should consider the result as an improvement.
   bool SerializeCss(int64 in_text_size,
@@ -364,14 +396,22 @@ class CssFilter::Context : public SingleRewriteContext {
   scoped_ptr<CssImageRewriter> css_image_rewriter_;
   ImageRewriteFilter* image_rewrite_filter_;
   CssResourceSlotFactory slot_factory_;
+  // The stylesheet parsed by RewriteCssText is allocated here and refers
+  // into input_resource_'s contents; it is all freed at once with this
+  // context.  This must be declared before hierarchy_, which owns the
+  // stylesheet, so that it outlives it.
+  Css::Arena arena_;
   CssHierarchy hierarchy_;
   bool css_rewritten_;
   bool has_utf8_bom_;
 
   // Are we performing a fallback rewrite?
   bool fallback_mode_;
+  // Are we performing a streaming rewrite?
+  bool streaming_mode_;
   // Transformer used by CssTagScanner to rewrite URLs if we failed to
-  // parse CSS. This will only be defined if CSS parsing failed.
+  // parse CSS, or did not parse it at all in streaming mode.  This will only
+  // be defined in fallback or streaming mode.
   scoped_ptr<AssociationTransformer> fallback_transformer_;
   // Backup transformer for AssociationTransformer. Absolutifies URLs and
   // rewrites their domains as necessary if they can't be cache extended.
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NET_INSTAWEB_REWRITER_PUBLIC_CSS_FRAGMENT_CACHE_H_
+#define NET_INSTAWEB_REWRITER_PUBLIC_CSS_FRAGMENT_CACHE_H_
+
+#include <cstddef>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/thread_annotations.h"
+#include "pagespeed/kernel/cache/lru_cache_base.h"
+
+namespace net_instaweb {
+
+class AbstractMutex;
+class ThreadSystem;
+
+// A size-bounded, in-memory cache of per-input pieces of combined CSS, such
+// as a stylesheet's text with its URLs already resolved against the base of
+// the combination it went into.  When the set of stylesheets on a page
+// changes slightly -- one added at the end of the head, say -- the new
+// combination is a different resource and has to be built from scratch, but
+// most of its inputs are the same as before.  The combiner keeps their
+// pieces here so those inputs are copied rather than parsed and rewritten
+// again.
+//
+// Callers choose the keys, and must fold into them everything that affects
+// the piece: typically the input's contents hash and URL, the combination's
+// base, and the options signature.
+//
+// This class is thread-safe.
+class CssFragmentCache {
+ public:
+  CssFragmentCache(size_t max_bytes, ThreadSystem* thread_system);
+  ~CssFragmentCache();
+
+  // Returns true and shares the cached bytes for 'key' into *fragment if
+  // present.
+  bool Lookup(const GoogleString& key, SharedString* fragment);
+
+  void Insert(const GoogleString& key, const SharedString& fragment);
+
+  size_t size_bytes() const;
+  size_t num_elements() const;
+
+ private:
+  class FragmentHelper {
+   public:
+    size_t size(const SharedString& fragment) const {
+      return fragment.size();
+    }
+    bool Equal(const SharedString& a, const SharedString& b) const {
+      return a.Value() == b.Value();
+    }
+    void EvictNotify(const SharedString& fragment) {}
+    bool ShouldReplace(const SharedString& old_fragment,
+                       const SharedString& new_fragment) const {
+      return true;
+    }
+  };
+  typedef LRUCacheBase<SharedString, FragmentHelper> Lru;
+
+  scoped_ptr<AbstractMutex> mutex_;
+  FragmentHelper helper_;
+  Lru lru_ GUARDED_BY(mutex_);
+
+  DISALLOW_COPY_AND_ASSIGN(CssFragmentCache);
+};
+
+}  // namespace net_instaweb
+
+#endif  // NET_INSTAWEB_REWRITER_PUBLIC_CSS_FRAGMENT_CACHE_H_
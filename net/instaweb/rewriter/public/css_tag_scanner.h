@@ -85,6 +85,19 @@ class CssTagScanner {
       const StringPiece& contents, Writer* writer, Transformer* transformer,
       MessageHandler* handler);
 
+  // Like TransformUrls, but also minifies the CSS in the same pass, without
+  // parsing it: comments and redundant whitespace and semicolons are removed,
+  // while everything else, including strings, is copied through unchanged.
+  // Only url( and @import outside strings and comments are transformed.
+  //
+  // Returns false, possibly having written partial output, if the CSS is
+  // not simple enough for that to be safe (unbalanced braces or parens,
+  // unterminated strings or comments) or if a URL fails to transform.  The
+  // caller should then fall back on the parser.
+  static bool TransformUrlsAndMinify(
+      const StringPiece& contents, Writer* writer, Transformer* transformer,
+      MessageHandler* handler);
+
   // Does this CSS file contain @import? If so, it cannot be combined with
   // previous CSS files. This may give false-positives, but no false-negatives.
   static bool HasImport(const StringPiece& contents, MessageHandler* handler);
@@ -118,6 +131,9 @@ class RewriteDomainTransformer : public CssTagScanner::Transformer {
 
   void set_trim_urls(bool x) { trim_urls_ = x; }
 
+  // True once Transform() has changed any URL.
+  bool changed_any_url() const { return changed_any_url_; }
+
  private:
   const GoogleUrl* old_base_url_;
   const GoogleUrl* new_base_url_;
@@ -126,6 +142,7 @@ class RewriteDomainTransformer : public CssTagScanner::Transformer {
   UrlLeftTrimFilter* url_trim_filter_;
   MessageHandler* handler_;
   bool trim_urls_;
+  bool changed_any_url_;
   RewriteDriver* driver_;
 
   DISALLOW_COPY_AND_ASSIGN(RewriteDomainTransformer);
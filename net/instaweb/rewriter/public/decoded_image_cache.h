@@ -0,0 +1,185 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NET_INSTAWEB_REWRITER_PUBLIC_DECODED_IMAGE_CACHE_H_
+#define NET_INSTAWEB_REWRITER_PUBLIC_DECODED_IMAGE_CACHE_H_
+
+#include <cstddef>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/ref_counted_ptr.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_annotations.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/cache/lru_cache_base.h"
+#include "pagespeed/kernel/image/image_util.h"
+
+namespace pagespeed {
+namespace image_compression {
+class ScanlineReaderInterface;
+}  // namespace image_compression
+}  // namespace pagespeed
+
+namespace net_instaweb {
+
+class MessageHandler;
+class Statistics;
+class Timer;
+class Variable;
+
+// A fully decoded image raster.  Instances are immutable once built and are
+// shared between threads, so any number of readers may scan one at a time.
+class DecodedImage : public RefCounted<DecodedImage> {
+ public:
+  // Takes ownership of 'pixels', which must have been allocated with
+  // malloc(), as ReadImage() does.
+  DecodedImage(void* pixels,
+               pagespeed::image_compression::PixelFormat pixel_format,
+               size_t width, size_t height, size_t stride, int64 decoded_ms);
+
+  // Returns a new reader over the raster.  The reader holds a reference to
+  // this image, so it may outlive the cache entry.
+  pagespeed::image_compression::ScanlineReaderInterface* NewReader(
+      MessageHandler* handler);
+
+  pagespeed::image_compression::PixelFormat pixel_format() const {
+    return pixel_format_;
+  }
+  size_t width() const { return width_; }
+  size_t height() const { return height_; }
+  size_t stride() const { return stride_; }
+  const uint8* pixels() const { return pixels_; }
+  size_t size_bytes() const { return stride_ * height_; }
+  int64 decoded_ms() const { return decoded_ms_; }
+
+ private:
+  friend class RefCounted<DecodedImage>;
+  ~DecodedImage();
+
+  uint8* pixels_;
+  const pagespeed::image_compression::PixelFormat pixel_format_;
+  const size_t width_;
+  const size_t height_;
+  const size_t stride_;
+  const int64 decoded_ms_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedImage);
+};
+
+typedef RefCountedPtr<DecodedImage> DecodedImagePtr;
+
+// A short-lived, size-bounded cache of decoded images, keyed by a hash of the
+// encoded contents.  An image on a page is commonly rewritten into several
+// variants -- one per rendered size, per WebP support level, per mobile
+// screen -- and each of those rewrites would otherwise decode the same input
+// from scratch.
+//
+// Entries expire a few seconds after they were decoded: the cache exists to
+// bridge sibling rewrites of one input, not to keep rasters around, so each
+// new decode also drops every expired entry rather than leaving them to be
+// evicted by size.  The bounds come from RewriteOptions::
+// decoded_image_cache_max_bytes() and decoded_image_cache_ttl_ms().  When a
+// thread asks for an image that another thread is in the middle of decoding,
+// it waits for that decode to finish rather than starting its own, so
+// variant rewrites of one input run back-to-back against a single decode.
+// The wait is bounded by the caller; past that it decodes a private copy.
+//
+// This class is thread-safe.
+class DecodedImageCache {
+ public:
+  static const char kDecodedImageCacheHits[];
+  static const char kDecodedImageCacheMisses[];
+  static const char kDecodedImageCacheWaits[];
+  static const char kDecodedImageCacheWaitTimeouts[];
+
+  DecodedImageCache(size_t max_bytes, int64 ttl_ms,
+                    ThreadSystem* thread_system, Timer* timer,
+                    Statistics* stats);
+  ~DecodedImageCache();
+
+  static void InitStats(Statistics* statistics);
+
+  // Returns the decoded raster for 'contents', an image of 'format' whose
+  // contents are identified by 'key'.  Decodes it if it is not cached,
+  // unless another thread is already doing so, in which case this waits
+  // up to max_wait_ms for that decode, or indefinitely if max_wait_ms is
+  // negative.  If the wait runs out, this decodes a copy of its own and
+  // leaves it out of the cache.  Returns NULL if the image cannot be
+  // decoded.
+  DecodedImagePtr Decode(const GoogleString& key,
+                         pagespeed::image_compression::ImageFormat format,
+                         const StringPiece& contents, int64 max_wait_ms,
+                         MessageHandler* handler);
+
+  size_t size_bytes() const;
+  size_t num_elements() const;
+
+ private:
+  class DecodedImageHelper {
+   public:
+    size_t size(const DecodedImagePtr& image) const {
+      return image->size_bytes();
+    }
+    bool Equal(const DecodedImagePtr& a, const DecodedImagePtr& b) const {
+      return a.get() == b.get();
+    }
+    void EvictNotify(const DecodedImagePtr& image) {}
+    bool ShouldReplace(const DecodedImagePtr& old_image,
+                       const DecodedImagePtr& new_image) const {
+      return true;
+    }
+  };
+  typedef LRUCacheBase<DecodedImagePtr, DecodedImageHelper> Lru;
+
+  bool IsExpired(const DecodedImagePtr& image, int64 now_ms) const {
+    return image->decoded_ms() + ttl_ms_ <= now_ms;
+  }
+
+  // Returns the cached image for 'key' if it has not expired.  Expired
+  // entries are dropped.
+  DecodedImagePtr LookupLocked(const GoogleString& key)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Waits until no decode of 'key' is in progress, for at most max_wait_ms
+  // if that is not negative.  Returns false if the wait ran out.
+  bool WaitForDecodeLocked(const GoogleString& key, int64 max_wait_ms)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drops all expired entries.  This walks the whole cache, which holds at
+  // most a few dozen rasters, so it is cheap next to the decode it follows.
+  void DropExpiredLocked() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int64 ttl_ms_;
+  Timer* timer_;
+  scoped_ptr<ThreadSystem::CondvarCapableMutex> mutex_;
+  scoped_ptr<ThreadSystem::Condvar> decode_done_;
+  DecodedImageHelper helper_;
+  Lru lru_ GUARDED_BY(mutex_);
+  StringSet decodes_in_progress_ GUARDED_BY(mutex_);
+
+  Variable* hits_;
+  Variable* misses_;
+  Variable* waits_;
+  Variable* wait_timeouts_;
+
+  DISALLOW_COPY_AND_ASSIGN(DecodedImageCache);
+};
+
+}  // namespace net_instaweb
+
+#endif  // NET_INSTAWEB_REWRITER_PUBLIC_DECODED_IMAGE_CACHE_H_
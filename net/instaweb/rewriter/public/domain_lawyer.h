@@ -394,12 +394,34 @@ class DomainLawyer {
 
   Domain* FindDomain(const GoogleUrl& gurl) const;
 
+  // Returns the first of wildcarded_domains_ that matches domain_path, or
+  // NULL if none do.
+  Domain* FindWildcardedDomain(const StringPiece& domain_path) const;
+
+  // Adds wildcarded_domains_[index] to wildcard_suffix_trie_.
+  void IndexWildcardedDomain(int index);
+  // Rebuilds wildcard_suffix_trie_ from scratch after wildcarded_domains_
+  // has been reordered.
+  void ReindexWildcardedDomains();
+
   // Map-order is important as ordering is taken into consideration while
   // constructing the signature of the domain lawyer.
   typedef std::map<GoogleString, Domain*> DomainMap;  // see AddDomainHelper
   DomainMap domain_map_;
   typedef std::vector<Domain*> DomainVector;          // see AddDomainHelper
   DomainVector wildcarded_domains_;
+
+  // A trie over the reversed literal suffixes of wildcarded_domains_, i.e.
+  // the text following the last * or ? in each wildcard.  A domain can only
+  // match a wildcard if it ends in that wildcard's literal suffix, so walking
+  // the trie backwards from the end of a domain yields every wildcard that
+  // could possibly match it.  Element 0 is the root.
+  struct WildcardSuffixNode {
+    std::map<char, int> children;  // Indices into wildcard_suffix_trie_.
+    std::vector<int> wildcards;    // Indices into wildcarded_domains_.
+  };
+  std::vector<WildcardSuffixNode> wildcard_suffix_trie_;
+
   GoogleString proxy_suffix_;
   bool can_rewrite_domains_;
   // Indicates if all domains are authorized. If set to true, IsDomainAuthorized
@@ -29,6 +29,7 @@
 #include "pagespeed/kernel/http/image_types.pb.h"
 
 namespace net_instaweb {
+class DecodedImageCache;
 class Histogram;
 class MessageHandler;
 class Timer;
@@ -109,9 +110,15 @@ class Image {
           jpeg_num_progressive_scans(
               RewriteOptions::kDefaultImageJpegNumProgressiveScans),
           webp_conversion_timeout_ms(-1),
+          target_ssim(-1.0),
+          searched_quality_hint(-1),
           conversions_attempted(0),
           preserve_lossless(false),
-          webp_conversion_variables(NULL) {}
+          searched_quality(-1),
+          fixed_quality_bytes(-1),
+          webp_conversion_variables(NULL),
+          decoded_image_cache(NULL),
+          decoded_image_max_wait_ms(-1) {}
 
     // These options are set by the client to specify what type of
     // conversion to perform:
@@ -133,13 +140,33 @@ class Image {
     bool use_transparent_for_blank_image;
     int64 jpeg_num_progressive_scans;
     int64 webp_conversion_timeout_ms;
+    // If positive, lossy JPEG and WebP encodings search for the lowest
+    // quality, no higher than jpeg_quality or webp_quality, whose output
+    // still has at least this structural similarity to the input.
+    double target_ssim;
+    // If set, the quality an earlier target_ssim search chose for the same
+    // input, which is used as is rather than searching again.
+    int64 searched_quality_hint;
 
     // These fields are set by the conversion routines to report
     // characteristics of the conversion process.
     int conversions_attempted;
     bool preserve_lossless;
+    // Set when a target_ssim quality search ran: the quality it chose, and
+    // the size the output would have had at the fixed configured quality.
+    int64 searched_quality;
+    int64 fixed_quality_bytes;
 
     ConversionVariables* webp_conversion_variables;
+
+    // If set, resizing takes the decoded original from this cache, keyed by
+    // decoded_image_key, which must identify the original's contents.  If
+    // another rewrite is decoding it, resizing waits for that decode for up
+    // to decoded_image_max_wait_ms (negative: no limit), then decodes the
+    // original itself.
+    DecodedImageCache* decoded_image_cache;
+    GoogleString decoded_image_key;
+    int64 decoded_image_max_wait_ms;
   };
 
   virtual ~Image();
@@ -72,6 +72,8 @@ class ImageRewriteFilter : public RewriteFilter {
   // Statistic names:
   static const char kImageNoRewritesHighResolution[];
   static const char kImageOngoingRewrites[];
+  static const char kImageQualitySearchBytesSaved[];
+  static const char kImageQualitySearches[];
   static const char kImageResizedUsingRenderedDimensions[];
   static const char kImageRewriteLatencyFailedMs[];
   static const char kImageRewriteLatencyOkMs[];
@@ -233,6 +235,11 @@ class ImageRewriteFilter : public RewriteFilter {
                                           const ResourcePtr& input_resource,
                                           const OutputResourcePtr& result);
 
+  // Remembers the quality a target SSIM search chose for input_resource, for
+  // the next rewrite of the same contents.
+  void SaveSearchedQuality(Context* context,
+                           const ResourcePtr& input_resource, int64 quality);
+
   // Returns true if it rewrote (ie inlined) the URL.
   bool FinishRewriteCssImageUrl(
       int64 css_image_inline_max_bytes,
@@ -334,6 +341,11 @@ class ImageRewriteFilter : public RewriteFilter {
   Variable* image_inline_count_;
   // # of images rewritten into WebP format.
   Variable* image_webp_rewrites_;
+  // # of images whose quality was chosen by a target-SSIM search.
+  Variable* image_quality_searches_;
+  // # of bytes saved by searched qualities relative to encoding the same
+  // images at the fixed configured quality.
+  Variable* image_quality_search_bytes_saved_;
 
   // # total number of milliseconds spent rewriting images since server start
   Variable* image_rewrite_latency_total_ms_;
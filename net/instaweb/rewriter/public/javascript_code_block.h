@@ -60,6 +60,7 @@ class JavascriptRewriteConfig {
 
   JavascriptRewriteConfig(
       Statistics* statistics, bool minify, bool use_experimental_minifier,
+      bool rename_locals,
       const JavascriptLibraryIdentification* identification,
       const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns);
 
@@ -71,6 +72,9 @@ class JavascriptRewriteConfig {
   // TODO(sligocki): Once that minifier has been around for a while, we
   // should deprecate this option.
   bool use_experimental_minifier() const { return use_experimental_minifier_; }
+  // Whether the experimental minifier should also rename function parameters
+  // and local variables.  Ignored if use_experimental_minifier() is false.
+  bool rename_locals() const { return rename_locals_; }
   const JavascriptLibraryIdentification* library_identification() const {
     return library_identification_;
   }
@@ -93,6 +97,7 @@ class JavascriptRewriteConfig {
  private:
   bool minify_;
   bool use_experimental_minifier_;
+  bool rename_locals_;
   // Library identifier.  NULL if library identification should be skipped.
   const JavascriptLibraryIdentification* library_identification_;
   const pagespeed::js::JsTokenizerPatterns* js_tokenizer_patterns_;
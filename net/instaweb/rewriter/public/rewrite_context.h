@@ -31,6 +31,7 @@
 #include "net/instaweb/rewriter/public/server_context.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/http/google_url.h"
@@ -149,6 +150,8 @@ class RewriteContext {
   static const char kNumDistributedRewriteSuccesses[];
   static const char kNumDistributedRewriteFailures[];
   static const char kNumDistributedMetadataFailures[];
+  static const char kNumDedupedRewriteHits[];
+  static const char kNumDedupedRewriteMisses[];
   // The extension used for all distributed fetch URLs.
   static const char kDistributedExt[];
   // The hash value used for all distributed fetch URLs.
@@ -383,6 +386,11 @@ class RewriteContext {
   // This method can run in any thread.
   void RewriteDone(RewriteResult result, int partition_index);
 
+  // Called in the rewrite thread once RewriteDone has recorded the result of
+  // a partition, before the partition table is written or the slots are
+  // rendered.  The default implementation does nothing.
+  virtual void PartitionRewriteDone(RewriteResult result, int partition_index);
+
   // Sends a a response to the the client via the AsyncFetch, transforming
   // output if needed (e.g. css absolutification) and controlling chunked
   // encoding hints as needed.
@@ -500,6 +508,12 @@ class RewriteContext {
   // trace (if present) as well as the root user request trace (if present).
   void TracePrintf(const char* fmt, ...);
 
+  // The structured trace of the request this rewrite is for, or NULL if the
+  // request is not being traced, and the span covering this rewrite, under
+  // which subclasses may record their own spans.
+  SpanTrace* span_trace();
+  SpanTrace::SpanId span() const { return span_; }
+
   // -----------------------------------------------------------------------
   // Fetch state machine override APIs, as well as exports of some general
   // state machine state for overriders to use. If you just want to write an
@@ -782,6 +796,10 @@ class RewriteContext {
   // unhealthy.
   void DetachSlots();
 
+  // Closes span_, if the request is being traced.  Called both when the
+  // rewrite finishes and when its successors are run, whichever is first.
+  void EndSpan();
+
   // Activate any Rewrites that come after this one, for serializability
   // of access to common slots.
   void RunSuccessors();
@@ -1022,6 +1040,13 @@ class RewriteContext {
   // Always owned externally.
   RequestTrace* dependent_request_trace_;
 
+  // When the request is traced, the span covering this rewrite from Start
+  // until it's done, and the span it's a child of.  span_parent_ is set by
+  // the RewriteDriver to the flush window that initiated the rewrite; nested
+  // rewrites use their parent's span instead.
+  SpanTrace::SpanId span_;
+  SpanTrace::SpanId span_parent_;
+
   // Set true if this rewrite context should be blocked from distributing its
   // rewrite.
   bool block_distribute_rewrite_;
@@ -50,6 +50,7 @@
 #include "pagespeed/kernel/base/printf_format.h"
 #include "pagespeed/kernel/base/proto_util.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/thread_annotations.h"
@@ -73,6 +74,7 @@
 namespace net_instaweb {
 
 class AbstractLogRecord;
+class AdaptiveRewriteDeadline;
 class AsyncFetch;
 class CriticalCssResult;
 class CriticalLineInfo;
@@ -150,6 +152,11 @@ class RewriteDriver : public HtmlParse {
   static const char kDomCohort[];
   // The cohort for properties that are written by the beacon handler.
   static const char kBeaconCohort[];
+  // The cohort for the rewrite deadline learned for an origin when
+  // adaptive_rewrite_deadline is on.  It is kept apart from the dom cohort
+  // so that saving the estimate does not rewrite the origin's other
+  // properties.
+  static const char kAdaptiveRewriteDeadlineCohort[];
 
   // Property Names in DomCohort.
   // Tracks the timestamp when we last received a request for this url.
@@ -1287,10 +1294,19 @@ class RewriteDriver : public HtmlParse {
 
   // Returns the amount of time to wait for rewrites to complete for the
   // current flush window. This combines the per-flush window deadline
-  // (configured via rewrite_deadline_ms()) and the per-page deadline
+  // (configured via rewrite_deadline_ms(), or learned for the site if
+  // adaptive_rewrite_deadline() is set) and the per-page deadline
   // (configured via max_page_processing_delay_ms()).
   int64 ComputeCurrentFlushWindowRewriteDelayMs();
 
+  // Creates adaptive_rewrite_deadline_, seeded from the estimate stored in
+  // the per-origin property page, if any.
+  void InitAdaptiveRewriteDeadline();
+
+  // Feeds the outcome of the flush window just completed into the flush
+  // window statistics and adaptive_rewrite_deadline_.
+  void RecordFlushWindowOutcome(int num_rewrites, int still_pending_rewrites);
+
   // Queues up invocation of FlushAsyncDone in our html_workers sequence.
   void QueueFlushAsyncDone(int num_rewrites, Function* callback);
 
@@ -1372,6 +1388,12 @@ class RewriteDriver : public HtmlParse {
   // RewriteFilter::UsesPropertyCacheDomCohort() to return true.
   void WriteDomCohortIntoPropertyCache();
 
+  // Saves what adaptive_rewrite_deadline_ learned from this page's flush
+  // windows into the per-origin property page.  Changes too small to save
+  // on their own account are saved by only a sample of requests, so that
+  // most requests don't write the origin's page, nor overwrite each other.
+  void WriteAdaptiveRewriteDeadlineIntoPropertyCache();
+
   // Used by CreateCacheFetcher() and CreateCacheOnlyFetcher().
   CacheUrlAsyncFetcher* CreateCustomCacheFetcher(UrlAsyncFetcher* base_fetcher);
 
@@ -1526,6 +1548,9 @@ class RewriteDriver : public HtmlParse {
   bool flush_requested_;
   bool flush_occurred_;
 
+  // The span covering the current flush window, when the request is traced.
+  SpanTrace::SpanId flush_span_;
+
   // If it is true, then cached html is flushed.
   bool flushed_cached_html_;
 
@@ -1585,6 +1610,14 @@ class RewriteDriver : public HtmlParse {
   // windows. A negative value implies no limit.
   int max_page_processing_delay_ms_;
 
+  // The rewrite deadline given to the current flush window, or -1 if it
+  // waits for all rewrites to complete.
+  int64 flush_window_deadline_ms_;
+
+  // Learns the site's flush window deadline when the
+  // adaptive_rewrite_deadline option is on; created at the first flush.
+  scoped_ptr<AdaptiveRewriteDeadline> adaptive_rewrite_deadline_;
+
   typedef std::set<RewriteContext*> RewriteContextSet;
 
   // Contains the RewriteContext* that have been queued into the
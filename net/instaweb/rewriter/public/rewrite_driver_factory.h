@@ -41,6 +41,8 @@ class CriticalCssFinder;
 class CriticalImagesFinder;
 class CriticalLineInfoFinder;
 class CriticalSelectorFinder;
+class CssFragmentCache;
+class DecodedImageCache;
 class FileSystem;
 class FlushEarlyInfoFinder;
 class ExperimentMatcher;
@@ -239,6 +241,16 @@ class RewriteDriverFactory {
   // first call to InitServerContext(), which is thread-safe.
   RewriteStats* rewrite_stats();
 
+  // Decoded images shared between variant rewrites of an image, across all
+  // server contexts, sized from default_options().  NULL if the options
+  // disable it.  Subject to the same threading rules as rewrite_stats().
+  DecodedImageCache* decoded_image_cache();
+
+  // Per-input pieces of combined CSS, shared across all server contexts and
+  // sized from default_options().  NULL if the options disable it.  Subject
+  // to the same threading rules as rewrite_stats().
+  CssFragmentCache* css_fragment_cache();
+
   // statistics (default is NullStatistics).  This can be overridden by calling
   // SetStatistics, either from subclasses or externally.
   Statistics* statistics() { return statistics_; }
@@ -511,6 +523,8 @@ class RewriteDriverFactory {
   // These must be initialized after the RewriteDriverFactory subclass has been
   // constructed so it can use a the statistics() override.
   scoped_ptr<RewriteStats> rewrite_stats_;
+  scoped_ptr<DecodedImageCache> decoded_image_cache_;
+  scoped_ptr<CssFragmentCache> css_fragment_cache_;
 
   // To assist with subclass destruction-order, subclasses can register
   // functions to run late in the destructor.
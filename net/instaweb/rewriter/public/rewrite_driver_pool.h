@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
 
 namespace net_instaweb {
 
@@ -43,15 +44,47 @@ class RewriteDriverPool  {
   // Return a driver from freelist, or NULL.
   RewriteDriver* PopDriver();
 
-  // Stores the driver on freelist, and Clear()s it for reuse.
+  // Stores the driver on freelist, and Clear()s it for reuse, or deletes it
+  // if the freelist already holds max_idle_drivers().
   void RecycleDriver(RewriteDriver* driver);
 
+  // Notes that a driver controlled by this pool, whether just created or
+  // popped from the freelist, has been handed out.  RecycleDriver undoes
+  // this.
+  void DriverActivated() { ++num_active_drivers_; }
+
+  // The number of drivers controlled by this pool that are in use.  A pool
+  // may only be deleted while this is 0.
+  int num_active_drivers() const { return num_active_drivers_; }
+
+  // Bounds the size of the freelist; negative (the default) means unbounded.
+  void set_max_idle_drivers(int x) { max_idle_drivers_ = x; }
+  int max_idle_drivers() const { return max_idle_drivers_; }
+
  private:
   std::vector<RewriteDriver*> drivers_;
+  int num_active_drivers_;
+  int max_idle_drivers_;
 
   DISALLOW_COPY_AND_ASSIGN(RewriteDriverPool);
 };
 
+// A pool for drivers with one particular set of custom options, which it
+// owns.
+class CustomOptionsRewriteDriverPool : public RewriteDriverPool {
+ public:
+  // Takes ownership of options, which must be frozen.
+  explicit CustomOptionsRewriteDriverPool(RewriteOptions* options);
+  virtual ~CustomOptionsRewriteDriverPool();
+
+  virtual const RewriteOptions* TargetOptions() const;
+
+ private:
+  scoped_ptr<RewriteOptions> options_;
+
+  DISALLOW_COPY_AND_ASSIGN(CustomOptionsRewriteDriverPool);
+};
+
 }  // namespace net_instaweb
 
 #endif  // NET_INSTAWEB_REWRITER_PUBLIC_REWRITE_DRIVER_POOL_H_
@@ -39,7 +39,6 @@
 #include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/md5_hasher.h"
 #include "pagespeed/kernel/base/proto_util.h"
-#include "pagespeed/kernel/base/rde_hash_map.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/sha1_signature.h"
 #include "pagespeed/kernel/base/string.h"
@@ -218,6 +217,8 @@ class RewriteOptions {
   // css_filter.cc.
   static const char kAcceptInvalidSignatures[];
   static const char kAccessControlAllowOrigins[];
+  static const char kAdaptiveRewriteDeadline[];
+  static const char kAdaptiveRewriteDeadlineTargetPercent[];
   static const char kAddOptionsToUrls[];
   static const char kAllowLoggingUrlsInLogRecord[];
   static const char kAllowOptionsToBeSetByCookies[];
@@ -236,10 +237,16 @@ class RewriteOptions {
   static const char kCriticalImagesBeaconEnabled[];
   static const char kCriticalLineConfig[];
   static const char kCssFlattenMaxBytes[];
+  static const char kCssFragmentCacheMaxBytes[];
   static const char kCssImageInlineMaxBytes[];
   static const char kCssInlineMaxBytes[];
   static const char kCssOutlineMinBytes[];
   static const char kCssPreserveURLs[];
+  static const char kCssStreamingRewrite[];
+  static const char kCustomRewriteDriverPoolMaxIdleDrivers[];
+  static const char kCustomRewriteDriverPools[];
+  static const char kDecodedImageCacheMaxBytes[];
+  static const char kDecodedImageCacheTtlMs[];
   static const char kDefaultCacheHtml[];
   static const char kDisableBackgroundFetchesForBots[];
   static const char kDisableRewriteOnNoTransform[];
@@ -276,6 +283,7 @@ class RewriteOptions {
   static const char kForbidAllDisabledFilters[];
   static const char kHideRefererUsingMeta[];
   static const char kIdleFlushTimeMs[];
+  static const char kImageDedupByContentHash[];
   static const char kImageInlineMaxBytes[];
   static const char kImageJpegNumProgressiveScans[];
   static const char kImageJpegNumProgressiveScansForSmallScreens[];
@@ -287,7 +295,9 @@ class RewriteOptions {
   static const char kImageMaxRewritesAtOnce[];
   static const char kImagePreserveURLs[];
   static const char kImageRecompressionQuality[];
+  static const char kImageRecompressionTargetSsim[];
   static const char kImageResolutionLimitBytes[];
+  static const char kImageSpritePacking[];
   static const char kImageWebpRecompressionQuality[];
   static const char kImageWebpRecompressionQualityForSmallScreens[];
   static const char kImageWebpTimeoutMs[];
@@ -306,6 +316,7 @@ class RewriteOptions {
   static const char kJsPreserveURLs[];
   static const char kLazyloadImagesAfterOnload[];
   static const char kLazyloadImagesBlankUrl[];
+  static const char kLexHtmlDuringPcacheLookup[];
   static const char kLoadFromFileCacheTtlMs[];
   static const char kLogBackgroundRewrite[];
   static const char kLogMobilizationSamples[];
@@ -350,6 +361,7 @@ class RewriteOptions {
   static const char kObliviousPagespeedUrls[];
   static const char kOptionCookiesDurationMs[];
   static const char kOverrideCachingTtlMs[];
+  static const char kPcacheLookupDeadlineMs[];
   static const char kPersistBlinkBlacklist[];
   static const char kPreserveUrlRelativity[];
   static const char kPrivateNotVaryForIE[];
@@ -361,6 +373,7 @@ class RewriteOptions {
   static const char kRejectBlacklistedStatusCode[];
   static const char kRemoteConfigurationTimeoutMs[];
   static const char kRemoteConfigurationUrl[];
+  static const char kRenameJavascriptLocals[];
   static const char kReportUnloadTime[];
   static const char kRequestOptionOverride[];
   static const char kRespectVary[];
@@ -429,6 +442,7 @@ class RewriteOptions {
   static const char kLogDir[];
   static const char kLruCacheByteLimit[];
   static const char kLruCacheKbPerProcess[];
+  static const char kLruCacheSnapshotIntervalSec[];
   static const char kMemcachedServers[];
   static const char kMemcachedThreads[];
   static const char kMemcachedTimeoutUs[];
@@ -584,7 +598,7 @@ class RewriteOptions {
   // occurs in each RewriteOptions instance.
   class OptionBase {
    public:
-    OptionBase() {}
+    OptionBase() : signature_term_valid_(false) {}
     virtual ~OptionBase();
 
     // Returns if parsing was successful. error_detail will be appended to
@@ -604,6 +618,26 @@ class RewriteOptions {
       return property()->is_used_for_signature_computation();
     }
     virtual const PropertyBase* property() const = 0;
+
+    // Returns "id:Signature(hasher)_", this option's piece of the options
+    // signature.  It is rendered once and reused until the value changes,
+    // so re-signing a cloned and merged options object only re-renders the
+    // options that the merge changed.
+    const GoogleString& SignatureTerm(const Hasher* hasher) const;
+
+   protected:
+    // Must be called whenever the value may have changed.
+    void ClearSignatureTerm() { signature_term_valid_ = false; }
+
+    // Adopts src's memoized term after copying src's value into this.
+    void CopySignatureTerm(const OptionBase& src) {
+      signature_term_ = src.signature_term_;
+      signature_term_valid_ = src.signature_term_valid_;
+    }
+
+   private:
+    mutable GoogleString signature_term_;
+    mutable bool signature_term_valid_;
   };
 
   // Convenience name for a set of rewrite options.
@@ -683,6 +717,7 @@ class RewriteOptions {
   static const int64 kDefaultImageWebpRecompressQuality;
   static const int64 kDefaultImageWebpRecompressQualityForSmallScreens;
   static const int64 kDefaultImageWebpTimeoutMs;
+  static const int64 kDefaultImageRecompressTargetSsim;
   static const int kDefaultDomainShardCount;
   static const int64 kDefaultBlinkHtmlChangeDetectionTimeMs;
   static const int kDefaultMaxPrefetchJsElements;
@@ -695,6 +730,14 @@ class RewriteOptions {
 
   static const int kDefaultImageMaxRewritesAtOnce;
 
+  static const int kDefaultCustomRewriteDriverPools;
+  static const int kDefaultCustomRewriteDriverPoolMaxIdleDrivers;
+
+  static const int64 kDefaultDecodedImageCacheMaxBytes;
+  static const int64 kDefaultDecodedImageCacheTtlMs;
+
+  static const int64 kDefaultCssFragmentCacheMaxBytes;
+
   // See http://code.google.com/p/modpagespeed/issues/detail?id=9
   // Apache evidently limits each URL path segment (between /) to
   // about 256 characters.  This is not fundamental URL limitation
@@ -1233,8 +1276,8 @@ class RewriteOptions {
   // Disables all filters that depend on executing custom javascript.
   void DisableFiltersRequiringScriptExecution();
 
-  // Returns true if any filter benefits from per-origin property cache
-  // information.
+  // Returns true if any filter or option benefits from per-origin property
+  // cache information.
   bool UsePerOriginPropertyCachePage() const;
 
   // Adds pairs of (option, value) to the option set. The option names and
@@ -1597,6 +1640,44 @@ class RewriteOptions {
     set_option(x, &image_max_rewrites_at_once_);
   }
 
+  int custom_rewrite_driver_pools() const {
+    return custom_rewrite_driver_pools_.value();
+  }
+  void set_custom_rewrite_driver_pools(int x) {
+    set_option(x, &custom_rewrite_driver_pools_);
+  }
+
+  int custom_rewrite_driver_pool_max_idle_drivers() const {
+    return custom_rewrite_driver_pool_max_idle_drivers_.value();
+  }
+  void set_custom_rewrite_driver_pool_max_idle_drivers(int x) {
+    set_option(x, &custom_rewrite_driver_pool_max_idle_drivers_);
+  }
+
+  // Bounds on the per-process cache of decoded images shared by variant
+  // rewrites of one input.  Either being 0 disables the cache.
+  int64 decoded_image_cache_max_bytes() const {
+    return decoded_image_cache_max_bytes_.value();
+  }
+  void set_decoded_image_cache_max_bytes(int64 x) {
+    set_option(x, &decoded_image_cache_max_bytes_);
+  }
+  int64 decoded_image_cache_ttl_ms() const {
+    return decoded_image_cache_ttl_ms_.value();
+  }
+  void set_decoded_image_cache_ttl_ms(int64 x) {
+    set_option(x, &decoded_image_cache_ttl_ms_);
+  }
+
+  // Size of the per-process cache of per-input pieces of combined CSS.  0
+  // disables the cache.
+  int64 css_fragment_cache_max_bytes() const {
+    return css_fragment_cache_max_bytes_.value();
+  }
+  void set_css_fragment_cache_max_bytes(int64 x) {
+    set_option(x, &css_fragment_cache_max_bytes_);
+  }
+
   // The maximum size of the entire URL.  If '0', this is left unlimited.
   int max_url_size() const { return max_url_size_.value(); }
   void set_max_url_size(int x) {
@@ -1608,6 +1689,20 @@ class RewriteOptions {
     set_option(x, &rewrite_deadline_ms_);
   }
 
+  bool adaptive_rewrite_deadline() const {
+    return adaptive_rewrite_deadline_.value();
+  }
+  void set_adaptive_rewrite_deadline(bool x) {
+    set_option(x, &adaptive_rewrite_deadline_);
+  }
+
+  int adaptive_rewrite_deadline_target_percent() const {
+    return adaptive_rewrite_deadline_target_percent_.value();
+  }
+  void set_adaptive_rewrite_deadline_target_percent(int x) {
+    set_option(x, &adaptive_rewrite_deadline_target_percent_);
+  }
+
   bool test_instant_fetch_rewrite_deadline() const {
     return test_instant_fetch_rewrite_deadline_.value();
   }
@@ -1763,6 +1858,11 @@ class RewriteOptions {
   }
   bool always_rewrite_css() const { return always_rewrite_css_.value(); }
 
+  void set_css_streaming_rewrite(bool x) {
+    set_option(x, &css_streaming_rewrite_);
+  }
+  bool css_streaming_rewrite() const { return css_streaming_rewrite_.value(); }
+
   void set_respect_vary(bool x) {
     set_option(x, &respect_vary_);
   }
@@ -1977,6 +2077,20 @@ class RewriteOptions {
     set_option(x, &css_preserve_urls_);
   }
 
+  bool image_dedup_by_content_hash() const {
+    return image_dedup_by_content_hash_.value();
+  }
+  void set_image_dedup_by_content_hash(bool x) {
+    set_option(x, &image_dedup_by_content_hash_);
+  }
+
+  bool image_sprite_packing() const {
+    return image_sprite_packing_.value();
+  }
+  void set_image_sprite_packing(bool x) {
+    set_option(x, &image_sprite_packing_);
+  }
+
   bool image_preserve_urls() const {
     return CheckBandwidthOption(image_preserve_urls_);
   }
@@ -2082,6 +2196,15 @@ class RewriteOptions {
     set_option(x, &image_recompress_quality_);
   }
 
+  // Target structural similarity for lossy recompression, in thousandths
+  // (e.g. 985 means 0.985). Non-positive values disable the quality search.
+  int64 image_recompress_target_ssim() const {
+    return image_recompress_target_ssim_.value();
+  }
+  void set_image_recompress_target_ssim(int64 x) {
+    set_option(x, &image_recompress_target_ssim_);
+  }
+
   int image_limit_optimized_percent() const {
     return image_limit_optimized_percent_.value();
   }
@@ -2262,6 +2385,20 @@ class RewriteOptions {
     return await_pcache_lookup_.value();
   }
 
+  void set_lex_html_during_pcache_lookup(bool x) {
+    set_option(x, &lex_html_during_pcache_lookup_);
+  }
+  bool lex_html_during_pcache_lookup() const {
+    return lex_html_during_pcache_lookup_.value();
+  }
+
+  void set_pcache_lookup_deadline_ms(int64 x) {
+    set_option(x, &pcache_lookup_deadline_ms_);
+  }
+  int64 pcache_lookup_deadline_ms() const {
+    return pcache_lookup_deadline_ms_.value();
+  }
+
   void set_enable_prioritizing_scripts(bool x) {
     set_option(x, &enable_prioritizing_scripts_);
   }
@@ -2444,6 +2581,13 @@ class RewriteOptions {
     set_option(x, &use_experimental_js_minifier_);
   }
 
+  bool rename_javascript_locals() const {
+    return rename_javascript_locals_.value();
+  }
+  void set_rename_javascript_locals(bool x) {
+    set_option(x, &rename_javascript_locals_);
+  }
+
   void set_max_combined_css_bytes(int64 x) {
     set_option(x, &max_combined_css_bytes_);
   }
@@ -2952,16 +3096,22 @@ class RewriteOptions {
     void set(const T& val) {
       was_set_ = true;
       value_ = val;
+      ClearSignatureTerm();
     }
 
     void set_default(const T& val) {
       if (!was_set_) {
         value_ = val;
+        ClearSignatureTerm();
       }
     }
 
     const T& value() const { return value_; }
-    T& mutable_value() { was_set_ = true; return value_; }
+    T& mutable_value() {
+      was_set_ = true;
+      ClearSignatureTerm();
+      return value_;
+    }
 
     // The signature of the Merge implementation must match the base-class.  The
     // caller is responsible for ensuring that only the same typed Options are
@@ -2979,6 +3129,7 @@ class RewriteOptions {
       if (src->was_set_ || !was_set_) {
         value_ = src->value_;
         was_set_ = src->was_set_;
+        CopySignatureTerm(*src);
       }
     }
 
@@ -3390,12 +3541,8 @@ class RewriteOptions {
       UrlCacheInvalidationEntryVector;
   typedef dense_hash_map<GoogleString, int64> UrlCacheInvalidationMap;
 
-  // Sigh. The folding Hash struct is required so that we ignore case when
-  // inserting. The folding Equal struct is required for looking up. Damned
-  // if I know why one needs to specify both.
-  typedef rde::hash_map<StringPiece, const PropertyBase*,
-                        CaseFoldStringPieceHash, /* TLoadFactor4 = */ 6,
-                        CaseFoldStringPieceEqual> PropertyNameMap;
+  // Case-insensitive perfect hash table from option name to property.
+  class OptionNameTable;
 
   // Private methods to help add properties to
   // RewriteOptions::properties_.  Subclasses define their own
@@ -3506,11 +3653,6 @@ class RewriteOptions {
     return StringCaseCompare(p1->option_name(), p2->option_name()) < 0;
   }
 
-  // Returns true if option's name is less than arg.
-  static bool OptionNameLessThanArg(OptionBase* option, StringPiece arg) {
-    return StringCaseCompare(option->option_name(), arg) < 0;
-  }
-
   // Returns true if e1's timestamp is less than e2's.
   static bool CompareUrlCacheInvalidationEntry(UrlCacheInvalidationEntry* e1,
                                                UrlCacheInvalidationEntry* e2) {
@@ -3524,9 +3666,9 @@ class RewriteOptions {
     return strcmp(e1->filter_id, e2->filter_id) < 0;
   }
 
-  // Return the effective option name. If the name is deprecated, the new name
-  // will be returned; otherwise the name will be returned as is.
-  static StringPiece GetEffectiveOptionName(StringPiece name);
+  // Returns this object's option named name, which may be a deprecated name,
+  // or NULL if there is none.  Looked up in option_name_table_.
+  OptionBase* OptionForName(StringPiece name) const;
 
   // In OptimizeForBandwidth mode, this sets up certain default filters
   // and options, which take effect only if not explicitly overridden.
@@ -3600,6 +3742,10 @@ class RewriteOptions {
   Option<bool> css_preserve_urls_;
   Option<bool> js_preserve_urls_;
   Option<bool> image_preserve_urls_;
+  // Share optimized images between URLs whose contents are identical.
+  Option<bool> image_dedup_by_content_hash_;
+  // Pack sprited images in two dimensions rather than in a vertical strip.
+  Option<bool> image_sprite_packing_;
 
   Option<int64> image_inline_max_bytes_;
   Option<int64> js_inline_max_bytes_;
@@ -3625,6 +3771,9 @@ class RewriteOptions {
   // Option related to generic image quality. This is overridden by
   // image(jpeg/webp) specific options.
   Option<int64> image_recompress_quality_;
+  // When positive, per-image quality search against this SSIM target, in
+  // thousandths, bounded above by the configured recompression qualities.
+  Option<int64> image_recompress_target_ssim_;
 
   // Options related to jpeg compression.
   Option<int64> image_jpeg_recompress_quality_;
@@ -3643,11 +3792,22 @@ class RewriteOptions {
   Option<int64> image_webp_timeout_ms_;
 
   Option<int> image_max_rewrites_at_once_;
+  // How many distinct sets of custom options to keep recycled drivers for,
+  // and how many idle drivers to keep for each.
+  Option<int> custom_rewrite_driver_pools_;
+  Option<int> custom_rewrite_driver_pool_max_idle_drivers_;
+  Option<int64> decoded_image_cache_max_bytes_;
+  Option<int64> decoded_image_cache_ttl_ms_;
+  Option<int64> css_fragment_cache_max_bytes_;
   Option<int> max_url_segment_size_;  // For http://a/b/c.d, use strlen("c.d").
   Option<int> max_url_size_;          // This is strlen("http://a/b/c.d").
   // The interval to wait for async rewrites to complete before flushing
   // content.  This deadline is per flush.
   Option<int> rewrite_deadline_ms_;
+  // Learn, per site, a shorter per-flush deadline that about
+  // adaptive_rewrite_deadline_target_percent_ of flush windows meet.
+  Option<bool> adaptive_rewrite_deadline_;
+  Option<int> adaptive_rewrite_deadline_target_percent_;
   // Maximum number of shards for rewritten resources in a directory.
   Option<int> domain_shard_count_;
 
@@ -3697,6 +3857,7 @@ class RewriteOptions {
   Option<bool> log_url_indices_;
   Option<bool> lowercase_html_names_;
   Option<bool> always_rewrite_css_;  // For tests/debugging.
+  Option<bool> css_streaming_rewrite_;
   Option<bool> respect_vary_;
   Option<bool> respect_x_forwarded_proto_;
   Option<bool> flush_html_;
@@ -3935,6 +4096,12 @@ class RewriteOptions {
   Option<bool> use_fallback_property_cache_values_;
   // Always wait for property cache lookup to finish.
   Option<bool> await_pcache_lookup_;
+  // Lex HTML from the origin while the property cache lookup is outstanding,
+  // rather than leaving it queued as text until the lookup completes.
+  Option<bool> lex_html_during_pcache_lookup_;
+  // How long after the first HTML bytes arrive to wait for the property
+  // cache lookup before finishing it early; negative means no deadline.
+  Option<int64> pcache_lookup_deadline_ms_;
   // Enable Prioritizing of scripts in defer javascript.
   Option<bool> enable_prioritizing_scripts_;
   // Enables rewriting of uncacheable resources.
@@ -3981,6 +4148,8 @@ class RewriteOptions {
   Option<bool> enable_extended_instrumentation_;
 
   Option<bool> use_experimental_js_minifier_;
+  // Whether the (experimental) JS minifier renames function locals.
+  Option<bool> rename_javascript_locals_;
 
   // Maximum size allowed for the combined CSS resource.
   // Negative value will bypass the size check.
@@ -4069,8 +4238,9 @@ class RewriteOptions {
   static const FilterEnumToIdAndNameEntry* filter_id_to_enum_array_[
       kEndOfFilters];
 
-  // Reverse map from option name string to corresponding PropertyBase.
-  static PropertyNameMap* option_name_to_property_map_;
+  // Reverse map from option name string, including deprecated names, to
+  // corresponding PropertyBase.
+  static OptionNameTable* option_name_table_;
 
   // Reverse map from option id string to corresponding PropertyBase.
   static const PropertyBase** option_id_to_property_array_;
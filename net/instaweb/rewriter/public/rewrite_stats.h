@@ -71,6 +71,15 @@ class RewriteStats {
     return num_cache_control_not_rewritable_resources_;
   }
   Variable* num_flushes() { return num_flushes_; }
+  Variable* custom_rewrite_drivers_constructed() {
+    return custom_rewrite_drivers_constructed_;
+  }
+  Variable* custom_rewrite_drivers_recycled() {
+    return custom_rewrite_drivers_recycled_;
+  }
+  Variable* custom_rewrite_driver_pools_evicted() {
+    return custom_rewrite_driver_pools_evicted_;
+  }
   Variable* resource_404_count() { return resource_404_count_; }
   Variable* resource_url_domain_acceptances() {
     return resource_url_domain_acceptances_;
@@ -119,6 +128,14 @@ class RewriteStats {
   // HTML rewrite latency in ms.
   Histogram* rewrite_latency_histogram() { return rewrite_latency_histogram_; }
   Histogram* backend_latency_histogram() { return backend_latency_histogram_; }
+  // Rewrite deadline given to each flush window with rewrites, in ms.
+  Histogram* flush_window_deadline_histogram() {
+    return flush_window_deadline_histogram_;
+  }
+  // Percentage of each such window's rewrites completed by its deadline.
+  Histogram* flush_window_completion_histogram() {
+    return flush_window_completion_histogram_;
+  }
 
   // Number of .pagespeed. resources fetched.
   TimedVariable* total_fetch_count() { return total_fetch_count_; }
@@ -141,6 +158,9 @@ class RewriteStats {
   Variable* num_cache_control_rewritable_resources_;
   Variable* num_cache_control_not_rewritable_resources_;
   Variable* num_flushes_;
+  Variable* custom_rewrite_drivers_constructed_;
+  Variable* custom_rewrite_drivers_recycled_;
+  Variable* custom_rewrite_driver_pools_evicted_;
   Variable* page_load_count_;
   Variable* resource_404_count_;
   Variable* resource_url_domain_acceptances_;
@@ -162,6 +182,8 @@ class RewriteStats {
   Histogram* fetch_latency_histogram_;
   Histogram* rewrite_latency_histogram_;
   Histogram* backend_latency_histogram_;
+  Histogram* flush_window_deadline_histogram_;
+  Histogram* flush_window_completion_histogram_;
 
   TimedVariable* total_fetch_count_;
   TimedVariable* total_rewrite_count_;
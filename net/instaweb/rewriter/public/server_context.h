@@ -21,6 +21,8 @@
 #define NET_INSTAWEB_REWRITER_PUBLIC_SERVER_CONTEXT_H_
 
 #include <cstddef>                     // for size_t
+#include <list>
+#include <map>
 #include <set>
 #include <utility>
 #include <vector>
@@ -34,6 +36,7 @@
 #include "net/instaweb/util/public/property_cache.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/atomic_bool.h"
+#include "pagespeed/kernel/base/atomic_int32.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/function.h"
@@ -57,10 +60,14 @@ namespace net_instaweb {
 class AsyncFetch;
 class CacheHtmlInfoFinder;
 class CachePropertyStore;
+class CostTracker;
 class CriticalCssFinder;
 class CriticalImagesFinder;
 class CriticalLineInfoFinder;
 class CriticalSelectorFinder;
+class CssFragmentCache;
+class CustomOptionsRewriteDriverPool;
+class DecodedImageCache;
 class RequestProperties;
 class ExperimentMatcher;
 class FileSystem;
@@ -81,6 +88,7 @@ class RewriteQuery;
 class RewriteStats;
 class SHA1Signature;
 class Scheduler;
+class SpanTraceSink;
 class StaticAssetManager;
 class Statistics;
 class ThreadSynchronizer;
@@ -249,6 +257,16 @@ class ServerContext {
     fix_reflow_cohort_ = c;
   }
 
+  // Set up only if adaptive_rewrite_deadline is on in the global options.
+  // While it is NULL, learned deadlines are not kept from one request to
+  // the next.
+  const PropertyCache::Cohort* adaptive_rewrite_deadline_cohort() const {
+    return adaptive_rewrite_deadline_cohort_;
+  }
+  void set_adaptive_rewrite_deadline_cohort(const PropertyCache::Cohort* c) {
+    adaptive_rewrite_deadline_cohort_ = c;
+  }
+
   // Cache for storing file system metadata. It must be private to a server,
   // preferably but not necessarily shared between its processes, and is
   // required if using load-from-file and memcached (or any cache shared
@@ -306,6 +324,20 @@ class ServerContext {
     return &simple_random_;
   }
 
+  // Decoded images shared between variant rewrites of the same input.
+  // Owned by RewriteDriverFactory.  May be NULL.
+  DecodedImageCache* decoded_image_cache() const {
+    return decoded_image_cache_;
+  }
+  void set_decoded_image_cache(DecodedImageCache* x) {
+    decoded_image_cache_ = x;
+  }
+
+  // Per-input pieces of combined CSS, reused when a combination changes.
+  // Owned by RewriteDriverFactory.  May be NULL.
+  CssFragmentCache* css_fragment_cache() const { return css_fragment_cache_; }
+  void set_css_fragment_cache(CssFragmentCache* x) { css_fragment_cache_ = x; }
+
   void set_cache_html_info_finder(CacheHtmlInfoFinder* finder);
 
   CriticalLineInfoFinder* critical_line_info_finder() const {
@@ -481,6 +513,11 @@ class ServerContext {
   // Filters allocated using this mechanism have their filter-chain
   // already frozen (see AddFilters()).
   //
+  // Drivers are recycled through a pool per distinct set of custom options,
+  // keeping pools for the global_options()->custom_rewrite_driver_pools()
+  // most recently used sets, so a request whose options match an earlier
+  // one's usually gets a driver with its filter chain already built.
+  //
   // Takes ownership of 'custom_options'.
   RewriteDriver* NewCustomRewriteDriver(
       RewriteOptions* custom_options, const RequestContextPtr& request_ctx);
@@ -489,14 +526,6 @@ class ServerContext {
   // be called by a RewriteDriver on itself, once all pending
   // activites on it have completed, including HTML Parsing
   // (FinishParse) and all pending Rewrites.
-  //
-  // TODO(jmarantz): this cannot recycle RewriteDrivers with custom
-  // rewrite options, which is a potential performance issue for Apache
-  // installations that set custom options in .htaccess files, where
-  // essentially every RewriteDriver will be a custom driver.  To
-  // resolve this we need to make a comparator for RewriteOptions
-  // so that we can determine option-equivalence and, potentially,
-  // keep free-lists for each unique option-set.
   void ReleaseRewriteDriver(RewriteDriver* rewrite_driver);
 
   ThreadSystem* thread_system() { return thread_system_; }
@@ -610,6 +639,29 @@ class ServerContext {
     hostname_ = x;
   }
 
+  // Traces sample_percent (0 to 100) of the HTML requests handled by this
+  // server, recording each trace to sink.  Does not take ownership of sink,
+  // which may be NULL to disable tracing.
+  void set_span_trace_sink(SpanTraceSink* sink, int sample_percent) {
+    span_trace_sink_ = sink;
+    span_trace_sample_percent_ = sample_percent;
+  }
+
+  // If the request for url is one of those sampled for tracing, gives
+  // request_context a SpanTrace, named after the url.  This must be called
+  // before request_context is shared with other threads.
+  void MaybeStartSpanTrace(const RequestContextPtr& request_context,
+                           StringPiece url);
+
+  // Starts accumulating the CPU and wall time spent in each HTML filter, and
+  // in each kind of resource rewrite (keyed by RewriteContext::id()), for the
+  // admin pages.  Must be called before any requests are handled.
+  void EnableCostTracking();
+
+  // These are NULL unless EnableCostTracking has been called.
+  CostTracker* html_filter_costs() { return html_filter_costs_.get(); }
+  CostTracker* rewrite_costs() { return rewrite_costs_.get(); }
+
   // Adds an X-Original-Content-Length header to the response headers
   // based on the size of the input resources.
   void AddOriginalContentLengthHeader(const ResourceVector& inputs,
@@ -712,6 +764,27 @@ class ServerContext {
   // Must be called with rewrite_drivers_mutex_ held.
   void ReleaseRewriteDriverImpl(RewriteDriver* rewrite_driver);
 
+  // As NewRewriteDriverFromPool, setting *recycled to whether the driver
+  // came from the pool's freelist.  A driver built afresh takes ownership
+  // of options_for_new_driver if non-NULL, rather than a clone of
+  // pool->TargetOptions(); a recycled one deletes it.  If pool_pinned, the
+  // caller has already called pool->DriverActivated() for this driver.
+  RewriteDriver* NewRewriteDriverFromPoolImpl(
+      RewriteDriverPool* pool, RewriteOptions* options_for_new_driver,
+      bool pool_pinned, const RequestContextPtr& request_ctx, bool* recycled);
+
+  // Returns the pool for drivers with the given (frozen) options, making
+  // one, and evicting the least recently used one, if need be.  Returns NULL
+  // if pooling of custom drivers is off.  Must be called with
+  // rewrite_drivers_mutex_ held.
+  RewriteDriverPool* CustomRewriteDriverPool(const RewriteOptions& options);
+
+  // Deletes a custom pool that has been taken out of custom_driver_pools_,
+  // or, if some of its drivers are still in use, stops it keeping idle
+  // drivers and defers the deletion until they are all released.  Must be
+  // called with rewrite_drivers_mutex_ held.
+  void RetireCustomDriverPool(CustomOptionsRewriteDriverPool* pool);
+
   // Applies the remote configuration options, by feeding each line in the
   // config to ApplyConfigLine.
   void ApplyRemoteConfig(const GoogleString& config, RewriteOptions* options);
@@ -774,6 +847,7 @@ class ServerContext {
   const PropertyCache::Cohort* blink_cohort_;
   const PropertyCache::Cohort* beacon_cohort_;
   const PropertyCache::Cohort* fix_reflow_cohort_;
+  const PropertyCache::Cohort* adaptive_rewrite_deadline_cohort_;
 
   // RewriteDrivers that were previously allocated, but have
   // been released with ReleaseRewriteDriver, and are ready
@@ -785,6 +859,20 @@ class ServerContext {
   // Other RewriteDriverPool's whose lifetime we help manage for our subclasses.
   std::vector<RewriteDriverPool*> additional_driver_pools_;
 
+  // Pools for drivers with custom options, most recently used first, and
+  // an index of them by options signature.
+  // Protected by rewrite_drivers_mutex_.
+  typedef std::list<CustomOptionsRewriteDriverPool*> CustomDriverPoolList;
+  typedef std::map<GoogleString, CustomDriverPoolList::iterator>
+      CustomDriverPoolMap;
+  CustomDriverPoolList custom_driver_pools_;
+  CustomDriverPoolMap custom_driver_pool_map_;
+
+  // Custom pools that were replaced or evicted while some of their drivers
+  // were still in use.  Each is deleted once its last driver is released.
+  // Protected by rewrite_drivers_mutex_.
+  std::set<RewriteDriverPool*> retired_custom_driver_pools_;
+
   // RewriteDrivers that are currently in use.  This is retained
   // as a sanity check to make sure our system is coherent,
   // and to facilitate complete cleanup if a Shutdown occurs
@@ -839,6 +927,15 @@ class ServerContext {
   // A convenient central place to store the hostname we're running on.
   GoogleString hostname_;
 
+  // Where sampled request traces are recorded; owned by the factory.
+  SpanTraceSink* span_trace_sink_;
+  int span_trace_sample_percent_;
+  // Counts the requests considered for tracing, to spread samples evenly.
+  AtomicInt32 span_trace_request_count_;
+
+  scoped_ptr<CostTracker> html_filter_costs_;
+  scoped_ptr<CostTracker> rewrite_costs_;
+
   // A simple (and always seeded with the same default!) random number
   // generator.  Do not use for security purposes.
   SimpleRandom simple_random_;
@@ -847,6 +944,12 @@ class ServerContext {
 
   scoped_ptr<CachePropertyStore> cache_property_store_;
 
+  // Owned by RewriteDriverFactory.
+  DecodedImageCache* decoded_image_cache_;
+
+  // Owned by RewriteDriverFactory.
+  CssFragmentCache* css_fragment_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(ServerContext);
 };
 
@@ -19,14 +19,18 @@
 #ifndef NET_INSTAWEB_REWRITER_PUBLIC_SINGLE_REWRITE_CONTEXT_H_
 #define NET_INSTAWEB_REWRITER_PUBLIC_SINGLE_REWRITE_CONTEXT_H_
 
+#include "net/instaweb/http/public/http_cache.h"
 #include "net/instaweb/rewriter/public/resource.h"
 #include "net/instaweb/rewriter/public/rewrite_context.h"
 #include "net/instaweb/rewriter/public/server_context.h"
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
 
 namespace net_instaweb {
 
 class CachedResult;
+class DedupedRewrite;
 class OutputPartitions;
 class ResourceContext;
 class RewriteDriver;
@@ -52,8 +56,47 @@ class SingleRewriteContext : public RewriteContext {
   virtual void Rewrite(int partition_index,
                        CachedResult* partition,
                        const OutputResourcePtr& output);
+  virtual void PartitionRewriteDone(RewriteResult result, int partition_index);
+
+  // Subclasses whose output depends only on the input contents, the options
+  // and the resource context -- not on the input URL -- may return true here.
+  // Successful rewrites are then also cached under the hash of the input
+  // contents, and any other URL with identical contents reuses that output
+  // instead of calling RewriteSingle.  The default is false.
+  virtual bool DedupByInputContents() const { return false; }
 
  private:
+  class DedupLookupCallback;
+  class DedupContentsCallback;
+
+  // Returns the metadata cache key under which rewrites of inputs with the
+  // same contents as 'input' are shared.
+  GoogleString DedupKey(const ResourcePtr& input) const;
+
+  // Called in the low-priority rewrite thread once the content-hash lookup
+  // completes; 'deduped' is NULL on a miss, and is owned by this method.
+  void DedupLookupDone(DedupedRewrite* deduped);
+  void DedupLookupCancelled(DedupedRewrite* deduped);
+
+  // Called in the low-priority rewrite thread once the HTTP cache lookup of
+  // the shared output's bytes completes.  Owns 'data'.
+  void DedupContentsDone(HTTPCache::FindResult find_result,
+                         HTTPCache::Callback* data);
+  void DedupContentsCancelled(HTTPCache::FindResult find_result,
+                              HTTPCache::Callback* data);
+
+  // Reuses a previously stored output, whose bytes are 'contents', for this
+  // input.  Returns false if it could not be written, in which case we
+  // rewrite normally.
+  bool ApplyDedupedRewrite(const DedupedRewrite& deduped,
+                           StringPiece contents);
+
+  // Non-empty once a content-hash lookup was issued for this rewrite.
+  GoogleString dedup_key_;
+  OutputResourcePtr dedup_output_;
+  // The hit, held while its output is read from the HTTP cache.
+  scoped_ptr<DedupedRewrite> dedup_hit_;
+
   DISALLOW_COPY_AND_ASSIGN(SingleRewriteContext);
 };
 
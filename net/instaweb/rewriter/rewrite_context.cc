@@ -54,6 +54,7 @@
 #include "pagespeed/kernel/base/base64_util.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/callback.h"
+#include "pagespeed/kernel/base/cost_tracker.h"
 #include "pagespeed/kernel/base/dynamic_annotations.h"  // RunningOnValgrind
 #include "pagespeed/kernel/base/file_system.h"
 #include "pagespeed/kernel/base/function.h"
@@ -1190,11 +1191,23 @@ class RewriteContext::InvokeRewriteFunction : public Function {
   virtual ~InvokeRewriteFunction() {}
 
   virtual void Run() {
-    context_->FindServerContext()->rewrite_stats()->num_rewrites_executed()
-        ->IncBy(1);
+    ServerContext* server_context = context_->FindServerContext();
+    server_context->rewrite_stats()->num_rewrites_executed()->IncBy(1);
+    CostTracker* rewrite_costs = server_context->rewrite_costs();
+    if (rewrite_costs == NULL) {
+      context_->Rewrite(partition_,
+                        context_->partitions_->mutable_partition(partition_),
+                        output_);
+      return;
+    }
+    // Only the synchronous part of the rewrite is measured, and the id is
+    // copied first, as the context may be deleted before Rewrite returns.
+    GoogleString id(context_->id());
+    CostTracker::Measurement cost(rewrite_costs);
     context_->Rewrite(partition_,
                       context_->partitions_->mutable_partition(partition_),
                       output_);
+    cost.Record(id, 1);
   }
 
   virtual void Cancel() {
@@ -1217,6 +1230,8 @@ void RewriteContext::InitStats(Statistics* stats) {
   stats->AddVariable(kNumDistributedRewriteSuccesses);
   stats->AddVariable(kNumDistributedRewriteFailures);
   stats->AddVariable(kNumDistributedMetadataFailures);
+  stats->AddVariable(kNumDedupedRewriteHits);
+  stats->AddVariable(kNumDedupedRewriteMisses);
   RewriteContext::FetchContext::InitStats(stats);
 }
 
@@ -1230,6 +1245,10 @@ const char RewriteContext::kNumDistributedRewriteSuccesses[] =
     "num_distributed_rewrite_successes";
 const char RewriteContext::kNumDistributedMetadataFailures[] =
     "num_distributed_metadata_failures";
+const char RewriteContext::kNumDedupedRewriteHits[] =
+    "num_deduped_rewrite_hits";
+const char RewriteContext::kNumDedupedRewriteMisses[] =
+    "num_deduped_rewrite_misses";
 // kDistributedExt shouldn't be longer than
 // ContentType::MaxProducedExtensionLength otherwise URL length estimation will
 // break.
@@ -1259,6 +1278,8 @@ RewriteContext::RewriteContext(RewriteDriver* driver,
     is_metadata_cache_miss_(false),
     rewrite_uncacheable_(false),
     dependent_request_trace_(NULL),
+    span_(SpanTrace::kNoSpan),
+    span_parent_(SpanTrace::kRootSpan),
     block_distribute_rewrite_(false),
     num_rewrites_abandoned_for_lock_contention_(
         Driver()->statistics()->GetVariable(
@@ -1342,6 +1363,15 @@ void RewriteContext::Start() {
   DCHECK_EQ(0, num_predecessors_);
   started_ = true;
 
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    span_ = trace->BeginSpan(StrCat("RewriteContext:", id()),
+                             has_parent() ? parent_->span_ : span_parent_);
+    if (num_slots() > 0 && slot(0)->resource().get() != NULL) {
+      trace->AddTag(span_, "url", slot(0)->resource()->url());
+    }
+  }
+
   // See if any of the input slots are marked as unsafe for use,
   // and if so bail out quickly.
   // TODO(morlovich): Add API for filters to do something more refined.
@@ -1621,6 +1651,10 @@ void RewriteContext::OutputCacheDone(CacheLookupResult* cache_result) {
 }
 
 void RewriteContext::OutputCacheHit(bool write_partitions) {
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    trace->AddTag(span_, "metadata_cache", "hit");
+  }
   Freshen();
   for (int i = 0, n = partitions_->partition_size(); i < n; ++i) {
     if (outputs_[i].get() != NULL) {
@@ -1632,6 +1666,10 @@ void RewriteContext::OutputCacheHit(bool write_partitions) {
 }
 
 void RewriteContext::OutputCacheMiss() {
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    trace->AddTag(span_, "metadata_cache", "miss");
+  }
   is_metadata_cache_miss_ = true;
   outputs_.clear();
   partitions_->Clear();
@@ -2318,6 +2356,7 @@ void RewriteContext::RewriteDoneImpl(RewriteResult result,
     }
 
     partition->set_optimizable(optimizable);
+    PartitionRewriteDone(result, partition_index);
     if (optimizable && (!IsFetchRewrite())) {
       // TODO(morlovich): currently in async mode, we tie rendering of slot
       // to the optimizable bit, making it impossible to do per-slot mutation
@@ -2334,6 +2373,10 @@ void RewriteContext::RewriteDoneImpl(RewriteResult result,
   }
 }
 
+void RewriteContext::PartitionRewriteDone(RewriteResult result,
+                                          int partition_index) {
+}
+
 void RewriteContext::Harvest() {
 }
 
@@ -2421,6 +2464,7 @@ void RewriteContext::Propagate(bool render_slots) {
 void RewriteContext::Finalize() {
   rewrite_done_ = true;
   DCHECK_EQ(0, num_pending_nested_);
+  EndSpan();
   if (IsFetchRewrite()) {
     fetch_->FetchDone();
   } else {
@@ -2470,8 +2514,21 @@ void RewriteContext::TracePrintf(const char* fmt, ...) {
   }
 }
 
+SpanTrace* RewriteContext::span_trace() {
+  RequestContextPtr request_context(Driver()->request_context());
+  return (request_context.get() == NULL) ? NULL : request_context->span_trace();
+}
+
+void RewriteContext::EndSpan() {
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    trace->EndSpan(span_);
+  }
+}
+
 void RewriteContext::RunSuccessors() {
   DetachSlots();
+  EndSpan();
 
   for (int i = 0, n = successors_.size(); i < n; ++i) {
     RewriteContext* successor = successors_[i];
@@ -44,6 +44,7 @@
 #include "net/instaweb/rewriter/critical_keys.pb.h"
 #include "net/instaweb/rewriter/critical_line_info.pb.h"
 #include "net/instaweb/rewriter/flush_early.pb.h"
+#include "net/instaweb/rewriter/public/adaptive_rewrite_deadline.h"
 #include "net/instaweb/rewriter/public/add_head_filter.h"
 #include "net/instaweb/rewriter/public/add_ids_filter.h"
 #include "net/instaweb/rewriter/public/add_instrumentation_filter.h"
@@ -143,6 +144,7 @@
 #include "pagespeed/kernel/base/request_trace.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/sha1_signature.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
@@ -177,6 +179,10 @@ namespace {
 const int kTestTimeoutMs = 10000;
 const char kDeadlineExceeded[] = "deadline_exceeded";
 
+// Of the requests whose learned rewrite deadline moved too little to be worth
+// saving, one in this many saves it anyway.
+const int kAdaptiveRewriteDeadlineSampleRequests = 10;
+
 // Implementation of RemoveCommentsFilter::OptionsInterface that wraps
 // a RewriteOptions instance.
 class RemoveCommentsFilterOptions
@@ -232,6 +238,8 @@ class RewriteDriverCacheUrlAsyncFetcherAsyncOpHooks
 
 const char RewriteDriver::kDomCohort[] = "dom";
 const char RewriteDriver::kBeaconCohort[] = "beacon_cohort";
+const char RewriteDriver::kAdaptiveRewriteDeadlineCohort[] =
+    "adaptive_rewrite_deadline";
 const char RewriteDriver::kSubresourcesPropertyName[] = "subresources";
 const char RewriteDriver::kStatusCodePropertyName[] = "status_code";
 
@@ -257,6 +265,7 @@ RewriteDriver::RewriteDriver(MessageHandler* message_handler,
       fast_blocking_rewrite_(true),
       flush_requested_(false),
       flush_occurred_(false),
+      flush_span_(SpanTrace::kNoSpan),
       flushed_cached_html_(false),
       flushing_cached_html_(false),
       flushed_early_(false),
@@ -267,6 +276,7 @@ RewriteDriver::RewriteDriver(MessageHandler* message_handler,
       response_headers_(NULL),
       status_code_(HttpStatus::kUnknownStatusCode),
       max_page_processing_delay_ms_(-1),
+      flush_window_deadline_ms_(-1),
       num_initiated_rewrites_(0),
       num_detached_rewrites_(0),
       possibly_quick_rewrites_(0),
@@ -427,11 +437,15 @@ void RewriteDriver::Clear() NO_THREAD_SAFETY_ANALYSIS {
 
   should_skip_parsing_ = kNotSet;
   max_page_processing_delay_ms_ = -1;
+  flush_window_deadline_ms_ = -1;
+  adaptive_rewrite_deadline_.reset();
   request_headers_.reset(NULL);
   response_headers_ = NULL;
   status_code_ = 0;
   flush_requested_ = false;
   flush_occurred_ = false;
+  flush_span_ = SpanTrace::kNoSpan;
+  set_span_trace(NULL, SpanTrace::kNoSpan);
   flushed_cached_html_ = false;
   flushing_cached_html_ = false;
   flushed_early_ = false;
@@ -648,6 +662,14 @@ void RewriteDriver::FlushAsync(Function* callback) {
 
   DetermineEnabledFilters();
 
+  // Filter passes, and the RewriteContexts initiated by this flush, are
+  // traced as children of a span covering the whole flush window.
+  SpanTrace* span_trace = request_context_->span_trace();
+  flush_span_ = (span_trace == NULL) ? SpanTrace::kNoSpan :
+      span_trace->BeginSpan("RewriteDriver::Flush", SpanTrace::kRootSpan);
+  set_span_trace(span_trace, flush_span_);
+  set_filter_cost_tracker(server_context_->html_filter_costs());
+
   for (FilterList::iterator it = early_pre_render_filters_.begin();
       it != early_pre_render_filters_.end(); ++it) {
     HtmlFilter* filter = *it;
@@ -691,6 +713,7 @@ void RewriteDriver::FlushAsync(Function* callback) {
     // are the ones to start it.
     for (int i = 0; i < num_rewrites; ++i) {
       RewriteContext* rewrite_context = rewrites_[i];
+      rewrite_context->span_parent_ = flush_span_;
       if (!rewrite_context->chained()) {
         rewrite_context->Initiate();
       }
@@ -706,9 +729,11 @@ void RewriteDriver::FlushAsync(Function* callback) {
         MakeFunction(this, &RewriteDriver::QueueFlushAsyncDone,
                      num_rewrites, callback);
     if (fully_rewrite_on_flush_) {
+      flush_window_deadline_ms_ = -1;
       CheckForCompletionAsync(kWaitForCompletion, -1, flush_async_done);
     } else {
       int64 deadline = ComputeCurrentFlushWindowRewriteDelayMs();
+      flush_window_deadline_ms_ = deadline;
       CheckForCompletionAsync(kWaitForCachedRender, deadline, flush_async_done);
     }
   }
@@ -716,6 +741,12 @@ void RewriteDriver::FlushAsync(Function* callback) {
 
 int64 RewriteDriver::ComputeCurrentFlushWindowRewriteDelayMs() {
   int64 deadline = rewrite_deadline_ms();
+  if (options()->adaptive_rewrite_deadline() && deadline > 0) {
+    if (adaptive_rewrite_deadline_.get() == NULL) {
+      InitAdaptiveRewriteDeadline();
+    }
+    deadline = adaptive_rewrite_deadline_->deadline_ms();
+  }
   // If we've configured a max processing delay for the entire page, enforce
   // that limit here.
   if (max_page_processing_delay_ms_ > 0) {
@@ -735,6 +766,42 @@ int64 RewriteDriver::ComputeCurrentFlushWindowRewriteDelayMs() {
   return deadline;
 }
 
+void RewriteDriver::InitAdaptiveRewriteDeadline() {
+  adaptive_rewrite_deadline_.reset(new AdaptiveRewriteDeadline(
+      rewrite_deadline_ms(),
+      options()->adaptive_rewrite_deadline_target_percent()));
+  PropertyPage* page = origin_property_page();
+  const PropertyCache::Cohort* cohort =
+      server_context_->adaptive_rewrite_deadline_cohort();
+  if (page != NULL && cohort != NULL) {
+    PropertyValue* property_value = page->GetProperty(
+        cohort, AdaptiveRewriteDeadline::kPropertyName);
+    if (property_value->has_value()) {
+      adaptive_rewrite_deadline_->DecodeEstimate(property_value->value());
+    }
+  }
+}
+
+void RewriteDriver::RecordFlushWindowOutcome(int num_rewrites,
+                                             int still_pending_rewrites) {
+  if (num_rewrites == 0 || flush_window_deadline_ms_ <= 0) {
+    return;
+  }
+  RewriteStats* stats = server_context_->rewrite_stats();
+  stats->flush_window_deadline_histogram()->Add(flush_window_deadline_ms_);
+  stats->flush_window_completion_histogram()->Add(
+      100 * (num_rewrites - still_pending_rewrites) / num_rewrites);
+  if (adaptive_rewrite_deadline_.get() != NULL) {
+    // A window whose deadline was cut short by the page's overall deadline
+    // doesn't tell us whether the learned deadline would have sufficed.
+    bool all_completed = (still_pending_rewrites == 0);
+    int64 learned_ms = adaptive_rewrite_deadline_->deadline_ms();
+    if (all_completed || flush_window_deadline_ms_ >= learned_ms) {
+      adaptive_rewrite_deadline_->RecordWindow(all_completed);
+    }
+  }
+}
+
 void RewriteDriver::QueueFlushAsyncDone(int num_rewrites, Function* callback) {
   html_worker_->Add(MakeFunction(this, &RewriteDriver::FlushAsyncDone,
                                  num_rewrites, callback));
@@ -744,10 +811,11 @@ void RewriteDriver::FlushAsyncDone(int num_rewrites, Function* callback) {
   DCHECK(request_context_.get() != NULL);
   TraceLiteral("RewriteDriver::FlushAsyncDone()");
 
+  int still_pending_rewrites;
   {
     ScopedMutex lock(rewrite_mutex());
     DCHECK_EQ(0, possibly_quick_rewrites_);
-    int still_pending_rewrites =
+    still_pending_rewrites =
         ref_counts_.QueryCountMutexHeld(kRefPendingRewrites);
     int completed_rewrites = num_rewrites - still_pending_rewrites;
 
@@ -760,6 +828,7 @@ void RewriteDriver::FlushAsyncDone(int num_rewrites, Function* callback) {
     RewriteStats* stats = server_context_->rewrite_stats();
     stats->cached_output_hits()->Add(completed_rewrites);
     stats->cached_output_missed_deadline()->Add(still_pending_rewrites);
+    RecordFlushWindowOutcome(num_rewrites, still_pending_rewrites);
     {
       // Add completed_rewrites (from this flush window) to the logged value.
       ScopedMutex lock(log_record()->mutex());
@@ -830,6 +899,14 @@ void RewriteDriver::FlushAsyncDone(int num_rewrites, Function* callback) {
   // Run all the post-render filters, and clear the event queue.
   HtmlParse::Flush();
   flush_occurred_ = true;
+
+  SpanTrace* span_trace = request_context_->span_trace();
+  if (span_trace != NULL) {
+    span_trace->AddTag(flush_span_, "rewrites", IntegerToString(num_rewrites));
+    span_trace->AddTag(flush_span_, "missed_deadline",
+                       IntegerToString(still_pending_rewrites));
+    span_trace->EndSpan(flush_span_);
+  }
   callback->CallRun();
 }
 
@@ -2421,7 +2498,11 @@ void RewriteDriver::SetDecodedUrlFromBase() {
 bool RewriteDriver::ShouldSkipParsing() {
   if (should_skip_parsing_ == kNotSet) {
     bool should_skip = false;
-    PropertyPage* page = property_page();
+    // Text lexed while filter setup is deferred waits in the event queue to
+    // be filtered, so nothing after it may bypass the parser either.  Nor is
+    // the property page safe to read yet.
+    PropertyPage* page =
+        defer_determine_enabled_filters() ? NULL : property_page();
     if (page != NULL) {
       PropertyCache* pcache = server_context_->page_property_cache();
       const PropertyCache::Cohort* dom_cohort = pcache->GetCohort(kDomCohort);
@@ -2597,6 +2678,30 @@ void RewriteDriver::WriteDomCohortIntoPropertyCache() {
   fallback_property_page()->WriteCohort(server_context()->dom_cohort());
 }
 
+void RewriteDriver::WriteAdaptiveRewriteDeadlineIntoPropertyCache() {
+  PropertyPage* page = origin_property_page();
+  const PropertyCache::Cohort* cohort =
+      server_context_->adaptive_rewrite_deadline_cohort();
+  if (adaptive_rewrite_deadline_.get() == NULL ||
+      adaptive_rewrite_deadline_->num_windows_recorded() == 0 ||
+      page == NULL || cohort == NULL || server_context_->shutting_down()) {
+    return;
+  }
+  if (!adaptive_rewrite_deadline_->ChangedSignificantly()) {
+    // The one request in kAdaptiveRewriteDeadlineSampleRequests which saves
+    // a small change stands in for the others.
+    if (server_context_->simple_random()->Next() %
+        kAdaptiveRewriteDeadlineSampleRequests != 0) {
+      return;
+    }
+    adaptive_rewrite_deadline_->ScaleChangeSinceDecode(
+        kAdaptiveRewriteDeadlineSampleRequests);
+  }
+  page->UpdateValue(cohort, AdaptiveRewriteDeadline::kPropertyName,
+                    adaptive_rewrite_deadline_->EncodeEstimate());
+  page->WriteCohort(cohort);
+}
+
 void RewriteDriver::UpdatePropertyValueInDomCohort(
     AbstractPropertyPage* page,
     StringPiece property_name,
@@ -2742,6 +2847,7 @@ void RewriteDriver::FinishParseAfterFlush(Function* user_callback) {
   HtmlParse::EndFinishParse();
   LogStats();
   WriteDomCohortIntoPropertyCache();
+  WriteAdaptiveRewriteDeadlineIntoPropertyCache();
 
   // Update stats.
   RewriteStats* stats = server_context_->rewrite_stats();
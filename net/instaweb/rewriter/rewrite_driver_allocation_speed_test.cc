@@ -0,0 +1,142 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Logs the number of calls to operator new made per HTML response rewritten
+// by a RewriteDriver.  This covers parsing, filtering and flushing only: the
+// response is handed straight to the driver, so ProxyFetch, the HTTPCache
+// and the fetchers are not exercised.  This is its own binary because it
+// replaces the global allocator, which would otherwise slow down every other
+// benchmark and displace mem_debug.cc's allocator in debug builds.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "net/instaweb/rewriter/public/rewrite_driver.h"
+
+#include "base/logging.h"
+#include "net/instaweb/http/public/mock_url_fetcher.h"
+#include "net/instaweb/http/public/request_context.h"
+#include "net/instaweb/rewriter/public/process_context.h"
+#include "net/instaweb/rewriter/public/rewrite_driver_factory.h"
+#include "net/instaweb/rewriter/public/rewrite_options.h"
+#include "net/instaweb/rewriter/public/server_context.h"
+#include "net/instaweb/rewriter/public/test_rewrite_driver_factory.h"
+#include "pagespeed/kernel/base/atomic_int32.h"
+#include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_writer.h"
+
+using net_instaweb::RequestContext;
+
+namespace {
+
+// Counts every allocation made through operator new in this binary, so that
+// benchmarks can report allocations per operation.  All eight forms are
+// replaced, as in mem_debug.cc, so that none of them is linked from there.
+net_instaweb::AtomicInt32 num_allocations(0);
+
+void* CountingMalloc(size_t size) {
+  num_allocations.NoBarrierIncrement(1);
+  void* ptr = malloc((size == 0) ? 1 : size);
+  CHECK(ptr != NULL);
+  return ptr;
+}
+
+}  // namespace
+
+#ifndef __THROW
+#define __THROW
+#endif
+
+void* operator new(size_t size) throw (std::bad_alloc) {
+  return CountingMalloc(size);
+}
+
+void* operator new[](size_t size) throw (std::bad_alloc) {
+  return CountingMalloc(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) __THROW {
+  return CountingMalloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) __THROW {
+  return CountingMalloc(size);
+}
+
+void operator delete(void* ptr) __THROW {
+  free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) __THROW {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) __THROW {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) __THROW {
+  free(ptr);
+}
+
+// Rewrites a small HTML response in two flush windows, as the proxy does
+// when the origin streams it, and logs the driver's allocations per
+// response.
+static void BM_HtmlRewriteAllocations(int iters) {
+  StopBenchmarkTiming();
+  static const char kHead[] =
+      "<html><head><title>Benchmark</title>"
+      "<style>body { color: red; }  .a { margin: 0px; }</style>"
+      "<script>var x = 1;  // comment\n</script></head>";
+  static const char kBody[] =
+      "<body><div class='a'>  Some   text  </div>"
+      "<a href='http://example.com/a'>link</a></body></html>";
+  net_instaweb::ProcessContext process_context;
+  net_instaweb::MockUrlFetcher fetcher;
+  net_instaweb::RewriteDriverFactory::Initialize();
+  net_instaweb::TestRewriteDriverFactory factory(
+      process_context, "/tmp", &fetcher, NULL);
+  net_instaweb::RewriteDriverFactory::InitStats(factory.statistics());
+  net_instaweb::ServerContext* server_context = factory.CreateServerContext();
+  StartBenchmarkTiming();
+  int32 allocations_before = num_allocations.value();
+  for (int i = 0; i < iters; ++i) {
+    net_instaweb::RewriteOptions* options = new net_instaweb::RewriteOptions(
+        factory.thread_system());
+    options->SetRewriteLevel(net_instaweb::RewriteOptions::kCoreFilters);
+    net_instaweb::RewriteDriver* driver =
+        server_context->NewCustomRewriteDriver(
+            options, RequestContext::NewTestRequestContext(
+                         factory.thread_system()));
+    GoogleString output;
+    net_instaweb::StringWriter writer(&output);
+    driver->SetWriter(&writer);
+    driver->StartParse("http://example.com/index.html");
+    driver->ParseText(kHead);
+    driver->Flush();
+    driver->ParseText(kBody);
+    driver->FinishParse();  // Also releases the driver.
+  }
+  int32 allocations = num_allocations.value() - allocations_before;
+  StopBenchmarkTiming();
+  LOG(INFO) << "BM_HtmlRewriteAllocations: "
+            << static_cast<double>(allocations) / iters
+            << " allocations per response over " << iters << " iterations";
+  net_instaweb::RewriteDriverFactory::Terminate();
+}
+BENCHMARK(BM_HtmlRewriteAllocations);
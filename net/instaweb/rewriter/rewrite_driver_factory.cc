@@ -31,6 +31,8 @@
 #include "net/instaweb/rewriter/public/critical_images_finder.h"
 #include "net/instaweb/rewriter/public/critical_line_info_finder.h"
 #include "net/instaweb/rewriter/public/critical_selector_finder.h"
+#include "net/instaweb/rewriter/public/css_fragment_cache.h"
+#include "net/instaweb/rewriter/public/decoded_image_cache.h"
 #include "net/instaweb/rewriter/public/device_properties.h"
 #include "net/instaweb/rewriter/public/experiment_matcher.h"
 #include "net/instaweb/rewriter/public/mobilize_cached_finder.h"
@@ -75,6 +77,10 @@ namespace {
 const int kWebpQualityArray[] = {20, 35, 50, 70, 85};
 const int kJpegQualityArray[] = {30, 50, 65, 80, 90};
 
+// Bytes of user agent classifications that UserAgentMatcher keeps, enough for
+// about 10000 typical user agents.
+const size_t kUserAgentClassificationCacheBytes = 2 * 1000 * 1000;
+
 }  // namespace
 
 RewriteDriverFactory::RewriteDriverFactory(
@@ -97,8 +103,8 @@ void RewriteDriverFactory::Init() {
   force_caching_ = false;
   slurp_read_only_ = false;
   slurp_print_urls_ = false;
-  SetStatistics(&null_statistics_);
   server_context_mutex_.reset(thread_system_->NewMutex());
+  SetStatistics(&null_statistics_);
   worker_pools_.assign(kNumWorkerPools, NULL);
   hostname_ = GetHostname();
 
@@ -514,6 +520,8 @@ void RewriteDriverFactory::InitServerContext(ServerContext* server_context) {
   if (server_context->rewrite_stats() == NULL) {
     server_context->set_rewrite_stats(rewrite_stats());
   }
+  server_context->set_decoded_image_cache(decoded_image_cache());
+  server_context->set_css_fragment_cache(css_fragment_cache());
   SetupCaches(server_context);
   if (server_context->lock_manager() == NULL) {
     server_context->set_lock_manager(lock_manager());
@@ -529,6 +537,8 @@ void RewriteDriverFactory::InitServerContext(ServerContext* server_context) {
   }
   server_context->set_url_namer(url_namer());
   server_context->SetRewriteOptionsManager(NewRewriteOptionsManager());
+  user_agent_matcher()->EnableClassificationCache(
+      kUserAgentClassificationCacheBytes, thread_system(), statistics());
   server_context->set_user_agent_matcher(user_agent_matcher());
   server_context->set_file_system(file_system());
   server_context->set_filename_prefix(filename_prefix_);
@@ -780,6 +790,7 @@ void RewriteDriverFactory::InitStats(Statistics* statistics) {
   CriticalSelectorFinder::InitStats(statistics);
   MobilizeCachedFinder::InitStats(statistics);
   PropertyStoreGetCallback::InitStats(statistics);
+  UserAgentMatcher::InitStats(statistics);
 }
 
 void RewriteDriverFactory::Initialize() {
@@ -793,6 +804,16 @@ void RewriteDriverFactory::Terminate() {
 void RewriteDriverFactory::SetStatistics(Statistics* statistics) {
   statistics_ = statistics;
   rewrite_stats_.reset(NULL);
+
+  // The decoded image cache counts into the statistics, so make a new one,
+  // and hand it to the server contexts holding the old one before that goes.
+  scoped_ptr<DecodedImageCache> old_decoded_image_cache(
+      decoded_image_cache_.release());
+  ScopedMutex lock(server_context_mutex_.get());
+  for (ServerContextSet::iterator p = server_contexts_.begin();
+       p != server_contexts_.end(); ++p) {
+    (*p)->set_decoded_image_cache(decoded_image_cache());
+  }
 }
 
 RewriteStats* RewriteDriverFactory::rewrite_stats() {
@@ -803,6 +824,29 @@ RewriteStats* RewriteDriverFactory::rewrite_stats() {
   return rewrite_stats_.get();
 }
 
+DecodedImageCache* RewriteDriverFactory::decoded_image_cache() {
+  const RewriteOptions* options = default_options();
+  if (decoded_image_cache_.get() == NULL &&
+      options->decoded_image_cache_max_bytes() > 0 &&
+      options->decoded_image_cache_ttl_ms() > 0) {
+    decoded_image_cache_.reset(new DecodedImageCache(
+        options->decoded_image_cache_max_bytes(),
+        options->decoded_image_cache_ttl_ms(),
+        thread_system_.get(), timer(), statistics_));
+  }
+  return decoded_image_cache_.get();
+}
+
+CssFragmentCache* RewriteDriverFactory::css_fragment_cache() {
+  const RewriteOptions* options = default_options();
+  if (css_fragment_cache_.get() == NULL &&
+      options->css_fragment_cache_max_bytes() > 0) {
+    css_fragment_cache_.reset(new CssFragmentCache(
+        options->css_fragment_cache_max_bytes(), thread_system_.get()));
+  }
+  return css_fragment_cache_.get();
+}
+
 RewriteOptions* RewriteDriverFactory::NewRewriteOptions() {
   return new RewriteOptions(thread_system());
 }
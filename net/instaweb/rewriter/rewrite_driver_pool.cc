@@ -18,12 +18,17 @@
 
 #include "net/instaweb/rewriter/public/rewrite_driver_pool.h"
 
+#include "base/logging.h"
 #include "net/instaweb/rewriter/public/rewrite_driver.h"
+#include "net/instaweb/rewriter/public/rewrite_options.h"
 #include "pagespeed/kernel/base/stl_util.h"
 
 namespace net_instaweb {
 
-RewriteDriverPool::RewriteDriverPool() {}
+RewriteDriverPool::RewriteDriverPool()
+    : num_active_drivers_(0),
+      max_idle_drivers_(-1) {
+}
 
 RewriteDriverPool::~RewriteDriverPool() {
   STLDeleteElements(&drivers_);
@@ -39,8 +44,28 @@ RewriteDriver* RewriteDriverPool::PopDriver() {
 }
 
 void RewriteDriverPool::RecycleDriver(RewriteDriver* driver) {
+  DCHECK_LT(0, num_active_drivers_);
+  --num_active_drivers_;
+  if ((max_idle_drivers_ >= 0) &&
+      (static_cast<int>(drivers_.size()) >= max_idle_drivers_)) {
+    delete driver;
+    return;
+  }
   drivers_.push_back(driver);
   driver->Clear();
 }
 
+CustomOptionsRewriteDriverPool::CustomOptionsRewriteDriverPool(
+    RewriteOptions* options)
+    : options_(options) {
+  DCHECK(options->frozen());
+}
+
+CustomOptionsRewriteDriverPool::~CustomOptionsRewriteDriverPool() {
+}
+
+const RewriteOptions* CustomOptionsRewriteDriverPool::TargetOptions() const {
+  return options_.get();
+}
+
 }  // namespace net_instaweb
@@ -24,6 +24,7 @@
 #include "net/instaweb/http/public/logging_proto_impl.h"
 #include "net/instaweb/http/public/mock_url_fetcher.h"
 #include "net/instaweb/http/public/wait_url_async_fetcher.h"
+#include "net/instaweb/rewriter/public/adaptive_rewrite_deadline.h"
 #include "net/instaweb/rewriter/public/domain_lawyer.h"
 #include "net/instaweb/rewriter/public/file_load_policy.h"
 #include "net/instaweb/rewriter/public/mock_resource_callback.h"
@@ -37,6 +38,8 @@
 #include "net/instaweb/rewriter/public/single_rewrite_context.h"
 #include "net/instaweb/rewriter/public/test_rewrite_driver_factory.h"
 #include "net/instaweb/rewriter/public/test_url_namer.h"
+#include "net/instaweb/util/public/mock_property_page.h"
+#include "net/instaweb/util/public/property_cache.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/gtest.h"
@@ -44,10 +47,12 @@
 #include "pagespeed/kernel/base/mock_message_handler.h"
 #include "pagespeed/kernel/base/mock_timer.h"
 #include "pagespeed/kernel/base/null_mutex.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/sha1_signature.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/cache/lru_cache.h"
 #include "pagespeed/kernel/html/empty_html_filter.h"
@@ -80,6 +85,23 @@ class RewriteDriverTest : public RewriteTestBase {
     return rewrite_driver()->base_url().Spec().as_string();
   }
 
+  // Parses html with a fresh driver whose per-origin property page has been
+  // read from the property cache, as ProxyFetch sets one up.  The driver is
+  // released when the parse finishes.
+  void ParseWithOriginPropertyPage(StringPiece html) {
+    RewriteDriver* driver = server_context()->NewCustomRewriteDriver(
+        options()->Clone(), CreateRequestContext());
+    MockPropertyPage* page = NewMockPage(kTestDomain);
+    page_property_cache()->Read(page);
+    driver->set_origin_property_page(page);
+    GoogleString output;
+    StringWriter writer(&output);
+    driver->SetWriter(&writer);
+    ASSERT_TRUE(driver->StartParse(StrCat(kTestDomain, "page.html")));
+    driver->ParseText(html);
+    driver->FinishParse();
+  }
+
   // A helper to call ComputeCurrentFlushWindowRewriteDelayMs() that allows
   // us to keep it private.
   int64 GetFlushTimeout() {
@@ -744,6 +766,53 @@ TEST_F(RewriteDriverTest, TestComputeCurrentFlushWindowRewriteDelayMs) {
   rewrite_driver()->FinishParse();
 }
 
+// Verifies that with AdaptiveRewriteDeadline on, what one request learns
+// about the site's flush windows is saved in the origin page's adaptive
+// rewrite deadline cohort and shortens the deadline the next request's
+// windows get.
+TEST_F(RewriteDriverTest, AdaptiveRewriteDeadlineCarriesAcrossRequests) {
+  options()->set_rewrite_deadline_ms(1000);
+  options()->set_adaptive_rewrite_deadline(true);
+  options()->set_adaptive_rewrite_deadline_target_percent(90);
+  options()->EnableFilter(RewriteOptions::kExtendCacheCss);
+  SetResponseWithDefaultHeaders("a.css", kContentTypeCss,
+                                "* { display: none; }", 100);
+  server_context()->set_enable_property_cache(true);
+  PropertyCache* pcache = page_property_cache();
+  const PropertyCache::Cohort* cohort =
+      SetupCohort(pcache, RewriteDriver::kAdaptiveRewriteDeadlineCohort);
+  server_context()->set_adaptive_rewrite_deadline_cohort(cohort);
+  RewriteStats* stats = server_context()->rewrite_stats();
+  Histogram* deadlines = stats->flush_window_deadline_histogram();
+  Histogram* completions = stats->flush_window_completion_histogram();
+
+  // Nothing has been learned about the site yet, so the window gets the
+  // configured deadline, and completes its rewrite well within it.
+  ParseWithOriginPropertyPage(CssLinkHref("a.css"));
+  EXPECT_EQ(1, deadlines->Count());
+  EXPECT_EQ(1000, deadlines->Maximum());
+  EXPECT_EQ(1, completions->Count());
+  EXPECT_EQ(100, completions->Maximum());
+
+  scoped_ptr<MockPropertyPage> page(NewMockPage(kTestDomain));
+  pcache->Read(page.get());
+  PropertyValue* value =
+      page->GetProperty(cohort, AdaptiveRewriteDeadline::kPropertyName);
+  ASSERT_TRUE(value->has_value());
+  int64 estimate_us;
+  ASSERT_TRUE(StringToInt64(value->value(), &estimate_us));
+  EXPECT_GT(1000 * Timer::kMsUs, estimate_us);
+
+  // The next request starts from the saved estimate.
+  deadlines->Clear();
+  ParseWithOriginPropertyPage(CssLinkHref("a.css"));
+  EXPECT_EQ(1, deadlines->Count());
+  EXPECT_EQ((estimate_us + Timer::kMsUs - 1) / Timer::kMsUs,
+            deadlines->Maximum());
+  EXPECT_GT(1000, deadlines->Maximum());
+  EXPECT_EQ(2, completions->Count());
+}
+
 // Extension of above with cache invalidation.
 TEST_F(RewriteDriverTest, TestCacheUseOnTheFlyWithInvalidation) {
   AddFilter(RewriteOptions::kExtendCacheCss);
@@ -33,7 +33,6 @@
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/null_rw_lock.h"
-#include "pagespeed/kernel/base/rde_hash_map.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/time_util.h"
 #include "pagespeed/kernel/base/timer.h"
@@ -56,6 +55,10 @@ const char RewriteOptions::kAcceptInvalidSignatures[] =
     "AcceptInvalidSignatures";
 const char RewriteOptions::kAccessControlAllowOrigins[] =
     "AccessControlAllowOrigins";
+const char RewriteOptions::kAdaptiveRewriteDeadline[] =
+    "AdaptiveRewriteDeadline";
+const char RewriteOptions::kAdaptiveRewriteDeadlineTargetPercent[] =
+    "AdaptiveRewriteDeadlineTargetPercent";
 const char RewriteOptions::kAllowLoggingUrlsInLogRecord[] =
     "AllowLoggingUrlsInLogRecord";
 const char RewriteOptions::kAllowOptionsToBeSetByCookies[] =
@@ -81,10 +84,21 @@ const char RewriteOptions::kCriticalImagesBeaconEnabled[] =
     "CriticalImagesBeaconEnabled";
 const char RewriteOptions::kCriticalLineConfig[] = "CriticalLineConfig";
 const char RewriteOptions::kCssFlattenMaxBytes[] = "CssFlattenMaxBytes";
+const char RewriteOptions::kCssFragmentCacheMaxBytes[] =
+    "CssFragmentCacheMaxBytes";
 const char RewriteOptions::kCssImageInlineMaxBytes[] = "CssImageInlineMaxBytes";
 const char RewriteOptions::kCssInlineMaxBytes[] = "CssInlineMaxBytes";
 const char RewriteOptions::kCssOutlineMinBytes[] = "CssOutlineMinBytes";
 const char RewriteOptions::kCssPreserveURLs[] = "CssPreserveURLs";
+const char RewriteOptions::kCssStreamingRewrite[] = "CssStreamingRewrite";
+const char RewriteOptions::kCustomRewriteDriverPoolMaxIdleDrivers[] =
+    "CustomRewriteDriverPoolMaxIdleDrivers";
+const char RewriteOptions::kCustomRewriteDriverPools[] =
+    "CustomRewriteDriverPools";
+const char RewriteOptions::kDecodedImageCacheMaxBytes[] =
+    "DecodedImageCacheMaxBytes";
+const char RewriteOptions::kDecodedImageCacheTtlMs[] =
+    "DecodedImageCacheTtlMs";
 const char RewriteOptions::kDefaultCacheHtml[] = "DefaultCacheHtml";
 const char RewriteOptions::kDisableRewriteOnNoTransform[] =
     "DisableRewriteOnNoTransform";
@@ -144,6 +158,8 @@ const char RewriteOptions::kGoogleFontCssInlineMaxBytes[] =
     "GoogleFontCssInlineMaxBytes";
 const char RewriteOptions::kHideRefererUsingMeta[] = "HideRefererUsingMeta";
 const char RewriteOptions::kIdleFlushTimeMs[] = "IdleFlushTimeMs";
+const char RewriteOptions::kImageDedupByContentHash[] =
+    "ImageDedupByContentHash";
 const char RewriteOptions::kImageInlineMaxBytes[] = "ImageInlineMaxBytes";
 const char RewriteOptions::kImageJpegNumProgressiveScans[] =
     "ImageJpegNumProgressiveScans";
@@ -163,8 +179,11 @@ const char RewriteOptions::kImageMaxRewritesAtOnce[] = "ImageMaxRewritesAtOnce";
 const char RewriteOptions::kImagePreserveURLs[] = "ImagePreserveURLs";
 const char RewriteOptions::kImageRecompressionQuality[] =
     "ImageRecompressionQuality";
+const char RewriteOptions::kImageRecompressionTargetSsim[] =
+    "ImageRecompressionTargetSsim";
 const char RewriteOptions::kImageResolutionLimitBytes[] =
     "ImageResolutionLimitBytes";
+const char RewriteOptions::kImageSpritePacking[] = "ImageSpritePacking";
 const char RewriteOptions::kImageWebpRecompressionQuality[] =
     "WebpRecompressionQuality";
 const char RewriteOptions::kImageWebpRecompressionQualityForSmallScreens[] =
@@ -194,6 +213,8 @@ const char RewriteOptions::kJsPreserveURLs[] = "JsPreserveURLs";
 const char RewriteOptions::kLazyloadImagesAfterOnload[] =
     "LazyloadImagesAfterOnload";
 const char RewriteOptions::kLazyloadImagesBlankUrl[] = "LazyloadImagesBlankUrl";
+const char RewriteOptions::kLexHtmlDuringPcacheLookup[] =
+    "LexHtmlDuringPcacheLookup";
 const char RewriteOptions::kLoadFromFileCacheTtlMs[] = "LoadFromFileCacheTtlMs";
 const char RewriteOptions::kLogBackgroundRewrite[] = "LogBackgroundRewrite";
 const char RewriteOptions::kLogMobilizationSamples[] = "LogMobilizationSamples";
@@ -252,6 +273,7 @@ const char RewriteOptions::kObliviousPagespeedUrls[] = "ObliviousPagespeedUrls";
 const char RewriteOptions::kOptionCookiesDurationMs[] =
     "OptionCookiesDurationMs";
 const char RewriteOptions::kOverrideCachingTtlMs[] = "OverrideCachingTtlMs";
+const char RewriteOptions::kPcacheLookupDeadlineMs[] = "PcacheLookupDeadlineMs";
 const char RewriteOptions::kPersistBlinkBlacklist[] = "PersistBlinkBlacklist";
 const char RewriteOptions::kPreserveUrlRelativity[] = "PreserveUrlRelativity";
 const char RewriteOptions::kPrivateNotVaryForIE[] = "PrivateNotVaryForIE";
@@ -266,6 +288,8 @@ const char RewriteOptions::kProgressiveJpegMinBytes[] =
 const char RewriteOptions::kRejectBlacklisted[] = "RejectBlacklisted";
 const char RewriteOptions::kRejectBlacklistedStatusCode[] =
     "RejectBlacklistedStatusCode";
+const char RewriteOptions::kRenameJavascriptLocals[] =
+    "RenameJavascriptLocals";
 const char RewriteOptions::kReportUnloadTime[] = "ReportUnloadTime";
 const char RewriteOptions::kRespectVary[] = "RespectVary";
 const char RewriteOptions::kRespectXForwardedProto[] = "RespectXForwardedProto";
@@ -344,6 +368,8 @@ const char RewriteOptions::kFileCachePath[] = "FileCachePath";
 const char RewriteOptions::kLogDir[] = "LogDir";
 const char RewriteOptions::kLruCacheByteLimit[] = "LRUCacheByteLimit";
 const char RewriteOptions::kLruCacheKbPerProcess[] = "LRUCacheKbPerProcess";
+const char RewriteOptions::kLruCacheSnapshotIntervalSec[] =
+    "LRUCacheSnapshotIntervalSec";
 const char RewriteOptions::kMemcachedServers[] = "MemcachedServers";
 const char RewriteOptions::kMemcachedThreads[] = "MemcachedThreads";
 const char RewriteOptions::kMemcachedTimeoutUs[] = "MemcachedTimeoutUs";
@@ -460,6 +486,25 @@ const int64 RewriteOptions::kDefaultPrioritizeVisibleContentCacheTimeMs =
 // TODO(jmaessen): Determine a sane default for this value.
 const int RewriteOptions::kDefaultImageMaxRewritesAtOnce = 8;
 
+// Most custom options come from a handful of directory and host
+// configurations, so a few pools cover nearly all requests using them.
+const int RewriteOptions::kDefaultCustomRewriteDriverPools = 16;
+const int RewriteOptions::kDefaultCustomRewriteDriverPoolMaxIdleDrivers = 8;
+
+// Enough for a few dozen typical page images, or a couple of very large
+// ones, at three or four bytes per pixel.
+const int64 RewriteOptions::kDefaultDecodedImageCacheMaxBytes =
+    32 * 1024 * 1024;
+
+// Sibling variant rewrites of an image are issued together while a page is
+// parsed, so they all land within a few seconds of each other.
+const int64 RewriteOptions::kDefaultDecodedImageCacheTtlMs =
+    10 * Timer::kSecondMs;
+
+// Enough for the stylesheets of a few dozen typical sites.
+const int64 RewriteOptions::kDefaultCssFragmentCacheMaxBytes =
+    2 * 1024 * 1024;
+
 // IE limits URL size overall to about 2k characters.  See
 // http://support.microsoft.com/kb/208427/EN-US
 const int RewriteOptions::kDefaultMaxUrlSize = 2083;
@@ -502,6 +547,10 @@ RewriteOptions::kDefaultImageWebpRecompressQualityForSmallScreens = 70;
 // image. If negative, does not time out.
 const int64 RewriteOptions::kDefaultImageWebpTimeoutMs = -1;
 
+// Target SSIM, in thousandths, for searching per-image recompression quality.
+// If negative, images are recompressed at the configured fixed qualities.
+const int64 RewriteOptions::kDefaultImageRecompressTargetSsim = -1;
+
 // Setting the maximum length for the cacheable response content to -1
 // indicates that there is no size limit.
 const int64 RewriteOptions::kDefaultMaxCacheableResponseContentLength = -1;
@@ -580,8 +629,7 @@ const int RewriteOptions::kDefaultMaxLowResToFullResImageSizePercentage = 100;
 const RewriteOptions::FilterEnumToIdAndNameEntry*
     RewriteOptions::filter_id_to_enum_array_[RewriteOptions::kEndOfFilters];
 
-RewriteOptions::PropertyNameMap*
-    RewriteOptions::option_name_to_property_map_ = NULL;
+RewriteOptions::OptionNameTable* RewriteOptions::option_name_table_ = NULL;
 
 const RewriteOptions::PropertyBase**
     RewriteOptions::option_id_to_property_array_ = NULL;
@@ -996,12 +1044,6 @@ void StripBeaconUrlQueryParam(GoogleString* url,
 
 // Maps the deprecated options to the new names.
 struct DeprecatedOptionMap {
-  static bool LessThan(
-      const DeprecatedOptionMap& option_map,
-      StringPiece arg) {
-    return StringCaseCompare(option_map.deprecated_option_name, arg) < 0;
-  }
-
   const char* deprecated_option_name;
   const char* new_option_name;
 };
@@ -1013,13 +1055,171 @@ const DeprecatedOptionMap kDeprecatedOptionNameData[] = {
       "WebpRecompressionQualityForSmallScreens"}
 };
 
-std::vector<DeprecatedOptionMap> kDeprecatedOptionNameList(
-    kDeprecatedOptionNameData,
-    kDeprecatedOptionNameData + arraysize(kDeprecatedOptionNameData)
-);
+// The splitmix64 finalizer, so that option names differing in a single
+// character land in unrelated buckets of the option name table.
+uint64 MixBits(uint64 x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
 
 }  // namespace
 
+// Maps option names to properties, ignoring case, with a single probe.
+//
+// The names are only all known once subclasses have merged in their
+// properties, so instead of generating the table offline with gperf it is
+// built at initialization with the "hash and displace" scheme of
+// Belazzougui, Botelho and Dietzfelbinger: names are grouped into buckets by
+// one part of their hash, and each bucket, largest first, is assigned the
+// smallest displacement that sends all its names to free slots.  A lookup is
+// then one hash, one displacement, and one name comparison.
+class RewriteOptions::OptionNameTable {
+ public:
+  OptionNameTable() : seed_(0), bucket_mask_(0), slot_mask_(0) {}
+
+  // Adds a name, which must not already be present: Build() cannot separate
+  // two equal names.  Must be called before Build().  The name must outlive
+  // the table.
+  void Add(StringPiece name, const PropertyBase* property) {
+    Entry entry;
+    entry.name = name;
+    entry.property = property;
+    entry.hash = 0;
+    entries_.push_back(entry);
+  }
+
+  void Build() {
+    // Two distinct names collide on all 64 bits of one seed's hash with
+    // negligible probability, but if they do, another seed separates them.
+    for (seed_ = 0; !TryBuild(); ++seed_) {
+    }
+  }
+
+  const PropertyBase* Lookup(StringPiece name) const {
+    if (slots_.empty()) {
+      return NULL;
+    }
+    uint64 hash = Hash(name, seed_);
+    int index = slots_[Slot(hash, displacements_[hash & bucket_mask_])];
+    if (index < 0 || !StringCaseEqual(entries_[index].name, name)) {
+      return NULL;
+    }
+    return entries_[index].property;
+  }
+
+ private:
+  struct Entry {
+    StringPiece name;
+    const PropertyBase* property;
+    uint64 hash;
+  };
+
+  // Larger buckets are placed first, while the table is emptiest.
+  struct BucketSizeGreater {
+    explicit BucketSizeGreater(const std::vector<std::vector<int> >* buckets)
+        : buckets_(buckets) {}
+    bool operator()(int a, int b) const {
+      return (*buckets_)[a].size() > (*buckets_)[b].size();
+    }
+    const std::vector<std::vector<int> >* buckets_;
+  };
+
+  // A bucket whose names cannot be placed with any displacement up to this
+  // needs a fresh seed.
+  static const uint32 kMaxDisplacement = 1 << 16;
+
+  static uint64 Hash(StringPiece name, uint32 seed) {
+    uint64 hash = 0xcbf29ce484222325ULL ^ seed;
+    for (int i = 0, n = name.size(); i < n; ++i) {
+      hash ^= static_cast<unsigned char>(LowerChar(name[i]));
+      hash *= 0x100000001b3ULL;
+    }
+    return MixBits(hash);
+  }
+
+  // The low bits of the hash select the bucket; the high bits give each
+  // name its own starting slot and stride through the table.
+  int Slot(uint64 hash, uint32 displacement) const {
+    uint32 start = static_cast<uint32>(hash >> 32);
+    uint32 stride = static_cast<uint32>(hash >> 16) | 1;
+    return (start + displacement * stride) & slot_mask_;
+  }
+
+  bool TryBuild() {
+    int num_entries = entries_.size();
+    uint32 num_buckets = 1;
+    while (num_buckets * 4 < static_cast<uint32>(num_entries)) {
+      num_buckets <<= 1;
+    }
+    uint32 num_slots = 1;
+    while (num_slots < 2 * static_cast<uint32>(num_entries)) {
+      num_slots <<= 1;
+    }
+    bucket_mask_ = num_buckets - 1;
+    slot_mask_ = num_slots - 1;
+
+    std::vector<std::vector<int> > buckets(num_buckets);
+    for (int i = 0; i < num_entries; ++i) {
+      entries_[i].hash = Hash(entries_[i].name, seed_);
+      buckets[entries_[i].hash & bucket_mask_].push_back(i);
+    }
+    std::vector<int> order(num_buckets);
+    for (uint32 b = 0; b < num_buckets; ++b) {
+      order[b] = b;
+    }
+    std::stable_sort(order.begin(), order.end(), BucketSizeGreater(&buckets));
+
+    slots_.assign(num_slots, -1);
+    displacements_.assign(num_buckets, 0);
+    for (uint32 b = 0; b < num_buckets; ++b) {
+      const std::vector<int>& bucket = buckets[order[b]];
+      if (bucket.empty()) {
+        break;
+      }
+      uint32 d = 0;
+      for (; d < kMaxDisplacement; ++d) {
+        if (PlaceBucket(bucket, d)) {
+          break;
+        }
+      }
+      if (d == kMaxDisplacement) {
+        return false;
+      }
+      displacements_[order[b]] = d;
+    }
+    return true;
+  }
+
+  // Tries to put every entry in bucket into a free slot at displacement d.
+  // On failure, leaves the slots as they were.
+  bool PlaceBucket(const std::vector<int>& bucket, uint32 d) {
+    for (int i = 0, n = bucket.size(); i < n; ++i) {
+      int slot = Slot(entries_[bucket[i]].hash, d);
+      if (slots_[slot] >= 0) {
+        for (int j = 0; j < i; ++j) {
+          slots_[Slot(entries_[bucket[j]].hash, d)] = -1;
+        }
+        return false;
+      }
+      slots_[slot] = bucket[i];
+    }
+    return true;
+  }
+
+  std::vector<Entry> entries_;
+  std::vector<int> slots_;
+  std::vector<uint32> displacements_;
+  uint32 seed_;
+  uint32 bucket_mask_;
+  uint32 slot_mask_;
+
+  DISALLOW_COPY_AND_ASSIGN(OptionNameTable);
+};
+
 const char* RewriteOptions::FilterName(Filter filter) {
   int i = static_cast<int>(filter);
   int n = arraysize(kFilterVectorStaticInitializer);
@@ -1409,6 +1609,44 @@ void RewriteOptions::AddProperties() {
       kProcessScope,
       "Set bound on number of images being rewritten at one time "
       "(0 = unbounded).", true);
+  AddBaseProperty(
+      kDefaultCustomRewriteDriverPools,
+      &RewriteOptions::custom_rewrite_driver_pools_,
+      "crdp", kCustomRewriteDriverPools,
+      kProcessScope,
+      "Number of distinct sets of custom (directory or host-specific) "
+      "options for which to recycle rewrite drivers, rather than building "
+      "a new driver and filter chain per request (0 = never recycle).", true);
+  AddBaseProperty(
+      kDefaultCustomRewriteDriverPoolMaxIdleDrivers,
+      &RewriteOptions::custom_rewrite_driver_pool_max_idle_drivers_,
+      "crdpi", kCustomRewriteDriverPoolMaxIdleDrivers,
+      kProcessScope,
+      "Maximum number of idle rewrite drivers to keep for each set of "
+      "custom options.", true);
+  AddBaseProperty(
+      kDefaultDecodedImageCacheMaxBytes,
+      &RewriteOptions::decoded_image_cache_max_bytes_,
+      "dicb", kDecodedImageCacheMaxBytes,
+      kProcessScope,
+      "Size in bytes of the per-process cache of decoded images that lets "
+      "several resized variants of one image share a decode "
+      "(0 = no cache).", true);
+  AddBaseProperty(
+      kDefaultDecodedImageCacheTtlMs,
+      &RewriteOptions::decoded_image_cache_ttl_ms_,
+      "dict", kDecodedImageCacheTtlMs,
+      kProcessScope,
+      "Time in milliseconds a decoded image is kept for other variants of "
+      "it to reuse (0 = no cache).", true);
+  AddBaseProperty(
+      kDefaultCssFragmentCacheMaxBytes,
+      &RewriteOptions::css_fragment_cache_max_bytes_,
+      "cfcb", kCssFragmentCacheMaxBytes,
+      kProcessScope,
+      "Size in bytes of the per-process cache of per-input pieces of "
+      "combined CSS, reused when a page's set of stylesheets changes "
+      "(0 = no cache).", true);
   AddBaseProperty(
       kDefaultMaxUrlSegmentSize, &RewriteOptions::max_url_segment_size_,
       "uss", kMaxUrlSegmentSize,
@@ -1430,6 +1668,19 @@ void RewriteOptions::AddProperties() {
       kDirectoryScope,
       "Time to wait for resource optimization (per flush window) before"
       "falling back to the original resource for the request.", true);
+  AddBaseProperty(
+      false, &RewriteOptions::adaptive_rewrite_deadline_, "ard",
+      kAdaptiveRewriteDeadline,
+      kDirectoryScope,
+      "Learn per site how long flush windows take to complete their "
+      "rewrites, and wait only that long, up to RewriteDeadlinePerFlushMs.",
+      true);
+  AddBaseProperty(
+      90, &RewriteOptions::adaptive_rewrite_deadline_target_percent_, "ardtp",
+      kAdaptiveRewriteDeadlineTargetPercent,
+      kDirectoryScope,
+      "Percentage of flush windows which should complete all their rewrites "
+      "under the learned deadline.", true);
   AddBaseProperty(
       kEnabledOn, &RewriteOptions::enabled_, "e", kEnabled,
       kDirectoryScope,
@@ -1557,6 +1808,13 @@ void RewriteOptions::AddProperties() {
       kAlwaysRewriteCss,
       kDirectoryScope,
       NULL, true);  // TODO(jmarantz): write help & doc for mod_pagespeed.
+  AddBaseProperty(
+      false, &RewriteOptions::css_streaming_rewrite_, "cssr",
+      kCssStreamingRewrite,
+      kDirectoryScope,
+      "When no filter needs the parsed stylesheet (flattening, image "
+      "inlining or spriting, critical CSS), rewrite CSS URLs and minify "
+      "in a single pass without parsing the CSS.", true);
   AddBaseProperty(
       false, &RewriteOptions::respect_vary_, "rv", kRespectVary,
       kDirectoryScope,
@@ -1587,6 +1845,12 @@ void RewriteOptions::AddProperties() {
       kImagePreserveURLs,
       kDirectoryScope,
       "Disable the rewriting of Image URLs.", true);
+  AddBaseProperty(
+      false, &RewriteOptions::image_dedup_by_content_hash_, "idch",
+      kImageDedupByContentHash,
+      kDirectoryScope,
+      "Reuse the optimized image for any URL whose contents are identical "
+      "to an image already optimized with the same options.", true);
   AddBaseProperty(
       false, &RewriteOptions::js_preserve_urls_, "jpu",
       kJsPreserveURLs,
@@ -1817,6 +2081,16 @@ void RewriteOptions::AddProperties() {
       "100 refers to best quality, -1 disables lossy compression. "
       "JpegRecompressionQuality and WebpRecompressionQuality override "
       "this.", true);
+  AddBaseProperty(
+      kDefaultImageRecompressTargetSsim,
+      &RewriteOptions::image_recompress_target_ssim_, "irts",
+      kImageRecompressionTargetSsim,
+      kQueryScope,
+      "Target structural similarity (SSIM) of recompressed jpeg and webp "
+      "images to their inputs, in thousandths [-1,1000]. When set, each "
+      "image is recompressed at the lowest quality meeting the target, no "
+      "higher than the configured recompression quality. -1 disables.",
+      true);
   AddBaseProperty(
       kDefaultImageLimitOptimizedPercent,
       &RewriteOptions::image_limit_optimized_percent_, "ip",
@@ -1932,6 +2206,12 @@ void RewriteOptions::AddProperties() {
       "irlb", kImageResolutionLimitBytes,
       kDirectoryScope,
       "Maximum byte size of an image for optimization", true);
+  AddBaseProperty(
+      false, &RewriteOptions::image_sprite_packing_, "isbp",
+      kImageSpritePacking,
+      kDirectoryScope,
+      "Pack sprited images in two dimensions, which usually gives a smaller "
+      "sprite than stacking them in a vertical strip.", true);
   AddBaseProperty(
       0, &RewriteOptions::rewrite_random_drop_percentage_, "rrdp",
       kRewriteRandomDropPercentage, kDirectoryScope,
@@ -2037,6 +2317,21 @@ void RewriteOptions::AddProperties() {
         "wpcl", kAwaitPcacheLookup,
         kServerScope,
         NULL, true);
+  AddBaseProperty(
+      false, &RewriteOptions::lex_html_during_pcache_lookup_, "lhpl",
+      kLexHtmlDuringPcacheLookup,
+      kServerScope,
+      "Lex HTML as it arrives from the origin while the property cache "
+      "lookup is still outstanding, so that only filtering waits for the "
+      "lookup.", true);
+  AddBaseProperty(
+      -1, &RewriteOptions::pcache_lookup_deadline_ms_, "pcld",
+      kPcacheLookupDeadlineMs,
+      kServerScope,
+      "Milliseconds after the first HTML bytes arrive from the origin to "
+      "wait for the property cache lookup before finishing it early, where "
+      "the property store supports that.  Negative means no deadline.",
+      true);
   AddBaseProperty(
       true, &RewriteOptions::support_noscript_enabled_, "snse",
       kSupportNoScriptEnabled,
@@ -2056,6 +2351,15 @@ void RewriteOptions::AddProperties() {
       "If set to false, uses the old legacy::MinifyJs-based minifier. "
       "This option will be deprecated once we do a successful release with the "
       "new minifier.", true);
+  AddBaseProperty(
+      false, &RewriteOptions::rename_javascript_locals_, "rjl",
+      kRenameJavascriptLocals,
+      kDirectoryScope,
+      "If set to true, the JS minifier also renames function parameters and "
+      "local variables to shorter names where it is safe to do so.  This "
+      "breaks code that inspects its own source, such as AngularJS inferring "
+      "dependencies from parameter names.  Requires "
+      "UseExperimentalJsMinifier.", true);
   AddBaseProperty(
       kDefaultMaxCombinedCssBytes,
       &RewriteOptions::max_combined_css_bytes_, "xcc",
@@ -2438,6 +2742,15 @@ void RewriteOptions::InitializeOptions(const Properties* properties) {
 RewriteOptions::OptionBase::~OptionBase() {
 }
 
+const GoogleString& RewriteOptions::OptionBase::SignatureTerm(
+    const Hasher* hasher) const {
+  if (!signature_term_valid_) {
+    signature_term_ = StrCat(id(), ":", Signature(hasher), "_");
+    signature_term_valid_ = true;
+  }
+  return signature_term_;
+}
+
 RewriteOptions::Properties::Properties()
     : initialization_count_(1),
       owns_properties_(true) {
@@ -2582,16 +2895,40 @@ void RewriteOptions::InitOptionNameToPropertyArray() {
   // This method is called first by Initialize, when base properties are
   // added, then zero or more times when subclass properties are added by
   // MergeSubclassProperties (e.g. by ApacheConfig::AddProperties).
-  delete option_name_to_property_map_;
-  option_name_to_property_map_ = new PropertyNameMap;
+  delete option_name_table_;
+  option_name_table_ = new OptionNameTable;
+  StringPiece previous_name;
   for (int i = 0, n = all_properties_->size(); i < n; ++i) {
     PropertyBase* prop = all_properties_->property(i);
     StringPiece name(prop->option_name());
     if (!name.empty()) {
-      option_name_to_property_map_->insert(PropertyNameMap::value_type(name,
-                                                                       prop));
+      // all_properties_ is sorted by name, so a repeat would be adjacent.
+      DCHECK(previous_name.empty() ||
+             StringCaseCompare(previous_name, name) < 0)
+          << "Duplicate option name " << name;
+      previous_name = name;
+      option_name_table_->Add(name, prop);
+    }
+  }
+  // Deprecated names resolve directly to their replacements' properties.
+  for (int i = 0, n = arraysize(kDeprecatedOptionNameData); i < n; ++i) {
+    StringPiece deprecated_name(
+        kDeprecatedOptionNameData[i].deprecated_option_name);
+    StringPiece new_name(kDeprecatedOptionNameData[i].new_option_name);
+    PropertyBase* new_prop = NULL;
+    for (int j = 0, m = all_properties_->size(); j < m; ++j) {
+      PropertyBase* prop = all_properties_->property(j);
+      DCHECK(!StringCaseEqual(prop->option_name(), deprecated_name))
+          << "Deprecated option name " << deprecated_name << " is in use";
+      if (StringCaseEqual(prop->option_name(), new_name)) {
+        new_prop = prop;
+      }
+    }
+    if (new_prop != NULL) {
+      option_name_table_->Add(deprecated_name, new_prop);
     }
   }
+  option_name_table_->Build();
 }
 
 bool RewriteOptions::Terminate() {
@@ -2599,10 +2936,9 @@ bool RewriteOptions::Terminate() {
     DCHECK(option_id_to_property_array_ != NULL);
     delete [] option_id_to_property_array_;
     option_id_to_property_array_ = NULL;
-    DCHECK(option_name_to_property_map_ != NULL);
-    option_name_to_property_map_->clear();
-    delete option_name_to_property_map_;
-    option_name_to_property_map_ = NULL;
+    DCHECK(option_name_table_ != NULL);
+    delete option_name_table_;
+    option_name_table_ = NULL;
     Properties::Terminate(&all_properties_);
     return true;
   }
@@ -3072,11 +3408,7 @@ const RewriteOptions::PropertyBase* RewriteOptions::LookupOptionByName(
   if (option_name.empty()) {
     return NULL;
   }
-  PropertyNameMap::iterator
-      end = option_name_to_property_map_->end(),
-      pos = option_name_to_property_map_->find(
-          GetEffectiveOptionName(option_name));
-  return (pos == end ? NULL : pos->second);
+  return option_name_table_->Lookup(option_name);
 }
 
 const StringPiece RewriteOptions::LookupOptionNameById(StringPiece option_id) {
@@ -3340,66 +3672,48 @@ RewriteOptions::OptionSettingResult RewriteOptions::ParseAndSetOptionFromName3(
   return result;
 }
 
-StringPiece RewriteOptions::GetEffectiveOptionName(StringPiece name) {
-  StringPiece effective_name = name;
-  std::vector<DeprecatedOptionMap>::iterator id =
-       std::lower_bound(kDeprecatedOptionNameList.begin(),
-                        kDeprecatedOptionNameList.end(),
-                        name,
-                        DeprecatedOptionMap::LessThan);
-  if (id != kDeprecatedOptionNameList.end() &&
-      StringCaseEqual(name, id->deprecated_option_name)) {
-    effective_name = id->new_option_name;
+RewriteOptions::OptionBase* RewriteOptions::OptionForName(
+    StringPiece name) const {
+  const PropertyBase* property = LookupOptionByName(name);
+  if (property == NULL) {
+    return NULL;
   }
-  return effective_name;
+  DCHECK_LT(property->index(), static_cast<int>(all_options_.size()));
+  return all_options_[property->index()];
 }
 
 RewriteOptions::OptionSettingResult
 RewriteOptions::SetOptionFromNameInternal(
     StringPiece name, StringPiece value, RewriteOptions::OptionScope max_scope,
     GoogleString* error_detail) {
-  if (!IsValidOptionName(name)) {
+  // Deprecated names resolve to their replacements' options.
+  OptionBase* option = OptionForName(name);
+  if (option == NULL) {
     return kOptionNameUnknown;
+  } else if (option->scope() > max_scope) {
+    StrAppend(error_detail, "Option ", name,
+              " cannot be set. Maximum allowed scope is ",
+              ScopeEnumToString(max_scope));
+    return kOptionNameUnknown;
+  } else if (!option->SetFromString(value, error_detail)) {
+    return kOptionValueInvalid;
   }
-  StringPiece effective_name = GetEffectiveOptionName(name);
-  OptionBaseVector::iterator it =
-      std::lower_bound(all_options_.begin(), all_options_.end(), effective_name,
-                       RewriteOptions::OptionNameLessThanArg);
-  if (it != all_options_.end()) {
-    OptionBase* option = *it;
-    if (StringCaseEqual(effective_name, option->option_name())) {
-      if (option->scope() > max_scope) {
-        StrAppend(error_detail, "Option ", name,
-                  " cannot be set. Maximum allowed scope is ",
-                  ScopeEnumToString(max_scope));
-        return kOptionNameUnknown;
-      } else if (!option->SetFromString(value, error_detail)) {
-        return kOptionValueInvalid;
-      } else {
-        return kOptionOk;
-      }
-    }
-  }
-  return kOptionNameUnknown;
+  return kOptionOk;
 }
 
 bool RewriteOptions::OptionValue(StringPiece name,
                                  const char** id,
                                  bool* was_set,
                                  GoogleString* value) const {
-  OptionBaseVector::const_iterator it = std::lower_bound(
-      all_options_.begin(), all_options_.end(), name,
-      RewriteOptions::OptionNameLessThanArg);
-  if (it != all_options_.end()) {
-    OptionBase* option = *it;
-    if (StringCaseEqual(name, option->option_name())) {
-      *value = option->ToString();
-      *id = option->id();
-      *was_set = option->was_set();
-      return true;
-    }
+  // Unlike setting, this only answers to an option's current name.
+  OptionBase* option = OptionForName(name);
+  if (option == NULL || !StringCaseEqual(name, option->option_name())) {
+    return false;
   }
-  return false;
+  *value = option->ToString();
+  *id = option->id();
+  *was_set = option->was_set();
+  return true;
 }
 
 bool RewriteOptions::SetOptionFromNameAndLog(StringPiece name,
@@ -3602,7 +3916,7 @@ void RewriteOptions::DisableFiltersRequiringScriptExecution() {
 }
 
 bool RewriteOptions::UsePerOriginPropertyCachePage() const {
-  return Enabled(kMobilize);
+  return Enabled(kMobilize) || adaptive_rewrite_deadline();
 }
 
 DomainLawyer* RewriteOptions::WriteableDomainLawyer() {
@@ -3910,11 +4224,12 @@ void RewriteOptions::ComputeSignatureLockHeld() {
   signature_ += "O";
   for (int i = 0, n = all_options_.size(); i < n; ++i) {
     // Keep the signature relatively short by only including options
-    // with values overridden from the default.
+    // with values overridden from the default.  Each option's piece is
+    // memoized, so after a Clone and Merge only the options the merge
+    // changed are rendered again; the appends themselves remain.
     OptionBase* option = all_options_[i];
     if (option->is_used_for_signature_computation() && option->was_set()) {
-      StrAppend(&signature_, option->id(), ":",
-                option->Signature(hasher()), "_");
+      signature_ += option->SignatureTerm(hasher());
     }
   }
   if (javascript_library_identification() != NULL) {
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the per-request cost of RewriteOptions handling: a request with
+// query-param or header overrides clones the configured options, merges the
+// overrides in, and computes the signature of the result.
+
+#include "net/instaweb/rewriter/public/rewrite_options.h"
+
+#include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/null_thread_system.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+
+using net_instaweb::NullThreadSystem;
+using net_instaweb::RewriteOptions;
+
+// Options set in a typical vhost configuration.
+static void Configure(RewriteOptions* options) {
+  options->SetRewriteLevel(RewriteOptions::kCoreFilters);
+  options->EnableFilter(RewriteOptions::kPrioritizeCriticalCss);
+  options->EnableFilter(RewriteOptions::kLazyloadImages);
+  options->set_css_inline_max_bytes(4096);
+  options->set_js_inline_max_bytes(4096);
+  options->set_image_inline_max_bytes(8192);
+  options->set_image_jpeg_recompress_quality(75);
+  options->set_image_webp_recompress_quality(70);
+  options->set_beacon_url("/my_beacon");
+  options->set_lazyload_images_blank_url("/blank.gif");
+  options->set_x_header_value("custom-header");
+  options->Disallow("*/admin/*");
+  options->Disallow("*.svg");
+}
+
+static void BM_CloneMergeComputeSignature(int iters) {
+  RewriteOptions::Initialize();
+  NullThreadSystem thread_system;
+  RewriteOptions global_options(&thread_system);
+  Configure(&global_options);
+  global_options.ComputeSignature();
+
+  RewriteOptions query_options(&thread_system);
+  query_options.set_css_inline_max_bytes(1024);
+  query_options.DisableFilter(RewriteOptions::kLazyloadImages);
+
+  for (int i = 0; i < iters; ++i) {
+    scoped_ptr<RewriteOptions> options(global_options.Clone());
+    options->Merge(query_options);
+    options->ComputeSignature();
+  }
+  RewriteOptions::Terminate();
+}
+BENCHMARK(BM_CloneMergeComputeSignature);
+
+static void BM_LookupOptionByName(int iters) {
+  RewriteOptions::Initialize();
+  const char* kNames[] = {
+    "CssInlineMaxBytes", "ImageRecompressionQuality", "jsinlinemaxbytes",
+    "NotAnOption", "ImageWebpRecompressionQuality", "BeaconUrl",
+  };
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = arraysize(kNames); j < n; ++j) {
+      RewriteOptions::LookupOptionByName(kNames[j]);
+    }
+  }
+  RewriteOptions::Terminate();
+}
+BENCHMARK(BM_LookupOptionByName);
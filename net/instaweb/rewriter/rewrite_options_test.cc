@@ -857,6 +857,8 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
   const char* const option_names[] = {
     RewriteOptions::kAcceptInvalidSignatures,
     RewriteOptions::kAccessControlAllowOrigins,
+    RewriteOptions::kAdaptiveRewriteDeadline,
+    RewriteOptions::kAdaptiveRewriteDeadlineTargetPercent,
     RewriteOptions::kAddOptionsToUrls,
     RewriteOptions::kAllowLoggingUrlsInLogRecord,
     RewriteOptions::kAllowOptionsToBeSetByCookies,
@@ -875,10 +877,16 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kCriticalImagesBeaconEnabled,
     RewriteOptions::kCriticalLineConfig,
     RewriteOptions::kCssFlattenMaxBytes,
+    RewriteOptions::kCssFragmentCacheMaxBytes,
     RewriteOptions::kCssImageInlineMaxBytes,
     RewriteOptions::kCssInlineMaxBytes,
     RewriteOptions::kCssOutlineMinBytes,
     RewriteOptions::kCssPreserveURLs,
+    RewriteOptions::kCssStreamingRewrite,
+    RewriteOptions::kCustomRewriteDriverPoolMaxIdleDrivers,
+    RewriteOptions::kCustomRewriteDriverPools,
+    RewriteOptions::kDecodedImageCacheMaxBytes,
+    RewriteOptions::kDecodedImageCacheTtlMs,
     RewriteOptions::kDefaultCacheHtml,
     RewriteOptions::kDisableBackgroundFetchesForBots,
     RewriteOptions::kDisableRewriteOnNoTransform,
@@ -915,6 +923,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kGoogleFontCssInlineMaxBytes,
     RewriteOptions::kHideRefererUsingMeta,
     RewriteOptions::kIdleFlushTimeMs,
+    RewriteOptions::kImageDedupByContentHash,
     RewriteOptions::kImageInlineMaxBytes,
     RewriteOptions::kImageJpegNumProgressiveScans,
     RewriteOptions::kImageJpegNumProgressiveScansForSmallScreens,
@@ -926,7 +935,9 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kImageMaxRewritesAtOnce,
     RewriteOptions::kImagePreserveURLs,
     RewriteOptions::kImageRecompressionQuality,
+    RewriteOptions::kImageRecompressionTargetSsim,
     RewriteOptions::kImageResolutionLimitBytes,
+    RewriteOptions::kImageSpritePacking,
     RewriteOptions::kImageWebpRecompressionQuality,
     RewriteOptions::kImageWebpRecompressionQualityForSmallScreens,
     RewriteOptions::kImageWebpTimeoutMs,
@@ -946,6 +957,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kJsPreserveURLs,
     RewriteOptions::kLazyloadImagesAfterOnload,
     RewriteOptions::kLazyloadImagesBlankUrl,
+    RewriteOptions::kLexHtmlDuringPcacheLookup,
     RewriteOptions::kLoadFromFileCacheTtlMs,
     RewriteOptions::kLogBackgroundRewrite,
     RewriteOptions::kLogMobilizationSamples,
@@ -990,6 +1002,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kObliviousPagespeedUrls,
     RewriteOptions::kOptionCookiesDurationMs,
     RewriteOptions::kOverrideCachingTtlMs,
+    RewriteOptions::kPcacheLookupDeadlineMs,
     RewriteOptions::kPersistBlinkBlacklist,
     RewriteOptions::kPreserveUrlRelativity,
     RewriteOptions::kPrivateNotVaryForIE,
@@ -1001,6 +1014,7 @@ TEST_F(RewriteOptionsTest, LookupOptionByNameTest) {
     RewriteOptions::kRejectBlacklistedStatusCode,
     RewriteOptions::kRemoteConfigurationUrl,
     RewriteOptions::kRemoteConfigurationTimeoutMs,
+    RewriteOptions::kRenameJavascriptLocals,
     RewriteOptions::kReportUnloadTime,
     RewriteOptions::kRequestOptionOverride,
     RewriteOptions::kRespectVary,
@@ -1111,6 +1125,7 @@ TEST_F(RewriteOptionsTest, LookupNonBaseOptionByNameTest) {
   FailLookupOptionByName(RewriteOptions::kLogDir);
   FailLookupOptionByName(RewriteOptions::kLruCacheByteLimit);
   FailLookupOptionByName(RewriteOptions::kLruCacheKbPerProcess);
+  FailLookupOptionByName(RewriteOptions::kLruCacheSnapshotIntervalSec);
   FailLookupOptionByName(RewriteOptions::kMemcachedServers);
   FailLookupOptionByName(RewriteOptions::kMemcachedThreads);
   FailLookupOptionByName(RewriteOptions::kMemcachedTimeoutUs);
@@ -2379,6 +2394,33 @@ TEST_F(RewriteOptionsTest, ComputeSignatureEmptyIdempotent) {
   EXPECT_EQ(signature1, options_.signature());
 }
 
+TEST_F(RewriteOptionsTest, ComputeSignatureAfterCloneAndMerge) {
+  // Per-option signature terms are reused across Clone and Merge; make sure
+  // a merged-in value still shows up in the signature.
+  options_.set_css_image_inline_max_bytes(2048);
+  options_.set_js_inline_max_bytes(100);
+  options_.ComputeSignature();
+
+  RewriteOptions query_options(&thread_system_);
+  query_options.set_css_image_inline_max_bytes(1024);
+  scoped_ptr<RewriteOptions> merged(options_.Clone());
+  merged->Merge(query_options);
+  merged->ComputeSignature();
+  EXPECT_NE(options_.signature(), merged->signature());
+
+  RewriteOptions expected(&thread_system_);
+  expected.set_js_inline_max_bytes(100);
+  expected.set_css_image_inline_max_bytes(1024);
+  expected.ComputeSignature();
+  EXPECT_EQ(expected.signature(), merged->signature());
+
+  // Setting the original value back restores the original signature.
+  merged->ClearSignatureForTesting();
+  merged->set_css_image_inline_max_bytes(2048);
+  merged->ComputeSignature();
+  EXPECT_EQ(options_.signature(), merged->signature());
+}
+
 TEST_F(RewriteOptionsTest, ImageOptimizableCheck) {
   options_.ClearFilters();
   options_.EnableFilter(RewriteOptions::kRecompressJpeg);
@@ -2594,7 +2636,17 @@ TEST_F(RewriteOptionsTest, AccessOptionByIdAndName) {
   EXPECT_STREQ("iq", id);
   EXPECT_STREQ("63", value);
 
+  // Names are matched ignoring case, as with LookupOptionByName.
+  EXPECT_EQ(RewriteOptions::kOptionOk,
+            options_.SetOptionFromName("jpegrecompressionquality", "64"));
+  EXPECT_TRUE(options_.OptionValue("JPEGRECOMPRESSIONQUALITY", &id,
+                                   &was_set, &value));
+  EXPECT_STREQ("64", value);
+
   EXPECT_FALSE(options_.OptionValue(kBogusOptionName, &id, &was_set, &value));
+  // Only setting answers to deprecated names.
+  EXPECT_FALSE(options_.OptionValue("ImageWebpRecompressionQuality", &id,
+                                    &was_set, &value));
 }
 
 TEST_F(RewriteOptionsTest, AccessAcrossThreads) {
@@ -39,6 +39,14 @@ const char kResourceFetchConstructSuccesses[] =
 const char kResourceFetchConstructFailures[] =
     "resource_fetch_construct_failures";
 const char kNumFlushes[] = "num_flushes";
+
+// Drivers with custom options built afresh, taken from a pool, and pools of
+// them evicted to make room for another set of options.
+const char kCustomRewriteDriversConstructed[] =
+    "custom_rewrite_drivers_constructed";
+const char kCustomRewriteDriversRecycled[] = "custom_rewrite_drivers_recycled";
+const char kCustomRewriteDriverPoolsEvicted[] =
+    "custom_rewrite_driver_pools_evicted";
 const char kFallbackResponsesServed[] = "num_fallback_responses_served";
 const char kProactivelyFreshenUserFacingRequest[] =
     "num_proactively_freshen_user_facing_request";
@@ -73,6 +81,10 @@ const char kFetchLatencyHistogram[] = "Pagespeed Resource Latency Histogram";
 const char kRewriteLatencyHistogram[] = "Rewrite Latency Histogram";
 const char kBackendLatencyHistogram[] =
     "Backend Fetch First Byte Latency Histogram";
+const char kFlushWindowDeadlineHistogram[] =
+    "Flush Window Rewrite Deadline (ms)";
+const char kFlushWindowCompletionHistogram[] =
+    "Flush Window Rewrites Completed (%)";
 
 // TimedVariable names.
 const char kTotalFetchCount[] = "total_fetch_count";
@@ -124,10 +136,15 @@ void RewriteStats::InitStats(Statistics* statistics) {
   statistics->AddVariable(kNumCacheControlRewritableResources);
   statistics->AddVariable(kNumCacheControlNotRewritableResources);
   statistics->AddVariable(kNumFlushes);
+  statistics->AddVariable(kCustomRewriteDriversConstructed);
+  statistics->AddVariable(kCustomRewriteDriversRecycled);
+  statistics->AddVariable(kCustomRewriteDriverPoolsEvicted);
   statistics->AddHistogram(kBeaconTimingsMsHistogram);
   statistics->AddHistogram(kFetchLatencyHistogram);
   statistics->AddHistogram(kRewriteLatencyHistogram);
   statistics->AddHistogram(kBackendLatencyHistogram);
+  statistics->AddHistogram(kFlushWindowDeadlineHistogram);
+  statistics->AddHistogram(kFlushWindowCompletionHistogram);
   statistics->AddVariable(kFallbackResponsesServed);
   statistics->AddVariable(kProactivelyFreshenUserFacingRequest);
   statistics->AddVariable(kFallbackResponsesServedWhileRevalidate);
@@ -177,6 +194,12 @@ RewriteStats::RewriteStats(Statistics* stats,
           stats->GetVariable(kNumCacheControlNotRewritableResources)),
       num_flushes_(
           stats->GetVariable(kNumFlushes)),
+      custom_rewrite_drivers_constructed_(
+          stats->GetVariable(kCustomRewriteDriversConstructed)),
+      custom_rewrite_drivers_recycled_(
+          stats->GetVariable(kCustomRewriteDriversRecycled)),
+      custom_rewrite_driver_pools_evicted_(
+          stats->GetVariable(kCustomRewriteDriverPoolsEvicted)),
       page_load_count_(
           stats->GetVariable(kPageLoadCount)),
       resource_404_count_(
@@ -214,6 +237,10 @@ RewriteStats::RewriteStats(Statistics* stats,
           stats->GetHistogram(kRewriteLatencyHistogram)),
       backend_latency_histogram_(
           stats->GetHistogram(kBackendLatencyHistogram)),
+      flush_window_deadline_histogram_(
+          stats->GetHistogram(kFlushWindowDeadlineHistogram)),
+      flush_window_completion_histogram_(
+          stats->GetHistogram(kFlushWindowCompletionHistogram)),
       total_fetch_count_(stats->GetTimedVariable(kTotalFetchCount)),
       total_rewrite_count_(stats->GetTimedVariable(kTotalRewriteCount)),
       num_rewrites_executed_(stats->GetTimedVariable(kRewritesExecuted)),
@@ -227,6 +254,7 @@ RewriteStats::RewriteStats(Statistics* stats,
   fetch_latency_histogram_->EnableNegativeBuckets();
   rewrite_latency_histogram_->EnableNegativeBuckets();
   backend_latency_histogram_->EnableNegativeBuckets();
+  flush_window_completion_histogram_->SetMaxValue(100);
 
   for (int i = 0; i < RewriteDriverFactory::kNumWorkerPools; ++i) {
     thread_queue_depths_.push_back(
@@ -61,9 +61,11 @@
 #include "pagespeed/kernel/base/escaping.h"
 #include "pagespeed/kernel/base/hasher.h"
 #include "pagespeed/kernel/base/md5_hasher.h"
+#include "pagespeed/kernel/base/cost_tracker.h"
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/named_lock_manager.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/stl_util.h"          // for STLDeleteElements
 #include "pagespeed/kernel/base/string.h"
@@ -214,6 +216,16 @@ class BeaconPropertyCallback : public PropertyPage {
   DISALLOW_COPY_AND_ASSIGN(BeaconPropertyCallback);
 };
 
+// kDebug is left out of the options signature, but changes the filter chain,
+// so drivers with and without it are pooled separately.
+GoogleString CustomDriverPoolKey(const RewriteOptions& options) {
+  GoogleString key = options.signature();
+  if (options.Enabled(RewriteOptions::kDebug)) {
+    key += "/debug";
+  }
+  return key;
+}
+
 }  // namespace
 
 const int64 ServerContext::kGeneratedMaxAgeMs = Timer::kYearMs;
@@ -291,6 +303,7 @@ ServerContext::ServerContext(RewriteDriverFactory* factory)
       blink_cohort_(NULL),
       beacon_cohort_(NULL),
       fix_reflow_cohort_(NULL),
+      adaptive_rewrite_deadline_cohort_(NULL),
       available_rewrite_drivers_(new GlobalOptionsRewriteDriverPool(this)),
       trying_to_cleanup_rewrite_drivers_(false),
       shutdown_drivers_called_(false),
@@ -304,8 +317,12 @@ ServerContext::ServerContext(RewriteDriverFactory* factory)
       thread_synchronizer_(new ThreadSynchronizer(thread_system_)),
       experiment_matcher_(factory_->NewExperimentMatcher()),
       usage_data_reporter_(factory_->usage_data_reporter()),
+      span_trace_sink_(NULL),
+      span_trace_sample_percent_(0),
       simple_random_(thread_system_->NewMutex()),
-      js_tokenizer_patterns_(factory_->js_tokenizer_patterns()) {
+      js_tokenizer_patterns_(factory_->js_tokenizer_patterns()),
+      decoded_image_cache_(NULL),
+      css_fragment_cache_(NULL) {
   // Make sure the excluded-attributes are in abc order so binary_search works.
   // Make sure to use the same comparator that we pass to the binary_search.
 #ifndef NDEBUG
@@ -351,6 +368,8 @@ ServerContext::~ServerContext() {
   STLDeleteElements(&active_rewrite_drivers_);
   available_rewrite_drivers_.reset();
   STLDeleteElements(&additional_driver_pools_);
+  STLDeleteElements(&custom_driver_pools_);
+  STLDeleteElements(&retired_custom_driver_pools_);
 }
 
 // TODO(gee): These methods are out of order with respect to the .h #tech-debt
@@ -727,6 +746,30 @@ bool ServerContext::HandleBeacon(StringPiece params,
 
 RewriteDriver* ServerContext::NewCustomRewriteDriver(
     RewriteOptions* options, const RequestContextPtr& request_ctx) {
+  ComputeSignature(options);
+  RewriteDriverPool* pool;
+  {
+    ScopedMutex lock(rewrite_drivers_mutex_.get());
+    pool = CustomRewriteDriverPool(*options);
+    if (pool != NULL) {
+      // Count the driver against the pool now, so the pool can't be deleted
+      // before we have taken a driver from it.
+      pool->DriverActivated();
+    }
+  }
+  if (pool != NULL) {
+    bool recycled;
+    RewriteDriver* rewrite_driver = NewRewriteDriverFromPoolImpl(
+        pool, options, true /* pool_pinned */, request_ctx, &recycled);
+    if (recycled) {
+      rewrite_stats_->custom_rewrite_drivers_recycled()->Add(1);
+    } else {
+      rewrite_stats_->custom_rewrite_drivers_constructed()->Add(1);
+    }
+    return rewrite_driver;
+  }
+
+  rewrite_stats_->custom_rewrite_drivers_constructed()->Add(1);
   RewriteDriver* rewrite_driver = NewUnmanagedRewriteDriver(
       NULL /* no pool as custom*/,
       options,
@@ -773,6 +816,14 @@ RewriteDriver* ServerContext::NewRewriteDriver(
 
 RewriteDriver* ServerContext::NewRewriteDriverFromPool(
     RewriteDriverPool* pool, const RequestContextPtr& request_ctx) {
+  bool recycled;
+  return NewRewriteDriverFromPoolImpl(pool, NULL, false /* pool_pinned */,
+                                      request_ctx, &recycled);
+}
+
+RewriteDriver* ServerContext::NewRewriteDriverFromPoolImpl(
+    RewriteDriverPool* pool, RewriteOptions* options_for_new_driver,
+    bool pool_pinned, const RequestContextPtr& request_ctx, bool* recycled) {
   RewriteDriver* rewrite_driver = NULL;
 
   const RewriteOptions* options = pool->TargetOptions();
@@ -797,11 +848,18 @@ RewriteDriver* ServerContext::NewRewriteDriverFromPool(
         rewrite_driver = NULL;
       }
     }
+    if (!pool_pinned) {
+      pool->DriverActivated();
+    }
   }
 
+  *recycled = (rewrite_driver != NULL);
   if (rewrite_driver == NULL) {
     rewrite_driver = NewUnmanagedRewriteDriver(
-        pool, options->Clone(), request_ctx);
+        pool,
+        (options_for_new_driver != NULL) ? options_for_new_driver
+                                         : options->Clone(),
+        request_ctx);
     if (factory_ != NULL) {
       factory_->ApplyPlatformSpecificConfiguration(rewrite_driver);
     }
@@ -810,6 +868,7 @@ RewriteDriver* ServerContext::NewRewriteDriverFromPool(
       factory_->AddPlatformSpecificRewritePasses(rewrite_driver);
     }
   } else {
+    delete options_for_new_driver;
     rewrite_driver->AddUserReference();
     rewrite_driver->set_request_context(request_ctx);
     ApplySessionFetchers(request_ctx, rewrite_driver);
@@ -822,6 +881,65 @@ RewriteDriver* ServerContext::NewRewriteDriverFromPool(
   return rewrite_driver;
 }
 
+RewriteDriverPool* ServerContext::CustomRewriteDriverPool(
+    const RewriteOptions& options) {
+  int max_pools = global_options()->custom_rewrite_driver_pools();
+  if (max_pools <= 0) {
+    return NULL;
+  }
+
+  GoogleString key = CustomDriverPoolKey(options);
+  CustomDriverPoolMap::iterator p = custom_driver_pool_map_.find(key);
+  if (p != custom_driver_pool_map_.end()) {
+    CustomDriverPoolList::iterator pos = p->second;
+    CustomOptionsRewriteDriverPool* pool = *pos;
+    if (pool->TargetOptions()->IsEqual(options)) {
+      custom_driver_pools_.splice(custom_driver_pools_.begin(),
+                                  custom_driver_pools_, pos);
+      return pool;
+    }
+    // The options match in signature but not in full, as happens when the
+    // cache is purged, so the pool is stale: replace it.
+    custom_driver_pools_.erase(pos);
+    custom_driver_pool_map_.erase(p);
+    RetireCustomDriverPool(pool);
+  }
+
+  if (static_cast<int>(custom_driver_pools_.size()) >= max_pools) {
+    CustomOptionsRewriteDriverPool* victim = custom_driver_pools_.back();
+    custom_driver_pools_.pop_back();
+    custom_driver_pool_map_.erase(
+        CustomDriverPoolKey(*victim->TargetOptions()));
+    RetireCustomDriverPool(victim);
+    rewrite_stats_->custom_rewrite_driver_pools_evicted()->Add(1);
+  }
+
+  RewriteOptions* target_options = options.Clone();
+  ComputeSignature(target_options);
+  CustomOptionsRewriteDriverPool* pool =
+      new CustomOptionsRewriteDriverPool(target_options);
+  pool->set_max_idle_drivers(
+      global_options()->custom_rewrite_driver_pool_max_idle_drivers());
+  custom_driver_pools_.push_front(pool);
+  custom_driver_pool_map_[key] = custom_driver_pools_.begin();
+  return pool;
+}
+
+void ServerContext::RetireCustomDriverPool(
+    CustomOptionsRewriteDriverPool* pool) {
+  if (pool->num_active_drivers() == 0) {
+    delete pool;
+  } else {
+    // Drop the idle drivers now; those released later are deleted, not kept.
+    RewriteDriver* idle_driver;
+    while ((idle_driver = pool->PopDriver()) != NULL) {
+      delete idle_driver;
+    }
+    pool->set_max_idle_drivers(0);
+    retired_custom_driver_pools_.insert(pool);
+  }
+}
+
 void ServerContext::ReleaseRewriteDriver(RewriteDriver* rewrite_driver) {
   ScopedMutex lock(rewrite_drivers_mutex_.get());
   ReleaseRewriteDriverImpl(rewrite_driver);
@@ -842,6 +960,10 @@ void ServerContext::ReleaseRewriteDriverImpl(RewriteDriver* rewrite_driver) {
       delete rewrite_driver;
     } else {
       pool->RecycleDriver(rewrite_driver);
+      if ((pool->num_active_drivers() == 0) &&
+          (retired_custom_driver_pools_.erase(pool) == 1)) {
+        delete pool;
+      }
     }
   }
 }
@@ -1119,6 +1241,27 @@ void ServerContext::ApplySessionFetchers(const RequestContextPtr& req,
                                          RewriteDriver* driver) {
 }
 
+void ServerContext::MaybeStartSpanTrace(
+    const RequestContextPtr& request_context, StringPiece url) {
+  if (span_trace_sink_ == NULL || span_trace_sample_percent_ <= 0 ||
+      request_context->span_trace() != NULL) {
+    return;
+  }
+  // Trace request n whenever n * percent / 100 ticks over, which spreads
+  // the sampled requests evenly rather than tracing them in bursts.
+  int64 n = span_trace_request_count_.NoBarrierIncrement(1);
+  int64 percent = span_trace_sample_percent_;
+  if ((n * percent) / 100 != ((n - 1) * percent) / 100) {
+    request_context->set_span_trace(new SpanTrace(
+        url, timer(), thread_system_, span_trace_sink_));
+  }
+}
+
+void ServerContext::EnableCostTracking() {
+  html_filter_costs_.reset(new CostTracker(timer(), thread_system_));
+  rewrite_costs_.reset(new CostTracker(timer(), thread_system_));
+}
+
 RequestProperties* ServerContext::NewRequestProperties() {
   RequestProperties* request_properties =
       new RequestProperties(user_agent_matcher());
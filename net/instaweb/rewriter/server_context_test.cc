@@ -45,6 +45,7 @@
 #include "net/instaweb/rewriter/public/rewrite_filter.h"
 #include "net/instaweb/rewriter/public/rewrite_options.h"
 #include "net/instaweb/rewriter/public/rewrite_query.h"
+#include "net/instaweb/rewriter/public/rewrite_stats.h"
 #include "net/instaweb/rewriter/public/rewrite_test_base.h"
 #include "net/instaweb/rewriter/public/test_rewrite_driver_factory.h"
 #include "net/instaweb/rewriter/rendered_image.pb.h"
@@ -761,6 +762,168 @@ TEST_F(ServerContextTest, TestPlatformSpecificConfiguration) {
   custom_driver->Cleanup();
 }
 
+// Custom drivers with equal options are recycled through a pool keyed by
+// the options signature.
+TEST_F(ServerContextTest, CustomRewriteDriversRecycled) {
+  RewriteStats* stats = server_context()->rewrite_stats();
+  Variable* constructed = stats->custom_rewrite_drivers_constructed();
+  Variable* recycled = stats->custom_rewrite_drivers_recycled();
+  int64 constructed_before = constructed->Get();
+  int64 recycled_before = recycled->Get();
+  RewriteOptions* options = new RewriteOptions(factory()->thread_system());
+  options->EnableFilter(RewriteOptions::kCombineCss);
+  RewriteOptions* same_options = options->Clone();
+  RewriteOptions* other_options = options->Clone();
+  other_options->EnableFilter(RewriteOptions::kCombineJavascript);
+
+  RewriteDriver* driver = server_context()->NewCustomRewriteDriver(
+      options, CreateRequestContext());
+  EXPECT_EQ(options, driver->options());
+  driver->Cleanup();
+  EXPECT_EQ(constructed_before + 1, constructed->Get());
+  EXPECT_EQ(recycled_before, recycled->Get());
+
+  RewriteDriver* recycled_driver = server_context()->NewCustomRewriteDriver(
+      same_options, CreateRequestContext());
+  EXPECT_EQ(driver, recycled_driver);
+  EXPECT_TRUE(
+      recycled_driver->options()->Enabled(RewriteOptions::kCombineCss));
+  EXPECT_EQ(constructed_before + 1, constructed->Get());
+  EXPECT_EQ(recycled_before + 1, recycled->Get());
+
+  // While that driver is in use, a request with different options gets a
+  // new one.
+  RewriteDriver* other_driver = server_context()->NewCustomRewriteDriver(
+      other_options, CreateRequestContext());
+  EXPECT_NE(driver, other_driver);
+  EXPECT_TRUE(
+      other_driver->options()->Enabled(RewriteOptions::kCombineJavascript));
+  EXPECT_EQ(constructed_before + 2, constructed->Get());
+  other_driver->Cleanup();
+  recycled_driver->Cleanup();
+}
+
+// When there are more distinct custom options than pools, the least recently
+// used pool is evicted.
+TEST_F(ServerContextTest, CustomRewriteDriverPoolsEvictLeastRecentlyUsed) {
+  server_context()->global_options()->ClearSignatureForTesting();
+  server_context()->global_options()->set_custom_rewrite_driver_pools(2);
+  server_context()->ComputeSignature(server_context()->global_options());
+  RewriteStats* stats = server_context()->rewrite_stats();
+  Variable* recycled = stats->custom_rewrite_drivers_recycled();
+  Variable* evicted = stats->custom_rewrite_driver_pools_evicted();
+  int64 recycled_before = recycled->Get();
+  int64 evicted_before = evicted->Get();
+  RewriteOptions* css_options = new RewriteOptions(factory()->thread_system());
+  css_options->EnableFilter(RewriteOptions::kCombineCss);
+  RewriteOptions* js_options = new RewriteOptions(factory()->thread_system());
+  js_options->EnableFilter(RewriteOptions::kCombineJavascript);
+  RewriteOptions* image_options =
+      new RewriteOptions(factory()->thread_system());
+  image_options->EnableFilter(RewriteOptions::kRecompressJpeg);
+  RewriteOptions* css_options2 = css_options->Clone();
+  RewriteOptions* css_options3 = css_options->Clone();
+  RewriteOptions* js_options2 = js_options->Clone();
+
+  RewriteDriver* css_driver = server_context()->NewCustomRewriteDriver(
+      css_options, CreateRequestContext());
+  css_driver->Cleanup();
+  RewriteDriver* js_driver = server_context()->NewCustomRewriteDriver(
+      js_options, CreateRequestContext());
+  js_driver->Cleanup();
+
+  // Using the css pool again makes the js pool the least recently used, so
+  // that is the one a third set of options evicts.
+  RewriteDriver* driver = server_context()->NewCustomRewriteDriver(
+      css_options2, CreateRequestContext());
+  EXPECT_EQ(css_driver, driver);
+  driver->Cleanup();
+  driver = server_context()->NewCustomRewriteDriver(
+      image_options, CreateRequestContext());
+  driver->Cleanup();
+  EXPECT_EQ(evicted_before + 1, evicted->Get());
+  EXPECT_EQ(recycled_before + 1, recycled->Get());
+
+  driver = server_context()->NewCustomRewriteDriver(
+      css_options3, CreateRequestContext());
+  EXPECT_EQ(css_driver, driver);
+  driver->Cleanup();
+  driver = server_context()->NewCustomRewriteDriver(
+      js_options2, CreateRequestContext());
+  driver->Cleanup();
+  EXPECT_EQ(evicted_before + 2, evicted->Get());
+  EXPECT_EQ(recycled_before + 2, recycled->Get());
+}
+
+// A pool keeps at most custom_rewrite_driver_pool_max_idle_drivers drivers
+// once they are released.
+TEST_F(ServerContextTest, CustomRewriteDriverPoolMaxIdleDrivers) {
+  server_context()->global_options()->ClearSignatureForTesting();
+  server_context()->global_options()
+      ->set_custom_rewrite_driver_pool_max_idle_drivers(1);
+  server_context()->ComputeSignature(server_context()->global_options());
+  RewriteStats* stats = server_context()->rewrite_stats();
+  Variable* constructed = stats->custom_rewrite_drivers_constructed();
+  Variable* recycled = stats->custom_rewrite_drivers_recycled();
+  int64 constructed_before = constructed->Get();
+  int64 recycled_before = recycled->Get();
+  RewriteOptions* options1 = new RewriteOptions(factory()->thread_system());
+  options1->EnableFilter(RewriteOptions::kCombineCss);
+  RewriteOptions* options2 = options1->Clone();
+  RewriteOptions* options3 = options1->Clone();
+  RewriteOptions* options4 = options1->Clone();
+
+  RewriteDriver* driver1 = server_context()->NewCustomRewriteDriver(
+      options1, CreateRequestContext());
+  RewriteDriver* driver2 = server_context()->NewCustomRewriteDriver(
+      options2, CreateRequestContext());
+  EXPECT_NE(driver1, driver2);
+  driver1->Cleanup();
+  driver2->Cleanup();  // Deleted: driver1 already fills the idle list.
+  EXPECT_EQ(constructed_before + 2, constructed->Get());
+
+  driver1 = server_context()->NewCustomRewriteDriver(
+      options3, CreateRequestContext());
+  driver2 = server_context()->NewCustomRewriteDriver(
+      options4, CreateRequestContext());
+  EXPECT_EQ(recycled_before + 1, recycled->Get());
+  EXPECT_EQ(constructed_before + 3, constructed->Get());
+  driver1->Cleanup();
+  driver2->Cleanup();
+}
+
+// A pool whose options have gone stale, as after a cache purge, is replaced
+// even while one of its drivers is still in use, and deleted once that
+// driver is released.
+TEST_F(ServerContextTest, CustomRewriteDriverPoolReplacedWhenStale) {
+  RewriteStats* stats = server_context()->rewrite_stats();
+  Variable* constructed = stats->custom_rewrite_drivers_constructed();
+  Variable* recycled = stats->custom_rewrite_drivers_recycled();
+  int64 constructed_before = constructed->Get();
+  int64 recycled_before = recycled->Get();
+  RewriteOptions* options = new RewriteOptions(factory()->thread_system());
+  options->EnableFilter(RewriteOptions::kCombineCss);
+  RewriteOptions* purged_options = options->Clone();
+  purged_options->PurgeUrl("http://example.com/a.css", timer()->NowMs());
+  RewriteOptions* purged_options2 = purged_options->Clone();
+
+  RewriteDriver* driver = server_context()->NewCustomRewriteDriver(
+      options, CreateRequestContext());
+  RewriteDriver* purged_driver = server_context()->NewCustomRewriteDriver(
+      purged_options, CreateRequestContext());
+  EXPECT_NE(driver, purged_driver);
+  EXPECT_EQ(constructed_before + 2, constructed->Get());
+  purged_driver->Cleanup();
+  driver->Cleanup();
+
+  // The purged options got a pool of their own, which kept their driver.
+  RewriteDriver* recycled_driver = server_context()->NewCustomRewriteDriver(
+      purged_options2, CreateRequestContext());
+  EXPECT_EQ(purged_driver, recycled_driver);
+  EXPECT_EQ(recycled_before + 1, recycled->Get());
+  recycled_driver->Cleanup();
+}
+
 // Tests that platform-specific rewriters are used for decoding fetches.
 TEST_F(ServerContextTest, TestPlatformSpecificRewritersDecoding) {
   GoogleString url = Encode("http://example.com/dir/123/",
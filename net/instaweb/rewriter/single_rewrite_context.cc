@@ -19,15 +19,87 @@
 #include "net/instaweb/rewriter/public/single_rewrite_context.h"
 
 #include "base/logging.h"
+#include "net/instaweb/http/public/http_value.h"
 #include "net/instaweb/rewriter/cached_result.pb.h"
 #include "net/instaweb/rewriter/public/output_resource.h"
 #include "net/instaweb/rewriter/public/resource.h"
 #include "net/instaweb/rewriter/public/resource_slot.h"
 #include "net/instaweb/rewriter/public/rewrite_driver.h"
+#include "net/instaweb/rewriter/public/rewrite_options.h"
+#include "pagespeed/kernel/base/cache_interface.h"
+#include "pagespeed/kernel/base/function.h"
+#include "pagespeed/kernel/base/hasher.h"
+#include "pagespeed/kernel/base/proto_util.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/shared_string.h"
+#include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/http/content_type.h"
+#include "pagespeed/kernel/http/http_names.h"
+#include "pagespeed/kernel/http/response_headers.h"
+#include "pagespeed/kernel/util/url_segment_encoder.h"
 
 namespace net_instaweb {
 
+// Parses the result of a content-hash lookup in the cache thread, and hands
+// it to the context in the low-priority rewrite thread, where RewriteSingle
+// would otherwise have run.
+class SingleRewriteContext::DedupLookupCallback
+    : public CacheInterface::Callback {
+ public:
+  explicit DedupLookupCallback(SingleRewriteContext* context)
+      : context_(context) {}
+  virtual ~DedupLookupCallback() {}
+
+  virtual void Done(CacheInterface::KeyState state) {
+    DedupedRewrite* deduped = NULL;
+    if (state == CacheInterface::kAvailable) {
+      deduped = new DedupedRewrite;
+      StringPiece val_str = value()->Value();
+      ArrayInputStream input(val_str.data(), val_str.size());
+      if (!deduped->ParseFromZeroCopyStream(&input)) {
+        delete deduped;
+        deduped = NULL;
+      }
+    }
+    context_->Driver()->AddLowPriorityRewriteTask(MakeFunction(
+        context_, &SingleRewriteContext::DedupLookupDone,
+        &SingleRewriteContext::DedupLookupCancelled, deduped));
+    delete this;
+  }
+
+ private:
+  SingleRewriteContext* context_;
+
+  DISALLOW_COPY_AND_ASSIGN(DedupLookupCallback);
+};
+
+// Hands the shared output's bytes, as found in the HTTP cache, to the
+// context in the low-priority rewrite thread.  The receiver deletes the
+// callback, which holds the bytes.
+class SingleRewriteContext::DedupContentsCallback
+    : public OptionsAwareHTTPCacheCallback {
+ public:
+  explicit DedupContentsCallback(SingleRewriteContext* context)
+      : OptionsAwareHTTPCacheCallback(context->Options(),
+                                      context->Driver()->request_context()),
+        context_(context) {}
+  virtual ~DedupContentsCallback() {}
+
+  virtual void Done(HTTPCache::FindResult find_result) {
+    context_->Driver()->AddLowPriorityRewriteTask(MakeFunction(
+        context_, &SingleRewriteContext::DedupContentsDone,
+        &SingleRewriteContext::DedupContentsCancelled, find_result,
+        static_cast<HTTPCache::Callback*>(this)));
+  }
+
+ private:
+  SingleRewriteContext* context_;
+
+  DISALLOW_COPY_AND_ASSIGN(DedupContentsCallback);
+};
+
 SingleRewriteContext::SingleRewriteContext(RewriteDriver* driver,
                                            RewriteContext* parent,
                                            ResourceContext* resource_context)
@@ -77,7 +149,141 @@ void SingleRewriteContext::Rewrite(int partition_index,
   if (output_resource.get() != NULL) {
     DCHECK_EQ(output_resource->cached_result(), partition);
   }
-  RewriteSingle(resource, output_resource);
+  if (DedupByInputContents() && !rewrite_uncacheable() &&
+      output_resource.get() != NULL) {
+    dedup_key_ = DedupKey(resource);
+    dedup_output_ = output_resource;
+    FindServerContext()->metadata_cache()->Get(
+        dedup_key_, new DedupLookupCallback(this));
+  } else {
+    RewriteSingle(resource, output_resource);
+  }
+}
+
+GoogleString SingleRewriteContext::DedupKey(const ResourcePtr& input) const {
+  // This mirrors RewriteContext::SetPartitionKey for a single slot, with the
+  // hash of the input contents in place of its URL.
+  const Hasher* hasher = FindServerContext()->lock_hasher();
+  GoogleString encoding;
+  encoder()->Encode(StringVector(1, ""), resource_context(), &encoding);
+  GoogleString suffix = StrCat(encoding, "@",
+                               UserAgentCacheKey(resource_context()), "_",
+                               CacheKeySuffix());
+  return StrCat(ServerContext::kCacheKeyResourceNamePrefix, id(), "_",
+                hasher->Hash(Options()->signature()), "/content/",
+                input->ContentsHash(), "@", suffix);
+}
+
+void SingleRewriteContext::DedupLookupDone(DedupedRewrite* deduped) {
+  if (deduped != NULL && !deduped->output_cache_key().empty()) {
+    dedup_hit_.reset(deduped);
+    ServerContext* server_context = FindServerContext();
+    server_context->http_cache()->Find(
+        deduped->output_cache_key(), Driver()->CacheFragment(),
+        server_context->message_handler(), new DedupContentsCallback(this));
+  } else {
+    delete deduped;
+    Driver()->statistics()->GetVariable(kNumDedupedRewriteMisses)->Add(1);
+    OutputResourcePtr output_resource(dedup_output_);
+    RewriteSingle(slot(0)->resource(), output_resource);
+  }
+}
+
+void SingleRewriteContext::DedupLookupCancelled(DedupedRewrite* deduped) {
+  delete deduped;
+  dedup_key_.clear();
+  dedup_output_.clear();
+  RewriteDone(kTooBusy, 0);
+}
+
+void SingleRewriteContext::DedupContentsDone(
+    HTTPCache::FindResult find_result, HTTPCache::Callback* data) {
+  scoped_ptr<HTTPCache::Callback> data_deleter(data);
+  scoped_ptr<DedupedRewrite> deduped(dedup_hit_.release());
+  Statistics* stats = Driver()->statistics();
+  StringPiece contents;
+  if (find_result == HTTPCache::kFound &&
+      data->response_headers()->status_code() == HttpStatus::kOK &&
+      data->http_value()->ExtractContents(&contents) &&
+      ApplyDedupedRewrite(*deduped, contents)) {
+    stats->GetVariable(kNumDedupedRewriteHits)->Add(1);
+    // Nothing new to share once the rewrite completes.
+    dedup_key_.clear();
+    dedup_output_.clear();
+    RewriteDone(kRewriteOk, 0);
+  } else {
+    // The shared output has left the HTTP cache; rewrite, and share anew.
+    stats->GetVariable(kNumDedupedRewriteMisses)->Add(1);
+    OutputResourcePtr output_resource(dedup_output_);
+    RewriteSingle(slot(0)->resource(), output_resource);
+  }
+}
+
+void SingleRewriteContext::DedupContentsCancelled(
+    HTTPCache::FindResult find_result, HTTPCache::Callback* data) {
+  delete data;
+  dedup_hit_.reset();
+  dedup_key_.clear();
+  dedup_output_.clear();
+  RewriteDone(kTooBusy, 0);
+}
+
+bool SingleRewriteContext::ApplyDedupedRewrite(
+    const DedupedRewrite& deduped, StringPiece contents) {
+  const ContentType* type = MimeTypeToContentType(deduped.mime_type());
+  if (type == NULL) {
+    return false;
+  }
+  OutputResource* output = dedup_output_.get();
+  CachedResult* partition = output_partition(0);
+  CachedResult shared(deduped.result());
+  shared.mutable_input()->Swap(partition->mutable_input());
+  partition->Swap(&shared);
+  FindServerContext()->MergeNonCachingResponseHeaders(slot(0)->resource(),
+                                                      dedup_output_);
+  if (!deduped.cache_control_suffix().empty()) {
+    output->set_cache_control_suffix(deduped.cache_control_suffix());
+  }
+  if (!Driver()->Write(ResourceVector(1, slot(0)->resource()),
+                       contents, type, deduped.charset(), output)) {
+    // Restore the partition so RewriteSingle starts from a clean slate.
+    partition->Swap(&shared);
+    partition->mutable_input()->Swap(shared.mutable_input());
+    return false;
+  }
+  return true;
+}
+
+void SingleRewriteContext::PartitionRewriteDone(RewriteResult result,
+                                                int partition_index) {
+  if (dedup_key_.empty()) {
+    return;
+  }
+  OutputResourcePtr output_resource(dedup_output_);
+  dedup_output_.clear();
+  if (result != kRewriteOk || !output_resource->IsWritten() ||
+      output_resource->type() == NULL) {
+    return;
+  }
+  DedupedRewrite deduped;
+  CachedResult* result_copy = deduped.mutable_result();
+  *result_copy = *output_partition(partition_index);
+  result_copy->clear_frozen();
+  result_copy->clear_url();
+  result_copy->clear_hash();
+  result_copy->clear_extension();
+  result_copy->clear_input();
+  deduped.set_mime_type(output_resource->type()->mime_type());
+  output_resource->charset().CopyToString(deduped.mutable_charset());
+  deduped.set_cache_control_suffix(output_resource->cache_control_suffix());
+  deduped.set_output_cache_key(output_resource->HttpCacheKey());
+
+  GoogleString buf;
+  {
+    StringOutputStream sstream(&buf);  // finalizes buf in destructor
+    deduped.SerializeToZeroCopyStream(&sstream);
+  }
+  FindServerContext()->metadata_cache()->PutSwappingString(dedup_key_, &buf);
 }
 
 }  // namespace net_instaweb
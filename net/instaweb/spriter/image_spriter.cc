@@ -15,6 +15,9 @@
  */
 // Author: skerner@google.com (Sam Kerner)
 
+#include <algorithm>
+#include <climits>
+#include <utility>
 #include <vector>
 
 #include "base/logging.h"
@@ -27,6 +30,112 @@
 namespace net_instaweb {
 namespace spriter {
 
+namespace {
+
+// An image to be packed, identified by its index in the SpriterResult.
+struct PackItem {
+  int index;
+  int width;
+  int height;
+};
+
+// Orders taller images first, then wider ones, then by input order so that
+// the layout is deterministic.
+bool TallerFirst(const PackItem& a, const PackItem& b) {
+  if (a.height != b.height) {
+    return a.height > b.height;
+  }
+  if (a.width != b.width) {
+    return a.width > b.width;
+  }
+  return a.index < b.index;
+}
+
+// A horizontal run of the skyline: the topmost free row over [x, x + width).
+struct SkylineSegment {
+  int x;
+  int y;
+  int width;
+};
+
+// Packs |items| (already sorted) into a strip |bin_width| pixels wide using
+// the bottom-left skyline heuristic: each image goes wherever its bottom
+// edge ends up highest, leftmost on ties.  Fills |positions| (x, y pairs
+// indexed like |items|) and returns the extent of the packed images.
+void PackSkyline(const std::vector<PackItem>& items, int bin_width,
+                 std::vector<std::pair<int, int> >* positions,
+                 int* used_width, int* used_height) {
+  std::vector<SkylineSegment> skyline;
+  SkylineSegment floor = {0, 0, bin_width};
+  skyline.push_back(floor);
+  positions->clear();
+  *used_width = 0;
+  *used_height = 0;
+
+  for (int i = 0, n = items.size(); i < n; ++i) {
+    const PackItem& item = items[i];
+    int best_segment = -1;
+    int best_x = 0;
+    int best_y = 0;
+    int best_bottom = INT_MAX;
+    for (int s = 0, ns = skyline.size(); s < ns; ++s) {
+      const int x = skyline[s].x;
+      if (x + item.width > bin_width) {
+        break;
+      }
+      // The image rests on the highest segment it spans.
+      int y = 0;
+      int covered = 0;
+      for (int t = s; t < ns && covered < item.width; ++t) {
+        y = std::max(y, skyline[t].y);
+        covered += skyline[t].width;
+      }
+      if (y + item.height < best_bottom) {
+        best_segment = s;
+        best_x = x;
+        best_y = y;
+        best_bottom = y + item.height;
+      }
+    }
+    // bin_width is never less than the widest image, so the first segment
+    // always fits.
+    DCHECK_GE(best_segment, 0);
+    positions->push_back(std::make_pair(best_x, best_y));
+    *used_width = std::max(*used_width, best_x + item.width);
+    *used_height = std::max(*used_height, best_bottom);
+
+    // Raise the skyline under the new image, trimming the segments it
+    // covers, and merge neighbours that end up at the same height.
+    SkylineSegment top = {best_x, best_bottom, item.width};
+    skyline.insert(skyline.begin() + best_segment, top);
+    const int right = best_x + item.width;
+    for (int s = best_segment + 1; s < static_cast<int>(skyline.size()); ) {
+      SkylineSegment* segment = &skyline[s];
+      if (segment->x >= right) {
+        break;
+      }
+      const int segment_right = segment->x + segment->width;
+      if (segment_right <= right) {
+        skyline.erase(skyline.begin() + s);
+      } else {
+        segment->width = segment_right - right;
+        segment->x = right;
+        break;
+      }
+    }
+    for (int s = 0; s + 1 < static_cast<int>(skyline.size()); ) {
+      if (skyline[s].y == skyline[s + 1].y) {
+        skyline[s].width += skyline[s + 1].width;
+        skyline.erase(skyline.begin() + s + 1);
+      } else {
+        ++s;
+      }
+    }
+  }
+}
+
+}  // namespace
+
 ImageSpriter::ImageSpriter(ImageLibraryInterface* image_lib)
     : image_lib_(image_lib) {}
 
@@ -39,10 +148,23 @@ SpriterResult* ImageSpriter::Sprite(
       spriter_input.options().output_base_path());
   spriter_result->set_output_image_path(
       spriter_input.options().output_image_path());
+
+  ImagePointerVector images;
+  STLElementDeleter<ImagePointerVector> images_deleter(&images);
+  if (!ReadImages(spriter_input, &images, spriter_result.get()))
+    return NULL;  // ReadFromFile() or GetDimensions() has called OnError.
+
+  int canvas_width = 0;
+  int canvas_height = 0;
   switch (spriter_input.options().placement_method()) {
     case VERTICAL_STRIP: {
-      if (!DrawImagesInVerticalStrip(spriter_input, spriter_result.get()))
-        return NULL;
+      PlaceImagesInVerticalStrip(spriter_result.get(),
+                                 &canvas_width, &canvas_height);
+    } break;
+
+    case SKYLINE: {
+      PlaceImagesOnSkyline(spriter_result.get(),
+                           &canvas_width, &canvas_height);
     } break;
 
     default: {
@@ -51,20 +173,17 @@ SpriterResult* ImageSpriter::Sprite(
     }
   }
 
+  if (!DrawImages(spriter_input, images, *spriter_result,
+                  canvas_width, canvas_height))
+    return NULL;
+
   return spriter_result.release();
 }
 
-bool ImageSpriter::DrawImagesInVerticalStrip(
+bool ImageSpriter::ReadImages(
     const SpriterInput& spriter_input,
+    ImagePointerVector* images,
     SpriterResult* spriter_result) {
-  typedef std::vector<ImageLibraryInterface::Image*> ImagePointerVector;
-  ImagePointerVector images;
-  STLElementDeleter<ImagePointerVector> images_deleter(&images);
-
-  int max_image_width = 0;
-  int total_y_offset = 0;
-
-  // For each image, read it and compute its position based on its size.
   for (int i = 0, ie = spriter_input.input_image_set().size(); i < ie; ++i) {
     ImageLibraryInterface::FilePath image_path(
         spriter_input.input_image_set(i).path());
@@ -74,9 +193,9 @@ bool ImageSpriter::DrawImagesInVerticalStrip(
 
     int width, height;
     if (image.get() == NULL || !image->GetDimensions(&width, &height))
-      return false;  // ReadFromFile() or GetDimensions() has called OnError.
+      return false;
 
-    images.push_back(image.release());  // |images| takes ownership of |image|.
+    images->push_back(image.release());  // |images| takes ownership.
 
     ImagePosition* image_pos = spriter_result->add_image_position();
     image_pos->set_path(image_path);
@@ -84,21 +203,88 @@ bool ImageSpriter::DrawImagesInVerticalStrip(
     rect->set_width(width);
     rect->set_height(height);
     rect->set_x_pos(0);
+    rect->set_y_pos(0);
+  }
+  return true;
+}
+
+void ImageSpriter::PlaceImagesInVerticalStrip(
+    SpriterResult* spriter_result, int* canvas_width, int* canvas_height) {
+  int max_image_width = 0;
+  int total_y_offset = 0;
+  for (int i = 0, ie = spriter_result->image_position_size(); i < ie; ++i) {
+    Rect* rect = spriter_result->mutable_image_position(i)->
+        mutable_clip_rect();
+    rect->set_x_pos(0);
     rect->set_y_pos(total_y_offset);
+    total_y_offset += rect->height();
+    if (max_image_width < rect->width())
+      max_image_width = rect->width();
+  }
+  *canvas_width = max_image_width;
+  *canvas_height = total_y_offset;
+}
+
+void ImageSpriter::PlaceImagesOnSkyline(
+    SpriterResult* spriter_result, int* canvas_width, int* canvas_height) {
+  std::vector<PackItem> items;
+  int max_image_width = 0;
+  for (int i = 0, ie = spriter_result->image_position_size(); i < ie; ++i) {
+    const Rect& rect = spriter_result->image_position(i).clip_rect();
+    PackItem item = {i, rect.width(), rect.height()};
+    items.push_back(item);
+    max_image_width = std::max(max_image_width, rect.width());
+  }
+  std::sort(items.begin(), items.end(), TallerFirst);
+
+  // Candidate strip widths run from the widest image (which degenerates to
+  // a vertical strip) to the width of the k tallest images side by side.
+  std::vector<int> bin_widths(1, max_image_width);
+  int row_width = 0;
+  for (int i = 0, n = items.size(); i < n; ++i) {
+    row_width += items[i].width;
+    if (row_width > max_image_width) {
+      bin_widths.push_back(row_width);
+    }
+  }
+
+  std::vector<std::pair<int, int> > positions, best_positions;
+  int64 best_area = -1;
+  *canvas_width = 0;
+  *canvas_height = 0;
+  for (int w = 0, nw = bin_widths.size(); w < nw; ++w) {
+    int used_width, used_height;
+    PackSkyline(items, bin_widths[w], &positions, &used_width, &used_height);
+    const int64 area = static_cast<int64>(used_width) * used_height;
+    if (best_area < 0 || area < best_area) {
+      best_area = area;
+      best_positions.swap(positions);
+      *canvas_width = used_width;
+      *canvas_height = used_height;
+    }
+  }
 
-    total_y_offset += height;
-    if (max_image_width < width)
-      max_image_width = width;
+  for (int i = 0, n = items.size(); i < n; ++i) {
+    Rect* rect = spriter_result->mutable_image_position(items[i].index)->
+        mutable_clip_rect();
+    rect->set_x_pos(best_positions[i].first);
+    rect->set_y_pos(best_positions[i].second);
   }
+}
 
+bool ImageSpriter::DrawImages(
+    const SpriterInput& spriter_input,
+    const ImagePointerVector& images,
+    const SpriterResult& spriter_result,
+    int canvas_width, int canvas_height) {
   // Write all images into a canvas, and write the canvas to a file.
   scoped_ptr<ImageLibraryInterface::Canvas> canvas(
-      image_lib_->CreateCanvas(max_image_width, total_y_offset));
+      image_lib_->CreateCanvas(canvas_width, canvas_height));
   if (!canvas.get())
     return false;
 
   for (int i = 0, ie = images.size(); i < ie; ++i) {
-    const Rect& image_pos = spriter_result->image_position(i).clip_rect();
+    const Rect& image_pos = spriter_result.image_position(i).clip_rect();
     if (!canvas->DrawImage(images[i], image_pos.x_pos(), image_pos.y_pos()))
       return false;
   }
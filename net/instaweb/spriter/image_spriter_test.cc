@@ -224,6 +224,143 @@ TEST(SpriterTest, TwoImages) {
   EXPECT_EQ(2, sprite_result->image_position_size());
   EXPECT_EQ(kCombinedImagePath, sprite_result->output_image_path());
 }
+
+// Sprite three images with the skyline packer.  The two shorter images
+// should end up side by side next to the tallest one, rather than stacked.
+TEST(SpriterTest, SkylineThreeImages) {
+  SpriterInput spriter_input;
+  SetupCommonOptions(&spriter_input, PNG);
+  spriter_input.mutable_options()->set_placement_method(SKYLINE);
+
+  const ImageLibraryInterface::FilePath kPngC("c.png");
+  spriter_input.add_input_image_set()->set_path(kPngA);
+  spriter_input.add_input_image_set()->set_path(kPngB);
+  spriter_input.add_input_image_set()->set_path(kPngC);
+
+  FailOnImageLibError no_failures_allowed;
+
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockCanvas> >
+      mock_canvas(new StrictMock<MockImageLibraryInterface::MockCanvas>);
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockImage> >
+      mock_image_a(new StrictMock<MockImageLibraryInterface::MockImage>);
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockImage> >
+      mock_image_b(new StrictMock<MockImageLibraryInterface::MockImage>);
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockImage> >
+      mock_image_c(new StrictMock<MockImageLibraryInterface::MockImage>);
+
+  testing::StrictMock<MockImageLibraryInterface>
+      mock_image_lib(kInBasePath, kOutBasePath, &no_failures_allowed);
+
+  // a: 20x10, b: 30x20, c: 20x10.
+  EXPECT_CALL(mock_image_lib, ReadFromFile(kPngA))
+      .WillOnce(Return(mock_image_a.get()));
+  EXPECT_CALL(*mock_image_a, GetDimensions(_, _))
+      .WillOnce(DoAll(SetArgumentPointee<0>(20),
+                      SetArgumentPointee<1>(10),
+                      Return(true)));
+  EXPECT_CALL(mock_image_lib, ReadFromFile(kPngB))
+      .WillOnce(Return(mock_image_b.get()));
+  EXPECT_CALL(*mock_image_b, GetDimensions(_, _))
+      .WillOnce(DoAll(SetArgumentPointee<0>(30),
+                      SetArgumentPointee<1>(20),
+                      Return(true)));
+  EXPECT_CALL(mock_image_lib, ReadFromFile(kPngC))
+      .WillOnce(Return(mock_image_c.get()));
+  EXPECT_CALL(*mock_image_c, GetDimensions(_, _))
+      .WillOnce(DoAll(SetArgumentPointee<0>(20),
+                      SetArgumentPointee<1>(10),
+                      Return(true)));
+
+  // A vertical strip would be 30x40; packing gives 50x20.  b is tallest so
+  // it goes first, at the origin; a and c stack to its right.
+  EXPECT_CALL(mock_image_lib, CreateCanvas(50, 20))
+      .WillOnce(Return(mock_canvas.get()));
+  EXPECT_CALL(*mock_canvas, DrawImage(mock_image_b.get(), 0, 0))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_canvas, DrawImage(mock_image_a.get(), 30, 0))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_canvas, DrawImage(mock_image_c.get(), 30, 10))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_canvas, WriteToFile(kCombinedImagePath, PNG))
+      .WillOnce(Return(true));
+
+  // spriter.Sprite() will free these.
+  EXPECT_FALSE(NULL == mock_canvas.release());
+  EXPECT_FALSE(NULL == mock_image_a.release());
+  EXPECT_FALSE(NULL == mock_image_b.release());
+  EXPECT_FALSE(NULL == mock_image_c.release());
+
+  ImageSpriter spriter(&mock_image_lib);
+  scoped_ptr<SpriterResult> sprite_result(spriter.Sprite(spriter_input));
+
+  ASSERT_TRUE(sprite_result.get());
+  ASSERT_EQ(3, sprite_result->image_position_size());
+  // Positions are reported in input order.
+  EXPECT_EQ(kPngA, sprite_result->image_position(0).path());
+  EXPECT_EQ(30, sprite_result->image_position(0).clip_rect().x_pos());
+  EXPECT_EQ(0, sprite_result->image_position(0).clip_rect().y_pos());
+  EXPECT_EQ(kPngB, sprite_result->image_position(1).path());
+  EXPECT_EQ(0, sprite_result->image_position(1).clip_rect().x_pos());
+  EXPECT_EQ(kPngC, sprite_result->image_position(2).path());
+  EXPECT_EQ(30, sprite_result->image_position(2).clip_rect().x_pos());
+  EXPECT_EQ(10, sprite_result->image_position(2).clip_rect().y_pos());
+}
+
+// Packing never makes the canvas bigger than a vertical strip would: when
+// the images have very different heights, the narrow layout wins.
+TEST(SpriterTest, SkylineKeepsSmallestArea) {
+  SpriterInput spriter_input;
+  SetupCommonOptions(&spriter_input, PNG);
+  spriter_input.mutable_options()->set_placement_method(SKYLINE);
+  spriter_input.add_input_image_set()->set_path(kPngA);
+  spriter_input.add_input_image_set()->set_path(kPngB);
+
+  FailOnImageLibError no_failures_allowed;
+
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockCanvas> >
+      mock_canvas(new StrictMock<MockImageLibraryInterface::MockCanvas>);
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockImage> >
+      mock_image_a(new StrictMock<MockImageLibraryInterface::MockImage>);
+  scoped_ptr<StrictMock<MockImageLibraryInterface::MockImage> >
+      mock_image_b(new StrictMock<MockImageLibraryInterface::MockImage>);
+
+  testing::StrictMock<MockImageLibraryInterface>
+      mock_image_lib(kInBasePath, kOutBasePath, &no_failures_allowed);
+
+  // a: 100x5, b: 100x100.  Side by side would be 200x100; stacked is 100x105.
+  EXPECT_CALL(mock_image_lib, ReadFromFile(kPngA))
+      .WillOnce(Return(mock_image_a.get()));
+  EXPECT_CALL(*mock_image_a, GetDimensions(_, _))
+      .WillOnce(DoAll(SetArgumentPointee<0>(100),
+                      SetArgumentPointee<1>(5),
+                      Return(true)));
+  EXPECT_CALL(mock_image_lib, ReadFromFile(kPngB))
+      .WillOnce(Return(mock_image_b.get()));
+  EXPECT_CALL(*mock_image_b, GetDimensions(_, _))
+      .WillOnce(DoAll(SetArgumentPointee<0>(100),
+                      SetArgumentPointee<1>(100),
+                      Return(true)));
+
+  EXPECT_CALL(mock_image_lib, CreateCanvas(100, 105))
+      .WillOnce(Return(mock_canvas.get()));
+  EXPECT_CALL(*mock_canvas, DrawImage(mock_image_a.get(), 0, 100))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_canvas, DrawImage(mock_image_b.get(), 0, 0))
+      .WillOnce(Return(true));
+  EXPECT_CALL(*mock_canvas, WriteToFile(kCombinedImagePath, PNG))
+      .WillOnce(Return(true));
+
+  // spriter.Sprite() will free these.
+  EXPECT_FALSE(NULL == mock_canvas.release());
+  EXPECT_FALSE(NULL == mock_image_a.release());
+  EXPECT_FALSE(NULL == mock_image_b.release());
+
+  ImageSpriter spriter(&mock_image_lib);
+  scoped_ptr<SpriterResult> sprite_result(spriter.Sprite(spriter_input));
+  ASSERT_TRUE(sprite_result.get());
+  EXPECT_EQ(2, sprite_result->image_position_size());
+}
+
 }  // namesapce
 }  // namespace spriter
 }  // namespace net_instaweb
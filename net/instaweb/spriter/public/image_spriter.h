@@ -19,6 +19,8 @@
 #ifndef NET_INSTAWEB_SPRITER_PUBLIC_IMAGE_SPRITER_H_
 #define NET_INSTAWEB_SPRITER_PUBLIC_IMAGE_SPRITER_H_
 
+#include <vector>
+
 #include "net/instaweb/spriter/image_library_interface.h"
 
 namespace net_instaweb {
@@ -35,9 +37,26 @@ class ImageSpriter {
   SpriterResult* Sprite(const SpriterInput& spriter_input);
 
  private:
-  bool DrawImagesInVerticalStrip(
-      const SpriterInput& spriter_input,
-      SpriterResult* spriter_result);
+  typedef std::vector<ImageLibraryInterface::Image*> ImagePointerVector;
+
+  // Reads every input image into |images|, and adds a position to
+  // |spriter_result| for each, with its dimensions filled in.
+  bool ReadImages(const SpriterInput& spriter_input,
+                  ImagePointerVector* images,
+                  SpriterResult* spriter_result);
+
+  // Sets the offsets of all the image positions in |spriter_result|, and
+  // computes the size of the canvas they fit into.
+  void PlaceImagesInVerticalStrip(SpriterResult* spriter_result,
+                                  int* canvas_width, int* canvas_height);
+  void PlaceImagesOnSkyline(SpriterResult* spriter_result,
+                            int* canvas_width, int* canvas_height);
+
+  // Draws the images at their positions onto a new canvas, and writes it out.
+  bool DrawImages(const SpriterInput& spriter_input,
+                  const ImagePointerVector& images,
+                  const SpriterResult& spriter_result,
+                  int canvas_width, int canvas_height);
 
   ImageLibraryInterface* image_lib_;
 
@@ -97,6 +97,7 @@
         'http/url_async_fetcher_stats_test.cc',
         'http/wait_url_async_fetcher_test.cc',
         'http/write_through_http_cache_test.cc',
+        'rewriter/adaptive_rewrite_deadline_test.cc',
         'rewriter/add_ids_filter_test.cc',
         'rewriter/add_instrumentation_filter_test.cc',
         'rewriter/association_transformer_test.cc',
@@ -124,6 +125,7 @@
         'rewriter/css_embedded_config_test.cc',
         'rewriter/css_filter_test.cc',
         'rewriter/css_flatten_imports_test.cc',
+        'rewriter/css_fragment_cache_test.cc',
         'rewriter/css_hierarchy_test.cc',
         'rewriter/css_image_rewriter_test.cc',
         'rewriter/css_inline_filter_test.cc',
@@ -138,6 +140,7 @@
         'rewriter/debug_filter_test.cc',
         'rewriter/decision_tree_test.cc',
         'rewriter/decode_rewritten_urls_filter_test.cc',
+        'rewriter/decoded_image_cache_test.cc',
         'rewriter/dedup_inlined_images_filter_test.cc',
         'rewriter/defer_iframe_filter_test.cc',
         'rewriter/delay_images_filter_test.cc',
@@ -240,6 +243,7 @@
         '<(DEPTH)/pagespeed/kernel/base/charset_util_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/chunking_writer_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/circular_buffer_test.cc',
+        '<(DEPTH)/pagespeed/kernel/base/cost_tracker_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/countdown_timer_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/escaping_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/fast_wildcard_group_test.cc',
@@ -259,6 +263,7 @@
         '<(DEPTH)/pagespeed/kernel/base/sha1_signature_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/shared_string_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/source_map_test.cc',
+        '<(DEPTH)/pagespeed/kernel/base/span_trace_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/split_statistics_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/split_writer_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/stdio_file_system_test.cc',
@@ -273,6 +278,7 @@
         '<(DEPTH)/pagespeed/kernel/base/wildcard_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/async_cache_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/cache_batcher_test.cc',
+        '<(DEPTH)/pagespeed/kernel/cache/cache_snapshot_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/cache_stats_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/compressed_cache_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/delay_cache_test.cc',
@@ -313,6 +319,7 @@
         '<(DEPTH)/pagespeed/kernel/image/image_converter_test.cc',
         '<(DEPTH)/pagespeed/kernel/image/image_analysis_test.cc',
         '<(DEPTH)/pagespeed/kernel/image/image_resizer_test.cc',
+        '<(DEPTH)/pagespeed/kernel/image/image_similarity_test.cc',
         '<(DEPTH)/pagespeed/kernel/image/image_util_test.cc',
         '<(DEPTH)/pagespeed/kernel/image/jpeg_optimizer_test.cc',
         '<(DEPTH)/pagespeed/kernel/image/jpeg_reader_test.cc',
@@ -346,6 +353,7 @@
         '<(DEPTH)/pagespeed/kernel/util/re2_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/simple_stats_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/statistics_logger_test.cc',
+        '<(DEPTH)/pagespeed/kernel/util/statistics_time_series_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/statistics_work_bound_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/url_escaper_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/url_multipart_encoder_test.cc',
@@ -492,16 +500,38 @@
         'rewriter/image_speed_test.cc',
         'rewriter/javascript_minify_speed_test.cc',
         'rewriter/rewrite_driver_speed_test.cc',
+        'rewriter/rewrite_options_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/fast_wildcard_group_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/string_multi_map_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/base/wildcard_group.cc',
         '<(DEPTH)/pagespeed/kernel/cache/compressed_cache_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/cache/lru_cache_speed_test.cc',
+        '<(DEPTH)/pagespeed/kernel/html/html_keywords_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/html/html_parse_speed_test.cc',
+        '<(DEPTH)/pagespeed/kernel/http/google_url_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/deque_speed_test.cc',
         '<(DEPTH)/pagespeed/kernel/util/url_escaper_speed_test.cc',
       ],
     },
+    {
+      # Replaces the global operator new to count allocations, so it must
+      # not share a binary with the other benchmarks.
+      'target_name': 'rewrite_driver_allocation_speed_test',
+      'type': 'executable',
+      'dependencies': [
+        'test_util',
+        '<(DEPTH)/net/instaweb/instaweb.gyp:instaweb_console_css_data2c',
+        '<(DEPTH)/net/instaweb/instaweb.gyp:instaweb_console_js_data2c',
+        '<(DEPTH)/pagespeed/kernel.gyp:pthread_system',
+        '<(DEPTH)/third_party/re2/re2.gyp:re2_bench_util',
+      ],
+      'include_dirs': [
+        '<(DEPTH)',
+      ],
+      'sources': [
+        'rewriter/rewrite_driver_allocation_speed_test.cc',
+      ],
+    },
     {
       'target_name': 'css_minify_main',
       'type': 'executable',
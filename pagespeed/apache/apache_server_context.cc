@@ -86,6 +86,7 @@ ApacheServerContext::~ApacheServerContext() {
 void ApacheServerContext::InitStats(Statistics* statistics) {
   SystemServerContext::InitStats(statistics);
   ModSpdyFetcher::InitStats(statistics);
+  ProxyFetchFactory::InitStats(statistics);
 }
 
 bool ApacheServerContext::InitPath(const GoogleString& path) {
@@ -42,6 +42,8 @@
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/ref_counted_ptr.h"
 #include "pagespeed/kernel/base/request_trace.h"
+#include "pagespeed/kernel/base/span_trace.h"
+#include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/timer.h"
@@ -72,6 +74,22 @@ const char ProxyFetch::kHeadersSetupRaceFlush[] = "HeadersSetupRace:Flush";
 const char ProxyFetch::kHeadersSetupRacePrefix[] = "HeadersSetupRace:";
 const char ProxyFetch::kHeadersSetupRaceWait[] = "HeadersSetupRace:Wait";
 
+const char ProxyFetch::kLexDuringPcacheLookupPrefix[] =
+    "LexDuringPcacheLookup:";
+const char ProxyFetch::kLexDuringPcacheLookupResume[] =
+    "LexDuringPcacheLookup:Resume";
+const char ProxyFetch::kLexDuringPcacheLookupStarted[] =
+    "LexDuringPcacheLookup:Started";
+
+const char ProxyFetchFactory::kLexedDuringPcacheLookupRequests[] =
+    "html-lexed-during-pcache-lookup-requests";
+const char ProxyFetchFactory::kLexedDuringPcacheLookupBytes[] =
+    "html-lexed-during-pcache-lookup-bytes";
+const char ProxyFetchFactory::kLexedDuringPcacheLookupUs[] =
+    "html-lexed-during-pcache-lookup-us";
+const char ProxyFetchFactory::kPcacheLookupDeadlineExpirations[] =
+    "pcache-lookup-deadline-expirations";
+
 ProxyFetchFactory::ProxyFetchFactory(ServerContext* server_context)
     : server_context_(server_context),
       timer_(server_context->timer()),
@@ -80,6 +98,13 @@ ProxyFetchFactory::ProxyFetchFactory(ServerContext* server_context)
           server_context->thread_system()->NewMutex()) {
 }
 
+void ProxyFetchFactory::InitStats(Statistics* statistics) {
+  statistics->AddVariable(kLexedDuringPcacheLookupRequests);
+  statistics->AddVariable(kLexedDuringPcacheLookupBytes);
+  statistics->AddVariable(kLexedDuringPcacheLookupUs);
+  statistics->AddVariable(kPcacheLookupDeadlineExpirations);
+}
+
 ProxyFetchFactory::~ProxyFetchFactory() {
   // Factory should outlive all fetches.
   DCHECK(outstanding_proxy_fetches_.empty());
@@ -230,10 +255,19 @@ ProxyFetchPropertyCallbackCollector::ProxyFetchPropertyCallbackCollector(
       request_headers_ok_(false),
       proxy_fetch_(NULL),
       options_(options),
-      status_code_(HttpStatus::kUnknownStatusCode) {
+      status_code_(HttpStatus::kUnknownStatusCode),
+      lookup_span_(SpanTrace::kNoSpan),
+      deadline_alarm_(NULL) {
+  SpanTrace* trace = (request_context_.get() == NULL) ? NULL :
+      request_context_->span_trace();
+  if (trace != NULL) {
+    lookup_span_ = trace->BeginSpan("PropertyCacheLookup",
+                                    SpanTrace::kRootSpan);
+  }
 }
 
 ProxyFetchPropertyCallbackCollector::~ProxyFetchPropertyCallbackCollector() {
+  DCHECK(deadline_alarm_ == NULL);
   ThreadSynchronizer* sync = server_context_->thread_synchronizer();
   server_context_->html_workers()->FreeSequence(sequence_);
   if (!post_lookup_task_vector_.empty()) {
@@ -303,8 +337,12 @@ void ProxyFetchPropertyCallbackCollector::ExecuteDone(
   pending_callbacks_.erase(callback);
   property_pages_[callback->page_type()] = callback;
   if (pending_callbacks_.empty()) {
+    CancelLookupDeadline();
     DCHECK(request_context_.get() != NULL);
     request_context_->mutable_timing_info()->PropertyCacheLookupFinished();
+    if (request_context_->span_trace() != NULL) {
+      request_context_->span_trace()->EndSpan(lookup_span_);
+    }
     PropertyPage* actual_page = ReleasePropertyPage(
         PropertyPage::kPropertyCachePage);
     if (actual_page != NULL) {
@@ -402,6 +440,15 @@ void ProxyFetchPropertyCallbackCollector::ExecuteConnectProxyFetch(
       // starts sending content.
       (*iter)->FastFinishLookup();
     }
+  } else if (!done_ && options->pcache_lookup_deadline_ms() >= 0) {
+    // Origin has started sending content; give the lookups until the
+    // deadline to finish before finishing them early.
+    Timer* timer = server_context_->timer();
+    deadline_alarm_ = new QueuedAlarm(
+        server_context_->scheduler(), sequence_,
+        timer->NowUs() + options->pcache_lookup_deadline_ms() * Timer::kMsUs,
+        MakeFunction(
+            this, &ProxyFetchPropertyCallbackCollector::HandleLookupDeadline));
   }
   ThreadSynchronizer* sync = server_context_->thread_synchronizer();
   if (done_) {
@@ -448,6 +495,7 @@ void ProxyFetchPropertyCallbackCollector::ExecuteDetach(
   detached_ = true;
   proxy_fetch_ = NULL;
   status_code_ = status_code;
+  CancelLookupDeadline();
 
   for (int i = 0, n = post_lookup_task_vector_.size(); i < n; ++i) {
     post_lookup_task_vector_[i]->CallCancel();
@@ -463,6 +511,28 @@ void ProxyFetchPropertyCallbackCollector::ExecuteDetach(
   sync->Signal(ProxyFetch::kCollectorDetachFinish);
 }
 
+void ProxyFetchPropertyCallbackCollector::HandleLookupDeadline() {
+  // The alarm deletes itself once run.
+  deadline_alarm_ = NULL;
+  if (pending_callbacks_.empty()) {
+    return;
+  }
+  server_context_->statistics()->GetVariable(
+      ProxyFetchFactory::kPcacheLookupDeadlineExpirations)->Add(1);
+  for (std::set<ProxyFetchPropertyCallback*>::iterator iter =
+           pending_callbacks_.begin();
+       iter != pending_callbacks_.end(); ++iter) {
+    (*iter)->FastFinishLookup();
+  }
+}
+
+void ProxyFetchPropertyCallbackCollector::CancelLookupDeadline() {
+  if (deadline_alarm_ != NULL) {
+    deadline_alarm_->CancelAlarm();
+    deadline_alarm_ = NULL;
+  }
+}
+
 void ProxyFetchPropertyCallbackCollector::AddPostLookupTask(Function* func) {
   sequence_->Add(MakeFunction(
       this,
@@ -503,6 +573,11 @@ ProxyFetch::ProxyFetch(
       parse_text_called_(false),
       done_called_(false),
       property_cache_callback_(property_cache_callback),
+      lex_during_pcache_lookup_(false),
+      lexed_during_pcache_lookup_bytes_(0),
+      lexed_during_pcache_lookup_us_(0),
+      property_cache_results_pending_(false),
+      pending_device_type_(UserAgentMatcher::kDesktop),
       original_content_fetch_(original_content_fetch),
       driver_(driver),
       queue_run_job_created_(false),
@@ -515,7 +590,9 @@ ProxyFetch::ProxyFetch(
       waiting_for_flush_to_finish_(false),
       idle_alarm_(NULL),
       factory_(factory),
-      distributed_fetch_(false) {
+      distributed_fetch_(false),
+      fetch_span_(SpanTrace::kNoSpan),
+      finish_parse_span_(SpanTrace::kNoSpan) {
   driver_->SetWriter(async_fetch);
   set_request_headers(async_fetch->request_headers());
   set_response_headers(async_fetch->response_headers());
@@ -543,6 +620,7 @@ ProxyFetch::ProxyFetch(
   }
 
   driver_->EnableBlockingRewrite(request_headers());
+  lex_during_pcache_lookup_ = Options()->lex_html_during_pcache_lookup();
 
   // Set the implicit cache ttl and the min cache ttl for the response headers
   // based on the value specified in the options.
@@ -765,6 +843,11 @@ void ProxyFetch::DoFetch(bool prepare_success) {
     return;
   }
 
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    fetch_span_ = trace->BeginSpan("ProxyFetch::Fetch", SpanTrace::kRootSpan);
+  }
+
   const RewriteOptions* options = driver_->options();
   const bool is_allowed = options->IsAllowed(url_);
   const bool is_enabled = options->enabled();
@@ -827,8 +910,11 @@ void ProxyFetch::ScheduleQueueExecutionIfNeeded() {
 
   // We're waiting for any property-cache lookups and previous flushes to
   // complete, so no need to queue it here.  The queuing will happen when
-  // the PropertyCache lookup is complete or from FlushDone.
-  if (waiting_for_flush_to_finish_ || (property_cache_callback_ != NULL)) {
+  // the PropertyCache lookup is complete or from FlushDone.  While the
+  // lookup is outstanding, we may be allowed to get on with lexing text.
+  if (waiting_for_flush_to_finish_ ||
+      ((property_cache_callback_ != NULL) &&
+       (!lex_during_pcache_lookup_ || text_queue_.empty()))) {
     return;
   }
 
@@ -838,18 +924,20 @@ void ProxyFetch::ScheduleQueueExecutionIfNeeded() {
 
 void ProxyFetch::PropertyCacheComplete(
     ProxyFetchPropertyCallbackCollector* callback_collector) {
-  driver_->TraceLiteral("PropertyCache lookup completed");
   ScopedMutex lock(mutex_.get());
 
   if (driver_ == NULL) {
     LOG(DFATAL) << "Expected non-null driver.";
   } else {
-    // Set the page property and device property objects in the driver.
-    driver_->set_fallback_property_page(
+    // We are on the collector's thread, and sequence_ may be lexing text
+    // into driver_, so keep the page property and device property objects
+    // for ExecuteQueued to set in the driver.
+    pending_fallback_property_page_.reset(
         callback_collector->ReleaseFallbackPropertyPage());
-    driver_->set_origin_property_page(
+    pending_origin_property_page_.reset(
         callback_collector->ReleaseOriginPropertyPage());
-    driver_->set_device_type(callback_collector->device_type());
+    pending_device_type_ = callback_collector->device_type();
+    property_cache_results_pending_ = true;
   }
   // We have to set the callback to NULL to let ScheduleQueueExecutionIfNeeded
   // proceed (it waits until it's NULL). And we have to delete it because then
@@ -996,6 +1084,12 @@ void ProxyFetch::HandleDone(bool success) {
 
   VLOG(1) << "Fetch result:" << success << " " << url_
           << " : " << response_headers()->status_code();
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    trace->AddTag(fetch_span_, "status",
+                  IntegerToString(response_headers()->status_code()));
+    trace->EndSpan(fetch_span_);
+  }
   if (started_parse_) {
     ScopedMutex lock(mutex_.get());
     done_outstanding_ = true;
@@ -1029,6 +1123,11 @@ void ProxyFetch::ExecuteQueued() {
   bool do_finish = false;
   bool done_result = false;
   bool force_flush = false;
+  bool lex_only = false;
+  bool apply_property_cache_results = false;
+  scoped_ptr<FallbackPropertyPage> fallback_page;
+  scoped_ptr<PropertyPage> origin_page;
+  UserAgentMatcher::DeviceType device_type = UserAgentMatcher::kDesktop;
 
   size_t buffer_limit = Options()->flush_buffer_limit_bytes();
   StringStarVector v;
@@ -1036,51 +1135,69 @@ void ProxyFetch::ExecuteQueued() {
     ScopedMutex lock(mutex_.get());
     DCHECK(!waiting_for_flush_to_finish_);
 
-    // See if we should force a flush based on how much stuff has
-    // accumulated.
-    size_t total = 0;
-    size_t force_flush_chunk_count = 0;  // set only if force_flush is true.
-    for (size_t c = 0, n = text_queue_.size(); c < n; ++c) {
-      total += text_queue_[c]->length();
-      if (total >= buffer_limit) {
-        force_flush = true;
-        force_flush_chunk_count = c + 1;
-        break;
+    if (property_cache_callback_ != NULL) {
+      // The property cache lookup is still outstanding, so we were only
+      // scheduled to lex the text that has arrived.  Flushes and Done wait
+      // until the lookup completes.
+      DCHECK(lex_during_pcache_lookup_);
+      lex_only = true;
+      v.swap(text_queue_);
+      queue_run_job_created_ = false;
+    } else {
+      if (property_cache_results_pending_) {
+        apply_property_cache_results = true;
+        property_cache_results_pending_ = false;
+        fallback_page.reset(pending_fallback_property_page_.release());
+        origin_page.reset(pending_origin_property_page_.release());
+        device_type = pending_device_type_;
       }
-    }
 
-    // Are we forcing a flush of some, but not all, of the queued
-    // content?
-    bool partial_forced_flush =
-        force_flush && (force_flush_chunk_count != text_queue_.size());
-    if (partial_forced_flush) {
-      for (size_t c = 0; c < force_flush_chunk_count; ++c) {
-        v.push_back(text_queue_[c]);
+      // See if we should force a flush based on how much stuff has
+      // accumulated.
+      size_t total = 0;
+      size_t force_flush_chunk_count = 0;  // set only if force_flush is true.
+      for (size_t c = 0, n = text_queue_.size(); c < n; ++c) {
+        total += text_queue_[c]->length();
+        if (total >= buffer_limit) {
+          force_flush = true;
+          force_flush_chunk_count = c + 1;
+          break;
+        }
+      }
+
+      // Are we forcing a flush of some, but not all, of the queued
+      // content?
+      bool partial_forced_flush =
+          force_flush && (force_flush_chunk_count != text_queue_.size());
+      if (partial_forced_flush) {
+        for (size_t c = 0; c < force_flush_chunk_count; ++c) {
+          v.push_back(text_queue_[c]);
+        }
+        size_t old_len = text_queue_.size();
+        text_queue_.erase(text_queue_.begin(),
+                          text_queue_.begin() + force_flush_chunk_count);
+        DCHECK_EQ(old_len, v.size() + text_queue_.size());
+
+        // Note that in this case, since text_queue_ isn't empty,
+        // the call to ScheduleQueueExecutionIfNeeded from FlushDone
+        // will make us run again.
+      } else {
+        v.swap(text_queue_);
+      }
+      do_flush = network_flush_outstanding_ || force_flush;
+      do_finish = done_outstanding_;
+      done_result = done_result_;
+
+      network_flush_outstanding_ = false;
+
+      // Note that we don't clear done_outstanding_ here yet, as we
+      // can only handle it if we are not also handling a flush.
+      queue_run_job_created_ = false;
+      if (do_flush) {
+        // Stop queuing up invocations of us until the flush we will do
+        // below is done.
+        waiting_for_flush_to_finish_ = true;
       }
-      size_t old_len = text_queue_.size();
-      text_queue_.erase(text_queue_.begin(),
-                        text_queue_.begin() + force_flush_chunk_count);
-      DCHECK_EQ(old_len, v.size() + text_queue_.size());
-
-      // Note that in this case, since text_queue_ isn't empty,
-      // the call to ScheduleQueueExecutionIfNeeded from FlushDone
-      // will make us run again.
-    } else {
-      v.swap(text_queue_);
-    }
-    do_flush = network_flush_outstanding_ || force_flush;
-    do_finish = done_outstanding_;
-    done_result = done_result_;
-
-    network_flush_outstanding_ = false;
-
-    // Note that we don't clear done_outstanding_ here yet, as we
-    // can only handle it if we are not also handling a flush.
-    queue_run_job_created_ = false;
-    if (do_flush) {
-      // Stop queuing up invocations of us until the flush we will do
-      // below is done.
-      waiting_for_flush_to_finish_ = true;
     }
   }
 
@@ -1089,6 +1206,16 @@ void ProxyFetch::ExecuteQueued() {
     parse_text_called_ = true;
   }
 
+  if (lex_only) {
+    LexDuringPropertyCacheLookup(v);
+    return;
+  }
+  if (apply_property_cache_results) {
+    ApplyPropertyCacheResults(fallback_page.release(), origin_page.release(),
+                              device_type);
+  }
+  EndLexingDuringPropertyCacheLookup();
+
   // Collect all text received from the fetcher
   for (int i = 0, n = v.size(); i < n; ++i) {
     GoogleString* str = v[i];
@@ -1119,6 +1246,51 @@ void ProxyFetch::ExecuteQueued() {
   }
 }
 
+void ProxyFetch::LexDuringPropertyCacheLookup(const StringStarVector& text) {
+  // Filters may decide whether they are enabled based on property cache
+  // data, so they must not do so until the first flush, which waits for the
+  // lookup.  Until then the text is only lexed into the driver's event queue.
+  driver_->set_defer_determine_enabled_filters(true);
+  int64 start_us = timer_->NowUs();
+
+  // Lets ProxyInterfaceTest complete the lookup while we lex.  This is a
+  // no-op unless the test enables prefix "LexDuringPcacheLookup:".
+  ThreadSynchronizer* sync = server_context_->thread_synchronizer();
+  sync->Signal(kLexDuringPcacheLookupStarted);
+  sync->Wait(kLexDuringPcacheLookupResume);
+  for (int i = 0, n = text.size(); i < n; ++i) {
+    GoogleString* str = text[i];
+    lexed_during_pcache_lookup_bytes_ += str->size();
+    driver_->ParseText(*str);
+    delete str;
+  }
+  lexed_during_pcache_lookup_us_ += timer_->NowUs() - start_us;
+}
+
+void ProxyFetch::ApplyPropertyCacheResults(
+    FallbackPropertyPage* fallback_page, PropertyPage* origin_page,
+    UserAgentMatcher::DeviceType device_type) {
+  driver_->TraceLiteral("PropertyCache lookup completed");
+  driver_->set_fallback_property_page(fallback_page);
+  driver_->set_origin_property_page(origin_page);
+  driver_->set_device_type(device_type);
+}
+
+void ProxyFetch::EndLexingDuringPropertyCacheLookup() {
+  if (!driver_->defer_determine_enabled_filters()) {
+    return;
+  }
+  driver_->set_defer_determine_enabled_filters(false);
+  Statistics* stats = server_context_->statistics();
+  stats->GetVariable(ProxyFetchFactory::kLexedDuringPcacheLookupRequests)
+      ->Add(1);
+  stats->GetVariable(ProxyFetchFactory::kLexedDuringPcacheLookupBytes)
+      ->Add(lexed_during_pcache_lookup_bytes_);
+  stats->GetVariable(ProxyFetchFactory::kLexedDuringPcacheLookupUs)
+      ->Add(lexed_during_pcache_lookup_us_);
+  driver_->TraceLiteral("Lexed HTML during PropertyCache lookup");
+}
+
 void ProxyFetch::Finish(bool success) {
   ProxyFetchPropertyCallbackCollector* detach_callback = NULL;
   {
@@ -1151,6 +1323,10 @@ void ProxyFetch::Finish(bool success) {
 
   if (driver_ != NULL) {
     if (started_parse_) {
+      if (span_trace() != NULL) {
+        finish_parse_span_ = span_trace()->BeginSpan("ProxyFetch::FinishParse",
+                                                     SpanTrace::kRootSpan);
+      }
       driver_->FinishParseAsync(
           MakeFunction(this, &ProxyFetch::CompleteFinishParse, success));
       return;
@@ -1163,6 +1339,12 @@ void ProxyFetch::Finish(bool success) {
     }
   }
 
+  // The root span measures the latency seen by the client, so close it as
+  // the response completes, even though the request context -- and so the
+  // trace -- may live on while the driver is cleaned up.
+  if (span_trace() != NULL) {
+    span_trace()->EndSpan(SpanTrace::kRootSpan);
+  }
   SharedAsyncFetch::HandleDone(success);
   done_called_ = true;
   factory_->RegisterFinishedFetch(this);
@@ -1176,11 +1358,19 @@ void ProxyFetch::Finish(bool success) {
 }
 
 void ProxyFetch::CompleteFinishParse(bool success) {
+  if (span_trace() != NULL) {
+    span_trace()->EndSpan(finish_parse_span_);
+  }
   driver_ = NULL;
   // Have to call directly -- sequence is gone with driver.
   Finish(success);
 }
 
+SpanTrace* ProxyFetch::span_trace() {
+  return (request_context().get() == NULL) ? NULL :
+      request_context()->span_trace();
+}
+
 void ProxyFetch::CancelIdleAlarm() {
   if (idle_alarm_ != NULL) {
     idle_alarm_->CancelAlarm();
@@ -1397,29 +1587,37 @@ ProxyFetchPropertyCallbackCollector*
     }
   }
 
-  // All callbacks need to be registered before Reads to avoid race.
+  // All callbacks need to be registered before Reads to avoid race.  The
+  // pages are read together so that the property store can batch the lookups
+  // of their cohorts.
   PropertyCache::CohortVector cohort_list_without_blink =
       GetCohortList(false /* requires_blink_cohort */, server_context);
+  PropertyCache::CohortVector cohort_list_with_blink;
+  PropertyCache::PageReadVector reads;
   if (property_callback != NULL) {
-    page_property_cache->ReadWithCohorts(
-        requires_blink_cohort ?
-            GetCohortList(
-                true /* requires_blink_cohort */, server_context) :
-            cohort_list_without_blink,
-            property_callback);
+    if (requires_blink_cohort) {
+      cohort_list_with_blink =
+          GetCohortList(true /* requires_blink_cohort */, server_context);
+      reads.push_back(PropertyCache::PageRead(property_callback,
+                                              &cohort_list_with_blink));
+    } else {
+      reads.push_back(PropertyCache::PageRead(property_callback,
+                                              &cohort_list_without_blink));
+    }
   }
 
   if (fallback_property_callback != NULL) {
     // Always read property page with fallback values without blink as there is
     // no property in BlinkCohort which can used fallback values.
-    page_property_cache->ReadWithCohorts(cohort_list_without_blink,
-                                         fallback_property_callback);
+    reads.push_back(PropertyCache::PageRead(fallback_property_callback,
+                                            &cohort_list_without_blink));
   }
 
   if (origin_property_callback != NULL) {
-    page_property_cache->ReadWithCohorts(cohort_list_without_blink,
-                                         origin_property_callback);
+    reads.push_back(PropertyCache::PageRead(origin_property_callback,
+                                            &cohort_list_without_blink));
   }
+  page_property_cache->MultiReadWithCohorts(reads);
 
   if (added_callback) {
     request_ctx->mutable_timing_info()->PropertyCacheLookupStarted();
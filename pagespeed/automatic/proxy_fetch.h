@@ -35,6 +35,7 @@
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/gtest_prod.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/http/http_names.h"
@@ -55,15 +56,29 @@ class ServerContext;
 class ResponseHeaders;
 class RewriteDriver;
 class RewriteOptions;
+class Statistics;
 class Timer;
 
 // Factory for creating and starting ProxyFetches. Must outlive all
 // ProxyFetches it creates.
 class ProxyFetchFactory {
  public:
+  // Statistics on HTML lexed while the property cache lookup was outstanding
+  // (see RewriteOptions::lex_html_during_pcache_lookup): the number of
+  // requests, the bytes lexed and the microseconds spent lexing them, which
+  // would otherwise have been spent after the lookup completed.
+  static const char kLexedDuringPcacheLookupRequests[];
+  static const char kLexedDuringPcacheLookupBytes[];
+  static const char kLexedDuringPcacheLookupUs[];
+  // Number of property cache lookups finished early because
+  // RewriteOptions::pcache_lookup_deadline_ms passed.
+  static const char kPcacheLookupDeadlineExpirations[];
+
   explicit ProxyFetchFactory(ServerContext* server_context);
   ~ProxyFetchFactory();
 
+  static void InitStats(Statistics* statistics);
+
   // Convenience method that calls CreateNewProxyFetch and then StartFetch() on
   // the resulting fetch.
   void StartNewProxyFetch(
@@ -266,6 +281,11 @@ class ProxyFetchPropertyCallbackCollector {
   void ExecuteDetach(HttpStatus::Code status_code);
   void ExecuteRequestHeadersComplete();
 
+  // Finishes the outstanding lookups early when
+  // RewriteOptions::pcache_lookup_deadline_ms passes; run in sequence_.
+  void HandleLookupDeadline();
+  void CancelLookupDeadline();
+
   void RunPostLookupsAndCleanupIfSafe();
 
   // Updates the status code of response in property cache.
@@ -292,6 +312,10 @@ class ProxyFetchPropertyCallbackCollector {
   HttpStatus::Code status_code_;  // status_code_ of the response.
   scoped_ptr<FallbackPropertyPage> fallback_property_page_;
   scoped_ptr<PropertyPage> origin_property_page_;
+  // Covers the lookup of all the property pages, if the request is traced.
+  SpanTrace::SpanId lookup_span_;
+  // Pending while a lookup deadline is set.
+  QueuedAlarm* deadline_alarm_;
 
   DISALLOW_COPY_AND_ASSIGN(ProxyFetchPropertyCallbackCollector);
 };
@@ -335,6 +359,12 @@ class ProxyFetch : public SharedAsyncFetch {
   static const char kHeadersSetupRacePrefix[];
   static const char kHeadersSetupRaceWait[];
 
+  // These strings identify sync-points for completing the PropertyCache
+  // lookup while HTML is being lexed.
+  static const char kLexDuringPcacheLookupPrefix[];
+  static const char kLexDuringPcacheLookupResume[];
+  static const char kLexDuringPcacheLookupStarted[];
+
   // Number of milliseconds to wait, in a test, for an event that we
   // are hoping does not occur, specifically an inappropriate call to
   // base_fetch()->HeadersComplete() while we are still mutating
@@ -399,6 +429,20 @@ class ProxyFetch : public SharedAsyncFetch {
   // in the QueuedWorkerPool::Sequence sequence_.
   void ExecuteQueued();
 
+  // Lexes text while the property cache lookup is outstanding, deferring
+  // the filters' setup until the first flush.  Deletes the strings.
+  void LexDuringPropertyCacheLookup(const StringStarVector& text);
+
+  // Ends filter-setup deferral once the lookup has completed, and records
+  // statistics on any text lexed before then.
+  void EndLexingDuringPropertyCacheLookup();
+
+  // Hands the property pages and device type saved by PropertyCacheComplete
+  // to driver_.  Called from sequence_, so it cannot race with lexing.
+  void ApplyPropertyCacheResults(FallbackPropertyPage* fallback_page,
+                                 PropertyPage* origin_page,
+                                 UserAgentMatcher::DeviceType device_type);
+
   // Schedules the task to run any buffered work, if needed. Assumes mutex
   // held.
   void ScheduleQueueExecutionIfNeeded();
@@ -412,6 +456,9 @@ class ProxyFetch : public SharedAsyncFetch {
   // Used to wrap up the FinishParseAsync invocation.
   void CompleteFinishParse(bool success);
 
+  // The trace of this request, or NULL if it's not being traced.
+  SpanTrace* span_trace();
+
   // Callback we give to ExecuteFlushIfRequestedAsync to notify us when
   // it's done with its work.
   void FlushDone();
@@ -459,6 +506,22 @@ class ProxyFetch : public SharedAsyncFetch {
   // property-caches because we discovered we are not working with HTML.
   ProxyFetchPropertyCallbackCollector* property_cache_callback_;
 
+  // Whether text may be lexed while property_cache_callback_ is outstanding.
+  bool lex_during_pcache_lookup_;
+
+  // Bytes of HTML lexed, and microseconds spent lexing them, before the
+  // property cache lookup completed.  Accessed only from sequence_.
+  int64 lexed_during_pcache_lookup_bytes_;
+  int64 lexed_during_pcache_lookup_us_;
+
+  // The results of the property cache lookup, saved by PropertyCacheComplete
+  // on the collector's thread until ExecuteQueued hands them to driver_ from
+  // sequence_.  Guarded by mutex_.
+  bool property_cache_results_pending_;
+  scoped_ptr<FallbackPropertyPage> pending_fallback_property_page_;
+  scoped_ptr<PropertyPage> pending_origin_property_page_;
+  UserAgentMatcher::DeviceType pending_device_type_;
+
   // Fetch where raw original headers and contents are sent.
   // To contrast, base_fetch() is sent rewritten contents and headers.
   // If NULL, original_content_fetch_ is ignored.
@@ -514,6 +577,11 @@ class ProxyFetch : public SharedAsyncFetch {
   // Set to true if this proxy_fetch is the result of a distributed fetch.
   bool distributed_fetch_;
 
+  // Spans covering the origin (or cache) fetch and the final flush of the
+  // parse, if the request is being traced.
+  SpanTrace::SpanId fetch_span_;
+  SpanTrace::SpanId finish_parse_span_;
+
   DISALLOW_COPY_AND_ASSIGN(ProxyFetch);
 };
 
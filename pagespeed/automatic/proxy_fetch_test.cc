@@ -34,6 +34,7 @@
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/html/html_parse_test_base.h"
 #include "pagespeed/kernel/http/http_names.h"
@@ -517,6 +518,42 @@ TEST_F(ProxyFetchPropertyCallbackCollectorTest, FallbackPagePostLookupRace) {
   mock_proxy_fetch->Done(true);
 }
 
+TEST_F(ProxyFetchPropertyCallbackCollectorTest, DetachCancelsLookupDeadline) {
+  // ProxyInterface never detaches a collector it has connected, so the
+  // deadline alarm can only be pending at Detach() when the collector is
+  // driven directly.
+  const int64 kDeadlineMs = 10;
+  EnableCollectorPrefix();
+  ProxyFetchFactory::InitStats(statistics());
+  options()->set_await_pcache_lookup(true);
+  options()->set_pcache_lookup_deadline_ms(kDeadlineMs);
+  ProxyFetchPropertyCallbackCollector* collector = MakeCollector();
+  collector->RequestHeadersComplete();
+  ProxyFetchPropertyCallback* callback = AddCallback(
+      collector, ProxyFetchPropertyCallback::kPropertyCachePage);
+  ExpectStringAsyncFetch async_fetch(
+      true, RequestContext::NewTestRequestContext(thread_system_.get()));
+  ProxyFetchFactory factory(server_context_);
+  MockProxyFetch* mock_proxy_fetch = new MockProxyFetch(
+      &async_fetch, &factory, server_context_);
+
+  // Connecting while the lookup is outstanding sets the deadline alarm, and
+  // detaching must cancel it.
+  collector->ConnectProxyFetch(mock_proxy_fetch);
+  collector->Detach(HttpStatus::kOK);
+  AdvanceTimeMs(kDeadlineMs);
+
+  // This will delete the collector.  Had the alarm fired, it would have run
+  // on the collector's sequence ahead of ExecuteDone.
+  callback->Done(true);
+  EXPECT_EQ(0, statistics()->GetVariable(
+      ProxyFetchFactory::kPcacheLookupDeadlineExpirations)->Get());
+  EXPECT_FALSE(mock_proxy_fetch->complete());
+
+  // Needed for cleanup.
+  mock_proxy_fetch->Done(true);
+}
+
 
 TEST_F(ProxyFetchPropertyCallbackCollectorTest, TestOptionsValid) {
   RewriteOptions* options = new RewriteOptions(thread_system_.get());
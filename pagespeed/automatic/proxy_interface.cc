@@ -116,6 +116,7 @@ void ProxyInterface::InitStats(Statistics* statistics) {
                                ServerContext::kStatisticsGroup);
   CacheHtmlFlow::InitStats(statistics);
   FlushEarlyFlow::InitStats(statistics);
+  ProxyFetchFactory::InitStats(statistics);
 }
 
 bool ProxyInterface::IsWellFormedUrl(const GoogleUrl& url) {
@@ -305,6 +306,11 @@ void ProxyInterface::GetRewriteOptionsDone(RequestData* request_data,
     ResourceFetch::Start(*request_url, options, using_spdy,
                          server_context_, async_fetch);
   } else {
+    // Decide whether to trace this request before anything else looks at its
+    // request context, so the property-cache lookup is included.
+    server_context_->MaybeStartSpanTrace(async_fetch->request_context(),
+                                         url_string);
+
     // TODO(nforman): If we are not running an experiment, remove the
     // experiment cookie.
     // If we don't already have custom options, and the global options say we're
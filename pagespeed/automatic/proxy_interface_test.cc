@@ -28,6 +28,7 @@
 #include "net/instaweb/http/public/reflecting_test_fetcher.h"
 #include "net/instaweb/http/public/request_context.h"
 #include "net/instaweb/http/public/request_timing_info.h"
+#include "net/instaweb/http/public/url_async_fetcher.h"
 #include "net/instaweb/rewriter/public/blink_util.h"
 #include "net/instaweb/rewriter/public/domain_lawyer.h"
 #include "net/instaweb/rewriter/public/experiment_util.h"
@@ -36,6 +37,7 @@
 #include "net/instaweb/rewriter/public/rewrite_test_base.h"
 #include "net/instaweb/rewriter/public/server_context.h"
 #include "net/instaweb/rewriter/public/test_rewrite_driver_factory.h"
+#include "net/instaweb/util/public/cache_property_store.h"
 #include "net/instaweb/util/public/fallback_property_page.h"
 #include "net/instaweb/util/public/mock_property_page.h"
 #include "net/instaweb/util/public/property_cache.h"
@@ -45,6 +47,7 @@
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/mock_message_handler.h"
 #include "pagespeed/kernel/base/mock_timer.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
@@ -55,6 +58,7 @@
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/time_util.h"
 #include "pagespeed/kernel/base/timer.h"
+#include "pagespeed/kernel/cache/delay_cache.h"
 #include "pagespeed/kernel/cache/lru_cache.h"
 #include "pagespeed/kernel/html/html_parse_test_base.h"
 #include "pagespeed/kernel/http/content_type.h"
@@ -84,6 +88,35 @@ const char kHttpsCssUrl[] = "https://www.test.com/style.css";
 const char kCssContent[] = "* { display: none; }";
 const char kMinimizedCssContent[] = "*{display:none}";
 
+// Serves every request as HTML, written in two pieces with a flush between
+// them.
+class FlushingHtmlFetcher : public UrlAsyncFetcher {
+ public:
+  FlushingHtmlFetcher(StringPiece first, StringPiece second)
+      : first_(first.data(), first.size()),
+        second_(second.data(), second.size()) {}
+  virtual ~FlushingHtmlFetcher() {}
+
+  virtual void Fetch(const GoogleString& url,
+                     MessageHandler* message_handler,
+                     AsyncFetch* fetch) {
+    ResponseHeaders* headers = fetch->response_headers();
+    headers->SetStatusAndReason(HttpStatus::kOK);
+    headers->Add(HttpAttributes::kContentType, kContentTypeHtml.mime_type());
+    headers->ComputeCaching();
+    fetch->Write(first_, message_handler);
+    fetch->Flush(message_handler);
+    fetch->Write(second_, message_handler);
+    fetch->Done(true);
+  }
+
+ private:
+  GoogleString first_;
+  GoogleString second_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlushingHtmlFetcher);
+};
+
 }  // namespace
 
 class ProxyInterfaceTest : public ProxyInterfaceTestBase {
@@ -308,6 +341,46 @@ class ProxyInterfaceTest : public ProxyInterfaceTestBase {
                  get_headers.ToString());
   }
 
+  void SetLexHtmlDuringPcacheLookup(bool lex) {
+    RewriteOptions* options = server_context()->global_options();
+    options->ClearSignatureForTesting();
+    options->set_lex_html_during_pcache_lookup(lex);
+    server_context()->ComputeSignature(options);
+  }
+
+  // Returns the key under which the dom cohort of url is looked up, so that
+  // a test can hold the property-cache lookup in the delay cache.
+  GoogleString DomCohortCacheKey(const StringPiece& url) {
+    const PropertyCache::Cohort* cohort =
+        page_property_cache()->GetCohort(RewriteDriver::kDomCohort);
+    return factory()->cache_property_store()->CacheKey(
+        AbsolutifyUrl(url), "",
+        UserAgentMatcher::DeviceTypeSuffix(UserAgentMatcher::kDesktop),
+        cohort);
+  }
+
+  // Fetches url, holding its property-cache lookup until the origin response
+  // has been delivered in full and the html worker has gone idle, so
+  // everything the ProxyFetch does with the response happens while the
+  // lookup is outstanding.  Flushes are logged in text_out.
+  void FetchWithPcacheLookupOutstanding(const StringPiece& url,
+                                        GoogleString* text_out) {
+    GoogleString pcache_key = DomCohortCacheKey(url);
+    delay_cache()->DelayKey(pcache_key);
+    RequestHeaders request_headers;
+    ResponseHeaders headers_out;
+    FetchFromProxyNoWait(url, request_headers, true, true /* log_flush */,
+                         &headers_out);
+    mock_scheduler()->AwaitQuiescence();
+    delay_cache()->ReleaseKey(pcache_key);
+    WaitForFetch(true);
+    *text_out = callback_buffer_;
+  }
+
+  int64 StatValue(const char* name) {
+    return statistics()->GetVariable(name)->Get();
+  }
+
   scoped_ptr<BackgroundFetchCheckingUrlAsyncFetcher> background_fetch_fetcher_;
   int64 start_time_ms_;
   GoogleString start_time_string_;
@@ -3196,9 +3269,122 @@ TEST_F(ProxyInterfaceTest, HeadersSetupRace) {
   sync->AllowSloppyTermination(ProxyFetch::kHeadersSetupRaceAlarmQueued);
 }
 
-// TODO(jmarantz): add a test with a simulated slow cache to see what happens
-// when the rest of the system must block, buffering up incoming HTML text,
-// waiting for the property-cache lookups to complete.
+TEST_F(ProxyInterfaceTest, LexHtmlWhilePcacheLookupOutstanding) {
+  // The whole response, including Done, arrives while the property-cache
+  // lookup is held.  Lexing it early must not change what we serve.
+  DisableAjax();
+  const char kContent[] =
+      "<html><head><style>* { display: none; }</style></head>"
+      "<body><div><p></p></div></body></html>";
+  SetResponseWithDefaultHeaders(kPageUrl, kContentTypeHtml, kContent, 0);
+
+  GoogleString buffered_text;
+  FetchWithPcacheLookupOutstanding(kPageUrl, &buffered_text);
+  EXPECT_EQ(0, StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupRequests));
+
+  SetLexHtmlDuringPcacheLookup(true);
+  GoogleString lexed_text;
+  FetchWithPcacheLookupOutstanding(kPageUrl, &lexed_text);
+  EXPECT_EQ(buffered_text, lexed_text);
+  EXPECT_EQ(1, StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupRequests));
+  // Bytes are only counted when lexed before the lookup completed.
+  EXPECT_EQ(static_cast<int64>(STATIC_STRLEN(kContent)),
+            StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupBytes));
+}
+
+TEST_F(ProxyInterfaceTest, LexHtmlWithFlushWhilePcacheLookupOutstanding) {
+  // A flush from the origin arrives between two writes, then Done, all while
+  // the property-cache lookup is held.  The flush must wait for the lookup
+  // rather than be dropped or served early.
+  DisableAjax();
+  RewriteOptions* options = server_context()->global_options();
+  options->ClearSignatureForTesting();
+  options->set_flush_html(true);
+  server_context()->ComputeSignature(options);
+  const char kFirst[] = "<html><head><style>* { display: none; }</style>";
+  const char kSecond[] = "</head><body><div><p></p></div></body></html>";
+  FlushingHtmlFetcher fetcher(kFirst, kSecond);
+  server_context()->set_default_system_fetcher(&fetcher);
+
+  GoogleString buffered_text;
+  FetchWithPcacheLookupOutstanding(kPageUrl, &buffered_text);
+
+  SetLexHtmlDuringPcacheLookup(true);
+  GoogleString lexed_text;
+  FetchWithPcacheLookupOutstanding(kPageUrl, &lexed_text);
+  EXPECT_EQ(buffered_text, lexed_text);
+  EXPECT_EQ(1, StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupRequests));
+  EXPECT_EQ(static_cast<int64>(STATIC_STRLEN(kFirst) + STATIC_STRLEN(kSecond)),
+            StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupBytes));
+}
+
+TEST_F(ProxyInterfaceTest, PcacheLookupCompletesWhileLexing) {
+  // The lookup completes on the collector's thread while the html worker is
+  // in the middle of lexing.  The property pages must reach the driver from
+  // the html worker afterwards, and the page must come out as if it had all
+  // been buffered.
+  DisableAjax();
+  const char kContent[] =
+      "<html><head><style>* { display: none; }</style></head>"
+      "<body><div><p></p></div></body></html>";
+  SetResponseWithDefaultHeaders(kPageUrl, kContentTypeHtml, kContent, 0);
+  GoogleString buffered_text;
+  FetchWithPcacheLookupOutstanding(kPageUrl, &buffered_text);
+
+  SetLexHtmlDuringPcacheLookup(true);
+  ThreadSynchronizer* sync = server_context()->thread_synchronizer();
+  sync->EnableForPrefix(ProxyFetch::kLexDuringPcacheLookupPrefix);
+  GoogleString pcache_key = DomCohortCacheKey(kPageUrl);
+  delay_cache()->DelayKey(pcache_key);
+  RequestHeaders request_headers;
+  ResponseHeaders headers_out;
+  FetchFromProxyNoWait(kPageUrl, request_headers, true, true /* log_flush */,
+                       &headers_out);
+  sync->Wait(ProxyFetch::kLexDuringPcacheLookupStarted);
+  delay_cache()->ReleaseKey(pcache_key);
+  sync->Signal(ProxyFetch::kLexDuringPcacheLookupResume);
+  WaitForFetch(true);
+  EXPECT_EQ(buffered_text, callback_buffer_);
+  EXPECT_EQ(1, StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupRequests));
+  EXPECT_EQ(static_cast<int64>(STATIC_STRLEN(kContent)),
+            StatValue(ProxyFetchFactory::kLexedDuringPcacheLookupBytes));
+}
+
+TEST_F(ProxyInterfaceTest, PcacheLookupDeadlineExpires) {
+  const int64 kDeadlineMs = 10;
+  DisableAjax();
+  GoogleString expected_text;
+  ResponseHeaders headers;
+  FetchFromProxy(kPageUrl, true, &expected_text, &headers);
+
+  RewriteOptions* options = server_context()->global_options();
+  options->ClearSignatureForTesting();
+  options->set_await_pcache_lookup(true);
+  options->set_pcache_lookup_deadline_ms(kDeadlineMs);
+  server_context()->ComputeSignature(options);
+  factory()->cache_property_store()->set_enable_get_cancellation(true);
+
+  GoogleString pcache_key = DomCohortCacheKey(kPageUrl);
+  delay_cache()->DelayKey(pcache_key);
+  RequestHeaders request_headers;
+  ResponseHeaders headers_out;
+  FetchFromProxyNoWait(kPageUrl, request_headers, true, false, &headers_out);
+  EXPECT_EQ(0, StatValue(ProxyFetchFactory::kPcacheLookupDeadlineExpirations));
+
+  // The expired deadline finishes the lookup from the collector's own
+  // sequence, so Done() must not block there waiting for ExecuteDone; we
+  // consume ExecuteDone's signal ourselves below.
+  ThreadSynchronizer* sync = server_context()->thread_synchronizer();
+  sync->Signal(ProxyFetch::kCollectorDoneFinish);
+  AdvanceTimeMs(kDeadlineMs);
+
+  // The page is served without waiting for the held lookup.
+  WaitForFetch(true);
+  sync->Wait(ProxyFetch::kCollectorDoneFinish);
+  EXPECT_EQ(expected_text, callback_buffer_);
+  EXPECT_EQ(1, StatValue(ProxyFetchFactory::kPcacheLookupDeadlineExpirations));
+  delay_cache()->ReleaseKey(pcache_key);
+}
 
 // Test that we set the Experiment cookie up appropriately.
 TEST_F(ProxyInterfaceTest, ExperimentTest) {
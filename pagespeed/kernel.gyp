@@ -87,6 +87,7 @@
         'kernel/base/chunking_writer.cc',
         'kernel/base/circular_buffer.cc',
         'kernel/base/condvar.cc',
+        'kernel/base/cost_tracker.cc',
         'kernel/base/countdown_timer.cc',
         'kernel/base/escaping.cc',
         'kernel/base/fast_wildcard_group.cc',
@@ -107,6 +108,7 @@
         'kernel/base/shared_string.cc',
         'kernel/base/signature.cc',
         'kernel/base/source_map.cc',
+        'kernel/base/span_trace.cc',
         'kernel/base/split_statistics.cc',
         'kernel/base/split_writer.cc',
         'kernel/base/thread.cc',
@@ -190,6 +192,7 @@
       'sources': [
         'kernel/cache/async_cache.cc',
         'kernel/cache/cache_batcher.cc',
+        'kernel/cache/cache_snapshot.cc',
         'kernel/cache/cache_stats.cc',
         'kernel/cache/compressed_cache.cc',
         'kernel/cache/delegating_cache_callback.cc',
@@ -282,6 +285,7 @@
       ],
       'dependencies': [
         '<(DEPTH)/third_party/domain_registry_provider/src/domain_registry/domain_registry.gyp:init_registry_tables_lib',
+        '<(DEPTH)/third_party/rdestl/rdestl.gyp:rdestl',
         'pagespeed_http_core',
         'pagespeed_http_gperf',
         'pagespeed_http_pb',
@@ -335,6 +339,7 @@
       'target_name': 'jsminify',
       'type': '<(library)',
       'sources': [
+        'kernel/js/js_local_renamer.cc',
         'kernel/js/js_minify.cc',
       ],
       # TODO(bmcquade): We should fix the code so this is not needed.
@@ -352,6 +357,7 @@
       'target_name': 'js_tokenizer',
       'type': '<(library)',
       'sources': [
+        'kernel/js/js_token_scanner.cc',
         'kernel/js/js_tokenizer.cc',
       ],
       'include_dirs': [
@@ -389,6 +395,7 @@
         'kernel/util/nonce_generator.cc',
         'kernel/util/simple_random.cc',
         'kernel/util/statistics_logger.cc',
+        'kernel/util/statistics_time_series.cc',
         'kernel/util/statistics_work_bound.cc',
         'kernel/util/url_escaper.cc',
         'kernel/util/url_multipart_encoder.cc',
@@ -427,6 +434,7 @@
         'kernel/image/image_converter.cc',
         'kernel/image/image_frame_interface.cc',
         'kernel/image/image_resizer.cc',
+        'kernel/image/image_similarity.cc',
         'kernel/image/image_util.cc',
         'kernel/image/jpeg_optimizer.cc',
         'kernel/image/jpeg_reader.cc',
@@ -58,6 +58,9 @@ class CircularBuffer {
   bool Write(const StringPiece& message);
   // Return data content as string.
   GoogleString ToString(MessageHandler* handler);
+  // Whether writes have wrapped around the end of the buffer since it was
+  // last cleared, in which case the oldest content may have been truncated.
+  bool wrapped() const { return wrapped_; }
 
  private:
   // Can't construct -- must call Create() or Init() from a pre-allocated
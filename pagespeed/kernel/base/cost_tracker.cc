@@ -0,0 +1,159 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/base/cost_tracker.h"
+
+#include <sys/resource.h>
+#include <time.h>
+#include <algorithm>
+
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/base/timer.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char* const kSortOrderNames[] = {
+  "name", "calls", "events", "cpu", "wall", "max_wall",
+};
+
+int64 SortKey(CostTracker::SortOrder order, const CostTracker::Cost& cost) {
+  switch (order) {
+    case CostTracker::kByName: return 0;
+    case CostTracker::kByCalls: return cost.calls;
+    case CostTracker::kByEvents: return cost.events;
+    case CostTracker::kByCpu: return cost.cpu_us;
+    case CostTracker::kByWall: return cost.wall_us;
+    case CostTracker::kByMaxWall: return cost.max_wall_us;
+  }
+  return 0;
+}
+
+// Orders by descending cost, breaking ties by name.
+class CostGreater {
+ public:
+  explicit CostGreater(CostTracker::SortOrder order) : order_(order) {}
+
+  bool operator()(const std::pair<GoogleString, CostTracker::Cost>& a,
+                  const std::pair<GoogleString, CostTracker::Cost>& b) const {
+    int64 key_a = SortKey(order_, a.second);
+    int64 key_b = SortKey(order_, b.second);
+    if (key_a != key_b) {
+      return key_a > key_b;
+    }
+    return a.first < b.first;
+  }
+
+ private:
+  CostTracker::SortOrder order_;
+};
+
+}  // namespace
+
+CostTracker::Measurement::Measurement(CostTracker* tracker)
+    : tracker_(tracker),
+      start_cpu_us_(0),
+      start_wall_us_(0) {
+  if (tracker_ != NULL) {
+    start_cpu_us_ = tracker_->CpuUs();
+    start_wall_us_ = tracker_->timer()->NowUs();
+  }
+}
+
+void CostTracker::Measurement::Record(StringPiece name, int64 events) {
+  if (tracker_ != NULL) {
+    tracker_->Record(name, events, tracker_->CpuUs() - start_cpu_us_,
+                     tracker_->timer()->NowUs() - start_wall_us_);
+  }
+}
+
+CostTracker::CostTracker(Timer* timer, ThreadSystem* thread_system)
+    : timer_(timer),
+      cpu_timer_(NULL),
+      mutex_(thread_system->NewMutex()) {
+}
+
+CostTracker::~CostTracker() {
+}
+
+void CostTracker::Record(StringPiece name, int64 events, int64 cpu_us,
+                         int64 wall_us) {
+  ScopedMutex lock(mutex_.get());
+  Cost& cost = costs_[name.as_string()];
+  ++cost.calls;
+  cost.events += events;
+  cost.cpu_us += cpu_us;
+  cost.wall_us += wall_us;
+  cost.max_wall_us = std::max(cost.max_wall_us, wall_us);
+}
+
+void CostTracker::GetCosts(SortOrder order, CostVector* costs) const {
+  costs->clear();
+  {
+    ScopedMutex lock(mutex_.get());
+    costs->assign(costs_.begin(), costs_.end());
+  }
+  // The map already orders by name.
+  if (order != kByName) {
+    std::stable_sort(costs->begin(), costs->end(), CostGreater(order));
+  }
+}
+
+CostTracker::SortOrder CostTracker::ParseSortOrder(StringPiece name) {
+  for (int i = 0, n = arraysize(kSortOrderNames); i < n; ++i) {
+    if (name == kSortOrderNames[i]) {
+      return static_cast<SortOrder>(i);
+    }
+  }
+  return kByCpu;
+}
+
+const char* CostTracker::SortOrderName(SortOrder order) {
+  return kSortOrderNames[order];
+}
+
+void CostTracker::Clear() {
+  ScopedMutex lock(mutex_.get());
+  costs_.clear();
+}
+
+int64 CostTracker::CpuUs() const {
+  return (cpu_timer_ == NULL) ? ThreadCpuUs() : cpu_timer_->NowUs();
+}
+
+int64 CostTracker::ThreadCpuUs() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+    return (static_cast<int64>(ts.tv_sec) * Timer::kSecondUs) +
+        (ts.tv_nsec / 1000);
+  }
+#endif
+#ifdef RUSAGE_THREAD
+  // See http://linux.die.net/man/2/getrusage -- RUSAGE_THREAD is supported
+  // on Linux since Linux 2.6.26.
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+    return (static_cast<int64>(usage.ru_utime.tv_sec) * Timer::kSecondUs) +
+        usage.ru_utime.tv_usec;
+  }
+#endif
+  return 0;
+}
+
+}  // namespace net_instaweb
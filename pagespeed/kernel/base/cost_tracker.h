@@ -0,0 +1,124 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_BASE_COST_TRACKER_H_
+#define PAGESPEED_KERNEL_BASE_COST_TRACKER_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_annotations.h"
+
+namespace net_instaweb {
+
+class AbstractMutex;
+class ThreadSystem;
+class Timer;
+
+// Accumulates the CPU time, wall-clock time and amount of work done by named
+// components -- HTML filters, rewriters -- so the expensive ones can be
+// identified.  The tracker is thread-safe; each Record takes a lock, so
+// measurements should be made around units of work that are large compared
+// to that, such as a filter's pass over a flush window.
+class CostTracker {
+ public:
+  struct Cost {
+    Cost() : calls(0), events(0), cpu_us(0), wall_us(0), max_wall_us(0) {}
+
+    int64 calls;
+    int64 events;       // Units of work processed, as defined by the caller.
+    int64 cpu_us;       // CPU time of the recording thread.
+    int64 wall_us;
+    int64 max_wall_us;  // Longest single call.
+  };
+
+  typedef std::vector<std::pair<GoogleString, Cost> > CostVector;
+
+  enum SortOrder {
+    kByName,
+    kByCalls,
+    kByEvents,
+    kByCpu,
+    kByWall,
+    kByMaxWall,
+  };
+
+  // Measures the CPU and wall time from its construction until Record is
+  // called, and adds them to a tracker.  The tracker may be NULL, in which
+  // case nothing is measured and Record does nothing.
+  class Measurement {
+   public:
+    explicit Measurement(CostTracker* tracker);
+
+    void Record(StringPiece name, int64 events);
+
+   private:
+    CostTracker* tracker_;
+    int64 start_cpu_us_;
+    int64 start_wall_us_;
+
+    DISALLOW_COPY_AND_ASSIGN(Measurement);
+  };
+
+  CostTracker(Timer* timer, ThreadSystem* thread_system);
+  ~CostTracker();
+
+  void Record(StringPiece name, int64 events, int64 cpu_us, int64 wall_us);
+
+  // Copies the accumulated costs into *costs, ordered as requested: by name
+  // ascending, or otherwise by the chosen cost descending.
+  void GetCosts(SortOrder order, CostVector* costs) const;
+
+  // Parses the name of a sort order as used by SortOrderName, returning
+  // kByCpu if it is not recognized.
+  static SortOrder ParseSortOrder(StringPiece name);
+  static const char* SortOrderName(SortOrder order);
+
+  void Clear();
+
+  // Returns the CPU time consumed so far by the calling thread, or 0 if the
+  // platform can't measure it.
+  static int64 ThreadCpuUs();
+
+  // Returns the CPU time Measurements are taken against: ThreadCpuUs(),
+  // unless a CPU timer has been set.
+  int64 CpuUs() const;
+
+  // For testing: reads CPU time from cpu_timer rather than from the calling
+  // thread's clock.  Does not take ownership.
+  void set_cpu_timer(Timer* cpu_timer) { cpu_timer_ = cpu_timer; }
+
+  Timer* timer() const { return timer_; }
+
+ private:
+  typedef std::map<GoogleString, Cost> CostMap;
+
+  Timer* timer_;
+  Timer* cpu_timer_;
+  scoped_ptr<AbstractMutex> mutex_;
+  CostMap costs_ GUARDED_BY(mutex_);
+
+  DISALLOW_COPY_AND_ASSIGN(CostTracker);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_KERNEL_BASE_COST_TRACKER_H_
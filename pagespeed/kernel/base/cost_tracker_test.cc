@@ -0,0 +1,143 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/base/cost_tracker.h"
+
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/mock_timer.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/util/platform.h"
+
+namespace net_instaweb {
+
+namespace {
+
+class CostTrackerTest : public testing::Test {
+ protected:
+  CostTrackerTest()
+      : thread_system_(Platform::CreateThreadSystem()),
+        timer_(thread_system_->NewMutex(), MockTimer::kApr_5_2010_ms),
+        cpu_timer_(thread_system_->NewMutex(), 0),
+        tracker_(&timer_, thread_system_.get()) {
+    tracker_.set_cpu_timer(&cpu_timer_);
+  }
+
+  scoped_ptr<ThreadSystem> thread_system_;
+  MockTimer timer_;
+  MockTimer cpu_timer_;
+  CostTracker tracker_;
+};
+
+TEST_F(CostTrackerTest, Accumulates) {
+  tracker_.Record("a", 10, 5, 100);
+  tracker_.Record("a", 20, 7, 300);
+  tracker_.Record("b", 1, 50, 60);
+
+  CostTracker::CostVector costs;
+  tracker_.GetCosts(CostTracker::kByName, &costs);
+  ASSERT_EQ(2, costs.size());
+  EXPECT_EQ("a", costs[0].first);
+  EXPECT_EQ(2, costs[0].second.calls);
+  EXPECT_EQ(30, costs[0].second.events);
+  EXPECT_EQ(12, costs[0].second.cpu_us);
+  EXPECT_EQ(400, costs[0].second.wall_us);
+  EXPECT_EQ(300, costs[0].second.max_wall_us);
+  EXPECT_EQ("b", costs[1].first);
+  EXPECT_EQ(1, costs[1].second.calls);
+
+  tracker_.Clear();
+  tracker_.GetCosts(CostTracker::kByName, &costs);
+  EXPECT_TRUE(costs.empty());
+}
+
+TEST_F(CostTrackerTest, Sorting) {
+  tracker_.Record("a", 10, 5, 100);
+  tracker_.Record("b", 1, 50, 60);
+  tracker_.Record("c", 5, 50, 200);
+
+  CostTracker::CostVector costs;
+  tracker_.GetCosts(CostTracker::kByCpu, &costs);
+  ASSERT_EQ(3, costs.size());
+  // Ties are broken by name.
+  EXPECT_EQ("b", costs[0].first);
+  EXPECT_EQ("c", costs[1].first);
+  EXPECT_EQ("a", costs[2].first);
+
+  tracker_.GetCosts(CostTracker::kByEvents, &costs);
+  EXPECT_EQ("a", costs[0].first);
+  EXPECT_EQ("c", costs[1].first);
+  EXPECT_EQ("b", costs[2].first);
+
+  tracker_.GetCosts(CostTracker::kByWall, &costs);
+  EXPECT_EQ("c", costs[0].first);
+  EXPECT_EQ("a", costs[1].first);
+  EXPECT_EQ("b", costs[2].first);
+}
+
+TEST_F(CostTrackerTest, SortOrderNames) {
+  for (int i = CostTracker::kByName; i <= CostTracker::kByMaxWall; ++i) {
+    CostTracker::SortOrder order = static_cast<CostTracker::SortOrder>(i);
+    EXPECT_EQ(order,
+              CostTracker::ParseSortOrder(CostTracker::SortOrderName(order)));
+  }
+  EXPECT_EQ(CostTracker::kByCpu, CostTracker::ParseSortOrder("bogus"));
+}
+
+TEST_F(CostTrackerTest, Measurement) {
+  {
+    CostTracker::Measurement measurement(&tracker_);
+    timer_.AdvanceUs(250);
+    cpu_timer_.AdvanceUs(120);
+    measurement.Record("filter", 42);
+  }
+  CostTracker::CostVector costs;
+  tracker_.GetCosts(CostTracker::kByName, &costs);
+  ASSERT_EQ(1, costs.size());
+  EXPECT_EQ("filter", costs[0].first);
+  EXPECT_EQ(1, costs[0].second.calls);
+  EXPECT_EQ(42, costs[0].second.events);
+  EXPECT_EQ(250, costs[0].second.wall_us);
+  EXPECT_EQ(120, costs[0].second.cpu_us);
+
+  // A measurement without a tracker does nothing.
+  CostTracker::Measurement null_measurement(NULL);
+  null_measurement.Record("ignored", 1);
+}
+
+TEST_F(CostTrackerTest, MeasurementsAccumulate) {
+  // Only the time between a measurement's construction and its Record is
+  // charged, so time spent outside measurements is not.
+  for (int i = 0; i < 3; ++i) {
+    CostTracker::Measurement measurement(&tracker_);
+    timer_.AdvanceUs(100);
+    cpu_timer_.AdvanceUs(40);
+    measurement.Record("filter", 1);
+    timer_.AdvanceUs(1000);
+    cpu_timer_.AdvanceUs(500);
+  }
+  CostTracker::CostVector costs;
+  tracker_.GetCosts(CostTracker::kByName, &costs);
+  ASSERT_EQ(1, costs.size());
+  EXPECT_EQ(3, costs[0].second.calls);
+  EXPECT_EQ(300, costs[0].second.wall_us);
+  EXPECT_EQ(120, costs[0].second.cpu_us);
+  EXPECT_EQ(100, costs[0].second.max_wall_us);
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -19,6 +19,8 @@
 #include "pagespeed/kernel/base/fast_wildcard_group.h"
 
 #include <algorithm>
+#include <deque>
+#include <utility>
 #include <vector>
 
 #include "base/logging.h"
@@ -27,7 +29,6 @@
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
-#include "pagespeed/kernel/base/rolling_hash.h"
 #include "pagespeed/kernel/base/wildcard.h"
 
 namespace net_instaweb {
@@ -37,12 +38,11 @@ namespace {
 // non-wildcard-only patterns.
 const int kMinPatterns = 11;
 
-// Maximum rolling hash window size
-const int32 kMaxRollingHashWindow = 256;
-
-// Special index value for unused hash table entry.
+// Special index value for no pattern or no automaton state.
 const int kNoEntry = -1;
 
+const int kRootState = 0;
+
 StringPiece LongestLiteralStringInWildcard(const Wildcard* wildcard) {
   StringPiece spec = wildcard->spec();
   const char kWildcardChars[] = { Wildcard::kMatchAny, Wildcard::kMatchOne };
@@ -72,14 +72,14 @@ FastWildcardGroup::~FastWildcardGroup() {
 }
 
 void FastWildcardGroup::Uncompile() {
-  if (rolling_hash_length_.value() == kUncompiled) {
+  if (compile_state_.value() == kUncompiled) {
     return;
   }
-  rolling_hash_length_.set_value(kUncompiled);
-  rolling_hashes_.clear();
+  compile_state_.set_value(kUncompiled);
+  states_.clear();
+  root_transitions_.clear();
   effective_indices_.clear();
   wildcard_only_indices_.clear();
-  pattern_hash_index_.clear();
 }
 
 void FastWildcardGroup::Clear() {
@@ -88,47 +88,57 @@ void FastWildcardGroup::Clear() {
   allow_.clear();
 }
 
-inline int& FastWildcardGroup::pattern_hash_index(uint64 rolling_hash) const {
-  // We exploit the fact that pattern_hash_index.size() is a power of two
-  // to do integer modulus by bit masking.
-  return pattern_hash_index_[rolling_hash & (pattern_hash_index_.size() - 1)];
+inline int FastWildcardGroup::Transition(int state, char ch) const {
+  if (state == kRootState) {
+    return root_transitions_[static_cast<unsigned char>(ch)];
+  }
+  const std::vector<std::pair<char, int> >& children = states_[state].children;
+  for (int i = 0, n = children.size(); i < n; ++i) {
+    if (children[i].first == ch) {
+      return children[i].second;
+    }
+  }
+  return kNoEntry;
+}
+
+int FastWildcardGroup::AddTransition(int state, char ch) const {
+  int next = Transition(state, ch);
+  if (next == kNoEntry) {
+    next = states_.size();
+    states_.push_back(AutomatonState());
+    if (state == kRootState) {
+      root_transitions_[static_cast<unsigned char>(ch)] = next;
+    } else {
+      states_[state].children.push_back(std::make_pair(ch, next));
+    }
+  }
+  return next;
 }
 
 void FastWildcardGroup::CompileNonTrivial() const {
   // First, assemble longest literal strings of each pattern
   std::vector<StringPiece> longest_literal_strings;
   int num_nontrivial_patterns = 0;
-  int32 rolling_hash_length = kMaxRollingHashWindow;
   for (int i = 0; i < static_cast<int>(wildcards_.size()); ++i) {
     longest_literal_strings.push_back(
         LongestLiteralStringInWildcard(wildcards_[i]));
     DCHECK_EQ(i + 1, static_cast<int>(longest_literal_strings.size()));
-    int length = longest_literal_strings[i].size();
-    if (length > 0) {
+    if (!longest_literal_strings[i].empty()) {
       ++num_nontrivial_patterns;
-      rolling_hash_length = std::min(rolling_hash_length, length);
     }
   }
   if (num_nontrivial_patterns < kMinPatterns) {
     // Not enough non-trivial patterns.
-    DCHECK_EQ(kDontHash, rolling_hash_length_.value());
+    DCHECK_EQ(kMatchNaively, compile_state_.value());
     return;
   }
-  // Allocate a hash table that's power-of-2 sized and >=
-  // 2*num_nontrivial_patterns.
-  int hash_index_size;
-  for (hash_index_size = 8;
-       hash_index_size < 2 * num_nontrivial_patterns;
-       hash_index_size *= 2) { }
-  pattern_hash_index_.resize(hash_index_size, kNoEntry);
-  rolling_hashes_.resize(wildcards_.size());
+  states_.push_back(AutomatonState());
+  root_transitions_.assign(256, kNoEntry);
   effective_indices_.resize(allow_.size());
   int current_effective_index = allow_.size() - 1;
   bool current_allow = allow_[current_effective_index];
-  // Fill in the hash table with a rolling hash.  We do this in
-  // reverse order so that collisions will result in the later
-  // pattern being matched first (if that succeeds, no further
-  // matching will be required).
+  // Build the trie of literals.  We do this in reverse order so that each
+  // state's patterns (and wildcard_only_indices_) end up latest first.
   for (int i = longest_literal_strings.size() - 1; i >= 0; --i) {
     const StringPiece literal(longest_literal_strings[i]);
     if (allow_[i] != current_allow) {
@@ -141,76 +151,90 @@ void FastWildcardGroup::CompileNonTrivial() const {
     DCHECK_LE(i, current_effective_index);
     DCHECK_EQ(allow_[i], current_allow);
     DCHECK_EQ(current_allow, allow_[effective_indices_[i]]);
-    if (literal.size() == 0) {
+    if (literal.empty()) {
       // All-wildcard pattern.
       wildcard_only_indices_.push_back(i);
-      rolling_hashes_[i] = 0;
     } else {
-      DCHECK_GE(static_cast<int>(literal.size()), rolling_hash_length);
-      // If possible, find a non-colliding rolling hash taken from literal.  If
-      // the first hash collides, using a different hash is OK; we'll still end
-      // up checking both matches in the table for an input that matches both.
-      // The goal is to avoid chaining by spreading the entries out across the
-      // table.
-      // TODO(jmaessen): Consider re-hashing the current entry as well on
-      // collision to favor collision-free hash tables.
-      int max_start = literal.size() - rolling_hash_length;
-      int start = 0;
-      uint64 rolling_hash =
-          RollingHash(literal.data(), start, rolling_hash_length);
-      for (start = 1;
-           start <= max_start && pattern_hash_index(rolling_hash) != kNoEntry;
-           ++start) {
-        rolling_hash = NextRollingHash(literal.data(), start,
-                                       rolling_hash_length, rolling_hash);
+      int state = kRootState;
+      for (int j = 0, n = literal.size(); j < n; ++j) {
+        state = AddTransition(state, literal[j]);
       }
-      // Now insert the entry, dealing with any collisions.
-      rolling_hashes_[i] = rolling_hash;
-      while (pattern_hash_index(rolling_hash) != kNoEntry) {
-        ++rolling_hash;
+      states_[state].patterns.push_back(i);
+    }
+  }
+  // Now fill in the failure and output links breadth-first, so that the
+  // states they point to (which are shallower) are always done already.
+  std::deque<int> queue;
+  for (int ch = 0; ch < 256; ++ch) {
+    int child = root_transitions_[ch];
+    if (child == kNoEntry) {
+      // Missing transitions from the root just stay there.
+      root_transitions_[ch] = kRootState;
+    } else {
+      queue.push_back(child);
+    }
+  }
+  while (!queue.empty()) {
+    const int state = queue.front();
+    queue.pop_front();
+    AutomatonState* current = &states_[state];
+    const AutomatonState& failure = states_[current->failure];
+    current->output =
+        failure.patterns.empty() ? failure.output : current->failure;
+    current->latest_pattern = failure.latest_pattern;
+    if (!current->patterns.empty()) {
+      current->latest_pattern =
+          std::max(current->latest_pattern, current->patterns[0]);
+    }
+    for (int i = 0, n = current->children.size(); i < n; ++i) {
+      const char ch = current->children[i].first;
+      const int child = current->children[i].second;
+      int fallback = current->failure;
+      int next;
+      while ((next = Transition(fallback, ch)) == kNoEntry) {
+        fallback = states_[fallback].failure;
       }
-      pattern_hash_index(rolling_hash) = i;
+      states_[child].failure = next;
+      queue.push_back(child);
     }
   }
-  // Finally, after all the metadata is initialized, make rolling_hash_length
+  // Finally, after all the metadata is initialized, make the compiled state
   // visible to the world.  This has release semantics, meaning that if another
-  // thread reads rolling_hash_length_ (with acquire semantics) and gets the
-  // value we set here, it is guaranteed to see all the preceding writes we did
-  // to the other compilation metadata.
-  rolling_hash_length_.set_value(rolling_hash_length);
+  // thread reads compile_state_ (with acquire semantics) and gets the value we
+  // set here, it is guaranteed to see all the preceding writes we did to the
+  // other compilation metadata.
+  compile_state_.set_value(kCompiled);
 }
 
 void FastWildcardGroup::Compile() const {
   // Basic invariant
   CHECK_EQ(wildcards_.size(), allow_.size());
   // Make sure we don't have cruft left around from a previous compile.
-  CHECK_EQ(0, static_cast<int>(rolling_hashes_.size()));
+  CHECK_EQ(0, static_cast<int>(states_.size()));
+  CHECK_EQ(0, static_cast<int>(root_transitions_.size()));
   CHECK_EQ(0, static_cast<int>(effective_indices_.size()));
   CHECK_EQ(0, static_cast<int>(wildcard_only_indices_.size()));
-  CHECK_EQ(0, static_cast<int>(pattern_hash_index_.size()));
-  CHECK_EQ(kDontHash, rolling_hash_length_.value());
+  CHECK_EQ(kMatchNaively, compile_state_.value());
 
   if (static_cast<int>(wildcards_.size()) >= kMinPatterns) {
-    // Slow path, compute metadata and set rolling_hash_length_ to
-    // its final value.
+    // Slow path, compute metadata and set compile_state_ to its final value.
     CompileNonTrivial();
   }
 
   // When we're done, things should be in a sensible state.
-  int32 rolling_hash_length = rolling_hash_length_.value();
-  DCHECK_NE(kUncompiled, rolling_hash_length);
-  if (rolling_hash_length == kDontHash) {
-    DCHECK_EQ(0, static_cast<int>(rolling_hashes_.size()));
+  int32 compile_state = compile_state_.value();
+  DCHECK_NE(kUncompiled, compile_state);
+  if (compile_state == kMatchNaively) {
+    DCHECK_EQ(0, static_cast<int>(states_.size()));
+    DCHECK_EQ(0, static_cast<int>(root_transitions_.size()));
     DCHECK_EQ(0, static_cast<int>(effective_indices_.size()));
     DCHECK_EQ(0, static_cast<int>(wildcard_only_indices_.size()));
-    DCHECK_EQ(0, static_cast<int>(pattern_hash_index_.size()));
   } else {
-    DCHECK_LT(0, rolling_hash_length);
-    DCHECK_EQ(wildcards_.size(), rolling_hashes_.size());
+    DCHECK_EQ(kCompiled, compile_state);
     DCHECK_EQ(wildcards_.size(), effective_indices_.size());
-    int hash_pats = wildcards_.size() - wildcard_only_indices_.size();
-    DCHECK_LE(kMinPatterns, hash_pats);
-    DCHECK_LE(2 * hash_pats, static_cast<int>(pattern_hash_index_.size()));
+    DCHECK_EQ(256, static_cast<int>(root_transitions_.size()));
+    int indexed_patterns = wildcards_.size() - wildcard_only_indices_.size();
+    DCHECK_LE(kMinPatterns, indexed_patterns);
   }
 }
 
@@ -229,33 +253,33 @@ void FastWildcardGroup::Disallow(const StringPiece& expr) {
 }
 
 bool FastWildcardGroup::Match(const StringPiece& str, bool allow) const {
-  int32 rolling_hash_length = rolling_hash_length_.value();
+  int32 compile_state = compile_state_.value();
   // The previous read has acquire semantics, and all writes to
-  // rolling_hash_length_ have release semantics.  This means we'll see the
-  // results of compilation if rolling_hash_length > 0.
+  // compile_state_ have release semantics.  This means we'll see the
+  // results of compilation if compile_state == kCompiled.
   //
   // NOTE: it is unsafe (and expensive) to just CompareAndSwap (CAS) here.
   //  AtomicInt32::CAS guarantees release semantics but not acquire semantics.
   //  As a result we would potentially miss the results of compilation released
-  //  by a prior write to rolling_hash_length_.  This would cause us to read
+  //  by a prior write to compile_state_.  This would cause us to read
   //  inconsistent compilation metadata, possibly resulting in a crash.
-  if (rolling_hash_length == kUncompiled) {
-    if (rolling_hash_length_.CompareAndSwap(kUncompiled, kDontHash) ==
+  if (compile_state == kUncompiled) {
+    if (compile_state_.CompareAndSwap(kUncompiled, kMatchNaively) ==
         kUncompiled) {
-      // During compilation other Match attempts will see kDontHash
+      // During compilation other Match attempts will see kMatchNaively
       // and will perform matching naively.  Only the caller that
-      // does the kUncompiled -> kDontHash transition is permitted
+      // does the kUncompiled -> kMatchNaively transition is permitted
       // to compile.
       Compile();
     }
-    // rolling_hash_length is no longer kUncompiled, due to some call to
-    // Compile().  Re-acquire it so that we can safely view the results of
-    // compilation so far.
-    rolling_hash_length = rolling_hash_length_.value();
+    // compile_state is no longer kUncompiled, due to some call to Compile().
+    // Re-acquire it so that we can safely view the results of compilation so
+    // far.
+    compile_state = compile_state_.value();
   }
-  if (rolling_hash_length == kDontHash) {
+  if (compile_state == kMatchNaively) {
     // Set of wildcards is small, or compilation was ongoing when we last read
-    // rolling_hash_length_.
+    // compile_state_.
     // Just match against each pattern in reverse order (starting with most
     // recent, which overrides less recent), returning when a match succeeds.
     for (int i = wildcards_.size() - 1; i >= 0; --i) {
@@ -266,55 +290,48 @@ bool FastWildcardGroup::Match(const StringPiece& str, bool allow) const {
     return allow;
   }
   int max_effective_index = kNoEntry;
-  // Start by matching against all-wildcard patterns in reverse order,
-  // stopping if a match is found (since earlier matches will have
-  // a smaller index and be overridden by the already-found match).
+  // Start by matching against all-wildcard patterns, latest first, stopping
+  // if a match is found (since earlier matches will have a smaller index and
+  // be overridden by the already-found match).
   // TODO(jmaessen): These patterns all devolve to
   // a string length check (== or >=).  Consider optimizing them.
-  for (int i = wildcard_only_indices_.size() - 1; i >= 0; --i) {
+  for (int i = 0, n = wildcard_only_indices_.size(); i < n; ++i) {
     int index = wildcard_only_indices_[i];
     if (wildcards_[index]->Match(str)) {
       max_effective_index = effective_indices_[index];
       break;
     }
   }
-  int rolling_end = str.size() - rolling_hash_length;
-  if (rolling_end >= 0) {
-    // Do a Rabin-Karp rolling match through the string.
-    uint64 rolling_hash = RollingHash(str.data(), 0, rolling_hash_length);
-    int exit_effective_index = wildcards_.size() - 1;
-      // Uses signed arithmetic for correct comparison below.
-    for (int ofs = 0;
-         max_effective_index < exit_effective_index && ofs <= rolling_end; ) {
-      // Look up rolling_hash in table, stopping if we find a:
-      //   1) Smaller index than max_effective_index
-      //   2) Matching string (update max_effective_index).
-      // In either case, all subsequent hash matches will be overridden by
-      // max_effective_index, so we need not search the bucket anymore.  This is
-      // guaranteed by the order of table insertion (largest index first)
-      // and the fact that later smaller colliding entries are further along
-      // in the linear probe.  This is true even if intervening slots are
-      // occupied by entries with completely different hash values - those
-      // entries will still have larger indices as they were inserted earlier.
-      for (uint64 probe = 0; ; ++probe) {
-        // The following invariant (and thus loop termination) should be
-        // guaranteed by the sparseness of pattern_hash_index_.
-        DCHECK_GT(pattern_hash_index_.size(), probe);
-        int index = pattern_hash_index(rolling_hash + probe);
+  // Now run the automaton over the string.  Each time it reaches a state
+  // whose chain of output links could hold a pattern that would override
+  // max_effective_index, verify those patterns latest first.  Within a state
+  // we can stop at the first pattern that either matches or would not
+  // override, as the rest have smaller indices still.
+  const int exit_effective_index = wildcards_.size() - 1;
+  int state = kRootState;
+  for (int pos = 0, size = str.size();
+       max_effective_index < exit_effective_index && pos < size; ++pos) {
+    const char ch = str[pos];
+    int next;
+    while ((next = Transition(state, ch)) == kNoEntry) {
+      state = states_[state].failure;
+    }
+    state = next;
+    for (int output = state;
+         output != kNoEntry &&
+             states_[output].latest_pattern > max_effective_index;
+         output = states_[output].output) {
+      const std::vector<int>& patterns = states_[output].patterns;
+      for (int i = 0, n = patterns.size(); i < n; ++i) {
+        int index = patterns[i];
         if (index <= max_effective_index) {
-          // This also includes the kNoEntry case.
           break;
         }
-        if (rolling_hash == rolling_hashes_[index] &&
-            wildcards_[index]->Match(str)) {
+        if (wildcards_[index]->Match(str)) {
           max_effective_index = effective_indices_[index];
           break;
         }
       }
-      if (++ofs <= rolling_end) {
-        rolling_hash = NextRollingHash(str.data(), ofs, rolling_hash_length,
-                                       rolling_hash);
-      }
     }
   }
   if (max_effective_index == kNoEntry) {
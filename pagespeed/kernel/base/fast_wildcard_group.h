@@ -19,7 +19,9 @@
 #ifndef PAGESPEED_KERNEL_BASE_FAST_WILDCARD_GROUP_H_
 #define PAGESPEED_KERNEL_BASE_FAST_WILDCARD_GROUP_H_
 
+#include <utility>
 #include <vector>
+
 #include "pagespeed/kernel/base/atomic_int32.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/string.h"
@@ -61,19 +63,18 @@ chunks of diverse literals and so it's good enough in practice.
 WildcardGroup simply iterates through wildcards in the group, attempting to
 match against each one in turn.
 
-In FastWildcardGroup we attempt a Rabin-Karp string match for a fixed-size
-substring of each of the wildcards.  We choose the largest possible substring
-size for a given group (for a single wildcard pattern, this will be the length
-of the longest literal in the pattern; for the group, it is the minimum such
-length).  Note that in the worst case this is a single character (we treat
-all-wildcard patterns specially).  We track the insertion index of the
-latest-inserted matched pattern (so the first pattern in the set has index 0,
-and initially our insertion index is -1).  As in Rabin-Karp we traverse the
-string using a rolling hash; when we encounter a hash match, we retrieve the
-corresponding insertion index.  If it's larger than our current insertion index
-(the pattern would override), we retrieve the pattern and attempt to match the
-whole string against it.  If the match succeeds we update the insertion index.
-Our return value is the corresponding "allow" status.
+In FastWildcardGroup we compile the group into an Aho-Corasick automaton over
+the longest literal substring of each wildcard (a wildcard can only match a
+string that contains all of its literals, in particular its longest one).  A
+single left-to-right pass over the string then visits every wildcard whose
+literal occurs in it, no matter how many wildcards are in the group, and we
+verify just those with a full wildcard match.  Wildcards with no literal
+characters at all (such as "*" or "?*") can't be indexed and are simply tried
+first.  We track the insertion index of the latest-inserted matched pattern
+(so the first pattern in the set has index 0, and initially our insertion
+index is -1); a candidate is only worth verifying if its index is larger than
+this (the pattern would override).  Our return value is the corresponding
+"allow" status.
 
 We actually optimize this a little in two ways: rather than remembering the
 insertion index, we actually remember the insertion index just before the next
@@ -84,19 +85,21 @@ first "allow" pattern means that we will subsequently check only against the
 is the last pattern in the group (always true if the group is nothing but
 "allow" or "deny" entries) then we can immediately return.
 
-We use a simple vector of indexes to store the hash table, dealing with
-collisions by linear probing.  Metadata (eg a cached hash) is stored with the
-patterns.  We make the table size >= 2x the number of patterns so that chains
-don't get long, and all failed probes terminate in an empty bucket.
+Each state of the automaton lists the patterns whose literal ends there, latest
+first, and links to the nearest state on its failure chain that lists any
+patterns (the dictionary suffix link); it also caches the latest pattern
+reachable along that chain, so the chain is only walked if it could lead to an
+override.  Transitions out of the root are a 256-entry table, since the scan
+returns there often; other states have few children and keep a short list.
 
 */
 
 class FastWildcardGroup {
  public:
   FastWildcardGroup()
-      : rolling_hash_length_(kUncompiled) { }
+      : compile_state_(kUncompiled) { }
   FastWildcardGroup(const FastWildcardGroup& src)
-      : rolling_hash_length_(kUncompiled) {
+      : compile_state_(kUncompiled) {
     CopyFrom(src);
   }
 
@@ -131,15 +134,30 @@ class FastWildcardGroup {
   bool empty() const { return wildcards_.empty(); }
 
  private:
-  // Special values for rolling hash size.
+  // Values of compile_state_.
   static const int32 kUncompiled = -1;
-  static const int32 kDontHash = 0;
+  static const int32 kMatchNaively = 0;
+  static const int32 kCompiled = 1;
+
+  // A state of the Aho-Corasick automaton; see the note at the top.
+  struct AutomatonState {
+    AutomatonState() : failure(0), output(-1), latest_pattern(-1) { }
+
+    std::vector<std::pair<char, int> > children;  // Except for the root.
+    int failure;         // State for the longest proper suffix of this one.
+    int output;          // Next state on the failure chain with patterns.
+    int latest_pattern;  // Largest index in patterns, or via output.
+    std::vector<int> patterns;  // Literal ends here; descending indices.
+  };
 
   void Uncompile();
   void Clear();
-  inline int& pattern_hash_index(uint64 rolling_hash) const;
   void Compile() const;
   void CompileNonTrivial() const;
+  // Returns the state reached from state on ch, or -1 if there's no such
+  // transition (which is never the case for the root, once compiled).
+  inline int Transition(int state, char ch) const;
+  int AddTransition(int state, char ch) const;
 
   // To avoid having to new another structure we use parallel
   // vectors.  Note that vector<bool> is special-case implemented
@@ -148,11 +166,11 @@ class FastWildcardGroup {
   std::vector<bool> allow_;  // parallel array (actually a bitvector)
 
   // Information that is computed during compilation.
-  mutable std::vector<uint64> rolling_hashes_;  // One per wildcard
+  mutable std::vector<AutomatonState> states_;  // states_[0] is the root.
+  mutable std::vector<int> root_transitions_;  // Indexed by unsigned char.
   mutable std::vector<int> effective_indices_;  // One per wildcard
-  mutable std::vector<int> wildcard_only_indices_;
-  mutable std::vector<int> pattern_hash_index_;  // hash table
-  mutable AtomicInt32 rolling_hash_length_;
+  mutable std::vector<int> wildcard_only_indices_;  // Descending.
+  mutable AtomicInt32 compile_state_;
 
   // This is copyable, since we want to use this with CopyOnWrite<>
 };
@@ -180,6 +180,52 @@ void BM_FastWildcardGroup(int iters, int size) {
       iters, actual_size, include_wildcards);
 }
 
+// Models per-tenant allow/disallow lists: num_patterns patterns alternating
+// between allowing a tenant's site and disallowing part of it, after a
+// pattern with no literal and one whose only literal is one character long.
+// The URLs looked up mostly belong
+// to tenants configured early on, so a scan from the latest pattern backwards
+// must pass most of the group.
+template<class G> static void ManyPatternsBenchmark(int iters,
+                                                    int num_patterns) {
+  StopBenchmarkTiming();
+  G group;
+  group.Disallow("*?*");
+  group.Allow("*/*");
+  for (int i = 0; i < num_patterns; ++i) {
+    GoogleString tenant = IntegerToString(i / 2);
+    if (i % 2 == 0) {
+      group.Allow(StrCat("http*://tenant", tenant, ".example.com/*"));
+    } else {
+      group.Disallow(StrCat("*//tenant", tenant, ".example.com/private/*"));
+    }
+  }
+  StringVector urls;
+  for (int i = 0; i < 16; ++i) {
+    GoogleString tenant = IntegerToString(i * 7);
+    urls.push_back(StrCat("http://tenant", tenant,
+                          ".example.com/static/js/app.js?v=20150601"));
+    urls.push_back(StrCat("https://tenant", tenant,
+                          ".example.com/private/account/settings.css"));
+    urls.push_back(StrCat("http://www.example.org/unrelated/tenant", tenant,
+                          "/image.png"));
+  }
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = urls.size(); j < n; ++j) {
+      group.Match(urls[j], false);
+    }
+  }
+}
+
+static void BM_WildcardGroupManyPatterns(int iters, int num_patterns) {
+  ManyPatternsBenchmark<WildcardGroup>(iters, num_patterns);
+}
+
+static void BM_FastWildcardGroupManyPatterns(int iters, int num_patterns) {
+  ManyPatternsBenchmark<FastWildcardGroup>(iters, num_patterns);
+}
+
 
 
 // Test version of this code, designed to make sure larger wildcard groups are
@@ -195,6 +241,9 @@ TEST_F(FastWildcardGroupScaleTest, LargeFastWildcardGroup) {
   UrlBlacklistBenchmark<FastWildcardGroup>(1, 14, true);
 }
 
+BENCHMARK_RANGE(BM_WildcardGroupManyPatterns, 10, 10000);
+BENCHMARK_RANGE(BM_FastWildcardGroupManyPatterns, 10, 10000);
+
 }  // namespace
 
 }  // namespace net_instaweb
@@ -20,6 +20,7 @@
 
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/wildcard_group.h"
 
 namespace net_instaweb {
 namespace {
@@ -194,5 +195,73 @@ TEST_F(FastWildcardGroupTest, IncrementalUpdate) {
   EXPECT_TRUE(group_.Match("Another complicated literal pattern", true));
 }
 
+TEST_F(FastWildcardGroupTest, WildcardOnlyPatternsLatestWins) {
+  // Patterns without literals are checked separately from the others, but
+  // must still be checked latest first.
+  FastWildcardGroup group;
+  group.Allow("*");
+  group.Disallow("?*");
+  group.AppendFrom(group_);
+  group_.CopyFrom(group);
+  MakeLarge();
+  EXPECT_FALSE(group_.Match("x", true));
+  EXPECT_TRUE(group_.Match("", false));
+  TestMatches(group_);
+}
+
+TEST_F(FastWildcardGroupTest, OverlappingLiterals) {
+  // Literals that are suffixes of one another share automaton states, and
+  // each must be found wherever it occurs in the string.
+  MakeLarge();
+  group_.Allow("*bc*");
+  group_.Disallow("*abc*");
+  group_.Disallow("*c?");
+  group_.Allow("*xabcx*");
+  EXPECT_FALSE(group_.Match("abc", true));
+  EXPECT_TRUE(group_.Match("zbc.h", false));
+  EXPECT_FALSE(group_.Match("zabc.h", true));
+  EXPECT_FALSE(group_.Match("abcd", true));
+  EXPECT_TRUE(group_.Match("xxabcxx", false));
+  EXPECT_FALSE(group_.Match("xabxabcd", true));
+  EXPECT_FALSE(group_.Match("1023", true));
+}
+
+TEST_F(FastWildcardGroupTest, ManyPatternsAgreeWithWildcardGroup) {
+  // Build a large group with a mix of literal lengths, including one-letter
+  // literals, and check it against a WildcardGroup with the same patterns.
+  static const char* const kSuffixes[] = { "*", ".html", "/*.js", "?.css" };
+  FastWildcardGroup fast;
+  WildcardGroup slow;
+  for (int i = 0; i < 1000; ++i) {
+    GoogleString pattern = StrCat("*", IntegerToString(i % 97),
+                                  kSuffixes[i % arraysize(kSuffixes)]);
+    if (i % 3 == 0) {
+      fast.Disallow(pattern);
+      slow.Disallow(pattern);
+    } else {
+      fast.Allow(pattern);
+      slow.Allow(pattern);
+    }
+  }
+  fast.Disallow("*x*");
+  slow.Disallow("*x*");
+  for (int i = 0; i < 200; ++i) {
+    const GoogleString n = IntegerToString(i);
+    const GoogleString urls[] = {
+      StrCat("http://example.com/", n, ".html"),
+      StrCat("http://example.com/", n, "/a.js"),
+      StrCat("http://example.com/", n, "a.css"),
+      StrCat("http://example.com/x", n, "a.css"),
+      StrCat("http://example.com/", n),
+    };
+    for (int j = 0; j < static_cast<int>(arraysize(urls)); ++j) {
+      EXPECT_EQ(slow.Match(urls[j], true), fast.Match(urls[j], true))
+          << urls[j];
+      EXPECT_EQ(slow.Match(urls[j], false), fast.Match(urls[j], false))
+          << urls[j];
+    }
+  }
+}
+
 }  // namespace
 }  // namespace net_instaweb
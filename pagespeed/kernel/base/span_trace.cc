@@ -0,0 +1,168 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/base/span_trace.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/escaping.h"
+#include "pagespeed/kernel/base/stl_util.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/base/timer.h"
+
+namespace net_instaweb {
+
+namespace {
+
+void AppendJsonString(StringPiece str, GoogleString* out) {
+  EscapeToJsonStringLiteral(str, true /* add_quotes */, out);
+}
+
+}  // namespace
+
+struct SpanTrace::Span {
+  Span(StringPiece name_in, SpanId parent_in, int thread_in, int64 start_us_in)
+      : parent(parent_in),
+        thread(thread_in),
+        start_us(start_us_in),
+        end_us(-1) {
+    name_in.CopyToString(&name);
+  }
+
+  GoogleString name;
+  SpanId parent;
+  int thread;
+  int64 start_us;
+  int64 end_us;  // -1 while the span is open.
+  std::vector<std::pair<GoogleString, GoogleString> > tags;
+};
+
+const SpanTrace::SpanId SpanTrace::kNoSpan;
+const SpanTrace::SpanId SpanTrace::kRootSpan;
+const int SpanTrace::kMaxSpans;
+
+SpanTraceSink::~SpanTraceSink() {
+}
+
+SpanTrace::SpanTrace(StringPiece name, Timer* timer,
+                     ThreadSystem* thread_system, SpanTraceSink* sink)
+    : name_(name.data(), name.size()),
+      timer_(timer),
+      thread_system_(thread_system),
+      sink_(sink),
+      mutex_(thread_system->NewMutex()) {
+  ScopedMutex lock(mutex_.get());
+  spans_.push_back(
+      new Span(name, kNoSpan, CurrentThreadIndex(), timer_->NowUs()));
+}
+
+SpanTrace::~SpanTrace() {
+  {
+    ScopedMutex lock(mutex_.get());
+    for (int i = spans_.size() - 1; i >= 0; --i) {
+      EndSpanLocked(i);
+    }
+  }
+  if (sink_ != NULL) {
+    sink_->RecordTrace(*this);
+  }
+  STLDeleteElements(&spans_);
+  STLDeleteElements(&threads_);
+}
+
+SpanTrace::SpanId SpanTrace::BeginSpan(StringPiece name, SpanId parent) {
+  ScopedMutex lock(mutex_.get());
+  if (parent < 0 || parent >= static_cast<int>(spans_.size()) ||
+      static_cast<int>(spans_.size()) >= kMaxSpans) {
+    return kNoSpan;
+  }
+  spans_.push_back(
+      new Span(name, parent, CurrentThreadIndex(), timer_->NowUs()));
+  return spans_.size() - 1;
+}
+
+void SpanTrace::EndSpan(SpanId id) {
+  ScopedMutex lock(mutex_.get());
+  EndSpanLocked(id);
+}
+
+void SpanTrace::EndSpanLocked(SpanId id) {
+  if (id >= 0 && id < static_cast<int>(spans_.size()) &&
+      spans_[id]->end_us < 0) {
+    spans_[id]->end_us = timer_->NowUs();
+  }
+}
+
+void SpanTrace::AddTag(SpanId id, StringPiece key, StringPiece value) {
+  ScopedMutex lock(mutex_.get());
+  if (id >= 0 && id < static_cast<int>(spans_.size())) {
+    spans_[id]->tags.push_back(
+        std::make_pair(key.as_string(), value.as_string()));
+  }
+}
+
+int SpanTrace::num_spans() const {
+  ScopedMutex lock(mutex_.get());
+  return spans_.size();
+}
+
+int SpanTrace::CurrentThreadIndex() {
+  scoped_ptr<ThreadSystem::ThreadId> current(thread_system_->GetThreadId());
+  for (int i = 0, n = threads_.size(); i < n; ++i) {
+    if (threads_[i]->IsEqual(*current)) {
+      return i;
+    }
+  }
+  threads_.push_back(current.release());
+  return threads_.size() - 1;
+}
+
+void SpanTrace::AppendChromeTraceEvents(int pid, GoogleString* out) const {
+  GoogleString pid_prefix = StrCat("{\"pid\":", IntegerToString(pid), ",");
+  StrAppend(out, pid_prefix,
+            "\"ph\":\"M\",\"name\":\"process_name\",\"args\":{\"name\":");
+  AppendJsonString(name_, out);
+  out->append("}}");
+
+  ScopedMutex lock(mutex_.get());
+  for (int i = 0, n = spans_.size(); i < n; ++i) {
+    const Span& span = *spans_[i];
+    int64 end_us = (span.end_us < 0) ? timer_->NowUs() : span.end_us;
+    StrAppend(out, ",", pid_prefix,
+              "\"tid\":", IntegerToString(span.thread),
+              ",\"ph\":\"X\",\"cat\":\"pagespeed\",\"name\":");
+    AppendJsonString(span.name, out);
+    StrAppend(out, ",\"ts\":", Integer64ToString(span.start_us),
+              ",\"dur\":", Integer64ToString(end_us - span.start_us));
+    StrAppend(out, ",\"args\":{\"span_id\":", IntegerToString(i),
+              ",\"parent_id\":", IntegerToString(span.parent));
+    for (int j = 0, m = span.tags.size(); j < m; ++j) {
+      out->append(",");
+      AppendJsonString(span.tags[j].first, out);
+      out->append(":");
+      AppendJsonString(span.tags[j].second, out);
+    }
+    out->append("}}");
+  }
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_BASE_SPAN_TRACE_H_
+#define PAGESPEED_KERNEL_BASE_SPAN_TRACE_H_
+
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_annotations.h"
+#include "pagespeed/kernel/base/thread_system.h"
+
+namespace net_instaweb {
+
+class AbstractMutex;
+class SpanTrace;
+class Timer;
+
+// Receives each SpanTrace as it is destroyed, with all its spans closed.
+class SpanTraceSink {
+ public:
+  SpanTraceSink() {}
+  virtual ~SpanTraceSink();
+
+  virtual void RecordTrace(const SpanTrace& trace) = 0;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SpanTraceSink);
+};
+
+// A structured trace of the work done on behalf of one request: a tree of
+// named, timed spans, each recording the thread it began on and any number
+// of key/value tags.  The trace starts with a root span, named after the
+// trace, which covers the lifetime of the SpanTrace object; when the object
+// is destroyed any spans still open are closed and the whole trace is handed
+// to the sink.
+//
+// Spans may be begun and ended from any thread.  Span ids are only
+// meaningful within the trace that issued them.  kNoSpan is accepted (and
+// ignored) everywhere a span id is, so callers needn't check whether a
+// BeginSpan call succeeded.
+class SpanTrace {
+ public:
+  typedef int SpanId;
+
+  static const SpanId kNoSpan = -1;
+  static const SpanId kRootSpan = 0;
+
+  // Bounds the memory used by a trace of a pathological request; spans begun
+  // beyond this are dropped.
+  static const int kMaxSpans = 2000;
+
+  // Takes ownership of neither timer, thread_system nor sink, all of which
+  // must outlive the trace.  sink may be NULL.
+  SpanTrace(StringPiece name, Timer* timer, ThreadSystem* thread_system,
+            SpanTraceSink* sink);
+  ~SpanTrace();
+
+  // Starts a new span as a child of parent, returning its id, or kNoSpan if
+  // the trace is full or parent is kNoSpan.
+  SpanId BeginSpan(StringPiece name, SpanId parent);
+
+  // Closes a span.  Ending a span more than once has no further effect.
+  void EndSpan(SpanId id);
+
+  // Adds a tag to a span; tags are reported in the order they were added.
+  void AddTag(SpanId id, StringPiece key, StringPiece value);
+
+  // Appends the spans, as a comma-separated series of Chrome trace event
+  // objects (suitable for the traceEvents array of the Chrome trace format),
+  // to *out.  All events are reported as belonging to process pid, and the
+  // first is a metadata event naming that process after the trace.  The text
+  // contains no newlines, and each event object begins with {"pid":<pid>, so
+  // that a consumer combining several traces can renumber them textually.
+  void AppendChromeTraceEvents(int pid, GoogleString* out) const;
+
+  const GoogleString& name() const { return name_; }
+  int num_spans() const;
+
+ private:
+  struct Span;
+
+  // Returns the small integer used to identify the current thread in this
+  // trace, allocating one if this is the first span begun on it.
+  int CurrentThreadIndex() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void EndSpanLocked(SpanId id) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const GoogleString name_;
+  Timer* timer_;
+  ThreadSystem* thread_system_;
+  SpanTraceSink* sink_;
+  scoped_ptr<AbstractMutex> mutex_;
+  std::vector<Span*> spans_ GUARDED_BY(mutex_);
+  std::vector<ThreadSystem::ThreadId*> threads_ GUARDED_BY(mutex_);
+
+  DISALLOW_COPY_AND_ASSIGN(SpanTrace);
+};
+
+// Begins a span on construction and ends it on destruction.  trace may be
+// NULL, in which case this does nothing.
+class ScopedSpan {
+ public:
+  ScopedSpan(SpanTrace* trace, StringPiece name, SpanTrace::SpanId parent)
+      : trace_(trace),
+        id_(trace == NULL ? SpanTrace::kNoSpan
+                          : trace->BeginSpan(name, parent)) {
+  }
+  ~ScopedSpan() {
+    if (trace_ != NULL) {
+      trace_->EndSpan(id_);
+    }
+  }
+
+  SpanTrace::SpanId id() const { return id_; }
+  void AddTag(StringPiece key, StringPiece value) {
+    if (trace_ != NULL) {
+      trace_->AddTag(id_, key, value);
+    }
+  }
+
+ private:
+  SpanTrace* trace_;
+  const SpanTrace::SpanId id_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSpan);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_KERNEL_BASE_SPAN_TRACE_H_
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/base/span_trace.h"
+
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/mock_timer.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/util/platform.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const int64 kStartUs = MockTimer::kApr_5_2010_ms * Timer::kMsUs;
+
+class RecordingSink : public SpanTraceSink {
+ public:
+  RecordingSink() : num_traces_(0) {}
+
+  virtual void RecordTrace(const SpanTrace& trace) {
+    ++num_traces_;
+    last_trace_.clear();
+    trace.AppendChromeTraceEvents(7, &last_trace_);
+  }
+
+  int num_traces() const { return num_traces_; }
+  const GoogleString& last_trace() const { return last_trace_; }
+
+ private:
+  int num_traces_;
+  GoogleString last_trace_;
+};
+
+class SpanTraceTest : public testing::Test {
+ protected:
+  SpanTraceTest()
+      : thread_system_(Platform::CreateThreadSystem()),
+        timer_(thread_system_->NewMutex(), MockTimer::kApr_5_2010_ms) {
+  }
+
+  SpanTrace* NewTrace() {
+    return new SpanTrace("http://example.com/", &timer_, thread_system_.get(),
+                         &sink_);
+  }
+
+  scoped_ptr<ThreadSystem> thread_system_;
+  MockTimer timer_;
+  RecordingSink sink_;
+};
+
+TEST_F(SpanTraceTest, NestedSpans) {
+  scoped_ptr<SpanTrace> trace(NewTrace());
+  timer_.AdvanceUs(10);
+  SpanTrace::SpanId fetch = trace->BeginSpan("fetch", SpanTrace::kRootSpan);
+  timer_.AdvanceUs(20);
+  SpanTrace::SpanId cache = trace->BeginSpan("cache", fetch);
+  trace->AddTag(cache, "result", "miss");
+  timer_.AdvanceUs(5);
+  trace->EndSpan(cache);
+  timer_.AdvanceUs(15);
+  trace->EndSpan(fetch);
+  EXPECT_EQ(1, fetch);
+  EXPECT_EQ(2, cache);
+  EXPECT_EQ(3, trace->num_spans());
+  EXPECT_EQ(0, sink_.num_traces());
+
+  timer_.AdvanceUs(50);
+  trace.reset();
+  ASSERT_EQ(1, sink_.num_traces());
+  GoogleString expected = StrCat(
+      "{\"pid\":7,\"ph\":\"M\",\"name\":\"process_name\","
+      "\"args\":{\"name\":\"http://example.com/\"}},"
+      "{\"pid\":7,\"tid\":0,\"ph\":\"X\",\"cat\":\"pagespeed\","
+      "\"name\":\"http://example.com/\",\"ts\":",
+      Integer64ToString(kStartUs),
+      ",\"dur\":100,\"args\":{\"span_id\":0,\"parent_id\":-1}},");
+  StrAppend(&expected,
+            "{\"pid\":7,\"tid\":0,\"ph\":\"X\",\"cat\":\"pagespeed\","
+            "\"name\":\"fetch\",\"ts\":", Integer64ToString(kStartUs + 10),
+            ",\"dur\":40,\"args\":{\"span_id\":1,\"parent_id\":0}},");
+  StrAppend(&expected,
+            "{\"pid\":7,\"tid\":0,\"ph\":\"X\",\"cat\":\"pagespeed\","
+            "\"name\":\"cache\",\"ts\":", Integer64ToString(kStartUs + 30),
+            ",\"dur\":5,\"args\":{\"span_id\":2,\"parent_id\":1,"
+            "\"result\":\"miss\"}}");
+  EXPECT_EQ(expected, sink_.last_trace());
+}
+
+TEST_F(SpanTraceTest, OpenSpansClosedOnDestruction) {
+  scoped_ptr<SpanTrace> trace(NewTrace());
+  trace->BeginSpan("never ended", SpanTrace::kRootSpan);
+  timer_.AdvanceUs(25);
+  trace.reset();
+  ASSERT_EQ(1, sink_.num_traces());
+  EXPECT_NE(GoogleString::npos,
+            sink_.last_trace().find("\"name\":\"never ended\",\"ts\":"));
+  EXPECT_NE(GoogleString::npos,
+            sink_.last_trace().find(",\"dur\":25,\"args\":{\"span_id\":1,"));
+}
+
+TEST_F(SpanTraceTest, NamesAndTagsEscaped) {
+  scoped_ptr<SpanTrace> trace(NewTrace());
+  SpanTrace::SpanId id = trace->BeginSpan("a\"b\nc", SpanTrace::kRootSpan);
+  trace->AddTag(id, "url", "http://example.com/?q=\"</script>");
+  trace.reset();
+  EXPECT_EQ(GoogleString::npos, sink_.last_trace().find('\n'));
+  EXPECT_NE(GoogleString::npos, sink_.last_trace().find("a\\u0022b"));
+  EXPECT_EQ(GoogleString::npos, sink_.last_trace().find("</script>"));
+}
+
+TEST_F(SpanTraceTest, InvalidSpansIgnored) {
+  scoped_ptr<SpanTrace> trace(NewTrace());
+  EXPECT_EQ(SpanTrace::kNoSpan,
+            trace->BeginSpan("orphan", SpanTrace::kNoSpan));
+  EXPECT_EQ(SpanTrace::kNoSpan, trace->BeginSpan("orphan", 5));
+  trace->EndSpan(SpanTrace::kNoSpan);
+  trace->AddTag(SpanTrace::kNoSpan, "key", "value");
+  EXPECT_EQ(1, trace->num_spans());
+
+  while (trace->num_spans() < SpanTrace::kMaxSpans) {
+    EXPECT_NE(SpanTrace::kNoSpan,
+              trace->BeginSpan("span", SpanTrace::kRootSpan));
+  }
+  EXPECT_EQ(SpanTrace::kNoSpan,
+            trace->BeginSpan("one too many", SpanTrace::kRootSpan));
+  EXPECT_EQ(SpanTrace::kMaxSpans, trace->num_spans());
+}
+
+TEST_F(SpanTraceTest, ScopedSpan) {
+  scoped_ptr<SpanTrace> trace(NewTrace());
+  {
+    ScopedSpan span(trace.get(), "scoped", SpanTrace::kRootSpan);
+    span.AddTag("key", "value");
+    EXPECT_EQ(1, span.id());
+    timer_.AdvanceUs(3);
+  }
+  timer_.AdvanceUs(100);
+  trace.reset();
+  EXPECT_NE(GoogleString::npos, sink_.last_trace().find(
+      ",\"dur\":3,\"args\":{\"span_id\":1,\"parent_id\":0,"
+      "\"key\":\"value\"}}"));
+
+  // With no trace, a ScopedSpan does nothing.
+  ScopedSpan null_span(NULL, "ignored", SpanTrace::kRootSpan);
+  null_span.AddTag("key", "value");
+  EXPECT_EQ(SpanTrace::kNoSpan, null_span.id());
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/cache/cache_snapshot.h"
+
+#include <cstddef>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char kMagic[] = "PSCACHE\n";
+const size_t kMagicSize = STATIC_STRLEN(kMagic);
+
+// Bump this whenever the layout changes, so that older images are ignored.
+const uint32 kVersion = 1;
+
+void AppendSize(uint32 size, GoogleString* out) {
+  for (int i = 0; i < 4; ++i) {
+    out->push_back(static_cast<char>(size & 0xff));
+    size >>= 8;
+  }
+}
+
+}  // namespace
+
+CacheSnapshotWriter::CacheSnapshotWriter() : num_entries_(0) {
+  image_.append(kMagic, kMagicSize);
+  AppendSize(kVersion, &image_);
+}
+
+CacheSnapshotWriter::~CacheSnapshotWriter() {
+}
+
+void CacheSnapshotWriter::AddEntry(StringPiece key, StringPiece value) {
+  AppendSize(key.size(), &image_);
+  AppendSize(value.size(), &image_);
+  image_.append(key.data(), key.size());
+  image_.append(value.data(), value.size());
+  ++num_entries_;
+}
+
+CacheSnapshotReader::CacheSnapshotReader(StringPiece image)
+    : image_(image),
+      pos_(0),
+      valid_(false) {
+  if (image_.starts_with(StringPiece(kMagic, kMagicSize))) {
+    pos_ = kMagicSize;
+    uint32 version;
+    valid_ = ReadSize(&version) && (version == kVersion);
+  }
+}
+
+CacheSnapshotReader::~CacheSnapshotReader() {
+}
+
+bool CacheSnapshotReader::ReadSize(uint32* size) {
+  if (image_.size() - pos_ < 4) {
+    valid_ = false;
+    return false;
+  }
+  const unsigned char* bytes =
+      reinterpret_cast<const unsigned char*>(image_.data() + pos_);
+  *size = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32>(bytes[3]) << 24);
+  pos_ += 4;
+  return true;
+}
+
+bool CacheSnapshotReader::Next(StringPiece* key, StringPiece* value) {
+  if (!valid_ || (pos_ == image_.size())) {
+    return false;
+  }
+  uint32 key_size, value_size;
+  if (!ReadSize(&key_size) || !ReadSize(&value_size)) {
+    return false;
+  }
+  size_t remaining = image_.size() - pos_;
+  if ((remaining < key_size) || (remaining - key_size < value_size)) {
+    valid_ = false;
+    return false;
+  }
+  *key = image_.substr(pos_, key_size);
+  pos_ += key_size;
+  *value = image_.substr(pos_, value_size);
+  pos_ += value_size;
+  return true;
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_CACHE_CACHE_SNAPSHOT_H_
+#define PAGESPEED_KERNEL_CACHE_CACHE_SNAPSHOT_H_
+
+#include <cstddef>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace net_instaweb {
+
+// A cache snapshot is a binary image of the contents of an in-memory cache,
+// written out so the cache can be reloaded warm after a restart.  The image
+// is a header followed by the entries, least recently used first:
+//
+//   magic (8 bytes), format version (uint32)
+//   for each entry: key size (uint32), value size (uint32), key, value
+//
+// All integers are little-endian.  Entries are read in place, so an image can
+// be walked directly in a memory-mapped file; nothing is parsed up front.
+// An image with a different version is ignored rather than converted.
+//
+// Builds a snapshot image in memory.
+class CacheSnapshotWriter {
+ public:
+  CacheSnapshotWriter();
+  ~CacheSnapshotWriter();
+
+  // Appends an entry; entries should be added least recently used first.
+  void AddEntry(StringPiece key, StringPiece value);
+
+  const GoogleString& image() const { return image_; }
+  int num_entries() const { return num_entries_; }
+
+ private:
+  GoogleString image_;
+  int num_entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheSnapshotWriter);
+};
+
+// Walks the entries of a snapshot image.  The image must outlive the reader,
+// and the keys and values it returns point into the image.
+class CacheSnapshotReader {
+ public:
+  explicit CacheSnapshotReader(StringPiece image);
+  ~CacheSnapshotReader();
+
+  // False if the image does not start with a header of the current version,
+  // or if a truncated entry has been found.
+  bool valid() const { return valid_; }
+
+  // Reads the next entry, returning false at the end of the image or if the
+  // image is not valid.
+  bool Next(StringPiece* key, StringPiece* value);
+
+ private:
+  bool ReadSize(uint32* size);
+
+  StringPiece image_;
+  size_t pos_;
+  bool valid_;
+
+  DISALLOW_COPY_AND_ASSIGN(CacheSnapshotReader);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_KERNEL_CACHE_CACHE_SNAPSHOT_H_
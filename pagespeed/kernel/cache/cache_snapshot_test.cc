@@ -0,0 +1,89 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/cache/cache_snapshot.h"
+
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace net_instaweb {
+
+namespace {
+
+TEST(CacheSnapshotTest, RoundTrip) {
+  CacheSnapshotWriter writer;
+  writer.AddEntry("a", "apple");
+  writer.AddEntry("", "empty key");
+  writer.AddEntry("binary", StringPiece("\0\xff\n", 3));
+  EXPECT_EQ(3, writer.num_entries());
+
+  CacheSnapshotReader reader(writer.image());
+  EXPECT_TRUE(reader.valid());
+  StringPiece key, value;
+  ASSERT_TRUE(reader.Next(&key, &value));
+  EXPECT_EQ("a", key);
+  EXPECT_EQ("apple", value);
+  ASSERT_TRUE(reader.Next(&key, &value));
+  EXPECT_EQ("", key);
+  EXPECT_EQ("empty key", value);
+  ASSERT_TRUE(reader.Next(&key, &value));
+  EXPECT_EQ("binary", key);
+  EXPECT_EQ(StringPiece("\0\xff\n", 3), value);
+  EXPECT_FALSE(reader.Next(&key, &value));
+  EXPECT_TRUE(reader.valid());
+}
+
+TEST(CacheSnapshotTest, RejectsBadHeader) {
+  CacheSnapshotWriter writer;
+  writer.AddEntry("a", "apple");
+
+  CacheSnapshotReader empty("");
+  EXPECT_FALSE(empty.valid());
+
+  GoogleString bad_magic = writer.image();
+  bad_magic[0] = 'X';
+  CacheSnapshotReader bad_magic_reader(bad_magic);
+  EXPECT_FALSE(bad_magic_reader.valid());
+  StringPiece key, value;
+  EXPECT_FALSE(bad_magic_reader.Next(&key, &value));
+
+  // The version immediately follows the 8-byte magic.
+  GoogleString bad_version = writer.image();
+  bad_version[8] = 2;
+  CacheSnapshotReader bad_version_reader(bad_version);
+  EXPECT_FALSE(bad_version_reader.valid());
+}
+
+TEST(CacheSnapshotTest, StopsAtTruncatedEntry) {
+  CacheSnapshotWriter writer;
+  writer.AddEntry("a", "apple");
+  writer.AddEntry("b", "banana");
+  GoogleString image = writer.image();
+  image.resize(image.size() - 1);
+
+  CacheSnapshotReader reader(image);
+  EXPECT_TRUE(reader.valid());
+  StringPiece key, value;
+  ASSERT_TRUE(reader.Next(&key, &value));
+  EXPECT_EQ("a", key);
+  EXPECT_FALSE(reader.Next(&key, &value));
+  EXPECT_FALSE(reader.valid());
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
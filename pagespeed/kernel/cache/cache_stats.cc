@@ -137,13 +137,20 @@ class CacheStats::StatsCallback : public DelegatingCacheCallback {
 };
 
 void CacheStats::Get(const GoogleString& key, Callback* callback) {
+  Callback* cb = WrapBackendLookup(key, callback);
+  if (cb != NULL) {
+    cache_->Get(key, cb);
+  }
+}
+
+CacheInterface::Callback* CacheStats::WrapBackendLookup(
+    const GoogleString& key, Callback* callback) {
   if (shutdown_.value()) {
     ValidateAndReportResult(key, CacheInterface::kNotFound, callback);
-  } else {
-    StatsCallback* cb = new StatsCallback(this, timer_, callback);
-    cache_->Get(key, cb);
-    get_count_histogram_->Add(1);
+    return NULL;
   }
+  get_count_histogram_->Add(1);
+  return new StatsCallback(this, timer_, callback);
 }
 
 void CacheStats::MultiGet(MultiGetRequest* request) {
@@ -70,6 +70,13 @@ class CacheStats : public CacheInterface {
   }
   static GoogleString FormatName(StringPiece prefix, StringPiece cache);
 
+  // Returns the callback to pass to Backend() in place of callback, for a
+  // lookup of key made directly on the backend but counted in this cache's
+  // statistics.  This lets a caller combine lookups made through several
+  // CacheStats that share a backend into a single MultiGet.  If this cache
+  // has been shut down, reports callback as not found and returns NULL.
+  Callback* WrapBackendLookup(const GoogleString& key, Callback* callback);
+
  private:
   class StatsCallback;
   friend class StatsCallback;
@@ -18,10 +18,13 @@
 
 #include "pagespeed/kernel/cache/lru_cache.h"
 
+#include <algorithm>
 #include <cstddef>
 #include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/cache/cache_snapshot.h"
 
 namespace net_instaweb {
 
@@ -65,4 +68,27 @@ void LRUCache::Delete(const GoogleString& key) {
   base_.Delete(key);
 }
 
+void LRUCache::AddToSnapshot(CacheSnapshotWriter* snapshot) const {
+  for (Base::Iterator p = base_.Begin(), e = base_.End(); p != e; ++p) {
+    snapshot->AddEntry(p.Key(), p.Value().Value());
+  }
+}
+
+int LRUCache::RestoreSnapshot(CacheSnapshotReader* snapshot) {
+  size_t stored_before = base_.num_inserts() + base_.num_identical_reinserts();
+  StringPiece key, value;
+  while (snapshot->Next(&key, &value)) {
+    SharedString shared_value(value);
+    base_.Put(key.as_string(), &shared_value);
+  }
+  size_t num_stored =
+      base_.num_inserts() + base_.num_identical_reinserts() - stored_before;
+
+  // Each restored entry is younger than anything that was already here, so
+  // evictions only reach restored entries once the older ones are all gone.
+  // Either none of the restored entries was evicted, or they are all that is
+  // left.
+  return static_cast<int>(std::min(num_stored, base_.num_elements()));
+}
+
 }  // namespace net_instaweb
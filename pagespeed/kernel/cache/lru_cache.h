@@ -29,6 +29,9 @@
 
 namespace net_instaweb {
 
+class CacheSnapshotReader;
+class CacheSnapshotWriter;
+
 // Simple C++ implementation of an in-memory least-recently used (LRU)
 // cache.  This implementation is not thread-safe, and must be
 // combined with a mutex to make it so.
@@ -85,6 +88,15 @@ class LRUCache : public CacheInterface {
   // Clear the stats -- note that this will not clear the content.
   void ClearStats() { base_.ClearStats(); }
 
+  // Adds every entry to the snapshot, least recently used first.
+  void AddToSnapshot(CacheSnapshotWriter* snapshot) const;
+
+  // Puts the entries of a snapshot into the cache in order, so that they keep
+  // their relative recency, and evicting older ones if the snapshot is larger
+  // than the cache.  Returns the number of restored entries still resident,
+  // which excludes any evicted by later ones or too large to fit at all.
+  int RestoreSnapshot(CacheSnapshotReader* snapshot);
+
   static GoogleString FormatName() { return "LRUCache"; }
   virtual GoogleString Name() const { return FormatName(); }
   virtual bool IsBlocking() const { return true; }
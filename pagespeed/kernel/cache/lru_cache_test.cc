@@ -22,6 +22,9 @@
 
 #include <cstddef>
 #include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/cache/cache_snapshot.h"
 #include "pagespeed/kernel/cache/cache_test_base.h"
 
 namespace {
@@ -152,4 +155,58 @@ TEST_F(LRUCacheTest, MultiGet) {
   TestMultiGet();
 }
 
+TEST_F(LRUCacheTest, RestoreSnapshot) {
+  // Twelve entries of 10 bytes each, with namea then used most recently.
+  LRUCache source(2 * kMaxSize);
+  for (int i = 0; i < 12; ++i) {
+    CheckPut(&source, StringPrintf("name%c", 'a' + i),
+             StringPrintf("valu%c", 'a' + i));
+  }
+  CheckGet(&source, "namea", "valua");
+
+  CacheSnapshotWriter writer;
+  source.AddToSnapshot(&writer);
+  EXPECT_EQ(12, writer.num_entries());
+
+  // Only ten fit, and restoring oldest first keeps the most recent ones.  The
+  // two evicted while restoring are not counted.
+  CacheSnapshotReader reader(writer.image());
+  EXPECT_EQ(10, cache_.RestoreSnapshot(&reader));
+  cache_.SanityCheck();
+  EXPECT_EQ(static_cast<size_t>(10), cache_.num_elements());
+
+  // Recency survives the round trip, so the next eviction is named, not
+  // namea.
+  CheckPut("namez", "valuz");
+  CheckNotFound("nameb");
+  CheckNotFound("namec");
+  CheckNotFound("named");
+  CheckGet("namea", "valua");
+  for (int i = 4; i < 12; ++i) {
+    CheckGet(StringPrintf("name%c", 'a' + i), StringPrintf("valu%c", 'a' + i));
+  }
+}
+
+TEST_F(LRUCacheTest, RestoreSnapshotIntoNonEmptyCache) {
+  // Entries already in the cache are older than restored ones, so they are
+  // evicted first and never counted.
+  for (int i = 0; i < 5; ++i) {
+    CheckPut(StringPrintf("oldn%c", 'a' + i), StringPrintf("oldv%c", 'a' + i));
+  }
+  LRUCache source(kMaxSize);
+  for (int i = 0; i < 7; ++i) {
+    CheckPut(&source, StringPrintf("name%c", 'a' + i),
+             StringPrintf("valu%c", 'a' + i));
+  }
+  CacheSnapshotWriter writer;
+  source.AddToSnapshot(&writer);
+  CacheSnapshotReader reader(writer.image());
+  EXPECT_EQ(7, cache_.RestoreSnapshot(&reader));
+  cache_.SanityCheck();
+  EXPECT_EQ(static_cast<size_t>(10), cache_.num_elements());
+  CheckNotFound("oldna");
+  CheckNotFound("oldnb");
+  CheckGet("oldnc", "oldvc");
+}
+
 }  // namespace net_instaweb
@@ -183,9 +183,8 @@ void HtmlElement::AddAttribute(const HtmlName& name,
                                const StringPiece& decoded_value,
                                QuoteStyle quote_style) {
   GoogleString buf;
-  Attribute* attr = new Attribute(name,
-                                  HtmlKeywords::Escape(decoded_value, &buf),
-                                  quote_style);
+  Attribute* attr = new Attribute(
+      name, HtmlKeywords::MaybeEscape(decoded_value, &buf), quote_style);
   attr->decoded_value_computed_ = true;
   attr->decoding_error_ = false;
   Attribute::CopyValue(decoded_value, &attr->decoded_value_);
@@ -235,7 +234,7 @@ void HtmlElement::Attribute::SetValue(const StringPiece& decoded_value) {
   DCHECK(decoded_value.data() + decoded_value.size() < escaped_chars ||
          escaped_chars + strlen(escaped_chars) < decoded_value.data())
       << "Setting unescaped value from substring of escaped value.";
-  CopyValue(HtmlKeywords::Escape(decoded_value, &buf), &escaped_value_);
+  CopyValue(HtmlKeywords::MaybeEscape(decoded_value, &buf), &escaped_value_);
   CopyValue(decoded_value, &decoded_value_);
 }
 
@@ -23,6 +23,10 @@
 #include <map>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "base/logging.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/string.h"
@@ -373,6 +377,58 @@ const char kParagraphTerminators[] =
 // TODO(jmarantz): handle & test Ruby containment.
 // const char kRubyElements[] = "ruby rt rp ";
 
+#if defined(__SSE2__)
+inline __m128i LoadBlock(const char* data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+// Returns a mask with a bit set for each byte of block that is '&' or 8-bit.
+inline int UnescapeCandidates(__m128i block) {
+  return _mm_movemask_epi8(block) |
+      _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('&')));
+}
+
+// Returns a mask with a bit set for each byte of block that is a control
+// character, 8-bit, or one of the characters HTML requires us to escape.
+// Control characters include \t, \n etc, which are not escaped, so a set bit
+// only means the byte might need escaping.
+inline int EscapeCandidates(__m128i block) {
+  // The comparison is signed, so this also catches 8-bit bytes.
+  __m128i candidates = _mm_cmplt_epi8(block, _mm_set1_epi8(' '));
+  candidates = _mm_or_si128(
+      candidates, _mm_cmpeq_epi8(block, _mm_set1_epi8('"')));
+  candidates = _mm_or_si128(
+      candidates, _mm_cmpeq_epi8(block, _mm_set1_epi8('\'')));
+  candidates = _mm_or_si128(
+      candidates, _mm_cmpeq_epi8(block, _mm_set1_epi8('&')));
+  candidates = _mm_or_si128(
+      candidates, _mm_cmpeq_epi8(block, _mm_set1_epi8('<')));
+  candidates = _mm_or_si128(
+      candidates, _mm_cmpeq_epi8(block, _mm_set1_epi8('>')));
+  return _mm_movemask_epi8(candidates);
+}
+#endif  // __SSE2__
+
+// Returns the number of leading bytes of [data, data + size) that are neither
+// '&' nor 8-bit, and so are copied through Unescape unchanged.
+size_t UnescapeSpan(const char* data, size_t size) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= size; i += 16) {
+    if (UnescapeCandidates(LoadBlock(data + i)) != 0) {
+      break;  // The loop below finds which byte it was.
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    uint8 ch = static_cast<uint8>(data[i]);
+    if ((ch == '&') || (ch > 127)) {
+      break;
+    }
+  }
+  return i;
+}
+
 }  // namespace
 
 HtmlKeywords* HtmlKeywords::singleton_ = NULL;
@@ -387,7 +443,7 @@ HtmlKeywords::HtmlKeywords() {
 void HtmlKeywords::InitEscapeSequences() {
   unescape_insensitive_map_.set_deleted_key("");
   unescape_sensitive_map_.set_deleted_key("");
-  escape_map_.set_deleted_key("");
+  StringStringSparseHashMapSensitive escape_map;
 
   StringSetInsensitive case_sensitive_symbols;
   for (size_t i = 0; i < arraysize(kHtmlKeywordsSequences); ++i) {
@@ -418,7 +474,30 @@ void HtmlKeywords::InitEscapeSequences() {
       // For now, we will only generate symbolic escaped-names for
       // single-byte sequences
       if (strlen(reinterpret_cast<const char*>(seq.value)) == 1) {
-        escape_map_[reinterpret_cast<const char*>(seq.value)] = seq.sequence;
+        escape_map[reinterpret_cast<const char*>(seq.value)] = seq.sequence;
+      }
+    }
+  }
+
+  for (int ch = 0; ch < 256; ++ch) {
+    // According to http://www.htmlescape.net/htmlescape_tool.html,
+    // single-quote does not need to be escaped.  However, input HTML
+    // might have used single-quote to quote attribute values, in
+    // which case we better escape any single-quotes in the value.
+    //
+    // Escape does not know what quoting was used.
+    // TODO(jmarantz): in remove_quotes filter, switch between ' and " for
+    // quoting based on whatever is in the attr value.
+    if (!IsHtmlSpace(ch) &&
+        ((ch > 127) || (ch < 32) || (ch == '"') || (ch == '\'') ||
+         (ch == '&') || (ch == '<') || (ch == '>'))) {
+      GoogleString char_to_escape(1, static_cast<char>(ch));
+      StringStringSparseHashMapSensitive::const_iterator p =
+          escape_map.find(char_to_escape);
+      if (p == escape_map.end()) {
+        escape_sequences_[ch] = StringPrintf("&#%02d;", ch);
+      } else {
+        escape_sequences_[ch] = StrCat("&", p->second, ";");
       }
     }
   }
@@ -461,21 +540,23 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
     *decoding_error = false;
     return escaped;
   }
-  *decoding_error = true;
 
-  // It would be nice to short-circuit the loop below via a memchr
-  // looking for "&".  Unfortunately we must at least also scan for
-  // 8-bit characters, as we cannot unescape those in a manner that's
-  // bidirectionally safe.  Consider CanonicalAttributesTest.Spanish,
-  // where a non-utf8 multi-byte 8-bit character is present.  If we
-  // short-circuit looking for "&" we'll wind up escaping each piece
-  // of the multi-byte sequence individually and that will not reverse
-  // properly.
-  // if (memchr(escaped.data(), '&', escaped.size()) == NULL) {
-  //   return escaped;
-  // }
+  // Most attribute values contain no escapes at all, so first skip over the
+  // run of bytes that need no attention, returning the input itself if that
+  // is everything.  Note that we must stop at 8-bit characters as well as
+  // "&", as we cannot unescape those in a manner that's bidirectionally
+  // safe.  Consider CanonicalAttributesTest.Spanish, where a non-utf8
+  // multi-byte 8-bit character is present.  If we only looked for "&" we'd
+  // wind up escaping each piece of the multi-byte sequence individually and
+  // that would not reverse properly.
+  size_t clean_prefix = UnescapeSpan(escaped.data(), escaped.size());
+  if (clean_prefix == escaped.size()) {
+    *decoding_error = false;
+    return escaped;
+  }
+  *decoding_error = true;
 
-  buf->clear();
+  buf->assign(escaped.data(), clean_prefix);
 
   // Attribute values may have HTML escapes in them, e.g.
   //    href="host.com/path?v1&amp;v2"
@@ -486,15 +567,10 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
   bool accumulate_numeric_code = false;
   bool hex_mode = false;
   bool in_escape = false;
-  bool found_ampersand = false;
-  for (size_t i = 0; i < escaped.size(); ++i) {
+  for (size_t i = clean_prefix; i < escaped.size(); ++i) {
     uint8 ch = static_cast<uint8>(escaped[i]);
     if (!in_escape) {
       if (ch == '&') {
-        if (!found_ampersand) {
-          found_ampersand = true;
-          buf->append(escaped.data(), i);
-        }
         in_escape = true;
         escape.clear();
         numeric_value = 0;
@@ -502,8 +578,11 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
         hex_mode = false;
       } else if (ch > 127) {
         return StringPiece(NULL, 0);
-      } else if (found_ampersand) {
-        *buf += ch;
+      } else {
+        // Copy the whole run of plain bytes starting here in one go.
+        size_t run = UnescapeSpan(escaped.data() + i, escaped.size() - i);
+        buf->append(escaped.data() + i, run);
+        i += run - 1;
       }
     } else if (escape.empty() && (ch == '#')) {
       escape += ch;
@@ -547,10 +626,6 @@ StringPiece HtmlKeywords::UnescapeHelper(const StringPiece& escaped,
       }
     }
   }
-  if (!found_ampersand) {
-    *decoding_error = false;
-    return escaped;
-  }
   if (in_escape) {
     if (escape.empty()) {
       buf->push_back('&');
@@ -639,42 +714,66 @@ bool HtmlKeywords::TryUnescape(bool accumulate_numeric_code,
   return true;
 }
 
+size_t HtmlKeywords::EscapeSpan(const char* data, size_t size) const {
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= size; i += 16) {
+    if (EscapeCandidates(LoadBlock(data + i)) != 0) {
+      for (size_t j = i; j < i + 16; ++j) {
+        if (!escape_sequences_[static_cast<uint8>(data[j])].empty()) {
+          return j;
+        }
+      }
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    if (!escape_sequences_[static_cast<uint8>(data[i])].empty()) {
+      break;
+    }
+  }
+  return i;
+}
+
+void HtmlKeywords::AppendEscaped(const StringPiece& unescaped,
+                                 size_t clean_prefix,
+                                 GoogleString* buf) const {
+  const char* data = unescaped.data();
+  size_t size = unescaped.size();
+  buf->append(data, clean_prefix);
+  for (size_t i = clean_prefix; i < size; ) {
+    // data[i] needs escaping; everything after it up to the next byte that
+    // does is copied in bulk.
+    buf->append(escape_sequences_[static_cast<uint8>(data[i])]);
+    ++i;
+    size_t run = EscapeSpan(data + i, size - i);
+    buf->append(data + i, run);
+    i += run;
+  }
+}
+
 StringPiece HtmlKeywords::EscapeHelper(const StringPiece& unescaped,
                                        GoogleString* buf) const {
   if (unescaped.data() == NULL) {
     return unescaped;
   }
   buf->clear();
+  AppendEscaped(unescaped, EscapeSpan(unescaped.data(), unescaped.size()),
+                buf);
+  return StringPiece(*buf);
+}
 
-  GoogleString char_to_escape;
-  for (size_t i = 0; i < unescaped.size(); ++i) {
-    int ch = static_cast<unsigned char>(unescaped[i]);
-    // According to http://www.htmlescape.net/htmlescape_tool.html,
-    // single-quote does not need to be escaped.  However, input HTML
-    // might have used single-quote to quote attribute values, in
-    // which case we better escape any single-quotes in the value.
-    //
-    // This function, unfortunately, does not know what quoting was used.
-    // TODO(jmarantz): in remove_quotes filter, switch between ' and " for
-    // quoting based on whatever is in the attr value.
-    if (!IsHtmlSpace(ch) &&
-        ((ch > 127) || (ch < 32) || (ch == '"') || (ch == '\'') ||
-         (ch == '&') || (ch == '<') || (ch == '>'))) {
-      char_to_escape.clear();
-      char_to_escape += ch;
-      StringStringSparseHashMapSensitive::const_iterator p =
-          escape_map_.find(char_to_escape);
-      if (p == escape_map_.end()) {
-        StringAppendF(buf, "&#%02d;", static_cast<int>(ch));
-      } else {
-        *buf += '&';
-        *buf += p->second;
-        *buf += ';';
-      }
-    } else {
-      *buf += unescaped[i];
-    }
+StringPiece HtmlKeywords::MaybeEscapeHelper(const StringPiece& unescaped,
+                                            GoogleString* buf) const {
+  if (unescaped.data() == NULL) {
+    return unescaped;
+  }
+  size_t clean_prefix = EscapeSpan(unescaped.data(), unescaped.size());
+  if (clean_prefix == unescaped.size()) {
+    return unescaped;
   }
+  buf->clear();
+  AppendEscaped(unescaped, clean_prefix, buf);
   return StringPiece(*buf);
 }
 
@@ -64,6 +64,14 @@ class HtmlKeywords {
     return singleton_->EscapeHelper(unescaped, buf);
   }
 
+  // Like Escape, but when unescaped needs no escaping it is returned as-is
+  // and *buf is left untouched, so that callers which go on to copy the
+  // result need not make an intermediate copy of clean text.
+  static StringPiece MaybeEscape(const StringPiece& unescaped,
+                                 GoogleString* buf) {
+    return singleton_->MaybeEscapeHelper(unescaped, buf);
+  }
+
   // Take escaped text and unescape it so its value can be interpreted,
   // e.g.    "http://myhost.com/p?v&amp;w"  --> "http://myhost.com/p?v&w"
   //
@@ -180,10 +188,21 @@ class HtmlKeywords {
   // Adds every space-delimited token in klist to kset.
   void AddToSet(const StringPiece& klist, KeywordVec* kset);
 
+  // Returns the number of leading bytes of [data, data + size) that are
+  // copied through unchanged by Escape.
+  size_t EscapeSpan(const char* data, size_t size) const;
+
+  // Appends unescaped to *buf, escaping it, given that clean_prefix is
+  // EscapeSpan(unescaped.data(), unescaped.size()).
+  void AppendEscaped(const StringPiece& unescaped, size_t clean_prefix,
+                     GoogleString* buf) const;
+
   static HtmlKeywords* singleton_;
 
   StringPiece EscapeHelper(const StringPiece& unescaped,
                            GoogleString* buf) const;
+  StringPiece MaybeEscapeHelper(const StringPiece& unescaped,
+                                GoogleString* buf) const;
   StringPiece UnescapeHelper(const StringPiece& escaped,
                              GoogleString* buf,
                              bool* decoding_error) const;
@@ -203,7 +222,10 @@ class HtmlKeywords {
 
   StringStringSparseHashMapInsensitive unescape_insensitive_map_;
   StringStringSparseHashMapSensitive unescape_sensitive_map_;
-  StringStringSparseHashMapSensitive escape_map_;
+
+  // The escape sequence for each byte value, indexed by the byte as an
+  // unsigned char, or empty if the byte is copied through unchanged.
+  GoogleString escape_sequences_[256];
 
   // Note that this is left immutable after being filled in, so it's OK
   // to take pointers into it.
@@ -0,0 +1,144 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures HTML attribute escaping and unescaping, both directly and as
+// CanonicalAttributes exercises them, decoding and re-encoding every
+// attribute on an attribute-heavy page.
+
+#include "pagespeed/kernel/html/html_keywords.h"
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/benchmark.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/null_writer.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/html/canonical_attributes.h"
+#include "pagespeed/kernel/html/html_parse.h"
+#include "pagespeed/kernel/html/html_writer_filter.h"
+
+namespace net_instaweb {
+
+namespace {
+
+// Attribute values typical of real pages: mostly URLs, class lists and alt
+// text with nothing to escape, and the occasional query string with &amp;.
+const char* const kCleanValues[] = {
+  "http://www.example.com/static/images/products/thumbnail-1234.jpg",
+  "nav-item nav-item--active js-track-click",
+  "A photograph of the product from the front, on a white background",
+  "/static/css/site.css?v=20150611",
+  "width:300px;height:250px;margin:0 auto",
+};
+
+const char* const kEscapedValues[] = {
+  "/search?q=pagespeed&amp;hl=en&amp;source=hp&amp;ie=UTF-8",
+  "Terms &amp; Conditions",
+  "/ads/banner.gif?slot=top&amp;size=728x90&amp;ord=12345",
+  "&quot;Quoted&quot; title text",
+  "Caf&#233; &lt;menu&gt;",
+};
+
+void Unescape(const char* const* values, int num_values, int iters) {
+  HtmlKeywords::Init();
+  GoogleString buf;
+  bool decoding_error;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < num_values; ++j) {
+      HtmlKeywords::Unescape(values[j], &buf, &decoding_error);
+      CHECK(!decoding_error);
+    }
+  }
+}
+
+GoogleString* sAttributeHeavyPage = NULL;
+StringPiece GetAttributeHeavyPage() {
+  if (sAttributeHeavyPage == NULL) {
+    sAttributeHeavyPage = new GoogleString("<html><body>\n");
+    for (int i = 0; i < 200; ++i) {
+      const char* clean = kCleanValues[i % arraysize(kCleanValues)];
+      const char* escaped = kEscapedValues[i % arraysize(kEscapedValues)];
+      StrAppend(sAttributeHeavyPage,
+                "<div class=\"", kCleanValues[1], "\" style=\"",
+                kCleanValues[4], "\" data-index=\"", IntegerToString(i),
+                "\">\n");
+      StrAppend(sAttributeHeavyPage,
+                "  <a href=\"", escaped, "\" title=\"", clean, "\">");
+      StrAppend(sAttributeHeavyPage,
+                "<img src=\"", kCleanValues[0], "\" alt=\"", kCleanValues[2],
+                "\" width=300 height=250></a>\n</div>\n");
+    }
+    StrAppend(sAttributeHeavyPage, "</body></html>\n");
+  }
+  return *sAttributeHeavyPage;
+}
+
+}  // namespace
+
+static void BM_UnescapeCleanAttributes(int iters) {
+  Unescape(kCleanValues, arraysize(kCleanValues), iters);
+}
+BENCHMARK(BM_UnescapeCleanAttributes);
+
+static void BM_UnescapeEscapedAttributes(int iters) {
+  Unescape(kEscapedValues, arraysize(kEscapedValues), iters);
+}
+BENCHMARK(BM_UnescapeEscapedAttributes);
+
+static void BM_EscapeCleanAttributes(int iters) {
+  HtmlKeywords::Init();
+  GoogleString buf;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = arraysize(kCleanValues); j < n; ++j) {
+      HtmlKeywords::Escape(kCleanValues[j], &buf);
+    }
+  }
+}
+BENCHMARK(BM_EscapeCleanAttributes);
+
+static void BM_MaybeEscapeCleanAttributes(int iters) {
+  HtmlKeywords::Init();
+  GoogleString buf;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0, n = arraysize(kCleanValues); j < n; ++j) {
+      HtmlKeywords::MaybeEscape(kCleanValues[j], &buf);
+    }
+  }
+}
+BENCHMARK(BM_MaybeEscapeCleanAttributes);
+
+static void BM_CanonicalizeAttributeHeavyPage(int iters) {
+  StopBenchmarkTiming();
+  StringPiece text = GetAttributeHeavyPage();
+  NullWriter writer;
+  NullMessageHandler handler;
+  HtmlParse parser(&handler);
+  CanonicalAttributes canonical_attributes(&parser);
+  HtmlWriterFilter writer_filter(&parser);
+  parser.AddFilter(&canonical_attributes);
+  parser.AddFilter(&writer_filter);
+  writer_filter.set_writer(&writer);
+
+  StartBenchmarkTiming();
+  for (int i = 0; i < iters; ++i) {
+    parser.StartParse("http://example.com/benchmark");
+    parser.ParseText(text);
+    parser.FinishParse();
+  }
+}
+BENCHMARK(BM_CanonicalizeAttributeHeavyPage);
+
+}  // namespace net_instaweb
@@ -291,4 +291,61 @@ TEST_F(HtmlKeywordsTest, WhitespaceNotChanged) {
   Unchanged("a\fb");
 }
 
+TEST_F(HtmlKeywordsTest, CleanTextIsNotCopied) {
+  static const char kClean[] = "http://example.com/images/logo.png?v=1";
+  GoogleString buf("untouched");
+  bool decoding_error = true;
+  StringPiece unescaped = HtmlKeywords::Unescape(kClean, &buf,
+                                                 &decoding_error);
+  EXPECT_FALSE(decoding_error);
+  EXPECT_EQ(kClean, unescaped.data());
+  EXPECT_EQ(STATIC_STRLEN(kClean), unescaped.size());
+
+  StringPiece escaped = HtmlKeywords::MaybeEscape(kClean, &buf);
+  EXPECT_EQ(kClean, escaped.data());
+  EXPECT_EQ(STATIC_STRLEN(kClean), escaped.size());
+  EXPECT_STREQ("untouched", buf);
+
+  EXPECT_STREQ("a&amp;b", HtmlKeywords::MaybeEscape("a&b", &buf));
+  EXPECT_STREQ("a&amp;b", buf);
+  EXPECT_TRUE(HtmlKeywords::MaybeEscape(StringPiece(), &buf).data() == NULL);
+}
+
+TEST_F(HtmlKeywordsTest, SpecialCharacterAtEveryOffset) {
+  // Escape and Unescape skip over clean text a block at a time, so make sure
+  // they find special characters wherever they are in relation to the block
+  // boundaries, and copy everything on either side of them.
+  for (int size = 1; size <= 50; ++size) {
+    for (int pos = 0; pos < size; ++pos) {
+      GoogleString text(size, 'x'), expected_escaped, buf;
+      text[pos] = '&';
+      expected_escaped = text;
+      expected_escaped.replace(pos, 1, "&amp;");
+      EXPECT_STREQ(expected_escaped, HtmlKeywords::Escape(text, &buf));
+      EXPECT_STREQ(expected_escaped, HtmlKeywords::MaybeEscape(text, &buf));
+      EXPECT_STREQ(text, Unescape(expected_escaped, &buf));
+
+      // Whitespace control characters are candidates for escaping in the
+      // block scan but are then left alone.
+      text[pos] = '\n';
+      EXPECT_STREQ(text, HtmlKeywords::Escape(text, &buf));
+
+      text[pos] = '\200';
+      EXPECT_TRUE(UnescapeEncodingError(text));
+      EXPECT_STREQ(StrCat(text.substr(0, pos), "&#128;", text.substr(pos + 1)),
+                   HtmlKeywords::Escape(text, &buf));
+    }
+  }
+}
+
+TEST_F(HtmlKeywordsTest, LongRunsBetweenEscapes) {
+  static const char kEscaped[] =
+      "/search?q=pagespeed+optimization&amp;hl=en&amp;source=hp&amp;"
+      "ie=ISO-8859-1&amp;oq=&quot;quoted phrase&quot;&amp;x=&lt;y&gt;";
+  static const char kUnescaped[] =
+      "/search?q=pagespeed+optimization&hl=en&source=hp&"
+      "ie=ISO-8859-1&oq=\"quoted phrase\"&x=<y>";
+  BiTest(kEscaped, kUnescaped);
+}
+
 }  // namespace net_instaweb
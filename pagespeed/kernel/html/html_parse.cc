@@ -24,8 +24,10 @@
 #include "base/logging.h"
 #include "pagespeed/kernel/base/arena.h"
 #include "pagespeed/kernel/base/atom.h"
+#include "pagespeed/kernel/base/cost_tracker.h"
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/print_message_handler.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -52,6 +54,7 @@ HtmlParse::HtmlParse(MessageHandler* message_handler)
       line_number_(1),
       skip_increment_(false),
       determine_enabled_filters_called_(false),
+      defer_determine_enabled_filters_(false),
       need_sanity_check_(false),
       coalesce_characters_(true),
       need_coalesce_characters_(false),
@@ -61,6 +64,9 @@ HtmlParse::HtmlParse(MessageHandler* message_handler)
       parse_start_time_us_(0),
       timer_(NULL),
       current_filter_(NULL),
+      span_trace_(NULL),
+      filter_span_parent_(SpanTrace::kNoSpan),
+      filter_cost_tracker_(NULL),
       dynamically_disabled_filter_list_(NULL) {
   lexer_ = new HtmlLexer(this);
   HtmlKeywords::Init();
@@ -230,6 +236,7 @@ bool HtmlParse::StartParseId(const StringPiece& url, const StringPiece& id,
                              const ContentType& content_type) {
   delayed_start_literal_.reset();
   determine_enabled_filters_called_ = false;
+  defer_determine_enabled_filters_ = false;
 
   // Paranoid debug-checking and unconditional clearing of state variables.
   DCHECK(!skip_increment_);
@@ -312,7 +319,9 @@ void HtmlParse::Clear() {
 void HtmlParse::ParseTextInternal(const char* text, int size) {
   DCHECK(url_valid_) << "Invalid to call ParseText with invalid url";
   if (url_valid_) {
-    DetermineEnabledFilters();
+    if (!defer_determine_enabled_filters_) {
+      DetermineEnabledFilters();
+    }
     lexer_->Parse(text, size);
   }
 }
@@ -372,12 +381,17 @@ void HtmlParse::ApplyFilter(HtmlFilter* filter) {
   }
 
   ShowProgress(StrCat("ApplyFilter:", filter->Name()).c_str());
+  ScopedSpan span(span_trace_, filter->Name(), filter_span_parent_);
+  CostTracker::Measurement cost(filter_cost_tracker_);
+  int num_events = 0;
   for (current_ = queue_.begin(); current_ != queue_.end(); NextEvent()) {
     HtmlEvent* event = *current_;
     line_number_ = event->line_number();
     event->Run(filter);
+    ++num_events;
   }
   filter->Flush();
+  cost.Record(filter->Name(), num_events);
 
   if (need_sanity_check_) {
     SanityCheck();
@@ -31,6 +31,7 @@
 #include "pagespeed/kernel/base/arena.h"
 #include "pagespeed/kernel/base/printf_format.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/symbol_table.h"
@@ -42,6 +43,7 @@
 
 namespace net_instaweb {
 
+class CostTracker;
 class DocType;
 class HtmlEvent;
 class HtmlFilter;
@@ -140,6 +142,18 @@ class HtmlParse {
     ParseTextInternal(sp.data(), sp.size());
   }
 
+  // While set, ParseText only lexes its input into the event queue, leaving
+  // the filters' DetermineEnabled calls to the next Flush.  This lets a
+  // caller start lexing before the information filters use to decide whether
+  // they are enabled (e.g. property cache data) is available, so long as it
+  // doesn't Flush until then.  Cleared by StartParseId.
+  void set_defer_determine_enabled_filters(bool x) {
+    defer_determine_enabled_filters_ = x;
+  }
+  bool defer_determine_enabled_filters() const {
+    return defer_determine_enabled_filters_;
+  }
+
   // Flush the currently queued events through the filters.  It is desirable
   // for large web pages, particularly dynamically generated ones, to start
   // getting delivered to the browser as soon as they are ready.  On the
@@ -444,6 +458,20 @@ class HtmlParse {
   Timer* timer() const { return timer_; }
   void set_log_rewrite_timing(bool x) { log_rewrite_timing_ = x; }
 
+  // Records each filter's pass over a flush window as a span in trace, under
+  // parent_span.  trace is not owned, and may be NULL to stop recording.
+  void set_span_trace(SpanTrace* trace, SpanTrace::SpanId parent_span) {
+    span_trace_ = trace;
+    filter_span_parent_ = parent_span;
+  }
+
+  // Accumulates the CPU and wall time of each filter's pass over a flush
+  // window, and the number of events it was shown, into tracker under the
+  // filter's Name().  tracker is not owned, and may be NULL to stop recording.
+  void set_filter_cost_tracker(CostTracker* tracker) {
+    filter_cost_tracker_ = tracker;
+  }
+
   // Adds a filter to be called during parsing as new events are added.
   // Takes ownership of the HtmlFilter passed in.
   void add_event_listener(HtmlFilter* listener);
@@ -611,6 +639,7 @@ class HtmlParse {
   int line_number_;
   bool skip_increment_;
   bool determine_enabled_filters_called_;
+  bool defer_determine_enabled_filters_;
   bool need_sanity_check_;
   bool coalesce_characters_;
   bool need_coalesce_characters_;
@@ -621,6 +650,9 @@ class HtmlParse {
   scoped_ptr<HtmlEvent> delayed_start_literal_;
   Timer* timer_;
   HtmlFilter* current_filter_;      // Filter currently running in ApplyFilter
+  SpanTrace* span_trace_;
+  SpanTrace::SpanId filter_span_parent_;
+  CostTracker* filter_cost_tracker_;
 
   // When deferring a node that spans a flush window, we present upstream
   // filters with a view of the event-stream that is not impacted by the
@@ -22,10 +22,13 @@
 #include <vector>
 
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/cost_tracker.h"
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/gmock.h"
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/mock_message_handler.h"
+#include "pagespeed/kernel/base/mock_timer.h"
+#include "pagespeed/kernel/base/null_thread_system.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
@@ -1402,6 +1405,25 @@ TEST_F(HandlerCalledTest, IEDirectiveCalledRevealedClose) {
   EXPECT_TRUE(second_event_listener_->called_ie_directive_.Test());
 }
 
+// With DetermineEnabled deferred, text is lexed (and seen by event
+// listeners) before the filters decide whether they are enabled, which they
+// do at the first Flush.
+TEST_F(HandlerCalledTest, DeferDetermineEnabledFilters) {
+  handler_called_filter_.SetEnabled(false);
+  html_parse_.StartParse("http://test.com/defer_determine_enabled.html");
+  html_parse_.set_defer_determine_enabled_filters(true);
+  html_parse_.ParseText("<p>...</p>");
+  EXPECT_TRUE(first_event_listener_->called_start_element_.Test());
+  EXPECT_FALSE(handler_called_filter_.called_start_element_.Test());
+
+  handler_called_filter_.SetEnabled(true);
+  html_parse_.set_defer_determine_enabled_filters(false);
+  html_parse_.FinishParse();
+  EXPECT_TRUE(handler_called_filter_.called_start_element_.Test());
+  EXPECT_TRUE(handler_called_filter_.called_end_document_.Test());
+  EXPECT_FALSE(html_parse_.defer_determine_enabled_filters());
+}
+
 // Unit tests for event-list manipulation.  In these tests, we do not parse
 // HTML input text, but instead create two 'Characters' nodes and use the
 // event-list manipulation methods and make sure they render as expected.
@@ -3160,4 +3182,37 @@ TEST_F(HtmlParseTestNoBody, InsertExternalScriptAfterEndOfHead) {
                    "<head>text</head><script src=\"inserted\"></script>");
 }
 
+TEST_F(HtmlParseTestNoBody, FilterCostsTracked) {
+  NullThreadSystem thread_system;
+  MockTimer timer(thread_system.NewMutex(), MockTimer::kApr_5_2010_ms);
+  CostTracker tracker(&timer, &thread_system);
+  InsertScriptsFilter insert_scripts(&html_parse_);
+  html_parse_.AddFilter(&insert_scripts);
+  html_parse_.set_filter_cost_tracker(&tracker);
+  SetupWriter();
+  Parse("costs", "<head>text</head>");
+  html_parse_.set_filter_cost_tracker(NULL);
+
+  CostTracker::CostVector costs;
+  tracker.GetCosts(CostTracker::kByName, &costs);
+  ASSERT_EQ(2, costs.size());
+  const CostTracker::Cost* insert_cost = NULL;
+  const CostTracker::Cost* writer_cost = NULL;
+  for (int i = 0; i < 2; ++i) {
+    if (costs[i].first == "InsertScriptsFilter") {
+      insert_cost = &costs[i].second;
+    } else if (costs[i].first == html_writer_filter_->Name()) {
+      writer_cost = &costs[i].second;
+    }
+  }
+  ASSERT_TRUE(insert_cost != NULL);
+  ASSERT_TRUE(writer_cost != NULL);
+  // One flush window, shown to each filter once.
+  EXPECT_EQ(1, insert_cost->calls);
+  EXPECT_EQ(1, writer_cost->calls);
+  EXPECT_LT(0, insert_cost->events);
+  // The writer also sees the script the earlier filter inserted.
+  EXPECT_LT(insert_cost->events, writer_cost->events);
+}
+
 }  // namespace net_instaweb
@@ -29,6 +29,35 @@
 
 namespace net_instaweb {
 
+namespace {
+
+// Characters that GURL's canonicalizer copies through unchanged in the path of
+// a standard URL.  This deliberately omits '%' (escapes can get normalized),
+// '\\' (treated as '/'), ':' (could make the URL look absolute), and anything
+// that is escaped.
+inline bool IsCanonicalPathChar(char c) {
+  if (IsAsciiAlphaNumeric(c)) {
+    return true;
+  }
+  switch (c) {
+    case '!': case '$': case '&': case '(': case ')': case '*': case '+':
+    case ',': case '-': case '.': case '/': case ';': case '=': case '@':
+    case '_': case '~':
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Likewise for the query, where '?' and ':' are also left alone.  Note that a
+// ':' in the query can't make the URL look absolute, since the path before it
+// is not a valid scheme once it's followed by '?'.
+inline bool IsCanonicalQueryChar(char c) {
+  return IsCanonicalPathChar(c) || c == '?' || c == ':';
+}
+
+}  // namespace
+
 const size_t GoogleUrl::npos = std::string::npos;
 
 GoogleUrl::GoogleUrl()
@@ -92,16 +121,100 @@ bool GoogleUrl::ResolveHelper(const GURL& base, const std::string& url) {
   return gurl_.is_valid();
 }
 
+bool GoogleUrl::ResolveCanonicalPath(const GoogleUrl& base,
+                                     const StringPiece& relative) {
+  if (!base.is_web_valid_ || relative.empty() ||
+      relative.starts_with("//")) {
+    return false;
+  }
+
+  // Find where the path ends, rejecting anything that needs canonicalizing
+  // and any "." or ".." segment.
+  const size_t size = relative.size();
+  size_t path_end = 0;
+  size_t segment_start = 0;
+  for (;; ++path_end) {
+    const bool at_end = (path_end == size) || (relative[path_end] == '?');
+    if (at_end || relative[path_end] == '/') {
+      StringPiece segment =
+          relative.substr(segment_start, path_end - segment_start);
+      if (segment == "." || segment == "..") {
+        return false;
+      }
+      if (at_end) {
+        break;
+      }
+      segment_start = path_end + 1;
+    } else if (!IsCanonicalPathChar(relative[path_end])) {
+      return false;
+    }
+  }
+  if (path_end == 0) {
+    return false;  // A bare query keeps the base's leaf.
+  }
+  for (size_t i = path_end + 1; i < size; ++i) {
+    if (!IsCanonicalQueryChar(relative[i])) {
+      return false;
+    }
+  }
+
+  // The result keeps everything in base up to the start of its path for an
+  // absolute path, or up to and including the last '/' in its path for a
+  // relative one.
+  const std::string& base_spec = base.gurl_.possibly_invalid_spec();
+  const url_parse::Parsed& base_parsed =
+      base.gurl_.parsed_for_possibly_invalid_spec();
+  if (!base_parsed.path.is_nonempty()) {
+    return false;
+  }
+  size_t prefix_size = base_parsed.path.begin;
+  if (relative[0] != '/') {
+    StringPiece base_path(base_spec.data() + base_parsed.path.begin,
+                          base_parsed.path.len);
+    size_t last_slash = base_path.rfind('/');
+    if (last_slash == StringPiece::npos) {
+      return false;
+    }
+    prefix_size += last_slash + 1;
+  }
+
+  GoogleString spec;
+  spec.reserve(prefix_size + size);
+  spec.append(base_spec.data(), prefix_size);
+  relative.AppendToString(&spec);
+
+  url_parse::Parsed parsed = base_parsed;
+  parsed.path = url_parse::Component(
+      base_parsed.path.begin, prefix_size - base_parsed.path.begin + path_end);
+  if (path_end < size) {
+    parsed.query = url_parse::Component(prefix_size + path_end + 1,
+                                        size - path_end - 1);
+  } else {
+    parsed.query = url_parse::Component();
+  }
+  parsed.ref = url_parse::Component();
+
+  // The scheme is the base's, so the result is web-valid too.
+  GURL resolved(spec.data(), spec.size(), parsed, true);
+  gurl_.Swap(&resolved);
+  is_web_valid_ = true;
+  is_web_or_data_valid_ = true;
+  return true;
+}
+
 bool GoogleUrl::Reset(const GoogleUrl& base, const GoogleString& str) {
-  return ResolveHelper(base.gurl_, str);
+  return (ResolveCanonicalPath(base, str) ||
+          ResolveHelper(base.gurl_, str));
 }
 
 bool GoogleUrl::Reset(const GoogleUrl& base, const StringPiece& sp) {
-  return ResolveHelper(base.gurl_, sp.as_string());
+  return (ResolveCanonicalPath(base, sp) ||
+          ResolveHelper(base.gurl_, sp.as_string()));
 }
 
 bool GoogleUrl::Reset(const GoogleUrl& base, const char* str) {
-  return ResolveHelper(base.gurl_, str);
+  return (ResolveCanonicalPath(base, str) ||
+          ResolveHelper(base.gurl_, str));
 }
 
 bool GoogleUrl::Reset(const StringPiece& new_value) {
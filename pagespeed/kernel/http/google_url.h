@@ -243,6 +243,14 @@ class GoogleUrl {
   // Resolves a URL against a base. Returns whether the resolution worked.
   inline bool ResolveHelper(const GURL& base, const std::string& path_and_leaf);
 
+  // Resolves relative against a web-valid base without going through GURL's
+  // general-purpose resolver, for the common case on the HTML path of a
+  // relative or absolute path (with optional query) that is already in
+  // canonical form, such as "images/a.png" or "/s.css?v=2".  The result is
+  // assembled directly from the base's parsed components.  Returns false,
+  // leaving this URL untouched, if relative is not of that form.
+  bool ResolveCanonicalPath(const GoogleUrl& base, const StringPiece& relative);
+
   GURL gurl_;
   bool is_web_valid_;
   bool is_web_or_data_valid_;
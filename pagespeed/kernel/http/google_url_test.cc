@@ -292,6 +292,58 @@ TEST_F(GoogleUrlTest, ResolveAbsolute) {
   EXPECT_STREQ("/", resolved.PathSansQuery());
 }
 
+TEST_F(GoogleUrlTest, ResolveCanonicalPaths) {
+  // These all take the shortcut that skips GURL's resolver, so check the
+  // parsed components as well as the spec.
+  GoogleUrl base("https://u:p@a.com:8080/b/c/d.html?e=f#g");
+  ASSERT_TRUE(base.IsWebValid());
+
+  GoogleUrl relative(base, "x/y.css?v=1&w=2:3");
+  ASSERT_TRUE(relative.IsWebValid());
+  EXPECT_STREQ("https://u:p@a.com:8080/b/c/x/y.css?v=1&w=2:3",
+               relative.Spec());
+  EXPECT_STREQ("/b/c/x/y.css", relative.PathSansQuery());
+  EXPECT_STREQ("v=1&w=2:3", relative.Query());
+  EXPECT_STREQ("a.com:8080", relative.HostAndPort());
+  EXPECT_STREQ("y.css", relative.LeafSansQuery());
+
+  GoogleUrl absolute(base, StringPiece("/s.css"));
+  ASSERT_TRUE(absolute.IsWebValid());
+  EXPECT_STREQ("https://u:p@a.com:8080/s.css", absolute.Spec());
+  EXPECT_FALSE(absolute.has_query());
+
+  GoogleUrl empty_query(base, GoogleString("x.js?"));
+  ASSERT_TRUE(empty_query.IsWebValid());
+  EXPECT_STREQ("https://u:p@a.com:8080/b/c/x.js?", empty_query.Spec());
+  EXPECT_STREQ("/b/c/x.js", empty_query.PathSansQuery());
+
+  GoogleUrl extra_dots(base, "a.../..b/...");
+  ASSERT_TRUE(extra_dots.IsWebValid());
+  EXPECT_STREQ("https://u:p@a.com:8080/b/c/a.../..b/...", extra_dots.Spec());
+
+  GoogleUrl base_with_query_slash("http://a.com/b?c=/d/e");
+  GoogleUrl leaf(base_with_query_slash, "f.png");
+  EXPECT_STREQ("http://a.com/f.png", leaf.Spec());
+
+  GoogleUrl in_place("http://a.com/b/c");
+  EXPECT_TRUE(in_place.Reset(in_place, "d/e"));
+  EXPECT_STREQ("http://a.com/b/d/e", in_place.Spec());
+}
+
+TEST_F(GoogleUrlTest, ResolveNonCanonicalPaths) {
+  // These need GURL's resolver, and must give the same answers as before.
+  GoogleUrl base("http://a.com/b/c/d.html?e=f");
+  EXPECT_STREQ("http://a.com/b/x.css", GoogleUrl(base, "../x.css").Spec());
+  EXPECT_STREQ("http://a.com/b/c/x.css", GoogleUrl(base, "./x.css").Spec());
+  EXPECT_STREQ("http://a.com/b/c/", GoogleUrl(base, "x/..").Spec());
+  EXPECT_STREQ("http://a.com/b/c/d.html?y", GoogleUrl(base, "?y").Spec());
+  EXPECT_STREQ("http://a.com/b/c/x%20y", GoogleUrl(base, "x y").Spec());
+  EXPECT_STREQ("http://a.com/b/c/x#y", GoogleUrl(base, "x#y").Spec());
+  EXPECT_STREQ("http://a.com/x/y", GoogleUrl(base, "\\x\\y").Spec());
+  EXPECT_STREQ("http://o.com/x", GoogleUrl(base, "//o.com/x").Spec());
+  EXPECT_STREQ("http://a.com/b/c/d.html?e=f", GoogleUrl(base, "").Spec());
+}
+
 TEST_F(GoogleUrlTest, TestReset) {
   GoogleUrl url("http://www.google.com");
   EXPECT_TRUE(url.IsWebValid());
@@ -89,6 +89,263 @@ void ApplyTimeDelta(const char* attr, int64 delta_ms,
   }
 }
 
+// WriteAsBinary uses a flat encoding rather than serializing the protobuf, so
+// that reading headers back out of a cache entry is a single pass over the
+// buffer with no wire-format dispatch.  It consists of:
+//   kFlatBinaryMarker, kFlatBinaryVersion
+//   2 bytes: bitmask of which of the optional proto fields below are present
+//   1 byte: values of the present bool fields, using the same bits
+//   each present int32/int64 field, little-endian, in the order below
+//   the reason phrase, if present, as a varint length then bytes
+//   a varint header count, then each name and value as varint length + bytes
+// The marker can never start a serialized HttpResponseHeaders (it would be a
+// tag with wire type 7), so ReadFromBinary can still read entries written as
+// protobufs.
+const char kFlatBinaryMarker = '\xff';
+const char kFlatBinaryVersion = 1;
+
+enum FlatBinaryField {
+  kFlatStatusCode = 1 << 0,
+  kFlatReasonPhrase = 1 << 1,
+  kFlatMinorVersion = 1 << 2,
+  kFlatMajorVersion = 1 << 3,
+  kFlatExpirationTimeMs = 1 << 4,
+  kFlatDateMs = 1 << 5,
+  kFlatLastModifiedTimeMs = 1 << 6,
+  kFlatCacheTtlMs = 1 << 7,
+  // The bool fields start over at bit 8, so that their values fit in a byte
+  // when shifted down.
+  kFlatBrowserCacheable = 1 << 8,
+  kFlatProxyCacheable = 1 << 9,
+  kFlatRequiresBrowserRevalidation = 1 << 10,
+  kFlatRequiresProxyRevalidation = 1 << 11,
+  kFlatIsImplicitlyCacheable = 1 << 12,
+};
+
+void AppendFixed(uint64 value, int bytes, GoogleString* out) {
+  for (int i = 0; i < bytes; ++i) {
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+void AppendVarint(uint32 value, GoogleString* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendString(const GoogleString& str, GoogleString* out) {
+  AppendVarint(str.size(), out);
+  out->append(str);
+}
+
+void EncodeFlatBinary(const HttpResponseHeaders& proto, GoogleString* out) {
+  int fields = 0;
+  int bools = 0;
+  if (proto.has_status_code()) fields |= kFlatStatusCode;
+  if (proto.has_reason_phrase()) fields |= kFlatReasonPhrase;
+  if (proto.has_minor_version()) fields |= kFlatMinorVersion;
+  if (proto.has_major_version()) fields |= kFlatMajorVersion;
+  if (proto.has_expiration_time_ms()) fields |= kFlatExpirationTimeMs;
+  if (proto.has_date_ms()) fields |= kFlatDateMs;
+  if (proto.has_last_modified_time_ms()) fields |= kFlatLastModifiedTimeMs;
+  if (proto.has_cache_ttl_ms()) fields |= kFlatCacheTtlMs;
+  if (proto.has_browser_cacheable()) {
+    fields |= kFlatBrowserCacheable;
+    bools |= proto.browser_cacheable() ? kFlatBrowserCacheable : 0;
+  }
+  if (proto.has_proxy_cacheable()) {
+    fields |= kFlatProxyCacheable;
+    bools |= proto.proxy_cacheable() ? kFlatProxyCacheable : 0;
+  }
+  if (proto.has_requires_browser_revalidation()) {
+    fields |= kFlatRequiresBrowserRevalidation;
+    bools |= proto.requires_browser_revalidation() ?
+        kFlatRequiresBrowserRevalidation : 0;
+  }
+  if (proto.has_requires_proxy_revalidation()) {
+    fields |= kFlatRequiresProxyRevalidation;
+    bools |= proto.requires_proxy_revalidation() ?
+        kFlatRequiresProxyRevalidation : 0;
+  }
+  if (proto.has_is_implicitly_cacheable()) {
+    fields |= kFlatIsImplicitlyCacheable;
+    bools |= proto.is_implicitly_cacheable() ? kFlatIsImplicitlyCacheable : 0;
+  }
+
+  out->push_back(kFlatBinaryMarker);
+  out->push_back(kFlatBinaryVersion);
+  AppendFixed(fields, 2, out);
+  AppendFixed(bools >> 8, 1, out);
+  if (fields & kFlatStatusCode) {
+    AppendFixed(static_cast<uint32>(proto.status_code()), 4, out);
+  }
+  if (fields & kFlatMinorVersion) {
+    AppendFixed(static_cast<uint32>(proto.minor_version()), 4, out);
+  }
+  if (fields & kFlatMajorVersion) {
+    AppendFixed(static_cast<uint32>(proto.major_version()), 4, out);
+  }
+  if (fields & kFlatExpirationTimeMs) {
+    AppendFixed(proto.expiration_time_ms(), 8, out);
+  }
+  if (fields & kFlatDateMs) {
+    AppendFixed(proto.date_ms(), 8, out);
+  }
+  if (fields & kFlatLastModifiedTimeMs) {
+    AppendFixed(proto.last_modified_time_ms(), 8, out);
+  }
+  if (fields & kFlatCacheTtlMs) {
+    AppendFixed(proto.cache_ttl_ms(), 8, out);
+  }
+  if (fields & kFlatReasonPhrase) {
+    AppendString(proto.reason_phrase(), out);
+  }
+  AppendVarint(proto.header_size(), out);
+  for (int i = 0, n = proto.header_size(); i < n; ++i) {
+    AppendString(proto.header(i).name(), out);
+    AppendString(proto.header(i).value(), out);
+  }
+}
+
+// Reads the fields of a flat encoding in order, failing (rather than reading
+// past the end) if the buffer is truncated or otherwise corrupt.
+class FlatBinaryReader {
+ public:
+  explicit FlatBinaryReader(StringPiece buf) : buf_(buf), pos_(0) {}
+
+  bool ReadFixed(int bytes, uint64* value) {
+    if (buf_.size() - pos_ < static_cast<size_t>(bytes)) {
+      return false;
+    }
+    *value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      *value |= static_cast<uint64>(static_cast<uint8>(buf_[pos_++]))
+          << (8 * i);
+    }
+    return true;
+  }
+
+  bool ReadVarint(uint32* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      if (pos_ == buf_.size()) {
+        return false;
+      }
+      const uint8 byte = buf_[pos_++];
+      *value |= static_cast<uint32>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool ReadString(StringPiece* str) {
+    uint32 size;
+    if (!ReadVarint(&size) || buf_.size() - pos_ < size) {
+      return false;
+    }
+    *str = buf_.substr(pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool at_end() const { return pos_ == buf_.size(); }
+
+ private:
+  StringPiece buf_;
+  size_t pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(FlatBinaryReader);
+};
+
+// Replaces *proto with the decoded headers.  Fields absent from the encoding
+// are left absent, as they are when parsing a serialized proto.
+bool DecodeFlatBinary(StringPiece buf, HttpResponseHeaders* proto) {
+  proto->Clear();
+  FlatBinaryReader reader(buf);
+  uint64 marker, version, fields, bools, value;
+  if (!reader.ReadFixed(1, &marker) ||
+      marker != static_cast<uint8>(kFlatBinaryMarker) ||
+      !reader.ReadFixed(1, &version) || version != kFlatBinaryVersion ||
+      !reader.ReadFixed(2, &fields) || !reader.ReadFixed(1, &bools)) {
+    return false;
+  }
+  bools <<= 8;
+  if (fields & kFlatStatusCode) {
+    if (!reader.ReadFixed(4, &value)) return false;
+    proto->set_status_code(static_cast<int32>(value));
+  }
+  if (fields & kFlatMinorVersion) {
+    if (!reader.ReadFixed(4, &value)) return false;
+    proto->set_minor_version(static_cast<int32>(value));
+  }
+  if (fields & kFlatMajorVersion) {
+    if (!reader.ReadFixed(4, &value)) return false;
+    proto->set_major_version(static_cast<int32>(value));
+  }
+  if (fields & kFlatExpirationTimeMs) {
+    if (!reader.ReadFixed(8, &value)) return false;
+    proto->set_expiration_time_ms(static_cast<int64>(value));
+  }
+  if (fields & kFlatDateMs) {
+    if (!reader.ReadFixed(8, &value)) return false;
+    proto->set_date_ms(static_cast<int64>(value));
+  }
+  if (fields & kFlatLastModifiedTimeMs) {
+    if (!reader.ReadFixed(8, &value)) return false;
+    proto->set_last_modified_time_ms(static_cast<int64>(value));
+  }
+  if (fields & kFlatCacheTtlMs) {
+    if (!reader.ReadFixed(8, &value)) return false;
+    proto->set_cache_ttl_ms(static_cast<int64>(value));
+  }
+  if (fields & kFlatBrowserCacheable) {
+    proto->set_browser_cacheable((bools & kFlatBrowserCacheable) != 0);
+  }
+  if (fields & kFlatProxyCacheable) {
+    proto->set_proxy_cacheable((bools & kFlatProxyCacheable) != 0);
+  }
+  if (fields & kFlatRequiresBrowserRevalidation) {
+    proto->set_requires_browser_revalidation(
+        (bools & kFlatRequiresBrowserRevalidation) != 0);
+  }
+  if (fields & kFlatRequiresProxyRevalidation) {
+    proto->set_requires_proxy_revalidation(
+        (bools & kFlatRequiresProxyRevalidation) != 0);
+  }
+  if (fields & kFlatIsImplicitlyCacheable) {
+    proto->set_is_implicitly_cacheable(
+        (bools & kFlatIsImplicitlyCacheable) != 0);
+  }
+  StringPiece name, str;
+  if (fields & kFlatReasonPhrase) {
+    if (!reader.ReadString(&str)) return false;
+    proto->set_reason_phrase(str.data(), str.size());
+  }
+  uint32 num_headers;
+  if (!reader.ReadVarint(&num_headers)) {
+    return false;
+  }
+  // Each header takes at least two bytes, which bounds how much a corrupt
+  // count can make us reserve.
+  if (num_headers <= buf.size() / 2) {
+    proto->mutable_header()->Reserve(num_headers);
+  }
+  for (uint32 i = 0; i < num_headers; ++i) {
+    if (!reader.ReadString(&name) || !reader.ReadString(&str)) {
+      return false;
+    }
+    NameValue* header = proto->add_header();
+    header->set_name(name.data(), name.size());
+    header->set_value(str.data(), str.size());
+  }
+  return reader.at_end();
+}
+
 }  // namespace
 
 bool ResponseHeaders::IsImminentlyExpiring(
@@ -356,11 +613,17 @@ bool ResponseHeaders::WriteAsBinary(Writer* writer, MessageHandler* handler) {
   if (cache_fields_dirty_) {
     ComputeCaching();
   }
-  return Headers<HttpResponseHeaders>::WriteAsBinary(writer, handler);
+  GoogleString buf;
+  EncodeFlatBinary(*proto(), &buf);
+  return writer->Write(buf, handler);
 }
 
 bool ResponseHeaders::ReadFromBinary(const StringPiece& buf,
                                      MessageHandler* message_handler) {
+  if (!buf.empty() && buf[0] == kFlatBinaryMarker) {
+    Clear();
+    return DecodeFlatBinary(buf, mutable_proto());
+  }
   cache_fields_dirty_ = false;
   return Headers<HttpResponseHeaders>::ReadFromBinary(buf, message_handler);
 }
@@ -83,12 +83,15 @@ class ResponseHeaders : public Headers<HttpResponseHeaders> {
   // existing fields.
   void UpdateFromProto(const HttpResponseHeaders& proto);
 
-  // Serialize HTTP response header to a binary stream.
+  // Serialize HTTP response header to a binary stream.  This uses a flat
+  // encoding that carries the computed caching fields, so ReadFromBinary can
+  // restore them without re-parsing Cache-Control and friends.
   virtual bool WriteAsBinary(Writer* writer, MessageHandler* message_handler);
 
   // Read HTTP response header from a binary string.  Note that this
   // is distinct from HTTP response-header parsing, which is in
-  // ResponseHeadersParser.
+  // ResponseHeadersParser.  Both the flat encoding written by WriteAsBinary
+  // and the older serialized-protobuf encoding are accepted.
   virtual bool ReadFromBinary(const StringPiece& buf, MessageHandler* handler);
 
   // Serialize HTTP response header in HTTP format so it can be re-parsed.
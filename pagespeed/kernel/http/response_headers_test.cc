@@ -285,6 +285,95 @@ TEST_F(ResponseHeadersTest, TestParseAndWrite) {
   CheckGoogleHeaders(response_headers3);
 }
 
+TEST_F(ResponseHeadersTest, BinaryRoundTripKeepsCachingFields) {
+  GoogleString header_text = StrCat(
+      "HTTP/1.1 203 Non-Authoritative\r\n"
+      "Date: ", start_time_string_, "\r\n"
+      "Cache-Control: max-age=300, must-revalidate\r\n"
+      "Last-Modified: ", start_time_string_, "\r\n"
+      "Vary: Accept-Encoding\r\n\r\n");
+  ParseHeaders(header_text);
+  response_headers_.Add("X-Empty", "");
+  response_headers_.Add("X-Binary", StringPiece("\0\x80\xff", 3));
+  response_headers_.ComputeCaching();
+
+  GoogleString binary;
+  StringWriter writer(&binary);
+  ASSERT_TRUE(response_headers_.WriteAsBinary(&writer, &message_handler_));
+
+  // The caching fields come back as computed, without recomputation, and
+  // the protos match field for field, including which fields are present.
+  ResponseHeaders read;
+  ASSERT_TRUE(read.ReadFromBinary(binary, &message_handler_));
+  EXPECT_EQ(response_headers_.cache_ttl_ms(), read.cache_ttl_ms());
+  EXPECT_EQ(response_headers_.date_ms(), read.date_ms());
+  EXPECT_EQ(response_headers_.CacheExpirationTimeMs(),
+            read.CacheExpirationTimeMs());
+  EXPECT_STREQ("Accept-Encoding", read.Lookup1(HttpAttributes::kVary));
+  HttpResponseHeaders expected_proto, read_proto;
+  response_headers_.CopyToProto(&expected_proto);
+  read.CopyToProto(&read_proto);
+  EXPECT_EQ(expected_proto.SerializeAsString(), read_proto.SerializeAsString());
+
+  // Truncating the encoding anywhere makes it unreadable.
+  for (int i = 1, n = binary.size(); i < n; ++i) {
+    EXPECT_FALSE(read.ReadFromBinary(StringPiece(binary.data(), i),
+                                     &message_handler_)) << i;
+  }
+}
+
+TEST_F(ResponseHeadersTest, ReadFromBinaryReplacesEarlierRead) {
+  // A cacheable response sets optional caching fields that an uncacheable
+  // one leaves out; reading the second into the same object must not keep
+  // the first's values.
+  ParseHeaders(StrCat("HTTP/1.1 200 OK\r\n"
+                      "Date: ", start_time_string_, "\r\n"
+                      "Cache-Control: max-age=300\r\n\r\n"));
+  response_headers_.ComputeCaching();
+  GoogleString cacheable;
+  StringWriter cacheable_writer(&cacheable);
+  ASSERT_TRUE(response_headers_.WriteAsBinary(&cacheable_writer,
+                                              &message_handler_));
+
+  ResponseHeaders uncacheable_headers;
+  uncacheable_headers.set_status_code(HttpStatus::kNotFound);
+  GoogleString uncacheable;
+  StringWriter uncacheable_writer(&uncacheable);
+  ASSERT_TRUE(uncacheable_headers.WriteAsBinary(&uncacheable_writer,
+                                                &message_handler_));
+  HttpResponseHeaders expected_proto;
+  uncacheable_headers.CopyToProto(&expected_proto);
+  ASSERT_FALSE(expected_proto.has_cache_ttl_ms());
+
+  ResponseHeaders read;
+  ASSERT_TRUE(read.ReadFromBinary(cacheable, &message_handler_));
+  EXPECT_EQ(300 * Timer::kSecondMs, read.cache_ttl_ms());
+  ASSERT_TRUE(read.ReadFromBinary(uncacheable, &message_handler_));
+  HttpResponseHeaders read_proto;
+  read.CopyToProto(&read_proto);
+  EXPECT_EQ(expected_proto.SerializeAsString(), read_proto.SerializeAsString());
+  EXPECT_FALSE(read_proto.has_cache_ttl_ms());
+  EXPECT_EQ(HttpStatus::kNotFound, read.status_code());
+}
+
+TEST_F(ResponseHeadersTest, ReadFromBinaryAcceptsProtobuf) {
+  // Cache entries written before the flat encoding hold a serialized
+  // HttpResponseHeaders, which must still be readable.
+  ParseHeaders(StrCat("HTTP/1.0 200 OK\r\n"
+                      "Date: ", start_time_string_, "\r\n"
+                      "Cache-control: max-age=300\r\n\r\n"));
+  response_headers_.ComputeCaching();
+  HttpResponseHeaders proto;
+  response_headers_.CopyToProto(&proto);
+
+  ResponseHeaders read;
+  ASSERT_TRUE(read.ReadFromBinary(proto.SerializeAsString(),
+                                  &message_handler_));
+  EXPECT_EQ(200, read.status_code());
+  EXPECT_EQ(300 * Timer::kSecondMs, read.cache_ttl_ms());
+  EXPECT_TRUE(read.IsProxyCacheable());
+}
+
 TEST_F(ResponseHeadersTest, TestSizeEstimate) {
   GoogleString headers = StrCat(
       "HTTP/1.0 200 OK\r\n"
@@ -14,13 +14,20 @@
 
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "base/logging.h"
+#include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/fast_wildcard_group.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_hash.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/cache/lru_cache_base.h"
 #include "pagespeed/kernel/http/user_agent_matcher.h"
 #include "pagespeed/kernel/util/re2.h"
 
@@ -301,8 +308,98 @@ const Dimension kKnownScreenDimensions[] = {
   {"XT907", 540, 960},
 };
 
+const char kClassificationCacheHits[] = "user_agent_classification_cache_hits";
+const char kClassificationCacheMisses[] =
+    "user_agent_classification_cache_misses";
+
+// User agents longer than this are classified without the cache.  Real ones
+// run to a few hundred bytes.
+const size_t kMaxCachedUserAgentLength = 1024;
+
 }  // namespace
 
+// Maps user agents to bitsets of the wildcard lists they match.  User agents
+// come from clients, so the cache is bounded in bytes and evicts the least
+// recently used entries, keeping a site's common user agents resident while
+// a stream of one-off ones passes through.  It is split into shards, chosen
+// by a hash of the user agent, each with its own lock, so that concurrent
+// requests rarely contend.
+class UserAgentMatcher::ClassificationCache {
+ public:
+  typedef uint32 Classification;
+
+  ClassificationCache(size_t max_bytes, ThreadSystem* thread_system,
+                      Statistics* statistics)
+      : hits_(statistics->GetVariable(kClassificationCacheHits)),
+        misses_(statistics->GetVariable(kClassificationCacheMisses)) {
+    for (int i = 0; i < kNumShards; ++i) {
+      shards_.push_back(new Shard(max_bytes / kNumShards, thread_system));
+    }
+  }
+
+  ~ClassificationCache() {
+    STLDeleteElements(&shards_);
+  }
+
+  // Returns true and sets *classification if user_agent is in the cache.
+  // The hash of user_agent picks the shard, here and in Insert.
+  bool Lookup(const GoogleString& user_agent, uint64 hash,
+              Classification* classification) {
+    bool found = false;
+    Shard* shard = shards_[hash % kNumShards];
+    {
+      ScopedMutex lock(shard->mutex.get());
+      Classification* value = shard->lru.GetFreshen(user_agent);
+      if (value != NULL) {
+        *classification = *value;
+        found = true;
+      }
+    }
+    (found ? hits_ : misses_)->Add(1);
+    return found;
+  }
+
+  void Insert(const GoogleString& user_agent, uint64 hash,
+              Classification classification) {
+    Shard* shard = shards_[hash % kNumShards];
+    ScopedMutex lock(shard->mutex.get());
+    shard->lru.Put(user_agent, &classification);
+  }
+
+ private:
+  static const int kNumShards = 16;
+
+  class ClassificationHelper {
+   public:
+    size_t size(Classification classification) const {
+      return sizeof(classification);
+    }
+    bool Equal(Classification a, Classification b) const { return a == b; }
+    void EvictNotify(Classification classification) {}
+    bool ShouldReplace(Classification old_classification,
+                       Classification new_classification) const {
+      return true;
+    }
+  };
+
+  struct Shard {
+    Shard(size_t max_bytes, ThreadSystem* thread_system)
+        : mutex(thread_system->NewMutex()),
+          lru(max_bytes, &helper) {
+    }
+
+    scoped_ptr<AbstractMutex> mutex;
+    ClassificationHelper helper;
+    LRUCacheBase<Classification, ClassificationHelper> lru;
+  };
+
+  std::vector<Shard*> shards_;
+  Variable* hits_;
+  Variable* misses_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClassificationCache);
+};
+
 // Note that "blink" here does not mean the new Chrome rendering
 // engine.  It refers to a pre-existing internal name for the
 // technology behind partial HTML caching:
@@ -408,8 +505,85 @@ UserAgentMatcher::UserAgentMatcher()
 UserAgentMatcher::~UserAgentMatcher() {
 }
 
+void UserAgentMatcher::InitStats(Statistics* statistics) {
+  statistics->AddVariable(kClassificationCacheHits);
+  statistics->AddVariable(kClassificationCacheMisses);
+}
+
+void UserAgentMatcher::EnableClassificationCache(size_t max_bytes,
+                                                 ThreadSystem* thread_system,
+                                                 Statistics* statistics) {
+  if (classification_cache_.get() == NULL) {
+    classification_cache_.reset(
+        new ClassificationCache(max_bytes, thread_system, statistics));
+  }
+}
+
+bool UserAgentMatcher::MatchesList(WildcardList list,
+                                   const StringPiece& user_agent) const {
+  // Overlong user agents are not worth the space they would take, and would
+  // push out many ordinary ones.
+  if ((classification_cache_.get() == NULL) ||
+      (user_agent.size() > kMaxCachedUserAgentLength)) {
+    return MatchListUncached(list, user_agent);
+  }
+  COMPILE_ASSERT(kNumWildcardLists <= 32, classification_too_small);
+  const uint64 hash =
+      HashString<CasePreserve, uint64>(user_agent.data(), user_agent.size());
+  const GoogleString key = user_agent.as_string();
+  ClassificationCache::Classification classification;
+  if (!classification_cache_->Lookup(key, hash, &classification)) {
+    classification = 0;
+    for (int i = 0; i < kNumWildcardLists; ++i) {
+      if (MatchListUncached(static_cast<WildcardList>(i), user_agent)) {
+        classification |= 1U << i;
+      }
+    }
+    classification_cache_->Insert(key, hash, classification);
+  }
+  return (classification & (1U << list)) != 0;
+}
+
+bool UserAgentMatcher::MatchListUncached(
+    WildcardList list, const StringPiece& user_agent) const {
+  switch (list) {
+    case kImageInliningList:
+      return supports_image_inlining_.Match(user_agent, false);
+    case kLazyloadImagesList:
+      return supports_lazyload_images_.Match(user_agent, true);
+    case kDeferJsWhitelist:
+      return defer_js_whitelist_.Match(user_agent, false);
+    case kBlinkDesktopWhitelist:
+      return blink_desktop_whitelist_.Match(user_agent, false);
+    case kBlinkDesktopBlacklist:
+      return blink_desktop_blacklist_.Match(user_agent, false);
+    case kBlinkMobileWhitelist:
+      return blink_mobile_whitelist_.Match(user_agent, false);
+    case kWebpList:
+      return supports_webp_.Match(user_agent, false);
+    case kWebpLosslessAlphaList:
+      return supports_webp_lossless_alpha_.Match(user_agent, false);
+    case kPrefetchImageTagList:
+      return supports_prefetch_image_tag_.Match(user_agent, false);
+    case kPrefetchLinkScriptTagList:
+      return supports_prefetch_link_script_tag_.Match(user_agent, false);
+    case kDnsPrefetchList:
+      return supports_dns_prefetch_.Match(user_agent, false);
+    case kMobileList:
+      return mobile_user_agents_.Match(user_agent, false);
+    case kTabletList:
+      return tablet_user_agents_.Match(user_agent, false);
+    case kIeList:
+      return ie_user_agents_.Match(user_agent, false);
+    case kNumWildcardLists:
+      break;
+  }
+  LOG(DFATAL) << "Unknown wildcard list " << list;
+  return false;
+}
+
 bool UserAgentMatcher::IsIe(const StringPiece& user_agent) const {
-  return ie_user_agents_.Match(user_agent, false);
+  return MatchesList(kIeList, user_agent);
 }
 
 bool UserAgentMatcher::IsIe9(const StringPiece& user_agent) const {
@@ -421,11 +595,11 @@ bool UserAgentMatcher::SupportsImageInlining(
   if (user_agent.empty()) {
     return true;
   }
-  return supports_image_inlining_.Match(user_agent, false);
+  return MatchesList(kImageInliningList, user_agent);
 }
 
 bool UserAgentMatcher::SupportsLazyloadImages(StringPiece user_agent) const {
-  return supports_lazyload_images_.Match(user_agent, true);
+  return MatchesList(kLazyloadImagesList, user_agent);
 }
 
 UserAgentMatcher::BlinkRequestType UserAgentMatcher::GetBlinkRequestType(
@@ -434,15 +608,15 @@ UserAgentMatcher::BlinkRequestType UserAgentMatcher::GetBlinkRequestType(
     return kNullOrEmpty;
   }
   if (GetDeviceTypeForUAAndHeaders(user_agent, request_headers) != kDesktop) {
-    if (blink_mobile_whitelist_.Match(user_agent, false)) {
+    if (MatchesList(kBlinkMobileWhitelist, user_agent)) {
       return kBlinkWhiteListForMobile;
     }
     return kDoesNotSupportBlinkForMobile;
   }
-  if (blink_desktop_blacklist_.Match(user_agent, false)) {
+  if (MatchesList(kBlinkDesktopBlacklist, user_agent)) {
     return kBlinkBlackListForDesktop;
   }
-  if (blink_desktop_whitelist_.Match(user_agent, false)) {
+  if (MatchesList(kBlinkDesktopWhitelist, user_agent)) {
     return kBlinkWhiteListForDesktop;
   }
   return kDoesNotSupportBlink;
@@ -450,9 +624,9 @@ UserAgentMatcher::BlinkRequestType UserAgentMatcher::GetBlinkRequestType(
 
 UserAgentMatcher::PrefetchMechanism UserAgentMatcher::GetPrefetchMechanism(
     const StringPiece& user_agent) const {
-  if (supports_prefetch_image_tag_.Match(user_agent, false)) {
+  if (MatchesList(kPrefetchImageTagList, user_agent)) {
     return kPrefetchImageTag;
-  } else if (supports_prefetch_link_script_tag_.Match(user_agent, false)) {
+  } else if (MatchesList(kPrefetchLinkScriptTagList, user_agent)) {
     return kPrefetchLinkScriptTag;
   }
   return kPrefetchNotSupported;
@@ -460,27 +634,27 @@ UserAgentMatcher::PrefetchMechanism UserAgentMatcher::GetPrefetchMechanism(
 
 bool UserAgentMatcher::SupportsDnsPrefetch(
     const StringPiece& user_agent) const {
-  return supports_dns_prefetch_.Match(user_agent, false);
+  return MatchesList(kDnsPrefetchList, user_agent);
 }
 
 bool UserAgentMatcher::SupportsJsDefer(const StringPiece& user_agent,
                                        bool allow_mobile) const {
   // TODO(ksimbili): Use IsMobileRequest?
   if (GetDeviceTypeForUA(user_agent) != kDesktop) {
-    return allow_mobile && blink_mobile_whitelist_.Match(user_agent, false);
+    return allow_mobile && MatchesList(kBlinkMobileWhitelist, user_agent);
   }
-  return user_agent.empty() || defer_js_whitelist_.Match(user_agent, false);
+  return user_agent.empty() || MatchesList(kDeferJsWhitelist, user_agent);
 }
 
 bool UserAgentMatcher::SupportsWebp(const StringPiece& user_agent) const {
   // TODO(jmaessen): this is a stub for regression testing purposes.
   // Put in real detection without treading on fengfei's toes.
-  return supports_webp_.Match(user_agent, false);
+  return MatchesList(kWebpList, user_agent);
 }
 
 bool UserAgentMatcher::SupportsWebpLosslessAlpha(
     const StringPiece& user_agent) const {
-  return supports_webp_lossless_alpha_.Match(user_agent, false);
+  return MatchesList(kWebpLosslessAlphaList, user_agent);
 }
 
 UserAgentMatcher::DeviceType UserAgentMatcher::GetDeviceTypeForUAAndHeaders(
@@ -523,10 +697,10 @@ bool UserAgentMatcher::SupportsSplitHtml(const StringPiece& user_agent,
 // http request.
 UserAgentMatcher::DeviceType UserAgentMatcher::GetDeviceTypeForUA(
     const StringPiece& user_agent) const {
-  if (mobile_user_agents_.Match(user_agent, false)) {
+  if (MatchesList(kMobileList, user_agent)) {
     return kMobile;
   }
-  if (tablet_user_agents_.Match(user_agent, false)) {
+  if (MatchesList(kTabletList, user_agent)) {
     return kTablet;
   }
   return kDesktop;
@@ -15,6 +15,7 @@
 #ifndef PAGESPEED_KERNEL_HTTP_USER_AGENT_MATCHER_H_
 #define PAGESPEED_KERNEL_HTTP_USER_AGENT_MATCHER_H_
 
+#include <cstddef>
 #include <map>
 #include <utility>
 
@@ -32,6 +33,8 @@ using std::map;
 namespace net_instaweb {
 
 class RequestHeaders;
+class Statistics;
+class ThreadSystem;
 
 // This class contains various user agent based checks.  Currently all of these
 // are based on simple wildcard based white- and black-lists.
@@ -73,6 +76,19 @@ class UserAgentMatcher {
   UserAgentMatcher();
   virtual ~UserAgentMatcher();
 
+  static void InitStats(Statistics* statistics);
+
+  // Makes the wildcard-list based checks below remember their answers for
+  // recently seen user agents, in up to about max_bytes.  The first check on a
+  // user agent evaluates all of the lists at once and caches the results as a
+  // bitset, so that subsequent checks of any kind on it are a single lookup.
+  // Very long user agents are never cached.  Hits and misses are counted in
+  // statistics, on which InitStats must have been called.  This must be called
+  // before the matcher is shared between threads; calls after the first are
+  // ignored.
+  void EnableClassificationCache(size_t max_bytes, ThreadSystem* thread_system,
+                                 Statistics* statistics);
+
   // Before calling IsIe, ask if you're doing the right thing: are you doing
   // something that will mess up IE 11 in standards mode?  Are you in a position
   // where you can't tell what compatibility mode IE 11 is in?  Right now we use
@@ -153,6 +169,36 @@ class UserAgentMatcher {
       int required_patch) const;
 
  private:
+  class ClassificationCache;
+
+  // The wildcard lists used above, each of which is given a bit in the
+  // bitsets held by ClassificationCache.
+  enum WildcardList {
+    kImageInliningList,
+    kLazyloadImagesList,
+    kDeferJsWhitelist,
+    kBlinkDesktopWhitelist,
+    kBlinkDesktopBlacklist,
+    kBlinkMobileWhitelist,
+    kWebpList,
+    kWebpLosslessAlphaList,
+    kPrefetchImageTagList,
+    kPrefetchLinkScriptTagList,
+    kDnsPrefetchList,
+    kMobileList,
+    kTabletList,
+    kIeList,
+    kNumWildcardLists
+  };
+
+  // Returns whether user_agent matches the given list, consulting the
+  // classification cache if there is one.
+  bool MatchesList(WildcardList list, const StringPiece& user_agent) const;
+
+  // Matches user_agent against the given list directly.
+  bool MatchListUncached(WildcardList list,
+                         const StringPiece& user_agent) const;
+
   FastWildcardGroup supports_image_inlining_;
   FastWildcardGroup supports_lazyload_images_;
   FastWildcardGroup defer_js_whitelist_;
@@ -172,6 +218,7 @@ class UserAgentMatcher {
   const RE2 chrome_version_pattern_;
   scoped_ptr<RE2> known_devices_pattern_;
   mutable map <GoogleString, pair<int, int> > screen_dimensions_map_;
+  scoped_ptr<ClassificationCache> classification_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(UserAgentMatcher);
 };
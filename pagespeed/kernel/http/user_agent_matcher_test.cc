@@ -14,13 +14,48 @@
 
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/http/request_headers.h"
 #include "pagespeed/kernel/http/user_agent_matcher.h"
 #include "pagespeed/kernel/http/user_agent_matcher_test_base.h"
+#include "pagespeed/kernel/util/platform.h"
+#include "pagespeed/kernel/util/simple_stats.h"
 
 namespace net_instaweb {
 
 class UserAgentMatcherTest : public UserAgentMatcherTestBase {
+ protected:
+  // Checks that every wildcard-list based answer from matcher agrees with
+  // the one from the uncached user_agent_matcher_.
+  void ExpectSameClassification(const UserAgentMatcher& matcher,
+                                const char* user_agent) {
+    SCOPED_TRACE(user_agent);
+    const UserAgentMatcher& expected = *user_agent_matcher_;
+    EXPECT_EQ(expected.IsIe(user_agent), matcher.IsIe(user_agent));
+    EXPECT_EQ(expected.SupportsImageInlining(user_agent),
+              matcher.SupportsImageInlining(user_agent));
+    EXPECT_EQ(expected.SupportsLazyloadImages(user_agent),
+              matcher.SupportsLazyloadImages(user_agent));
+    EXPECT_EQ(expected.GetBlinkRequestType(user_agent, NULL),
+              matcher.GetBlinkRequestType(user_agent, NULL));
+    EXPECT_EQ(expected.GetPrefetchMechanism(user_agent),
+              matcher.GetPrefetchMechanism(user_agent));
+    EXPECT_EQ(expected.GetDeviceTypeForUA(user_agent),
+              matcher.GetDeviceTypeForUA(user_agent));
+    EXPECT_EQ(expected.SupportsJsDefer(user_agent, false),
+              matcher.SupportsJsDefer(user_agent, false));
+    EXPECT_EQ(expected.SupportsJsDefer(user_agent, true),
+              matcher.SupportsJsDefer(user_agent, true));
+    EXPECT_EQ(expected.SupportsWebp(user_agent),
+              matcher.SupportsWebp(user_agent));
+    EXPECT_EQ(expected.SupportsWebpLosslessAlpha(user_agent),
+              matcher.SupportsWebpLosslessAlpha(user_agent));
+    EXPECT_EQ(expected.SupportsDnsPrefetch(user_agent),
+              matcher.SupportsDnsPrefetch(user_agent));
+  }
 };
 
 TEST_F(UserAgentMatcherTest, IsIeTest) {
@@ -576,4 +611,89 @@ TEST_F(UserAgentMatcherTest, IE11BlinkFailure) {
   }
 }
 
+TEST_F(UserAgentMatcherTest, ClassificationCache) {
+  scoped_ptr<ThreadSystem> thread_system(Platform::CreateThreadSystem());
+  SimpleStats stats(thread_system.get());
+  UserAgentMatcher::InitStats(&stats);
+  UserAgentMatcher matcher;
+  matcher.EnableClassificationCache(100 * 1000, thread_system.get(), &stats);
+
+  const char* user_agents[] = {
+    kIe6UserAgent, kIe9UserAgent, kChromeUserAgent, kFirefoxUserAgent,
+    kIPhoneUserAgent, kIPadUserAgent, kAndroidChrome21UserAgent,
+    kNexus7ChromeUserAgent, kBlackBerryOS5UserAgent, kGooglePlusUserAgent,
+    kOpera5UserAgent, UserAgentMatcher::kTestUserAgentWebP, ""
+  };
+  const int num_user_agents = arraysize(user_agents);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < num_user_agents; ++i) {
+      ExpectSameClassification(matcher, user_agents[i]);
+    }
+  }
+
+  // Each user agent is only classified once; SupportsImageInlining("")
+  // doesn't consult the lists.
+  Variable* hits = stats.GetVariable("user_agent_classification_cache_hits");
+  Variable* misses =
+      stats.GetVariable("user_agent_classification_cache_misses");
+  EXPECT_EQ(num_user_agents, misses->Get());
+  EXPECT_LT(num_user_agents, hits->Get());
+}
+
+TEST_F(UserAgentMatcherTest, ClassificationCacheOverflow) {
+  scoped_ptr<ThreadSystem> thread_system(Platform::CreateThreadSystem());
+  SimpleStats stats(thread_system.get());
+  UserAgentMatcher::InitStats(&stats);
+  UserAgentMatcher matcher;
+  // Room for about one real user agent in each shard.
+  matcher.EnableClassificationCache(16 * 200, thread_system.get(), &stats);
+
+  // Cycling through more user agents than fit keeps the answers right.
+  const char* user_agents[] = {
+    kIe6UserAgent, kChromeUserAgent, kIPhoneUserAgent, kIPadUserAgent
+  };
+  for (int pass = 0; pass < 3; ++pass) {
+    for (int i = 0, n = arraysize(user_agents); i < n; ++i) {
+      ExpectSameClassification(matcher, user_agents[i]);
+    }
+  }
+}
+
+TEST_F(UserAgentMatcherTest, ClassificationCacheKeepsRecentlyUsed) {
+  scoped_ptr<ThreadSystem> thread_system(Platform::CreateThreadSystem());
+  SimpleStats stats(thread_system.get());
+  UserAgentMatcher::InitStats(&stats);
+  UserAgentMatcher matcher;
+  // Each of the 16 shards holds two 14-byte user agents with their 4-byte
+  // classifications.
+  matcher.EnableClassificationCache(16 * 40, thread_system.get(), &stats);
+
+  // A flood of distinct user agents doesn't evict one that keeps being used.
+  matcher.IsIe("hot-user-agent");
+  for (int i = 0; i < 200; ++i) {
+    matcher.IsIe(StringPrintf("user-agent-%03d", i));
+    matcher.IsIe("hot-user-agent");
+  }
+  EXPECT_EQ(201, stats.GetVariable(
+      "user_agent_classification_cache_misses")->Get());
+  EXPECT_EQ(200, stats.GetVariable(
+      "user_agent_classification_cache_hits")->Get());
+}
+
+TEST_F(UserAgentMatcherTest, ClassificationCacheSkipsLongUserAgents) {
+  scoped_ptr<ThreadSystem> thread_system(Platform::CreateThreadSystem());
+  SimpleStats stats(thread_system.get());
+  UserAgentMatcher::InitStats(&stats);
+  UserAgentMatcher matcher;
+  matcher.EnableClassificationCache(100 * 1000, thread_system.get(), &stats);
+
+  GoogleString user_agent = StrCat(kChromeUserAgent, GoogleString(2000, 'x'));
+  ExpectSameClassification(matcher, user_agent.c_str());
+  ExpectSameClassification(matcher, user_agent.c_str());
+  EXPECT_EQ(0, stats.GetVariable(
+      "user_agent_classification_cache_misses")->Get());
+  EXPECT_EQ(0, stats.GetVariable(
+      "user_agent_classification_cache_hits")->Get());
+}
+
 }  // namespace net_instaweb
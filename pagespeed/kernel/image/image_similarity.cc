@@ -0,0 +1,244 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/image/image_similarity.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/image/read_image.h"
+#include "pagespeed/kernel/image/scanline_utils.h"
+
+namespace pagespeed {
+
+namespace {
+
+// Stabilizing constants from Wang et al., "Image Quality Assessment: From
+// Error Visibility to Structural Similarity", for 8-bit samples:
+// (0.01 * 255)^2 and (0.03 * 255)^2.
+const double kSsimC1 = 6.5025;
+const double kSsimC2 = 58.5225;
+
+// First and second order sums of the samples of two planes over a window.
+struct WindowSums {
+  WindowSums() : sum1(0), sum2(0), sum11(0), sum22(0), sum12(0) {}
+
+  int32_t sum1;
+  int32_t sum2;
+  int32_t sum11;
+  int32_t sum22;
+  int32_t sum12;
+};
+
+// Accumulates the sums over an arbitrary width x height window.
+void WindowSumsPortable(const uint8_t* plane1, const uint8_t* plane2,
+                        int stride, int width, int height, WindowSums* sums) {
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* row1 = plane1 + y * stride;
+    const uint8_t* row2 = plane2 + y * stride;
+    for (int x = 0; x < width; ++x) {
+      const int32_t p1 = row1[x];
+      const int32_t p2 = row2[x];
+      sums->sum1 += p1;
+      sums->sum2 += p2;
+      sums->sum11 += p1 * p1;
+      sums->sum22 += p2 * p2;
+      sums->sum12 += p1 * p2;
+    }
+  }
+}
+
+#if defined(__SSE2__)
+
+inline int32_t HorizontalSum(__m128i v) {
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+// Accumulates the sums over a kSsimWindowSize x kSsimWindowSize window,
+// processing one row of 8 samples from each plane per iteration. The largest
+// sum, 64 * 255^2, comfortably fits in 32 bits.
+void WindowSums8x8(const uint8_t* plane1, const uint8_t* plane2, int stride,
+                   WindowSums* sums) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum1 = zero;
+  __m128i sum2 = zero;
+  __m128i sum11 = zero;
+  __m128i sum22 = zero;
+  __m128i sum12 = zero;
+  for (int y = 0; y < image_compression::kSsimWindowSize; ++y) {
+    const __m128i row1 = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(plane1 + y * stride));
+    const __m128i row2 = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(plane2 + y * stride));
+    sum1 = _mm_add_epi64(sum1, _mm_sad_epu8(row1, zero));
+    sum2 = _mm_add_epi64(sum2, _mm_sad_epu8(row2, zero));
+    const __m128i wide1 = _mm_unpacklo_epi8(row1, zero);
+    const __m128i wide2 = _mm_unpacklo_epi8(row2, zero);
+    sum11 = _mm_add_epi32(sum11, _mm_madd_epi16(wide1, wide1));
+    sum22 = _mm_add_epi32(sum22, _mm_madd_epi16(wide2, wide2));
+    sum12 = _mm_add_epi32(sum12, _mm_madd_epi16(wide1, wide2));
+  }
+  // The byte sums live in the low 32 bits of each 64-bit lane, and the upper
+  // lane of _mm_loadl_epi64 is zero, so the first lane holds the total.
+  sums->sum1 += _mm_cvtsi128_si32(sum1);
+  sums->sum2 += _mm_cvtsi128_si32(sum2);
+  sums->sum11 += HorizontalSum(sum11);
+  sums->sum22 += HorizontalSum(sum22);
+  sums->sum12 += HorizontalSum(sum12);
+}
+
+#else
+
+void WindowSums8x8(const uint8_t* plane1, const uint8_t* plane2, int stride,
+                   WindowSums* sums) {
+  WindowSumsPortable(plane1, plane2, stride,
+                     image_compression::kSsimWindowSize,
+                     image_compression::kSsimWindowSize, sums);
+}
+
+#endif  // defined(__SSE2__)
+
+double SsimFromSums(const WindowSums& sums, int num_samples) {
+  const double inv_n = 1.0 / num_samples;
+  const double mean1 = sums.sum1 * inv_n;
+  const double mean2 = sums.sum2 * inv_n;
+  const double var1 = sums.sum11 * inv_n - mean1 * mean1;
+  const double var2 = sums.sum22 * inv_n - mean2 * mean2;
+  const double covar = sums.sum12 * inv_n - mean1 * mean2;
+  return ((2.0 * mean1 * mean2 + kSsimC1) * (2.0 * covar + kSsimC2)) /
+      ((mean1 * mean1 + mean2 * mean2 + kSsimC1) * (var1 + var2 + kSsimC2));
+}
+
+}  // namespace
+
+namespace image_compression {
+
+bool ComputeLumaPlane(const uint8_t* image, int width, int height,
+                      int bytes_per_line, PixelFormat pixel_format,
+                      int max_dimension, MessageHandler* handler,
+                      LumaPlane* luma) {
+  if (width <= 0 || height <= 0 ||
+      (pixel_format != GRAY_8 && pixel_format != RGB_888 &&
+       pixel_format != RGBA_8888)) {
+    return false;
+  }
+
+  // Integer downsampling factor, chosen so that the larger dimension fits
+  // into max_dimension.
+  int factor = 1;
+  if (max_dimension > 0) {
+    const int larger = std::max(width, height);
+    factor = (larger + max_dimension - 1) / max_dimension;
+  }
+  luma->width = std::max(1, width / factor);
+  luma->height = std::max(1, height / factor);
+  luma->pixels.assign(luma->width * luma->height, 0);
+
+  const int num_channels =
+      GetNumChannelsFromPixelFormat(pixel_format, handler);
+  const int block_width = std::min(factor, width);
+  const int block_height = std::min(factor, height);
+  const int num_samples = block_width * block_height;
+  for (int out_y = 0; out_y < luma->height; ++out_y) {
+    for (int out_x = 0; out_x < luma->width; ++out_x) {
+      int32_t sum = 0;
+      for (int dy = 0; dy < block_height; ++dy) {
+        const uint8_t* in_pixel = image +
+            (out_y * factor + dy) * bytes_per_line +
+            out_x * factor * num_channels;
+        for (int dx = 0; dx < block_width; ++dx, in_pixel += num_channels) {
+          if (pixel_format == GRAY_8) {
+            sum += in_pixel[0];
+          } else {
+            // ITU-R BT.601 luma in 8-bit fixed point.
+            sum += (77 * static_cast<int32_t>(in_pixel[0]) +
+                    150 * static_cast<int32_t>(in_pixel[1]) +
+                    29 * static_cast<int32_t>(in_pixel[2]) + 128) >> 8;
+          }
+        }
+      }
+      luma->pixels[out_y * luma->width + out_x] =
+          static_cast<uint8_t>((sum + num_samples / 2) / num_samples);
+    }
+  }
+  return true;
+}
+
+bool DecodeLumaPlane(ImageFormat image_format, const void* image_buffer,
+                     size_t buffer_length, int max_dimension,
+                     MessageHandler* handler, LumaPlane* luma) {
+  void* pixels = NULL;
+  PixelFormat pixel_format = UNSUPPORTED;
+  size_t width = 0;
+  size_t height = 0;
+  size_t stride = 0;
+  if (!ReadImage(image_format, image_buffer, buffer_length, &pixels,
+                 &pixel_format, &width, &height, &stride, handler)) {
+    return false;
+  }
+  bool ok = ComputeLumaPlane(static_cast<const uint8_t*>(pixels),
+                             static_cast<int>(width),
+                             static_cast<int>(height),
+                             static_cast<int>(stride), pixel_format,
+                             max_dimension, handler, luma);
+  free(pixels);
+  return ok;
+}
+
+double ComputeSsim(const LumaPlane& plane1, const LumaPlane& plane2) {
+  if (plane1.width != plane2.width || plane1.height != plane2.height ||
+      plane1.pixels.empty() || plane2.pixels.empty()) {
+    return -1.0;
+  }
+
+  const int width = plane1.width;
+  const int height = plane1.height;
+  const uint8_t* data1 = &plane1.pixels[0];
+  const uint8_t* data2 = &plane2.pixels[0];
+
+  // Planes too small for a single window are compared as a whole.
+  if (width < kSsimWindowSize || height < kSsimWindowSize) {
+    WindowSums sums;
+    WindowSumsPortable(data1, data2, width, width, height, &sums);
+    return SsimFromSums(sums, width * height);
+  }
+
+  // Trailing rows and columns which do not fill a whole window are ignored.
+  double total = 0.0;
+  int num_windows = 0;
+  for (int y = 0; y + kSsimWindowSize <= height; y += kSsimWindowSize) {
+    for (int x = 0; x + kSsimWindowSize <= width; x += kSsimWindowSize) {
+      const int offset = y * width + x;
+      WindowSums sums;
+      WindowSums8x8(data1 + offset, data2 + offset, width, &sums);
+      total += SsimFromSums(sums, kSsimWindowSize * kSsimWindowSize);
+      ++num_windows;
+    }
+  }
+  return total / num_windows;
+}
+
+}  // namespace image_compression
+
+}  // namespace pagespeed
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_IMAGE_IMAGE_SIMILARITY_H_
+#define PAGESPEED_KERNEL_IMAGE_IMAGE_SIMILARITY_H_
+
+#include <cstddef>
+#include <vector>
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/image/image_util.h"
+
+namespace net_instaweb {
+class MessageHandler;
+}
+
+namespace pagespeed {
+
+namespace image_compression {
+
+using net_instaweb::MessageHandler;
+
+// Side length, in pixels, of the square windows over which the structural
+// similarity is computed.
+const int kSsimWindowSize = 8;
+
+// A luminance plane, usually downsampled from a decoded image, which is the
+// input to the structural similarity computation below.
+struct LumaPlane {
+  LumaPlane() : width(0), height(0) {}
+
+  int width;
+  int height;
+  std::vector<uint8_t> pixels;  // width * height bytes, row-major.
+};
+
+// Computes the luminance of the image and box-filters it down by an integer
+// factor so that neither dimension exceeds max_dimension (a non-positive
+// max_dimension disables downsampling). Supports GRAY_8, RGB_888, and
+// RGBA_8888; alpha is ignored. Two images with the same dimensions always
+// produce planes with the same dimensions.
+bool ComputeLumaPlane(const uint8_t* image, int width, int height,
+                      int bytes_per_line, PixelFormat pixel_format,
+                      int max_dimension, MessageHandler* handler,
+                      LumaPlane* luma);
+
+// Decodes the image and computes its downsampled luminance plane as above.
+bool DecodeLumaPlane(ImageFormat image_format, const void* image_buffer,
+                     size_t buffer_length, int max_dimension,
+                     MessageHandler* handler, LumaPlane* luma);
+
+// Returns the mean structural similarity (SSIM) index of the two planes,
+// computed over non-overlapping kSsimWindowSize x kSsimWindowSize windows.
+// The result is 1.0 for identical planes and decreases as they diverge.
+// Returns a negative value if the planes are empty or differ in size.
+//
+// The per-window sums use SSE2 when the compiler targets it, and portable
+// code otherwise; both give identical results.
+double ComputeSsim(const LumaPlane& plane1, const LumaPlane& plane2);
+
+}  // namespace image_compression
+
+}  // namespace pagespeed
+
+#endif  // PAGESPEED_KERNEL_IMAGE_IMAGE_SIMILARITY_H_
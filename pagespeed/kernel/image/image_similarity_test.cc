@@ -0,0 +1,161 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/image/image_similarity.h"
+
+#include <cstddef>
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/mock_message_handler.h"
+#include "pagespeed/kernel/base/null_mutex.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/image/jpeg_optimizer.h"
+#include "pagespeed/kernel/image/test_utils.h"
+
+namespace {
+
+using net_instaweb::MockMessageHandler;
+using net_instaweb::NullMutex;
+using pagespeed::image_compression::ComputeLumaPlane;
+using pagespeed::image_compression::ComputeSsim;
+using pagespeed::image_compression::DecodeLumaPlane;
+using pagespeed::image_compression::GRAY_8;
+using pagespeed::image_compression::IMAGE_JPEG;
+using pagespeed::image_compression::IMAGE_PNG;
+using pagespeed::image_compression::JpegCompressionOptions;
+using pagespeed::image_compression::kJpegTestDir;
+using pagespeed::image_compression::kPngSuiteTestDir;
+using pagespeed::image_compression::LumaPlane;
+using pagespeed::image_compression::OptimizeJpegWithOptions;
+using pagespeed::image_compression::ReadTestFile;
+using pagespeed::image_compression::RGB_888;
+
+const int kMaxDimension = 256;
+
+class ImageSimilarityTest : public testing::Test {
+ public:
+  ImageSimilarityTest() : message_handler_(new NullMutex) {}
+
+ protected:
+  // Recompresses the JPEG test image 'name' at 'quality' and returns the
+  // SSIM of the result against the original.
+  double SsimAtQuality(const char* name, int quality) {
+    GoogleString original;
+    EXPECT_TRUE(ReadTestFile(kJpegTestDir, name, "jpg", &original));
+    JpegCompressionOptions options;
+    options.lossy = true;
+    options.lossy_options.quality = quality;
+    GoogleString recompressed;
+    EXPECT_TRUE(OptimizeJpegWithOptions(original, &recompressed, options,
+                                        &message_handler_));
+
+    LumaPlane reference, candidate;
+    EXPECT_TRUE(DecodeLumaPlane(IMAGE_JPEG, original.data(), original.size(),
+                                kMaxDimension, &message_handler_,
+                                &reference));
+    EXPECT_TRUE(DecodeLumaPlane(IMAGE_JPEG, recompressed.data(),
+                                recompressed.size(), kMaxDimension,
+                                &message_handler_, &candidate));
+    return ComputeSsim(reference, candidate);
+  }
+
+  MockMessageHandler message_handler_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ImageSimilarityTest);
+};
+
+TEST_F(ImageSimilarityTest, IdenticalImages) {
+  GoogleString contents;
+  ASSERT_TRUE(ReadTestFile(kJpegTestDir, "sjpeg3", "jpg", &contents));
+  LumaPlane plane1, plane2;
+  ASSERT_TRUE(DecodeLumaPlane(IMAGE_JPEG, contents.data(), contents.size(),
+                              kMaxDimension, &message_handler_, &plane1));
+  ASSERT_TRUE(DecodeLumaPlane(IMAGE_JPEG, contents.data(), contents.size(),
+                              kMaxDimension, &message_handler_, &plane2));
+  // sjpeg3 is 512x384, so it is downsampled by 2.
+  EXPECT_EQ(256, plane1.width);
+  EXPECT_EQ(192, plane1.height);
+  EXPECT_DOUBLE_EQ(1.0, ComputeSsim(plane1, plane2));
+}
+
+TEST_F(ImageSimilarityTest, LowerQualityIsLessSimilar) {
+  const double ssim_high = SsimAtQuality("sjpeg3", 90);
+  const double ssim_medium = SsimAtQuality("sjpeg3", 60);
+  const double ssim_low = SsimAtQuality("sjpeg3", 20);
+  EXPECT_GT(1.0, ssim_high);
+  EXPECT_GT(ssim_high, ssim_medium);
+  EXPECT_GT(ssim_medium, ssim_low);
+  EXPECT_LT(0.0, ssim_low);
+}
+
+TEST_F(ImageSimilarityTest, GrayAndColorLumaAgree) {
+  // A uniform gray image has the same luma whichever format it is in.
+  const int kWidth = 20;
+  const int kHeight = 10;
+  const uint8_t kValue = 123;
+  GoogleString gray(kWidth * kHeight, static_cast<char>(kValue));
+  GoogleString rgb(3 * kWidth * kHeight, static_cast<char>(kValue));
+
+  LumaPlane gray_plane, rgb_plane;
+  ASSERT_TRUE(ComputeLumaPlane(
+      reinterpret_cast<const uint8_t*>(gray.data()), kWidth, kHeight, kWidth,
+      GRAY_8, 0 /* no downsampling */, &message_handler_, &gray_plane));
+  ASSERT_TRUE(ComputeLumaPlane(
+      reinterpret_cast<const uint8_t*>(rgb.data()), kWidth, kHeight,
+      3 * kWidth, RGB_888, 0 /* no downsampling */, &message_handler_,
+      &rgb_plane));
+  EXPECT_EQ(kWidth, gray_plane.width);
+  EXPECT_EQ(kHeight, gray_plane.height);
+  EXPECT_EQ(kValue, gray_plane.pixels[0]);
+  EXPECT_EQ(kValue, rgb_plane.pixels[kWidth * kHeight - 1]);
+  EXPECT_DOUBLE_EQ(1.0, ComputeSsim(gray_plane, rgb_plane));
+}
+
+TEST_F(ImageSimilarityTest, TinyPlanes) {
+  // Planes smaller than a window are compared as a single window.
+  LumaPlane plane1, plane2;
+  plane1.width = plane2.width = 3;
+  plane1.height = plane2.height = 2;
+  plane1.pixels.assign(6, 10);
+  plane2.pixels.assign(6, 10);
+  EXPECT_DOUBLE_EQ(1.0, ComputeSsim(plane1, plane2));
+  plane2.pixels[0] = 250;
+  EXPECT_GT(1.0, ComputeSsim(plane1, plane2));
+}
+
+TEST_F(ImageSimilarityTest, MismatchedPlanes) {
+  GoogleString jpeg, png;
+  ASSERT_TRUE(ReadTestFile(kJpegTestDir, "sjpeg1", "jpg", &jpeg));
+  ASSERT_TRUE(ReadTestFile(kPngSuiteTestDir, "basi0g04", "png", &png));
+  LumaPlane plane1, plane2;
+  ASSERT_TRUE(DecodeLumaPlane(IMAGE_JPEG, jpeg.data(), jpeg.size(),
+                              kMaxDimension, &message_handler_, &plane1));
+  ASSERT_TRUE(DecodeLumaPlane(IMAGE_PNG, png.data(), png.size(),
+                              kMaxDimension, &message_handler_, &plane2));
+  EXPECT_GT(0.0, ComputeSsim(plane1, plane2));
+  EXPECT_GT(0.0, ComputeSsim(plane1, LumaPlane()));
+}
+
+TEST_F(ImageSimilarityTest, UndecodableImage) {
+  GoogleString contents;
+  ASSERT_TRUE(ReadTestFile(kJpegTestDir, "notajpeg", "png", &contents));
+  LumaPlane plane;
+  EXPECT_FALSE(DecodeLumaPlane(IMAGE_JPEG, contents.data(), contents.size(),
+                               kMaxDimension, &message_handler_, &plane));
+}
+
+}  // namespace
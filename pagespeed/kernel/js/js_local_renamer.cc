@@ -0,0 +1,499 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/kernel/js/js_local_renamer.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/js/js_tokenizer.h"
+
+namespace pagespeed {
+
+namespace js {
+
+namespace {
+
+// New names are drawn from these characters; digits can't start a name.
+const char kNameChars[] =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ$_0123456789";
+const int kNumFirstNameChars = 54;
+const int kNumNameChars = 64;
+
+// Returns the nth of all possible identifiers, shortest first.
+GoogleString NthName(int n) {
+  GoogleString name(1, kNameChars[n % kNumFirstNameChars]);
+  n /= kNumFirstNameChars;
+  while (n > 0) {
+    --n;
+    name.push_back(kNameChars[n % kNumNameChars]);
+    n /= kNumNameChars;
+  }
+  return name;
+}
+
+struct Token {
+  Token(JsKeywords::Type type_in, StringPiece text_in)
+      : type(type_in), text(text_in) {}
+
+  bool IsOperator(const char* op) const {
+    return type == JsKeywords::kOperator && text == op;
+  }
+
+  JsKeywords::Type type;
+  StringPiece text;
+};
+
+// A function, or (for scope 0 only) the global scope.
+struct Scope {
+  explicit Scope(int parent_in)
+      : parent(parent_in), renamable(parent_in >= 0), first_name(0) {}
+
+  int parent;
+  bool renamable;  // False for the global scope and unsafe functions.
+  // Each name declared in the function, with the number of times it occurs.
+  std::map<StringPiece, int> locals;
+  // The new name of each local, if renamable.
+  std::map<StringPiece, StringPiece> new_names;
+  // Index of this function's first name in the pool of new names; the names
+  // after its own locals are free for its nested functions.
+  int first_name;
+};
+
+// An open (, [ or {, or the top level.
+struct Delimiter {
+  Delimiter(char open_in, bool object_literal_in, bool parameters_in,
+            int scope_in, int var_depth_in, bool expecting_declarator_in)
+      : open(open_in), object_literal(object_literal_in),
+        parameters(parameters_in), scope(scope_in), ternaries(0),
+        in_case(false), saved_var_depth(var_depth_in),
+        saved_expecting_declarator(expecting_declarator_in) {}
+
+  char open;
+  bool object_literal;
+  bool parameters;  // The parameter list of the function scope.
+  int scope;        // The function we are in, inside the delimiters.
+  int ternaries;    // Number of ?s awaiting their :s.
+  bool in_case;     // Between a case keyword and its :.
+  // The var statement state outside the delimiters.
+  int saved_var_depth;
+  bool saved_expecting_declarator;
+};
+
+// Walks the tokens of a script, working out which function each occurrence of
+// an identifier belongs to and which names each function declares.
+class ScopeBuilder {
+ public:
+  ScopeBuilder(const std::vector<Token>& tokens,
+               std::vector<Scope>* scopes,
+               std::vector<std::pair<StringPiece, int> >* occurrences)
+      : tokens_(tokens), scopes_(scopes),
+        occurrences_(occurrences), pending_function_(-1), pending_body_(-1),
+        var_depth_(-1), expecting_declarator_(false),
+        last_colon_ends_statement_(false), accessor_key_pending_(false) {
+    scopes_->push_back(Scope(-1));
+    delimiters_.push_back(Delimiter('\0', false, false, 0, -1, false));
+  }
+
+  void Build() {
+    for (index_ = 0; index_ < static_cast<int>(tokens_.size()); ++index_) {
+      const Token& token = tokens_[index_];
+      const int depth = delimiters_.size();
+      switch (token.type) {
+        case JsKeywords::kFunction:
+          pending_function_ = NewScope();
+          break;
+        case JsKeywords::kVar:
+          var_depth_ = depth;
+          expecting_declarator_ = true;
+          break;
+        case JsKeywords::kIn:
+          // for (var x in y)
+          if (depth == var_depth_) {
+            var_depth_ = -1;
+          }
+          break;
+        case JsKeywords::kSemiInsert:
+          if (depth == var_depth_) {
+            var_depth_ = -1;
+          }
+          break;
+        case JsKeywords::kCase:
+          delimiters_.back().in_case = true;
+          break;
+        case JsKeywords::kConst:
+        case JsKeywords::kWith:
+          MarkUnsafe(CurrentScope());
+          break;
+        case JsKeywords::kIdentifier:
+          HandleIdentifier(token);
+          break;
+        case JsKeywords::kOperator:
+          HandleOperator(token);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+ private:
+  int NewScope() {
+    scopes_->push_back(Scope(CurrentScope()));
+    return scopes_->size() - 1;
+  }
+
+  int CurrentScope() const { return delimiters_.back().scope; }
+
+  void MarkUnsafe(int scope) {
+    (*scopes_)[scope].renamable = false;
+  }
+
+  const Token* TokenAt(int index) const {
+    return (index >= 0 && index < static_cast<int>(tokens_.size())) ?
+        &tokens_[index] : NULL;
+  }
+
+  bool TokenIsOperator(int index, const char* op) const {
+    const Token* token = TokenAt(index);
+    return token != NULL && token->IsOperator(op);
+  }
+
+  bool TokenIsOneOf(int index, JsKeywords::Type type1,
+                    JsKeywords::Type type2, JsKeywords::Type type3) const {
+    const Token* token = TokenAt(index);
+    return (token != NULL && (token->type == type1 || token->type == type2 ||
+                              token->type == type3));
+  }
+
+  // Records an occurrence of a name in the given scope, and declares it there
+  // if declare is true.
+  void AddOccurrence(StringPiece name, int scope, bool declare) {
+    if (declare) {
+      (*scopes_)[scope].locals.insert(std::make_pair(name, 0));
+    }
+    occurrences_->push_back(std::make_pair(name, scope));
+  }
+
+  // Does an open brace after the previous token start an object literal,
+  // rather than a block?  This mirrors JsTokenizer::CanPreceedObjectLiteral.
+  bool BraceStartsObjectLiteral() const {
+    const Token* prev = TokenAt(index_ - 1);
+    if (prev == NULL) {
+      return false;
+    }
+    switch (prev->type) {
+      case JsKeywords::kCase:
+      case JsKeywords::kDelete:
+      case JsKeywords::kIn:
+      case JsKeywords::kInstanceof:
+      case JsKeywords::kNew:
+      case JsKeywords::kReturn:
+      case JsKeywords::kThrow:
+      case JsKeywords::kTypeof:
+      case JsKeywords::kVoid:
+        return true;
+      case JsKeywords::kOperator:
+        if (prev->text == ":") {
+          return !last_colon_ends_statement_;
+        }
+        // A brace after the start or end of a block or statement starts a
+        // nested block, as the tokenizer's kOpenBrace state does.
+        return !(prev->text == ")" || prev->text == "]" || prev->text == "{" ||
+                 prev->text == "}" || prev->text == ";" ||
+                 prev->text == "++" || prev->text == "--");
+      default:
+        return false;
+    }
+  }
+
+  void HandleOperator(const Token& token) {
+    Delimiter* top = &delimiters_.back();
+    const int depth = delimiters_.size();
+    if (top->parameters && !token.IsOperator(",") && !token.IsOperator(")")) {
+      // Default values, destructuring, rest parameters...
+      MarkUnsafe(top->scope);
+    }
+    const char op = token.text[0];
+    if (token.text.size() != 1) {
+      // Nothing to do for multi-character operators.
+    } else if (op == '(' || op == '[' || op == '{') {
+      bool object_literal = false;
+      bool parameters = false;
+      int scope = CurrentScope();
+      if (op == '(' && pending_function_ >= 0) {
+        parameters = true;
+        scope = pending_function_;
+      } else if (op == '{' && pending_body_ >= 0) {
+        scope = pending_body_;
+      } else if (op == '{') {
+        object_literal = BraceStartsObjectLiteral();
+      }
+      pending_function_ = -1;
+      pending_body_ = -1;
+      delimiters_.push_back(Delimiter(op, object_literal, parameters, scope,
+                                      var_depth_, expecting_declarator_));
+    } else if (op == ')' || op == ']' || op == '}') {
+      if (depth > 1) {
+        var_depth_ = top->saved_var_depth;
+        expecting_declarator_ = top->saved_expecting_declarator;
+        if (top->parameters) {
+          pending_body_ = top->scope;
+        }
+        delimiters_.pop_back();
+      }
+    } else if (op == ',') {
+      if (depth == var_depth_) {
+        expecting_declarator_ = true;
+      }
+    } else if (op == ';') {
+      if (depth == var_depth_) {
+        var_depth_ = -1;
+      }
+    } else if (op == '?') {
+      ++top->ternaries;
+    } else if (op == ':') {
+      if (top->ternaries > 0) {
+        --top->ternaries;
+        last_colon_ends_statement_ = false;
+      } else if (top->in_case) {
+        top->in_case = false;
+        last_colon_ends_statement_ = true;
+      } else {
+        // Either an object literal key, or a label.
+        last_colon_ends_statement_ = !top->object_literal;
+      }
+    } else if (op == '=') {
+      const Token* next = TokenAt(index_ + 1);
+      if (next != NULL && next->IsOperator(">") &&
+          next->text.data() == token.text.data() + 1) {
+        // An arrow function.
+        MarkUnsafe(CurrentScope());
+      }
+    }
+  }
+
+  void HandleIdentifier(const Token& token) {
+    Delimiter* top = &delimiters_.back();
+    const Token* prev = TokenAt(index_ - 1);
+    if (token.text == "eval" || token.text == "let") {
+      MarkUnsafe(CurrentScope());
+    }
+    // Property names and labels are never renamed.
+    if (prev != NULL && (prev->IsOperator(".") ||
+                         prev->type == JsKeywords::kBreak ||
+                         prev->type == JsKeywords::kContinue)) {
+      return;
+    }
+    if (top->parameters) {
+      AddOccurrence(token.text, top->scope, true /* declare */);
+      return;
+    }
+    if (top->object_literal) {
+      if (accessor_key_pending_) {
+        // The key of a getter or setter.
+        accessor_key_pending_ = false;
+        pending_function_ = NewScope();
+        return;
+      }
+      if (TokenIsOperator(index_ - 1, "{") ||
+          TokenIsOperator(index_ - 1, ",")) {
+        if (TokenIsOperator(index_ + 1, ",") ||
+            TokenIsOperator(index_ + 1, "}")) {
+          // A shorthand property, {x} meaning {x: x}.
+          MarkUnsafe(CurrentScope());
+        } else if (TokenIsOperator(index_ + 1, "(")) {
+          // A method, {x() {...}}.
+          pending_function_ = NewScope();
+        } else if ((token.text == "get" || token.text == "set") &&
+                   TokenIsOneOf(index_ + 1, JsKeywords::kIdentifier,
+                                JsKeywords::kStringLiteral,
+                                JsKeywords::kNumber)) {
+          if (TokenAt(index_ + 1)->type == JsKeywords::kIdentifier) {
+            accessor_key_pending_ = true;
+          } else {
+            pending_function_ = NewScope();
+          }
+        }
+        return;
+      }
+    } else if (TokenIsOperator(index_ + 1, ":") && top->ternaries == 0 &&
+               !top->in_case) {
+      // A label.
+      return;
+    }
+    const bool declare = (expecting_declarator_ &&
+                          var_depth_ == static_cast<int>(delimiters_.size()));
+    if (declare) {
+      expecting_declarator_ = false;
+    }
+    AddOccurrence(token.text, CurrentScope(), declare);
+  }
+
+  const std::vector<Token>& tokens_;
+  std::vector<Scope>* scopes_;
+  std::vector<std::pair<StringPiece, int> >* occurrences_;
+  std::vector<Delimiter> delimiters_;
+  int index_;  // Index of the current token.
+  int pending_function_;  // Function whose parameter list comes next.
+  int pending_body_;      // Function whose body comes next.
+  // Delimiter depth of the current var statement, or -1 if none.
+  int var_depth_;
+  bool expecting_declarator_;  // The next identifier is declared by var.
+  bool last_colon_ends_statement_;  // The last : was a label or case.
+  bool accessor_key_pending_;  // The next identifier is a get/set key.
+
+  DISALLOW_COPY_AND_ASSIGN(ScopeBuilder);
+};
+
+// Orders locals so that the most used get the shortest names.
+bool MoreOccurrences(const std::pair<StringPiece, int>& a,
+                     const std::pair<StringPiece, int>& b) {
+  return a.second > b.second || (a.second == b.second && a.first < b.first);
+}
+
+}  // namespace
+
+JsLocalRenamer::JsLocalRenamer(const JsTokenizerPatterns* patterns,
+                               StringPiece input)
+    : input_(input), next_rename_(0), num_renamed_variables_(0) {
+  std::vector<Token> tokens;
+  std::set<StringPiece> identifiers;
+  JsTokenizer tokenizer(patterns, input);
+  while (true) {
+    StringPiece text;
+    const JsKeywords::Type type = tokenizer.NextToken(&text);
+    if (type == JsKeywords::kEndOfInput) {
+      break;
+    } else if (type == JsKeywords::kError) {
+      return;
+    } else if (type == JsKeywords::kIdentifier) {
+      if (text.find('\\') != StringPiece::npos) {
+        // We'd have to decode unicode escapes to tell which names are fresh.
+        return;
+      }
+      identifiers.insert(text);
+    }
+    if (type != JsKeywords::kComment && type != JsKeywords::kWhitespace &&
+        type != JsKeywords::kLineSeparator) {
+      tokens.push_back(Token(type, text));
+    }
+  }
+
+  std::vector<Scope> scopes;
+  std::vector<std::pair<StringPiece, int> > occurrences;
+  ScopeBuilder builder(tokens, &scopes, &occurrences);
+  builder.Build();
+
+  // A function isn't safe to rename if any function within it isn't.  Nested
+  // functions always come after their parents.
+  for (int i = scopes.size() - 1; i > 0; --i) {
+    if (!scopes[i].renamable) {
+      scopes[scopes[i].parent].renamable = false;
+    }
+  }
+
+  // Resolve each occurrence to the innermost function declaring its name, if
+  // that's renamable, and count the occurrences of each local.
+  std::vector<int> declaring_scopes(occurrences.size(), 0);
+  for (int i = 0, n = occurrences.size(); i < n; ++i) {
+    const StringPiece name = occurrences[i].first;
+    int scope = occurrences[i].second;
+    while (scope > 0 && scopes[scope].locals.count(name) == 0) {
+      scope = scopes[scope].parent;
+    }
+    if (scope > 0 && scopes[scope].renamable) {
+      declaring_scopes[i] = scope;
+      ++scopes[scope].locals[name];
+    }
+  }
+
+  // Lay out the names each function needs in the pool of new names, after
+  // those of its ancestors, and fill the pool with fresh names.
+  int pool_size = 0;
+  for (int i = 1, n = scopes.size(); i < n; ++i) {
+    const Scope& parent = scopes[scopes[i].parent];
+    scopes[i].first_name = parent.first_name +
+        (parent.renamable ? parent.locals.size() : 0);
+    if (scopes[i].renamable) {
+      pool_size = std::max(pool_size, static_cast<int>(
+          scopes[i].first_name + scopes[i].locals.size()));
+    }
+  }
+  for (int n = 0; static_cast<int>(names_.size()) < pool_size; ++n) {
+    GoogleString name = NthName(n);
+    JsKeywords::Flag flag_ignored;
+    if (JsKeywords::Lookup(name, &flag_ignored) == JsKeywords::kNotAKeyword &&
+        identifiers.count(name) == 0) {
+      names_.push_back(name);
+    }
+  }
+
+  // Give the most used locals of each function the shortest names, skipping
+  // any that wouldn't get shorter.
+  for (int i = 1, n = scopes.size(); i < n; ++i) {
+    Scope* scope = &scopes[i];
+    if (!scope->renamable) {
+      continue;
+    }
+    std::vector<std::pair<StringPiece, int> > locals(scope->locals.begin(),
+                                                     scope->locals.end());
+    std::sort(locals.begin(), locals.end(), MoreOccurrences);
+    for (int j = 0, num_locals = locals.size(); j < num_locals; ++j) {
+      const GoogleString& new_name = names_[scope->first_name + j];
+      if (new_name.size() < locals[j].first.size()) {
+        scope->new_names[locals[j].first] = new_name;
+        ++num_renamed_variables_;
+      }
+    }
+  }
+
+  for (int i = 0, n = occurrences.size(); i < n; ++i) {
+    if (declaring_scopes[i] > 0) {
+      const StringPiece name = occurrences[i].first;
+      const Scope& scope = scopes[declaring_scopes[i]];
+      std::map<StringPiece, StringPiece>::const_iterator iter =
+          scope.new_names.find(name);
+      if (iter != scope.new_names.end()) {
+        renames_.push_back(std::make_pair(
+            static_cast<int>(name.data() - input_.data()), iter->second));
+      }
+    }
+  }
+}
+
+JsLocalRenamer::~JsLocalRenamer() {}
+
+StringPiece JsLocalRenamer::Rename(StringPiece token) {
+  const int offset = token.data() - input_.data();
+  const int num_renames = renames_.size();
+  while (next_rename_ < num_renames && renames_[next_rename_].first < offset) {
+    ++next_rename_;
+  }
+  if (next_rename_ < num_renames && renames_[next_rename_].first == offset) {
+    return renames_[next_rename_].second;
+  }
+  return token;
+}
+
+}  // namespace js
+
+}  // namespace pagespeed
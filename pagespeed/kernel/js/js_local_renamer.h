@@ -0,0 +1,83 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAGESPEED_KERNEL_JS_JS_LOCAL_RENAMER_H_
+#define PAGESPEED_KERNEL_JS_JS_LOCAL_RENAMER_H_
+
+#include <utility>
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace pagespeed {
+
+namespace js {
+
+struct JsTokenizerPatterns;
+
+// Works out short new names for the parameters and var-declared locals of the
+// functions in a piece of JavaScript, for JsMinifyingTokenizer to substitute
+// as it minifies.
+//
+// This is deliberately not a real scope analysis.  It relies instead on the
+// fact that renaming *every* occurrence of a name within a function, other
+// than property names and labels, to a fresh name that appears nowhere else in
+// the input preserves meaning no matter which binding each occurrence
+// actually refers to.  So each occurrence of a name is renamed if the
+// innermost enclosing function that declares that name with var or as a
+// parameter is safe to rename.  Nested functions pick their names after those
+// of their ancestors, so they can never shadow a renamed ancestor local.
+//
+// A function is not safe to rename if it, or any function nested within it,
+// uses eval or with (which can refer to locals by their original names), or
+// uses syntax beyond ES5 that would make the above unsound: let and const,
+// arrow functions, non-identifier parameters, or shorthand object properties.
+// If the input fails to tokenize, or contains identifiers with unicode
+// escapes, nothing is renamed.
+//
+// Note that code which introspects on its own source, such as AngularJS
+// inferring dependencies from parameter names, is broken by renaming.
+class JsLocalRenamer {
+ public:
+  // Analyzes input (which must outlive the JsLocalRenamer object).
+  JsLocalRenamer(const JsTokenizerPatterns* patterns, StringPiece input);
+  ~JsLocalRenamer();
+
+  // Given an identifier token returned by a JsTokenizer over the same input,
+  // returns its new name, or the token itself if it's not being renamed.
+  // Tokens must be passed in the order they appear in the input.
+  StringPiece Rename(StringPiece token);
+
+  // The number of distinct local variables renamed.
+  int num_renamed_variables() const { return num_renamed_variables_; }
+
+ private:
+  const StringPiece input_;
+  // The pool of new names; renames_ point into this.
+  net_instaweb::StringVector names_;
+  // The offset in input_ and new name of each renamed token, in input order.
+  std::vector<std::pair<int, StringPiece> > renames_;
+  int next_rename_;  // Index of the next entry of renames_ to look at.
+  int num_renamed_variables_;
+
+  DISALLOW_COPY_AND_ASSIGN(JsLocalRenamer);
+};
+
+}  // namespace js
+
+}  // namespace pagespeed
+
+#endif  // PAGESPEED_KERNEL_JS_JS_LOCAL_RENAMER_H_
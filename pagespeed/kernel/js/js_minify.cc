@@ -19,6 +19,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/js/js_local_renamer.h"
 #include "pagespeed/kernel/js/js_tokenizer.h"
 
 using pagespeed::JsKeywords;
@@ -592,6 +593,26 @@ bool ShouldRecordStep(
   return true;
 }
 
+bool MinifyWithTokenizer(JsMinifyingTokenizer* tokenizer,
+                         GoogleString* output) {
+  while (true) {
+    StringPiece token;
+    switch (tokenizer->NextToken(&token)) {
+      case JsKeywords::kEndOfInput:
+        DCHECK(token.empty());
+        DCHECK(!tokenizer->has_error());
+        return true;
+      case JsKeywords::kError:
+        DCHECK(tokenizer->has_error());
+        token.AppendToString(output);
+        return false;
+      default:
+        token.AppendToString(output);
+        break;
+    }
+  }
+}
+
 }  // namespace
 
 JsMinifyingTokenizer::JsMinifyingTokenizer(
@@ -599,7 +620,7 @@ JsMinifyingTokenizer::JsMinifyingTokenizer(
     : tokenizer_(patterns, input), whitespace_(kNoWhitespace),
       prev_type_(JsKeywords::kEndOfInput), prev_token_(),
       next_type_(JsKeywords::kEndOfInput), next_token_(),
-      mappings_(NULL) {}
+      mappings_(NULL), renamer_(NULL) {}
 
 JsMinifyingTokenizer::JsMinifyingTokenizer(
     const JsTokenizerPatterns* patterns, StringPiece input,
@@ -608,7 +629,19 @@ JsMinifyingTokenizer::JsMinifyingTokenizer(
       prev_type_(JsKeywords::kEndOfInput), prev_token_(),
       next_type_(JsKeywords::kEndOfInput), next_token_(),
       mappings_(mappings),
-      current_position_(0, 0, 0, 0, 0), next_position_(0, 0, 0, 0, 0) {}
+      current_position_(0, 0, 0, 0, 0), next_position_(0, 0, 0, 0, 0),
+      renamer_(NULL) {}
+
+JsMinifyingTokenizer::JsMinifyingTokenizer(
+    const JsTokenizerPatterns* patterns, StringPiece input,
+    net_instaweb::source_map::MappingVector* mappings,
+    JsLocalRenamer* renamer)
+    : tokenizer_(patterns, input), whitespace_(kNoWhitespace),
+      prev_type_(JsKeywords::kEndOfInput), prev_token_(),
+      next_type_(JsKeywords::kEndOfInput), next_token_(),
+      mappings_(mappings),
+      current_position_(0, 0, 0, 0, 0), next_position_(0, 0, 0, 0, 0),
+      renamer_(renamer) {}
 
 JsMinifyingTokenizer::~JsMinifyingTokenizer() {}
 
@@ -652,6 +685,9 @@ JsKeywords::Type JsMinifyingTokenizer::NextTokenHelper(
     // Update source file line and col # with the consumed input token.
     UpdateLineAndCol(token, &current_position_.src_line,
                      &current_position_.src_col);
+    if (renamer_ != NULL && type == JsKeywords::kIdentifier) {
+      token = renamer_->Rename(token);
+    }
     if (type == JsKeywords::kWhitespace) {
       if (whitespace_ == kNoWhitespace) {
         whitespace_ = kSpace;
@@ -749,22 +785,16 @@ bool MinifyUtf8JsWithSourceMap(
     StringPiece input, GoogleString* output,
     net_instaweb::source_map::MappingVector* mappings) {
   JsMinifyingTokenizer tokenizer(patterns, input, mappings);
-  while (true) {
-    StringPiece token;
-    switch (tokenizer.NextToken(&token)) {
-      case JsKeywords::kEndOfInput:
-        DCHECK(token.empty());
-        DCHECK(!tokenizer.has_error());
-        return true;
-      case JsKeywords::kError:
-        DCHECK(tokenizer.has_error());
-        token.AppendToString(output);
-        return false;
-      default:
-        token.AppendToString(output);
-        break;
-    }
-  }
+  return MinifyWithTokenizer(&tokenizer, output);
+}
+
+bool MinifyUtf8JsRenamingLocals(
+    const JsTokenizerPatterns* patterns,
+    StringPiece input, GoogleString* output,
+    net_instaweb::source_map::MappingVector* mappings) {
+  JsLocalRenamer renamer(patterns, input);
+  JsMinifyingTokenizer tokenizer(patterns, input, mappings, &renamer);
+  return MinifyWithTokenizer(&tokenizer, output);
 }
 
 bool MinifyJs(const StringPiece& input, GoogleString* out) {
@@ -26,6 +26,8 @@ namespace pagespeed {
 
 namespace js {
 
+class JsLocalRenamer;
+
 // Represents the kind of whitespace between two tokens:
 //   kNoWhitespace means that there is no whitespace between the tokens.
 //   kSpace means there's been at least one space/tab, but no linebreaks.
@@ -52,6 +54,13 @@ class JsMinifyingTokenizer {
       const JsTokenizerPatterns* patterns, StringPiece input,
       net_instaweb::source_map::MappingVector* mappings);
 
+  // Version that also renames identifiers as directed by renamer, which must
+  // have been constructed over the same input.  mappings may be NULL.
+  JsMinifyingTokenizer(
+      const JsTokenizerPatterns* patterns, StringPiece input,
+      net_instaweb::source_map::MappingVector* mappings,
+      JsLocalRenamer* renamer);
+
   ~JsMinifyingTokenizer();
 
   // Gets the next token type from the input,
@@ -79,6 +88,7 @@ class JsMinifyingTokenizer {
   net_instaweb::source_map::MappingVector* mappings_;
   net_instaweb::source_map::Mapping current_position_;
   net_instaweb::source_map::Mapping next_position_;
+  JsLocalRenamer* renamer_;
 
   DISALLOW_COPY_AND_ASSIGN(JsMinifyingTokenizer);
 };
@@ -105,6 +115,14 @@ bool MinifyUtf8JsWithSourceMap(
     StringPiece input, GoogleString* output,
     net_instaweb::source_map::MappingVector* mappings);
 
+// Like MinifyUtf8JsWithSourceMap, but also renames the parameters and local
+// variables of functions where that's safe (see js_local_renamer.h for
+// details) to shorter names.  mappings may be NULL.
+bool MinifyUtf8JsRenamingLocals(
+    const JsTokenizerPatterns* patterns,
+    StringPiece input, GoogleString* output,
+    net_instaweb::source_map::MappingVector* mappings);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Below is the old JsMinify implementation.  It has several known issues that
 // the newer implementation above fixes, but for now is still more
@@ -699,4 +699,148 @@ TEST_F(JsMinifyTest, SourceMapsComplex) {
   EXPECT_EQ(expected_map, MappingsToString(mappings));
 }
 
+class JsRenamingMinifyTest : public JsMinifyTest {
+ protected:
+  void CheckRenaming(StringPiece before, StringPiece after) {
+    GoogleString output;
+    EXPECT_TRUE(pagespeed::js::MinifyUtf8JsRenamingLocals(
+        &patterns_, before, &output, NULL));
+    EXPECT_EQ(after, output);
+  }
+
+  // Checks that renaming leaves the input exactly as plain minification would.
+  void CheckNoRenaming(StringPiece input) {
+    GoogleString expected;
+    EXPECT_TRUE(pagespeed::js::MinifyUtf8Js(&patterns_, input, &expected));
+    CheckRenaming(input, expected);
+  }
+};
+
+TEST_F(JsRenamingMinifyTest, ParametersAndVars) {
+  CheckRenaming(
+      "function f(alpha, beta) { var gamma = alpha + beta; return gamma; }",
+      "function f(a,b){var c=a+b;return c;}");
+}
+
+TEST_F(JsRenamingMinifyTest, NestedFunctionsDoNotShadowAncestors) {
+  // The inner value must not be renamed to the same name as outer's count,
+  // which the inner function refers to.  Function names are left alone.
+  CheckRenaming(
+      "function outer(value) {\n"
+      "  var count = value;\n"
+      "  function inner(value) { return value + count; }\n"
+      "  return inner(count);\n"
+      "}",
+      "function outer(b){var a=b;function inner(c){return c+a;}"
+      "return inner(a);}");
+}
+
+TEST_F(JsRenamingMinifyTest, SiblingFunctionsReuseNames) {
+  CheckRenaming(
+      "function f(alpha) { return alpha } function g(alpha) { return alpha; }",
+      "function f(a){return a}function g(a){return a;}");
+}
+
+TEST_F(JsRenamingMinifyTest, GlobalsAreNotRenamed) {
+  CheckRenaming(
+      "var alpha = 1; function f(beta) { return alpha + beta + gamma; }",
+      "var alpha=1;function f(a){return alpha+a+gamma;}");
+}
+
+TEST_F(JsRenamingMinifyTest, PropertyNamesAreNotRenamed) {
+  CheckRenaming(
+      "function f(alpha) {\n"
+      "  var beta = {alpha: alpha, beta: 1};\n"
+      "  return beta.alpha + beta['beta'];\n"
+      "}",
+      "function f(b){var a={alpha:b,beta:1};return a.alpha+a['beta'];}");
+  CheckRenaming(
+      "function f(alpha) {\n"
+      "  var x = alpha ? {alpha: 1} : alpha;\n"
+      "  switch (alpha) { case alpha: return x; }\n"
+      "}",
+      "function f(a){var x=a?{alpha:1}:a;switch(a){case a:return x;}}");
+}
+
+TEST_F(JsRenamingMinifyTest, NestedBlocksAreNotObjectLiterals) {
+  // A brace after another brace opens a bare block, so the names in it are
+  // references, not property keys, and must be renamed with the parameter.
+  CheckRenaming(
+      "function f(longName) { { longName = 1; } return longName; }",
+      "function f(a){{a=1;}return a;}");
+  CheckRenaming(
+      "function f(longName) {\n"
+      "  if (longName) { { longName = 1; } }\n"
+      "  return longName;\n"
+      "}",
+      "function f(a){if(a){{a=1;}}return a;}");
+  CheckRenaming(
+      "function f(alpha) { ; { var beta = {alpha: alpha}; } return beta; }",
+      "function f(a){;{var b={alpha:a};}return b;}");
+}
+
+TEST_F(JsRenamingMinifyTest, LabelsAreNotRenamed) {
+  CheckRenaming(
+      "function f(limit) {\n"
+      "  loop: for (var index = 0; index < limit; ++index) {\n"
+      "    if (index) break loop;\n"
+      "  }\n"
+      "  return index;\n"
+      "}",
+      "function f(b){loop:for(var a=0;a<b;++a){if(a)break loop;}return a;}");
+}
+
+TEST_F(JsRenamingMinifyTest, EvalAndWithPreventRenaming) {
+  CheckNoRenaming("function f(alpha) { return eval('alpha'); }");
+  CheckNoRenaming("function f(beta) { with (beta) { return gamma; } }");
+  // eval in a nested function can see the enclosing function's locals too.
+  CheckNoRenaming(
+      "function outer(alpha) {\n"
+      "  return function(beta) { return eval(beta); };\n"
+      "}");
+}
+
+TEST_F(JsRenamingMinifyTest, NewerSyntaxPreventsRenaming) {
+  CheckNoRenaming("function f(alpha) { let beta = alpha; return beta; }");
+  CheckNoRenaming("function f(alpha) { const beta = alpha; return beta; }");
+  CheckNoRenaming("function f(alpha) { return {alpha}; }");
+}
+
+TEST_F(JsRenamingMinifyTest, SourceMap) {
+  const char js_before[] =
+      "function sum(alpha, beta) {\n"
+      "  var total = alpha + beta;\n"
+      "  return total;\n"
+      "}\n";
+  const char expected_js_after[] =
+      "function sum(a,b){var c=a+b;return c;}";
+  // Generated columns account for the shorter names.
+  const char expected_map[] =
+      "{"
+      "(0, 0, 0, 0, 0), "    // function sum(a
+      "(0, 14, 0, 0, 18), "  // ,
+      "(0, 15, 0, 0, 20), "  // b
+      "(0, 16, 0, 0, 24), "  // )
+      "(0, 17, 0, 0, 26), "  // {
+      "(0, 18, 0, 1, 2), "   // var c
+      "(0, 23, 0, 1, 12), "  // =
+      "(0, 24, 0, 1, 14), "  // a
+      "(0, 25, 0, 1, 20), "  // +
+      "(0, 26, 0, 1, 22), "  // b
+      "(0, 27, 0, 1, 26), "  // ;
+      "(0, 28, 0, 2, 2), "   // return c
+      "(0, 36, 0, 2, 14), "  // ;
+      "(0, 37, 0, 3, 0), "   // }
+      "}";
+
+  GoogleString output;
+  net_instaweb::source_map::MappingVector mappings;
+  EXPECT_TRUE(pagespeed::js::MinifyUtf8JsRenamingLocals(
+      &patterns_, js_before, &output, &mappings));
+
+  EXPECT_EQ(expected_js_after, output);
+
+  EXPECT_EQ(expected_map, MappingsToString(mappings));
+}
+
 }  // namespace
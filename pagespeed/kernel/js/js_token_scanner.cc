@@ -0,0 +1,229 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "pagespeed/kernel/js/js_token_scanner.h"
+
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace pagespeed {
+
+namespace js {
+
+namespace {
+
+// Character class bits for the ASCII range.
+enum {
+  kIdentStart = 1,  // $, _, A-Z, a-z
+  kIdentPart = 2,   // kIdentStart, plus 0-9
+  kDigit = 4,       // 0-9
+  kOctalDigit = 8,  // 0-7
+  kHexDigit = 16,   // 0-9, A-F, a-f
+
+  // Abbreviations for the table below.
+  L = kIdentStart | kIdentPart,              // Letter, $ or _.
+  X = kIdentStart | kIdentPart | kHexDigit,  // Hex letter.
+  O = kIdentPart | kDigit | kOctalDigit | kHexDigit,  // Octal digit.
+  N = kIdentPart | kDigit | kHexDigit,                // 8 or 9.
+};
+
+const unsigned char kCharClass[128] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x00
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x10
+  0, 0, 0, 0, L, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  // 0x20:  !"#$%&'()*+,-./
+  O, O, O, O, O, O, O, O, N, N, 0, 0, 0, 0, 0, 0,  // 0x30: 0123456789:;<=>?
+  0, X, X, X, X, X, X, L, L, L, L, L, L, L, L, L,  // 0x40: @ABCDEFGHIJKLMNO
+  L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, L,  // 0x50: PQRSTUVWXYZ[\]^_
+  0, X, X, X, X, X, X, L, L, L, L, L, L, L, L, L,  // 0x60: `abcdefghijklmno
+  L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, 0,  // 0x70: pqrstuvwxyz{|}~
+};
+
+inline bool HasClass(char ch, int bits) {
+  const unsigned char uch = ch;
+  return uch < 0x80 && (kCharClass[uch] & bits) != 0;
+}
+
+// Returns the number of characters with the given class at input[index...].
+inline int SpanClass(StringPiece input, int index, int bits) {
+  const int start = index;
+  const int size = input.size();
+  while (index < size && HasClass(input[index], bits)) {
+    ++index;
+  }
+  return index - start;
+}
+
+// True if input[index...] is a \uXXXX escape.
+inline bool IsUnicodeEscape(StringPiece input, int index) {
+  return (static_cast<int>(input.size()) >= index + 6 &&
+          input[index] == '\\' && input[index + 1] == 'u' &&
+          HasClass(input[index + 2], kHexDigit) &&
+          HasClass(input[index + 3], kHexDigit) &&
+          HasClass(input[index + 4], kHexDigit) &&
+          HasClass(input[index + 5], kHexDigit));
+}
+
+// Matches an optional exponent, [eE][+-]?[0-9]+, at input[index...], and
+// returns the index just past it.
+int ScanExponent(StringPiece input, int index) {
+  const int size = input.size();
+  if (index < size && (input[index] == 'e' || input[index] == 'E')) {
+    int exponent = index + 1;
+    if (exponent < size && (input[exponent] == '+' ||
+                            input[exponent] == '-')) {
+      ++exponent;
+    }
+    const int digits = SpanClass(input, exponent, kDigit);
+    if (digits > 0) {
+      return exponent + digits;
+    }
+  }
+  return index;
+}
+
+// Given that input[index] is the first character after the integer part of a
+// decimal literal, matches an optional fraction, (\.[0-9]*)?, and exponent,
+// and returns the index just past them.
+int ScanFractionAndExponent(StringPiece input, int index) {
+  if (index < static_cast<int>(input.size()) && input[index] == '.') {
+    ++index;
+    index += SpanClass(input, index, kDigit);
+  }
+  return ScanExponent(input, index);
+}
+
+}  // namespace
+
+int ScanJsIdentifier(StringPiece input) {
+  const int size = input.size();
+  int index = 0;
+  while (index < size) {
+    const unsigned char ch = input[index];
+    if (ch >= 0x80) {
+      return kJsScanNeedsRegex;
+    } else if (kCharClass[ch] & (index == 0 ? kIdentStart : kIdentPart)) {
+      ++index;
+    } else if (ch == '\\' && IsUnicodeEscape(input, index)) {
+      index += 6;
+    } else {
+      break;
+    }
+  }
+  return index;
+}
+
+int ScanJsLineComment(StringPiece input) {
+  int index;
+  if (input.starts_with("//")) {
+    index = 2;
+  } else if (input.starts_with("<!--")) {
+    index = 4;
+  } else if (input.starts_with("-->")) {
+    index = 3;
+  } else {
+    return 0;
+  }
+  // The comment ends at \r, \n, U+2028 (E2 80 A8) or U+2029 (E2 80 A9).  Since
+  // this works on bytes, it's fine for the comment to contain invalid UTF-8.
+  const int size = input.size();
+  for (; index < size; ++index) {
+    const char ch = input[index];
+    if (ch == '\n' || ch == '\r') {
+      break;
+    } else if (ch == '\xE2' && index + 2 < size && input[index + 1] == '\x80' &&
+               (input[index + 2] == '\xA8' || input[index + 2] == '\xA9')) {
+      break;
+    }
+  }
+  return index;
+}
+
+int ScanJsNumericLiteral(StringPiece input) {
+  const int size = input.size();
+  if (size == 0) {
+    return 0;
+  }
+  const char first = input[0];
+  if (first == '.') {
+    // \.[0-9]+ with optional exponent.
+    const int digits = SpanClass(input, 1, kDigit);
+    return (digits > 0) ? ScanExponent(input, 1 + digits) : 0;
+  } else if (!HasClass(first, kDigit)) {
+    return 0;
+  } else if (first != '0') {
+    return ScanFractionAndExponent(input, 1 + SpanClass(input, 1, kDigit));
+  }
+  // A leading zero could start any of the three kinds of literal; the regex
+  // is leftmost-longest, so take whichever match is longest.
+  int longest = 1;
+  if (size > 1 && (input[1] == 'x' || input[1] == 'X')) {
+    const int hex_digits = SpanClass(input, 2, kHexDigit);
+    if (hex_digits > 0) {
+      longest = 2 + hex_digits;
+    }
+  }
+  const int octal_digits = SpanClass(input, 1, kOctalDigit);
+  if (1 + octal_digits > longest) {
+    longest = 1 + octal_digits;
+  }
+  // 0 is only followed by further digits in a decimal literal if one of them
+  // is an 8 or 9; otherwise the decimal literal is just the 0.
+  const int digits = SpanClass(input, 1, kDigit);
+  const int decimal = ScanFractionAndExponent(
+      input, (digits > octal_digits) ? 1 + digits : 1);
+  return (decimal > longest) ? decimal : longest;
+}
+
+int ScanJsOperator(StringPiece input) {
+  const int size = input.size();
+  if (size == 0) {
+    return 0;
+  }
+  const char first = input[0];
+  const char second = (size > 1) ? input[1] : '\0';
+  switch (first) {
+    case '&': case '|': case '+': case '-':
+      // && || ++ -- or the assignment form.
+      return (second == first || second == '=') ? 2 : 1;
+    case '*': case '/': case '%': case '^':
+      return (second == '=') ? 2 : 1;
+    case '~':
+      return 1;
+    case '!': case '=': {
+      // ! != !== = == ===
+      int index = 1;
+      while (index < size && index < 3 && input[index] == '=') {
+        ++index;
+      }
+      return index;
+    }
+    case '<': case '>': {
+      // < << <= <<= and > >> >>> >= >>= >>>=
+      const int max_run = (first == '<') ? 2 : 3;
+      int index = 1;
+      while (index < size && index < max_run && input[index] == first) {
+        ++index;
+      }
+      if (index < size && input[index] == '=') {
+        ++index;
+      }
+      return index;
+    }
+    default:
+      return 0;
+  }
+}
+
+}  // namespace js
+
+}  // namespace pagespeed
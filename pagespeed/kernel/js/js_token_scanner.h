@@ -0,0 +1,58 @@
+// Copyright 2015 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef PAGESPEED_KERNEL_JS_JS_TOKEN_SCANNER_H_
+#define PAGESPEED_KERNEL_JS_JS_TOKEN_SCANNER_H_
+
+#include "pagespeed/kernel/base/string_util.h"
+
+namespace pagespeed {
+
+namespace js {
+
+// Hand-written scanners for the token classes that JsTokenizer sees most
+// often.  Each one matches exactly what the corresponding regex in
+// js_tokenizer.cc matches when anchored at the start of input (the unit tests
+// check this against the RE2 patterns over a corpus of real libraries), but
+// without RE2's per-call setup cost, which dominates for short tokens.
+//
+// Each function returns the length in bytes of the token at the start of
+// input, or 0 if input does not start with such a token.
+
+// Returned by ScanJsIdentifier if it runs into a non-ASCII byte, in which case
+// the caller must match the identifier with the (unicode-aware) regex instead.
+const int kJsScanNeedsRegex = -1;
+
+// Matches an identifier or keyword, including \uXXXX escapes, but only if it
+// is entirely ASCII; otherwise returns kJsScanNeedsRegex.
+int ScanJsIdentifier(StringPiece input);
+
+// Matches a line comment, i.e. //, <!--, or --> up to but not including the
+// next linebreak (\r, \n, U+2028 or U+2029) or the end of input.
+int ScanJsLineComment(StringPiece input);
+
+// Matches a hex, octal, or decimal numeric literal, taking the longest of the
+// three possible matches just as a POSIX regex would.
+int ScanJsNumericLiteral(StringPiece input);
+
+// Matches one of the operators recognized by the tokenizer's operator regex
+// (not including the punctuators such as comma, period, question mark and
+// colon, which JsTokenizer handles separately).
+int ScanJsOperator(StringPiece input);
+
+}  // namespace js
+
+}  // namespace pagespeed
+
+#endif  // PAGESPEED_KERNEL_JS_JS_TOKEN_SCANNER_H_
@@ -149,6 +149,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/js/js_token_scanner.h"
 #include "pagespeed/kernel/util/re2.h"
 
 namespace pagespeed {
@@ -583,18 +584,15 @@ JsKeywords::Type JsTokenizer::ConsumeBlockComment(StringPiece* token_out) {
 }
 
 JsKeywords::Type JsTokenizer::ConsumeLineComment(StringPiece* token_out) {
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  Re2StringPiece linebreak;
-  if (!RE2::Consume(&unconsumed, patterns_->line_comment_pattern, &linebreak)) {
+  const int length = ScanJsLineComment(input_);
+  if (length == 0) {
     // We only call ConsumeLineComment when we're sure we're looking at a line
     // comment, so this ought not happen even for pathalogical input.
     LOG(DFATAL) << "Failed to match line comment pattern: "
                 << input_.substr(0, 50);
     return Error(token_out);
   }
-  return Emit(JsKeywords::kComment,
-              input_.size() - unconsumed.size() - linebreak.size(),
-              token_out);
+  return Emit(JsKeywords::kComment, length, token_out);
 }
 
 bool JsTokenizer::TryConsumeComment(
@@ -710,36 +708,15 @@ bool JsTokenizer::TryConsumeIdentifierOrKeyword(
   // RE2 here mainly for the unicode support, but most JS files are plain
   // ASCII.  So first try to match against ASCII identifiers; only if we run
   // into a non-ASCII byte will we resort to RE2.
-  int index = 0;
-  {
-    bool use_regex = false;
-    const unsigned char first = input_[0];
-    if (first >= 0x80) {
-      use_regex = true;
-    } else if (('a' <= first && first <= 'z') || first == '_' ||
-               ('A' <= first && first <= 'Z') || first == '$' ||
-               first == '\\') {
-      int size = input_.size();
-      for (index = 1; index < size; ++index) {
-        const unsigned char ch = input_[index];
-        if (ch >= 0x80) {
-          use_regex = true;
-          break;
-        } else if (!net_instaweb::IsAsciiAlphaNumeric(ch) && ch != '_' &&
-                   ch != '$' && ch != '\\') {
-          break;
-        }
-      }
-    } else {
+  int index = ScanJsIdentifier(input_);
+  if (index == kJsScanNeedsRegex) {
+    Re2StringPiece unconsumed = StringPieceToRe2(input_);
+    if (!RE2::Consume(&unconsumed, patterns_->identifier_pattern)) {
       return false;
     }
-    if (use_regex) {
-      Re2StringPiece unconsumed = StringPieceToRe2(input_);
-      if (!RE2::Consume(&unconsumed, patterns_->identifier_pattern)) {
-        return false;
-      }
-      index = input_.size() - unconsumed.size();
-    }
+    index = input_.size() - unconsumed.size();
+  } else if (index == 0) {
+    return false;
   }
   DCHECK_GT(index, 0);
   // We have a match.  Determine which keyword it is, if any.
@@ -866,27 +843,25 @@ bool JsTokenizer::TryConsumeIdentifierOrKeyword(
 
 JsKeywords::Type JsTokenizer::ConsumeNumber(StringPiece* token_out) {
   DCHECK(!input_.empty());
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  if (!RE2::Consume(&unconsumed, patterns_->numeric_literal_pattern)) {
+  const int length = ScanJsNumericLiteral(input_);
+  if (length == 0) {
     // We only call ConsumeNumber when we're sure we're looking at a numeric
     // literal, so this ought not happen even for pathalogical input.
     LOG(DFATAL) << "Failed to match number pattern: " << input_.substr(0, 50);
     return Error(token_out);
   }
   PushExpression();
-  return Emit(JsKeywords::kNumber, input_.size() - unconsumed.size(),
-              token_out);
+  return Emit(JsKeywords::kNumber, length, token_out);
 }
 
 JsKeywords::Type JsTokenizer::ConsumeOperator(StringPiece* token_out) {
   DCHECK(!input_.empty());
-  Re2StringPiece unconsumed = StringPieceToRe2(input_);
-  if (!RE2::Consume(&unconsumed, patterns_->operator_pattern)) {
+  const int length = ScanJsOperator(input_);
+  if (length == 0) {
     // Unrecognized character:
     return Error(token_out);
   }
-  const JsKeywords::Type type =
-      Emit(JsKeywords::kOperator, input_.size() - unconsumed.size(), token_out);
+  const JsKeywords::Type type = Emit(JsKeywords::kOperator, length, token_out);
   const StringPiece token = *token_out;
   // Is this a postfix operator?  We treat those differently than prefix or
   // unary operators.
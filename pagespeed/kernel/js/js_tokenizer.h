@@ -196,7 +196,12 @@ struct JsTokenizerPatterns {
   JsTokenizerPatterns();
   ~JsTokenizerPatterns();
 
+  // JsTokenizer only uses this for identifiers containing non-ASCII
+  // characters; plain ASCII ones are matched by ScanJsIdentifier.
   const RE2 identifier_pattern;
+  // JsTokenizer matches these with the faster hand-written scanners in
+  // js_token_scanner.h; the patterns are kept as the reference definitions
+  // that the scanners are tested against.
   const RE2 line_comment_pattern;
   const RE2 numeric_literal_pattern;
   const RE2 operator_pattern;
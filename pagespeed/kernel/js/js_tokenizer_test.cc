@@ -22,6 +22,8 @@
 #include "pagespeed/kernel/base/stdio_file_system.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/js/js_keywords.h"
+#include "pagespeed/kernel/js/js_token_scanner.h"
+#include "pagespeed/kernel/util/re2.h"
 
 using pagespeed::JsKeywords;
 using pagespeed::js::JsTokenizer;
@@ -1628,4 +1630,116 @@ TEST_F(JsTokenizerTest, TokenizePrototype) {
   ExpectTokenizeFileSuccessfully("prototype.original");
 }
 
+// The hand-written scanners in js_token_scanner.h replace RE2 matching in the
+// tokenizer, and must agree exactly with the regexes they replace.  These
+// tests check that at every offset of some tricky inputs and real libraries.
+class JsTokenScannerTest : public testing::Test {
+ protected:
+  // Returns the length of the match of pattern at the start of input, or 0 if
+  // there is none.
+  static int RegexLength(const RE2& pattern, StringPiece input) {
+    Re2StringPiece unconsumed = StringPieceToRe2(input);
+    if (!RE2::Consume(&unconsumed, pattern)) {
+      return 0;
+    }
+    return input.size() - unconsumed.size();
+  }
+
+  // Like RegexLength for the line comment pattern, whose one capturing group
+  // matches the terminating linebreak, which isn't part of the comment.
+  int LineCommentRegexLength(StringPiece input) {
+    Re2StringPiece unconsumed = StringPieceToRe2(input);
+    Re2StringPiece linebreak;
+    if (!RE2::Consume(&unconsumed, patterns_.line_comment_pattern,
+                      &linebreak)) {
+      return 0;
+    }
+    return input.size() - unconsumed.size() - linebreak.size();
+  }
+
+  void ExpectScannersMatchRegexes(StringPiece input) {
+    for (int i = 0, n = input.size(); i < n; ++i) {
+      const StringPiece rest = input.substr(i);
+      const int identifier = pagespeed::js::ScanJsIdentifier(rest);
+      if (identifier != pagespeed::js::kJsScanNeedsRegex) {
+        ASSERT_EQ(RegexLength(patterns_.identifier_pattern, rest), identifier)
+            << "identifier at: " << rest.substr(0, 50);
+      }
+      ASSERT_EQ(LineCommentRegexLength(rest),
+                pagespeed::js::ScanJsLineComment(rest))
+          << "line comment at: " << rest.substr(0, 50);
+      ASSERT_EQ(RegexLength(patterns_.numeric_literal_pattern, rest),
+                pagespeed::js::ScanJsNumericLiteral(rest))
+          << "number at: " << rest.substr(0, 50);
+      ASSERT_EQ(RegexLength(patterns_.operator_pattern, rest),
+                pagespeed::js::ScanJsOperator(rest))
+          << "operator at: " << rest.substr(0, 50);
+    }
+  }
+
+  void ExpectScannersMatchRegexesOnFile(StringPiece filename) {
+    GoogleString contents;
+    net_instaweb::StdioFileSystem file_system;
+    const GoogleString filepath = net_instaweb::StrCat(
+        net_instaweb::GTestSrcDir(), kTestRootDir, filename);
+    net_instaweb::GoogleMessageHandler message_handler;
+    ASSERT_TRUE(file_system.ReadFile(
+        filepath.c_str(), &contents, &message_handler));
+    ExpectScannersMatchRegexes(contents);
+  }
+
+  JsTokenizerPatterns patterns_;
+};
+
+TEST_F(JsTokenScannerTest, Identifiers) {
+  ExpectScannersMatchRegexes("foo $bar _baz9 a1_$ 9x \\u0041bc x\\u00e9y "
+                             "\\u00G1 a\\u12 a\\b \\ x");
+  EXPECT_EQ(3, pagespeed::js::ScanJsIdentifier("foo+bar"));
+  EXPECT_EQ(8, pagespeed::js::ScanJsIdentifier("\\u0041bc;"));
+  EXPECT_EQ(1, pagespeed::js::ScanJsIdentifier("a\\u004"));
+  EXPECT_EQ(0, pagespeed::js::ScanJsIdentifier("\\x"));
+  EXPECT_EQ(pagespeed::js::kJsScanNeedsRegex,
+            pagespeed::js::ScanJsIdentifier("caf\xC3\xA9"));
+}
+
+TEST_F(JsTokenScannerTest, LineComments) {
+  ExpectScannersMatchRegexes("// foo\n<!-- bar\r--> baz\xE2\x80\xA8x// \xE2\x80"
+                             "\xA9// \xE2\x80\xA7\xE2\x80// \xFF\xFE//");
+  EXPECT_EQ(6, pagespeed::js::ScanJsLineComment("// foo\nbar"));
+  EXPECT_EQ(3, pagespeed::js::ScanJsLineComment("-->"));
+  EXPECT_EQ(0, pagespeed::js::ScanJsLineComment("/ /"));
+}
+
+TEST_F(JsTokenScannerTest, NumericLiterals) {
+  ExpectScannersMatchRegexes("0 00 07 08 0778 0x 0x1F 0XaBg 0.5 07.5 08.5e3 "
+                             ".5 . .e3 1. 1.e5 1e 1e+ 1e-7 12.34E+56 0e5 "
+                             "0171.5 0191.e+3 1..a 0x.5");
+  EXPECT_EQ(8, pagespeed::js::ScanJsNumericLiteral("0191.e+3+"));
+  EXPECT_EQ(4, pagespeed::js::ScanJsNumericLiteral("0171.toString()"));
+  EXPECT_EQ(2, pagespeed::js::ScanJsNumericLiteral("1..property"));
+  EXPECT_EQ(0, pagespeed::js::ScanJsNumericLiteral(".e3"));
+}
+
+TEST_F(JsTokenScannerTest, Operators) {
+  ExpectScannersMatchRegexes("&& &= & || |= | ++ += + -- -= - ~ * *= / /= % "
+                             "%= ^ ^= ! != !== !=== = == === ==== < <= << "
+                             "<<= <<< > >= >> >>= >>> >>>= >>>> >>>>= ? : , . "
+                             "+++ &&= ---");
+  EXPECT_EQ(4, pagespeed::js::ScanJsOperator(">>>=>"));
+  EXPECT_EQ(3, pagespeed::js::ScanJsOperator("<<=="));
+  EXPECT_EQ(0, pagespeed::js::ScanJsOperator("?"));
+}
+
+TEST_F(JsTokenScannerTest, AngularMatchesRegexes) {
+  ExpectScannersMatchRegexesOnFile("angular.original");
+}
+
+TEST_F(JsTokenScannerTest, JQueryMatchesRegexes) {
+  ExpectScannersMatchRegexesOnFile("jquery.original");
+}
+
+TEST_F(JsTokenScannerTest, PrototypeMatchesRegexes) {
+  ExpectScannersMatchRegexesOnFile("prototype.original");
+}
+
 }  // namespace
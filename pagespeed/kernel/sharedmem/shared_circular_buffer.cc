@@ -107,11 +107,40 @@ bool SharedCircularBuffer::Write(const StringPiece& message,
   return buffer_->Write(message);
 }
 
+bool SharedCircularBuffer::TryWrite(const StringPiece& message) {
+  if (!mutex_->TryLock()) {
+    return false;
+  }
+  bool ret = buffer_->Write(message);
+  mutex_->Unlock();
+  return ret;
+}
+
 bool SharedCircularBuffer::Dump(Writer* writer, MessageHandler* handler) {
   ScopedMutex hold_lock(mutex_.get());
   return (writer->Write(buffer_->ToString(handler), handler));
 }
 
+bool SharedCircularBuffer::DumpRecords(char delimiter, Writer* writer,
+                                       MessageHandler* handler) {
+  GoogleString content;
+  bool wrapped;
+  {
+    ScopedMutex hold_lock(mutex_.get());
+    content = buffer_->ToString(handler);
+    wrapped = buffer_->wrapped();
+  }
+  size_t begin = 0;
+  if (wrapped) {
+    begin = content.find(delimiter);
+    begin = (begin == GoogleString::npos) ? content.size() : begin + 1;
+  }
+  size_t end = content.rfind(delimiter);
+  end = (end == GoogleString::npos || end < begin) ? begin : end + 1;
+  return writer->Write(StringPiece(content.data() + begin, end - begin),
+                       handler);
+}
+
 GoogleString SharedCircularBuffer::ToString(MessageHandler* handler) {
   ScopedMutex hold_lock(mutex_.get());
   return buffer_->ToString(handler);
@@ -59,10 +59,21 @@ class SharedCircularBuffer : public Writer {
   void Clear();
   // Write content to circular buffer.
   virtual bool Write(const StringPiece& message, MessageHandler* handler);
+  // Like Write, but if another thread or process holds the buffer's lock,
+  // drops the message and returns false rather than waiting for it.  This
+  // suits writers on a request path, which would rather lose a record than
+  // stall behind a slow reader.
+  bool TryWrite(const StringPiece& message);
   virtual bool Flush(MessageHandler* message_handler) { return true; }
 
   // Write content of data in buffer to writer, without clearing the buffer.
   virtual bool Dump(Writer* writer, MessageHandler* handler);
+  // Treats the buffer content as a series of records, each terminated by
+  // delimiter, and writes the complete ones to writer, without clearing the
+  // buffer.  Once the buffer has wrapped, the oldest record has usually lost
+  // its beginning to a later write, so it is skipped; so is any trailing
+  // unterminated record.
+  bool DumpRecords(char delimiter, Writer* writer, MessageHandler* handler);
   // Return data content as string. This is for test purposes.
   GoogleString ToString(MessageHandler* handler);
   // This should be called from the root process as it is about to exit, when no
@@ -19,7 +19,9 @@
 #include "pagespeed/kernel/base/mock_message_handler.h"
 #include "pagespeed/kernel/base/null_message_handler.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/sharedmem/shared_circular_buffer.h"
 #include "pagespeed/kernel/sharedmem/shared_circular_buffer_test_base.h"
@@ -171,4 +173,34 @@ void SharedCircularBufferTestBase::TestCircular() {
   parent->GlobalCleanup(&handler_);
 }
 
+// Check that DumpRecords only reports complete records, including after
+// wraparound has truncated the oldest one.
+void SharedCircularBufferTestBase::TestRecords() {
+  scoped_ptr<SharedCircularBuffer> parent(ParentInit());
+  EXPECT_TRUE(parent->TryWrite("ab\n"));
+  message_ = "cd\n";
+  ASSERT_TRUE(CreateChild(
+      &SharedCircularBufferTestBase::TestChildWrite));
+  test_env_->WaitForChildren();
+  GoogleString records;
+  StringWriter writer(&records);
+  EXPECT_TRUE(parent->DumpRecords('\n', &writer, &handler_));
+  EXPECT_EQ("ab\ncd\n", records);
+
+  // An unterminated record isn't reported until it's complete.
+  EXPECT_TRUE(parent->TryWrite("ef"));
+  records.clear();
+  EXPECT_TRUE(parent->DumpRecords('\n', &writer, &handler_));
+  EXPECT_EQ("ab\ncd\n", records);
+
+  // Wrap around, overwriting the start of "ab\n".
+  EXPECT_TRUE(parent->TryWrite("g\nhi"));
+  EXPECT_EQ("\ncd\nefg\nhi", parent->ToString(&handler_));
+  records.clear();
+  EXPECT_TRUE(parent->DumpRecords('\n', &writer, &handler_));
+  EXPECT_EQ("cd\nefg\n", records);
+  parent->GlobalCleanup(&handler_);
+  EXPECT_EQ(0, handler_.SeriousMessages());
+}
+
 }  // namespace net_instaweb
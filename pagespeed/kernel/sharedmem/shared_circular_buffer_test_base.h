@@ -48,6 +48,8 @@ class SharedCircularBufferTestBase : public testing::Test {
   void TestClear();
   // Test the shared memory circular buffer.
   void TestCircular();
+  // Test writing and dumping delimited records.
+  void TestRecords();
 
  private:
   // Helper functions.
@@ -106,8 +108,12 @@ TYPED_TEST_P(SharedCircularBufferTestTemplate, TestCircular) {
   SharedCircularBufferTestBase::TestCircular();
 }
 
+TYPED_TEST_P(SharedCircularBufferTestTemplate, TestRecords) {
+  SharedCircularBufferTestBase::TestRecords();
+}
+
 REGISTER_TYPED_TEST_CASE_P(SharedCircularBufferTestTemplate, TestCreate,
-                           TestAdd, TestClear, TestCircular);
+                           TestAdd, TestClear, TestCircular, TestRecords);
 
 }  // namespace net_instaweb
 #endif  // PAGESPEED_KERNEL_SHAREDMEM_SHARED_CIRCULAR_BUFFER_TEST_BASE_H_
@@ -31,6 +31,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/util/statistics_logger.h"
+#include "pagespeed/kernel/util/statistics_time_series.h"
 
 namespace net_instaweb {
 
@@ -518,6 +519,12 @@ bool SharedMemStatistics::Init(bool parent,
     SharedMemHistogram* hist = histograms(i);
     total += hist->AllocationSize(shm_runtime_);
   }
+  // The logger's time series goes at the end, 8-byte aligned.
+  size_t time_series_pos = 0;
+  if (console_logger_.get() != NULL) {
+    time_series_pos = (total + sizeof(int64) - 1) & ~(sizeof(int64) - 1);
+    total = time_series_pos + console_logger_->time_series()->AllocationSize();
+  }
   bool ok = true;
   if (parent) {
     // In root process -> initialize shared memory.
@@ -586,6 +593,10 @@ bool SharedMemStatistics::Init(bool parent,
   }
 
   if (console_logger_.get() != NULL) {
+    if (ok) {
+      console_logger_->time_series()->Attach(
+          const_cast<char*>(segment_->Base() + time_series_pos), parent);
+    }
     console_logger_->Init();
   }
 
@@ -46,6 +46,54 @@ const size_t kUnboundedQueue = 0;
 
 }  // namespace
 
+class QueuedWorkerPool::PoolWorker : public QueuedWorker {
+ public:
+  PoolWorker(StringPiece thread_name, ThreadSystem* thread_system,
+             QueuedWorkerPool* pool)
+      : QueuedWorker(thread_name, thread_system),
+        dispatch_(pool, this) {
+  }
+
+  virtual ~PoolWorker() {
+    // Cancel anything still queued before dispatch_ goes away.
+    ShutDown();
+  }
+
+  // Runs sequence, and then any other sequences queued on the pool, in the
+  // work thread.  The closure is reused, so this must not be called again
+  // until the worker has put itself back on the pool's free-stack.
+  void RunSequence(Sequence* sequence) {
+    dispatch_.Reset();
+    dispatch_.set_sequence(sequence);
+    RunInWorkThread(&dispatch_);
+  }
+
+ private:
+  class Dispatch : public Function {
+   public:
+    Dispatch(QueuedWorkerPool* pool, QueuedWorker* worker)
+        : pool_(pool), worker_(worker), sequence_(NULL) {
+      set_delete_after_callback(false);
+    }
+
+    void set_sequence(Sequence* sequence) { sequence_ = sequence; }
+
+   protected:
+    virtual void Run() { pool_->Run(sequence_, worker_); }
+
+   private:
+    QueuedWorkerPool* pool_;
+    QueuedWorker* worker_;
+    Sequence* sequence_;
+
+    DISALLOW_COPY_AND_ASSIGN(Dispatch);
+  };
+
+  Dispatch dispatch_;
+
+  DISALLOW_COPY_AND_ASSIGN(PoolWorker);
+};
+
 QueuedWorkerPool::QueuedWorkerPool(
     int max_workers, StringPiece thread_name_base, ThreadSystem* thread_system)
     : thread_system_(thread_system),
@@ -191,9 +239,9 @@ void QueuedWorkerPool::QueueSequence(Sequence* sequence) {
       // on demand until we hit that limit.
       if (active_workers_.size() < max_workers_) {
         worker =
-            new QueuedWorker(StrCat(thread_name_base_, "-",
-                                    IntegerToString(active_workers_.size())),
-                             thread_system_);
+            new PoolWorker(StrCat(thread_name_base_, "-",
+                                  IntegerToString(active_workers_.size())),
+                           thread_system_, this);
         worker->Start();
         active_workers_.insert(worker);
       } else {
@@ -223,10 +271,7 @@ void QueuedWorkerPool::QueueSequence(Sequence* sequence) {
 
   // Run the worker without holding the Pool lock.
   if (worker != NULL) {
-    worker->RunInWorkThread(
-        new MemberFunction2<QueuedWorkerPool, QueuedWorkerPool::Sequence*,
-                            QueuedWorker*>(
-            &QueuedWorkerPool::Run, this, sequence, worker));
+    static_cast<PoolWorker*>(worker)->RunSequence(sequence);
   }
 }
 
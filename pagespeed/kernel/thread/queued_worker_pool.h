@@ -217,6 +217,10 @@ class QueuedWorkerPool {
   void set_queue_size_stat(Waveform* x) { queue_size_ = x; }
 
  private:
+  // A QueuedWorker that keeps the closure used to hand it sequences, so
+  // that waking an idle worker does not allocate.
+  class PoolWorker;
+
   friend class Sequence;
   void Run(Sequence* sequence, QueuedWorker* worker);
   void QueueSequence(Sequence* sequence);
@@ -226,7 +230,8 @@ class QueuedWorkerPool {
   ThreadSystem* thread_system_;
   scoped_ptr<AbstractMutex> mutex_;
 
-  // active_workers_ and available_workers_ are mutually exclusive.
+  // active_workers_ and available_workers_ are mutually exclusive.  All
+  // workers are PoolWorkers.
   std::set<QueuedWorker*> active_workers_;
   std::vector<QueuedWorker*> available_workers_;
 
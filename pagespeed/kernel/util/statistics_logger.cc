@@ -17,13 +17,16 @@
 
 #include "pagespeed/kernel/util/statistics_logger.h"
 
+#include <algorithm>
 #include <cstddef>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <set>
 #include <utility>                      // for pair
 #include <vector>
 
+#include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/escaping.h"
@@ -36,6 +39,7 @@
 #include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/base/writer.h"
 #include "pagespeed/kernel/html/html_keywords.h"
+#include "pagespeed/kernel/util/statistics_time_series.h"
 
 namespace net_instaweb {
 
@@ -125,6 +129,24 @@ const char* const kGraphsVars[] = {
   "cache_extensions", "cache_batcher_dropped_gets", "cache_flush_count",
 };
 
+// The time series keeps every dump, but no more than one a second, for an
+// hour, and one a minute for a week.
+const int64 kMinFinePeriodMs = Timer::kSecondMs;
+const int64 kFineRetentionMs = Timer::kHourMs;
+const int64 kCoarsePeriodMs = Timer::kMinuteMs;
+const int64 kCoarseRetentionMs = Timer::kWeekMs;
+
+// The number of distinct variables named above; one column of the time
+// series each.
+int NumLoggedVariables() {
+  std::set<StringPiece> names;
+  names.insert(kConsoleVars, kConsoleVars + arraysize(kConsoleVars));
+  names.insert(kOtherLoggedVars,
+               kOtherLoggedVars + arraysize(kOtherLoggedVars));
+  names.insert(kGraphsVars, kGraphsVars + arraysize(kGraphsVars));
+  return names.size();
+}
+
 }  // namespace
 
 StatisticsLogger::StatisticsLogger(
@@ -138,8 +160,13 @@ StatisticsLogger::StatisticsLogger(
       file_system_(file_system),
       timer_(timer),
       update_interval_ms_(update_interval_ms),
-      max_logfile_size_kb_(max_logfile_size_kb) {
+      max_logfile_size_kb_(max_logfile_size_kb),
+      time_series_(new StatisticsTimeSeries(NumLoggedVariables())) {
   logfile_name.CopyToString(&logfile_name_);
+  int64 fine_period_ms = std::max(update_interval_ms, kMinFinePeriodMs);
+  time_series_->AddTier(fine_period_ms, kFineRetentionMs);
+  time_series_->AddTier(std::max(fine_period_ms, kCoarsePeriodMs),
+                        kCoarseRetentionMs);
 }
 
 StatisticsLogger::~StatisticsLogger() {
@@ -196,6 +223,7 @@ void StatisticsLogger::UpdateAndDumpIfRequired() {
       // It's possible we'll need to do some of the following here for
       // cross-process consistency:
       // - flush the logfile before unlock to force out buffered data
+      AppendToTimeSeries(current_time_ms);
       FileSystem::OutputFile* statistics_log_file =
           file_system_->OpenOutputFileForAppend(
               logfile_name_.c_str(), message_handler_);
@@ -220,6 +248,26 @@ void StatisticsLogger::UpdateAndDumpIfRequired() {
   }
 }
 
+void StatisticsLogger::AppendToTimeSeries(int64 current_time_ms) {
+  if (!time_series_->attached()) {
+    return;
+  }
+  DCHECK_EQ(static_cast<size_t>(time_series_->num_columns()),
+            variables_to_log_.size());
+  std::vector<int64> values;
+  values.reserve(variables_to_log_.size());
+  for (VariableMap::const_iterator iter = variables_to_log_.begin();
+       iter != variables_to_log_.end(); ++iter) {
+    VariableOrCounter var_or_counter = iter->second;
+    values.push_back((var_or_counter.first != NULL)
+                     ? var_or_counter.first->Get()
+                     : var_or_counter.second->Get());
+  }
+  if (static_cast<int>(values.size()) == time_series_->num_columns()) {
+    time_series_->Append(current_time_ms, &values[0]);
+  }
+}
+
 void StatisticsLogger::DumpConsoleVarsToWriter(
     int64 current_time_ms, Writer* writer) {
   writer->Write(StringPrintf("timestamp: %s\n",
@@ -254,6 +302,11 @@ void StatisticsLogger::DumpJSON(
     bool dump_for_graphs, const StringSet& var_titles,
     int64 start_time, int64 end_time, int64 granularity_ms,
     Writer* writer, MessageHandler* message_handler) const {
+  if (DumpJSONFromTimeSeries(dump_for_graphs, var_titles, start_time,
+                             end_time, granularity_ms, writer,
+                             message_handler)) {
+    return;
+  }
   FileSystem::InputFile* log_file =
       file_system_->OpenInputFile(logfile_name_.c_str(), message_handler);
   if (log_file == NULL) {
@@ -276,6 +329,64 @@ void StatisticsLogger::DumpJSON(
   file_system_->Close(log_file, message_handler);
 }
 
+bool StatisticsLogger::DumpJSONFromTimeSeries(
+    bool dump_for_graphs, const StringSet& var_titles,
+    int64 start_time, int64 end_time, int64 granularity_ms,
+    Writer* writer, MessageHandler* message_handler) const {
+  AbstractMutex* mutex = last_dump_timestamp_->mutex();
+  if (mutex == NULL || !time_series_->attached()) {
+    return false;
+  }
+  StringSet graphs_titles;
+  const StringSet* titles = &var_titles;
+  if (dump_for_graphs) {
+    graphs_titles.insert(kGraphsVars, kGraphsVars + arraysize(kGraphsVars));
+    titles = &graphs_titles;
+  }
+  std::vector<int> columns;
+  for (StringSet::const_iterator iter = titles->begin();
+       iter != titles->end(); ++iter) {
+    VariableMap::const_iterator var = variables_to_log_.find(*iter);
+    if (var != variables_to_log_.end()) {
+      columns.push_back(std::distance(variables_to_log_.begin(), var));
+    }
+  }
+
+  std::vector<int64> timestamps;
+  std::vector<std::vector<int64> > values;
+  {
+    ScopedMutex lock(mutex);
+    // Data older than the time series (say, from before a restart) is only
+    // in the logfile.
+    int64 oldest = time_series_->OldestTimestampMs();
+    if (oldest < 0 ||
+        (oldest > start_time &&
+         file_system_->Exists(logfile_name_.c_str(),
+                              message_handler).is_true())) {
+      return false;
+    }
+    time_series_->Query(start_time, end_time, granularity_ms, columns,
+                        &timestamps, &values);
+  }
+
+  VarMap var_data;
+  int column = 0;
+  for (StringSet::const_iterator iter = titles->begin();
+       iter != titles->end(); ++iter) {
+    VariableInfo* info = &var_data[*iter];
+    if (variables_to_log_.find(*iter) == variables_to_log_.end()) {
+      info->assign(timestamps.size(), "0");
+    } else {
+      const std::vector<int64>& column_values = values[column++];
+      for (int i = 0, n = column_values.size(); i < n; ++i) {
+        info->push_back(Integer64ToString(column_values[i]));
+      }
+    }
+  }
+  PrintJSON(timestamps, var_data, writer, message_handler);
+  return true;
+}
+
 void StatisticsLogger::ParseDataFromReader(
     const StringSet& var_titles,
     StatisticsLogfileReader* reader,
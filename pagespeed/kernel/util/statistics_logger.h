@@ -25,6 +25,7 @@
 
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/file_system.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 
@@ -34,6 +35,7 @@ class MessageHandler;
 class MutexedScalar;
 class Statistics;
 class StatisticsLogfileReader;
+class StatisticsTimeSeries;
 class Timer;
 class UpDownCounter;
 class Variable;
@@ -52,7 +54,9 @@ class StatisticsLogger {
   // Writes filtered variable data in JSON format to the given writer.
   // Variable data is a time series collected from with data points from
   // start_time to end_time. Granularity is the minimum time difference
-  // between each successive data point.
+  // between each successive data point.  The data comes from time_series()
+  // if it is attached and reaches back to start_time (or there is no
+  // logfile), and from the logfile otherwise.
   void DumpJSON(bool dump_for_graphs, const StringSet& var_titles,
                 int64 start_time, int64 end_time, int64 granularity_ms,
                 Writer* writer, MessageHandler* message_handler) const;
@@ -71,6 +75,12 @@ class StatisticsLogger {
   // It is OK to call this multiple times (e.g. before & after a fork).
   void Init();
 
+  // In-memory store of recent dumps, holding one row per dump for the last
+  // hour and one per minute for the last week.  It does nothing until
+  // whoever owns the statistics memory attaches it; after that every dump is
+  // appended to it as well as to the logfile.
+  StatisticsTimeSeries* time_series() { return time_series_.get(); }
+
  private:
   friend class StatisticsLoggerTest;
 
@@ -109,6 +119,15 @@ class StatisticsLogger {
   void PrintJSON(const std::vector<int64>& list_of_timestamps,
                  const VarMap& parsed_var_data,
                  Writer* writer, MessageHandler* message_handler) const;
+  // Like DumpJSON, but reading from time_series_.  Returns false, having
+  // written nothing, if the time series can't answer the query.
+  bool DumpJSONFromTimeSeries(bool dump_for_graphs,
+                              const StringSet& var_titles, int64 start_time,
+                              int64 end_time, int64 granularity_ms,
+                              Writer* writer,
+                              MessageHandler* message_handler) const;
+  // Appends the current values of variables_to_log_ to time_series_.
+  void AppendToTimeSeries(int64 current_time_ms);
   void AddVariable(StringPiece var_name);
 
   // Initializes all stats that will be needed for logging. Only call this in
@@ -128,6 +147,8 @@ class StatisticsLogger {
   const int64 max_logfile_size_kb_;
   GoogleString logfile_name_;
   VariableMap variables_to_log_;
+  // Has one column for each entry in variables_to_log_, in the same order.
+  scoped_ptr<StatisticsTimeSeries> time_series_;
 
   DISALLOW_COPY_AND_ASSIGN(StatisticsLogger);
 };
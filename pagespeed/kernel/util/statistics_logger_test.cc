@@ -39,6 +39,7 @@
 #include "pagespeed/kernel/html/html_keywords.h"
 #include "pagespeed/kernel/util/platform.h"
 #include "pagespeed/kernel/util/simple_stats.h"
+#include "pagespeed/kernel/util/statistics_time_series.h"
 
 namespace net_instaweb {
 
@@ -439,4 +440,43 @@ TEST_F(StatisticsLoggerTest, LogfileTrimming) {
   }
 }
 
+TEST_F(StatisticsLoggerTest, DumpJSONFromTimeSeries) {
+  StatisticsTimeSeries* time_series = logger_.time_series();
+  std::vector<int64> memory(time_series->AllocationSize() / sizeof(int64));
+  time_series->Attach(reinterpret_cast<char*>(&memory[0]), true);
+
+  Variable* num_flushes = stats_.GetVariable("num_flushes");
+  int64 start_time = timer_.NowMs() + kLoggingIntervalMs;
+  for (int i = 0; i < 5; ++i) {
+    timer_.AdvanceMs(kLoggingIntervalMs);
+    num_flushes->Add(10);
+    logger_.UpdateAndDumpIfRequired();
+  }
+  // Without the logfile, the data can only come from the time series.
+  file_system_.RemoveFile(kStatsLogFile, &handler_);
+
+  std::set<GoogleString> var_titles;
+  var_titles.insert("num_flushes");
+  var_titles.insert(kUnloggedVariable);
+  GoogleString json_dump;
+  StringWriter writer(&json_dump);
+  logger_.DumpJSON(false, var_titles, start_time + kLoggingIntervalMs,
+                   timer_.NowMs(), 2 * kLoggingIntervalMs, &writer, &handler_);
+  EXPECT_EQ(StrCat("{\"timestamps\": [",
+                   Integer64ToString(start_time + kLoggingIntervalMs), ", ",
+                   Integer64ToString(start_time + 3 * kLoggingIntervalMs),
+                   "],\"variables\": {\"num_flushes\": [20, 40],"
+                   "\"unlogged_variable_\": [0, 0]}}"),
+            json_dump);
+
+  GoogleString json_dump_graphs;
+  StringWriter writer_graphs(&json_dump_graphs);
+  logger_.DumpJSON(true, var_titles, start_time, timer_.NowMs(), 0,
+                   &writer_graphs, &handler_);
+  EXPECT_THAT(json_dump_graphs, ::testing::HasSubstr(
+      "\"cache_hits\": [0, 0, 0, 0, 0]"));
+  EXPECT_THAT(json_dump_graphs, ::testing::Not(::testing::HasSubstr(
+      "num_flushes")));
+}
+
 }  // namespace net_instaweb
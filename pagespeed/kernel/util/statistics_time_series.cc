@@ -0,0 +1,259 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/util/statistics_time_series.h"
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "base/logging.h"
+#include "pagespeed/kernel/base/basictypes.h"
+
+namespace net_instaweb {
+
+const int StatisticsTimeSeries::kRowsPerKeyframe;
+
+StatisticsTimeSeries::StatisticsTimeSeries(int num_columns)
+    : num_columns_(num_columns),
+      base_(NULL) {
+}
+
+StatisticsTimeSeries::~StatisticsTimeSeries() {
+}
+
+void StatisticsTimeSeries::AddTier(int64 period_ms, int64 retention_ms) {
+  DCHECK(base_ == NULL);
+  DCHECK_LT(0, period_ms);
+  DCHECK(tiers_.empty() || tiers_.back().period_ms <= period_ms);
+  Tier tier;
+  tier.period_ms = period_ms;
+  // Round up to whole keyframe blocks, plus one more: the oldest block is
+  // unreadable once its keyframe has been overwritten.
+  int64 rows = (retention_ms + period_ms - 1) / period_ms;
+  int64 blocks = (rows + kRowsPerKeyframe - 1) / kRowsPerKeyframe + 1;
+  tier.capacity = blocks * kRowsPerKeyframe;
+  tier.offset = tiers_.empty()
+      ? 0 : tiers_.back().offset + TierSize(tiers_.back());
+  tiers_.push_back(tier);
+}
+
+size_t StatisticsTimeSeries::TierSize(const Tier& tier) const {
+  // Everything but the deltas is an int64, and the deltas come last.  Since
+  // capacity is a multiple of kRowsPerKeyframe, their total size is a
+  // multiple of 8, so the following tier is aligned too.
+  int64 keyframes = tier.capacity / kRowsPerKeyframe;
+  return sizeof(int64) * (1 + tier.capacity + num_columns_ +
+                          num_columns_ * keyframes) +
+      sizeof(int32) * num_columns_ * tier.capacity;
+}
+
+size_t StatisticsTimeSeries::AllocationSize() const {
+  return tiers_.empty()
+      ? 0 : tiers_.back().offset + TierSize(tiers_.back());
+}
+
+void StatisticsTimeSeries::Attach(char* memory, bool initialize) {
+  DCHECK_EQ(0U, reinterpret_cast<size_t>(memory) % sizeof(int64));
+  base_ = memory;
+  if (initialize) {
+    memset(base_, 0, AllocationSize());
+  }
+}
+
+int64* StatisticsTimeSeries::NumAppended(const Tier& tier) const {
+  return reinterpret_cast<int64*>(base_ + tier.offset);
+}
+
+int64* StatisticsTimeSeries::Timestamps(const Tier& tier) const {
+  return NumAppended(tier) + 1;
+}
+
+int64* StatisticsTimeSeries::LastValues(const Tier& tier) const {
+  return Timestamps(tier) + tier.capacity;
+}
+
+int64* StatisticsTimeSeries::Keyframes(const Tier& tier) const {
+  return LastValues(tier) + num_columns_;
+}
+
+int32* StatisticsTimeSeries::Deltas(const Tier& tier) const {
+  return reinterpret_cast<int32*>(
+      Keyframes(tier) + num_columns_ * (tier.capacity / kRowsPerKeyframe));
+}
+
+int64 StatisticsTimeSeries::FirstRow(const Tier& tier) const {
+  int64 num_appended = *NumAppended(tier);
+  if (num_appended <= tier.capacity) {
+    return 0;
+  }
+  int64 oldest = num_appended - tier.capacity;
+  return (oldest + kRowsPerKeyframe - 1) / kRowsPerKeyframe * kRowsPerKeyframe;
+}
+
+int64 StatisticsTimeSeries::TimestampOfRow(const Tier& tier, int64 row) const {
+  return Timestamps(tier)[row % tier.capacity];
+}
+
+void StatisticsTimeSeries::Append(int64 timestamp_ms, const int64* values) {
+  if (base_ == NULL) {
+    return;
+  }
+  for (int t = 0, num_tiers = tiers_.size(); t < num_tiers; ++t) {
+    const Tier& tier = tiers_[t];
+    int64* num_appended = NumAppended(tier);
+    int64 row = *num_appended;
+    if (row > 0 &&
+        timestamp_ms < TimestampOfRow(tier, row - 1) + tier.period_ms) {
+      continue;
+    }
+    int64 slot = row % tier.capacity;
+    Timestamps(tier)[slot] = timestamp_ms;
+    int64* last_values = LastValues(tier);
+    int64* keyframes = Keyframes(tier);
+    int32* deltas = Deltas(tier);
+    int64 num_keyframes = tier.capacity / kRowsPerKeyframe;
+    bool is_keyframe = (slot % kRowsPerKeyframe == 0);
+    for (int c = 0; c < num_columns_; ++c) {
+      int32* delta = &deltas[c * tier.capacity + slot];
+      if (is_keyframe) {
+        keyframes[c * num_keyframes + slot / kRowsPerKeyframe] = values[c];
+        *delta = 0;
+        last_values[c] = values[c];
+      } else {
+        int64 diff = values[c] - last_values[c];
+        if (diff > kint32max) {
+          diff = kint32max;
+        } else if (diff < kint32min) {
+          diff = kint32min;
+        }
+        *delta = static_cast<int32>(diff);
+        // Track the value as it will be decoded, so a clamped difference is
+        // made up in later rows.
+        last_values[c] += diff;
+      }
+    }
+    *num_appended = row + 1;
+  }
+}
+
+int64 StatisticsTimeSeries::OldestTimestampMs() const {
+  int64 oldest = -1;
+  if (base_ != NULL) {
+    for (int t = 0, num_tiers = tiers_.size(); t < num_tiers; ++t) {
+      const Tier& tier = tiers_[t];
+      if (*NumAppended(tier) > 0) {
+        int64 timestamp = TimestampOfRow(tier, FirstRow(tier));
+        if (oldest < 0 || timestamp < oldest) {
+          oldest = timestamp;
+        }
+      }
+    }
+  }
+  return oldest;
+}
+
+void StatisticsTimeSeries::Query(
+    int64 start_ms, int64 end_ms, int64 granularity_ms,
+    const std::vector<int>& columns, std::vector<int64>* timestamps,
+    std::vector<std::vector<int64> >* values) const {
+  timestamps->clear();
+  values->clear();
+  values->resize(columns.size());
+  if (base_ == NULL) {
+    return;
+  }
+
+  // Pick the finest tier reaching back to start_ms, or else the one
+  // reaching back furthest.
+  const Tier* tier = NULL;
+  int64 oldest = -1;
+  for (int t = 0, num_tiers = tiers_.size(); t < num_tiers; ++t) {
+    if (*NumAppended(tiers_[t]) > 0) {
+      int64 timestamp = TimestampOfRow(tiers_[t], FirstRow(tiers_[t]));
+      if (tier == NULL || timestamp < oldest) {
+        tier = &tiers_[t];
+        oldest = timestamp;
+      }
+      if (timestamp <= start_ms) {
+        break;
+      }
+    }
+  }
+  if (tier == NULL) {
+    return;
+  }
+
+  // Binary search for the first row at or after start_ms.
+  int64 low = FirstRow(*tier);
+  int64 high = *NumAppended(*tier);
+  int64 end_row = high;
+  while (low < high) {
+    int64 mid = low + (high - low) / 2;
+    if (TimestampOfRow(*tier, mid) < start_ms) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // Select the rows to report from the timestamps alone, then decode each
+  // requested column over just that span.
+  std::vector<int64> rows;
+  int64 previous_ms = 0;
+  for (int64 row = low; row < end_row; ++row) {
+    int64 timestamp = TimestampOfRow(*tier, row);
+    if (timestamp > end_ms) {
+      break;
+    }
+    if (timestamp >= previous_ms + granularity_ms) {
+      rows.push_back(row);
+      timestamps->push_back(timestamp);
+      previous_ms = timestamp;
+    }
+  }
+  if (rows.empty()) {
+    return;
+  }
+
+  const int64* keyframes = Keyframes(*tier);
+  const int32* deltas = Deltas(*tier);
+  int64 num_keyframes = tier->capacity / kRowsPerKeyframe;
+  for (int i = 0, n = columns.size(); i < n; ++i) {
+    int c = columns[i];
+    DCHECK_LE(0, c);
+    DCHECK_GT(num_columns_, c);
+    const int64* column_keyframes = keyframes + c * num_keyframes;
+    const int32* column_deltas = deltas + c * tier->capacity;
+    std::vector<int64>* column_values = &(*values)[i];
+    column_values->reserve(rows.size());
+    int64 row = rows[0] / kRowsPerKeyframe * kRowsPerKeyframe;
+    int64 value = 0;
+    for (int j = 0, num_rows = rows.size(); j < num_rows; ++j) {
+      for (; row <= rows[j]; ++row) {
+        int64 slot = row % tier->capacity;
+        if (slot % kRowsPerKeyframe == 0) {
+          value = column_keyframes[slot / kRowsPerKeyframe];
+        } else {
+          value += column_deltas[slot];
+        }
+      }
+      column_values->push_back(value);
+    }
+  }
+}
+
+}  // namespace net_instaweb
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_KERNEL_UTIL_STATISTICS_TIME_SERIES_H_
+#define PAGESPEED_KERNEL_UTIL_STATISTICS_TIME_SERIES_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+
+namespace net_instaweb {
+
+// A fixed-size store of periodic samples of a set of int64 values (columns),
+// kept in one or more retention tiers.  Each tier is a ring of rows holding
+// at most one row per period, so a fine tier (say one row a second for an
+// hour) can sit beside a coarse one (one row a minute for a week) in a
+// bounded amount of memory.
+//
+// Storage is columnar: each column's values in a tier are contiguous, with
+// the absolute value recorded every kRowsPerKeyframe rows and 32-bit
+// differences from the previous row in between.  Appending a row is O(1) per
+// column per tier, and a query finds its first row by binary search on the
+// timestamps and decodes at most kRowsPerKeyframe - 1 deltas before it.  A
+// difference too large for 32 bits is clamped and made up over the following
+// rows; the next keyframe is always exact.
+//
+// The store keeps no state outside the memory it is attached to, so it may
+// live in shared memory and be appended to and queried from any process.
+// It does no locking: callers must serialize Append with other Appends and
+// with Query.
+class StatisticsTimeSeries {
+ public:
+  static const int kRowsPerKeyframe = 64;
+
+  explicit StatisticsTimeSeries(int num_columns);
+  ~StatisticsTimeSeries();
+
+  // Adds a tier holding one row per period_ms for at least retention_ms.
+  // Tiers must be added finest first, and all before AllocationSize or
+  // Attach is called.
+  void AddTier(int64 period_ms, int64 retention_ms);
+
+  // Number of bytes of memory Attach requires.
+  size_t AllocationSize() const;
+
+  // Points the store at AllocationSize() bytes of 8-byte-aligned memory,
+  // which must outlive it.  Exactly one attacher (the process creating a
+  // shared segment, say) should pass initialize = true, before any other
+  // uses the memory.
+  void Attach(char* memory, bool initialize);
+  bool attached() const { return base_ != NULL; }
+
+  // Appends num_columns() values sampled at timestamp_ms to every tier whose
+  // latest row is at least a period older, or which is empty.
+  void Append(int64 timestamp_ms, const int64* values);
+
+  // Returns the timestamp of the oldest row held in any tier, or -1 if the
+  // store is empty or unattached.
+  int64 OldestTimestampMs() const;
+
+  // Reads the rows with timestamps in [start_ms, end_ms] from the finest
+  // tier that reaches back to start_ms (or failing that, the one reaching
+  // back furthest), skipping any row less than granularity_ms after the
+  // previous one returned.  Fills *timestamps with the row timestamps and
+  // (*values)[i] with the values of columns[i] in those rows.
+  void Query(int64 start_ms, int64 end_ms, int64 granularity_ms,
+             const std::vector<int>& columns, std::vector<int64>* timestamps,
+             std::vector<std::vector<int64> >* values) const;
+
+  int num_columns() const { return num_columns_; }
+
+ private:
+  struct Tier {
+    int64 period_ms;
+    int64 capacity;  // Rows; a multiple of kRowsPerKeyframe.
+    size_t offset;   // Of the tier's storage from base_.
+  };
+
+  // Per-tier storage, in order from tier.offset.
+  int64* NumAppended(const Tier& tier) const;  // Rows ever appended.
+  int64* Timestamps(const Tier& tier) const;   // [capacity]
+  int64* LastValues(const Tier& tier) const;   // [num_columns_]
+  int64* Keyframes(const Tier& tier) const;    // [column][keyframe]
+  int32* Deltas(const Tier& tier) const;       // [column][row]
+  size_t TierSize(const Tier& tier) const;
+
+  // Rows are numbered in order of appending, and row r is stored in slot
+  // r % capacity.  Returns the oldest row that can still be decoded: the
+  // first keyframe row not yet overwritten.
+  int64 FirstRow(const Tier& tier) const;
+  int64 TimestampOfRow(const Tier& tier, int64 row) const;
+
+  const int num_columns_;
+  std::vector<Tier> tiers_;
+  char* base_;
+
+  DISALLOW_COPY_AND_ASSIGN(StatisticsTimeSeries);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_KERNEL_UTIL_STATISTICS_TIME_SERIES_H_
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/kernel/util/statistics_time_series.h"
+
+#include <vector>
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/gtest.h"
+#include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/timer.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const int64 kStartMs = 1000 * Timer::kSecondMs;
+
+class StatisticsTimeSeriesTest : public testing::Test {
+ protected:
+  // Makes a store of two columns with a one-second tier kept for
+  // fine_retention_ms and a one-minute tier kept for an hour.
+  void MakeStore(int64 fine_retention_ms) {
+    store_.reset(new StatisticsTimeSeries(2));
+    store_->AddTier(Timer::kSecondMs, fine_retention_ms);
+    store_->AddTier(Timer::kMinuteMs, Timer::kHourMs);
+    memory_.resize(store_->AllocationSize() / sizeof(int64) + 1);
+    store_->Attach(reinterpret_cast<char*>(&memory_[0]), true);
+  }
+
+  void Append(int64 timestamp_ms, int64 value0, int64 value1) {
+    int64 values[2] = { value0, value1 };
+    store_->Append(timestamp_ms, values);
+  }
+
+  void Query(int64 start_ms, int64 end_ms, int64 granularity_ms) {
+    std::vector<int> columns;
+    columns.push_back(1);
+    columns.push_back(0);
+    store_->Query(start_ms, end_ms, granularity_ms, columns, &timestamps_,
+                  &values_);
+    ASSERT_EQ(2, values_.size());
+    ASSERT_EQ(timestamps_.size(), values_[0].size());
+    ASSERT_EQ(timestamps_.size(), values_[1].size());
+  }
+
+  scoped_ptr<StatisticsTimeSeries> store_;
+  std::vector<int64> memory_;
+  std::vector<int64> timestamps_;
+  std::vector<std::vector<int64> > values_;
+};
+
+TEST_F(StatisticsTimeSeriesTest, Empty) {
+  MakeStore(Timer::kMinuteMs);
+  EXPECT_EQ(-1, store_->OldestTimestampMs());
+  Query(0, kStartMs, 0);
+  EXPECT_TRUE(timestamps_.empty());
+
+  StatisticsTimeSeries unattached(2);
+  unattached.AddTier(Timer::kSecondMs, Timer::kMinuteMs);
+  int64 values[2] = { 1, 2 };
+  unattached.Append(kStartMs, values);
+  EXPECT_EQ(-1, unattached.OldestTimestampMs());
+}
+
+TEST_F(StatisticsTimeSeriesTest, AppendAndQuery) {
+  MakeStore(Timer::kHourMs);
+  for (int i = 0; i < 200; ++i) {
+    Append(kStartMs + i * Timer::kSecondMs, i * 10, 1000 - i);
+  }
+  EXPECT_EQ(kStartMs, store_->OldestTimestampMs());
+
+  Query(kStartMs + 100 * Timer::kSecondMs, kStartMs + 102 * Timer::kSecondMs,
+        0);
+  ASSERT_EQ(3, timestamps_.size());
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(kStartMs + (100 + i) * Timer::kSecondMs, timestamps_[i]);
+    EXPECT_EQ(900 - i, values_[0][i]);
+    EXPECT_EQ((100 + i) * 10, values_[1][i]);
+  }
+
+  // Granularity thins the rows returned.
+  Query(kStartMs, kStartMs + 199 * Timer::kSecondMs, 50 * Timer::kSecondMs);
+  ASSERT_EQ(4, timestamps_.size());
+  EXPECT_EQ(kStartMs + 150 * Timer::kSecondMs, timestamps_[3]);
+  EXPECT_EQ(1500, values_[1][3]);
+
+  // Samples arriving faster than a tier's period are dropped from it.
+  Append(kStartMs + 199 * Timer::kSecondMs + 10, 5, 5);
+  Query(kStartMs + 199 * Timer::kSecondMs, kStartMs + 200 * Timer::kSecondMs,
+        0);
+  ASSERT_EQ(1, timestamps_.size());
+  EXPECT_EQ(1990, values_[1][0]);
+}
+
+TEST_F(StatisticsTimeSeriesTest, RingWraps) {
+  // The fine tier holds a minute in whole keyframe blocks, plus a block.
+  MakeStore(Timer::kMinuteMs);
+  const int kRows = 2 * StatisticsTimeSeries::kRowsPerKeyframe;
+  const int kAppends = 5 * kRows + 7;
+  for (int i = 0; i < kAppends; ++i) {
+    Append(kStartMs + i * Timer::kSecondMs, i, -i);
+  }
+  // The partly overwritten oldest block can no longer be decoded, so the
+  // fine tier only reaches back to the keyframe following it.
+  const int kReadable = StatisticsTimeSeries::kRowsPerKeyframe + 7;
+  Query(kStartMs + (kAppends - kReadable) * Timer::kSecondMs,
+        kStartMs + kAppends * Timer::kSecondMs, 0);
+  ASSERT_EQ(kReadable, timestamps_.size());
+  for (int i = 0; i < kReadable; ++i) {
+    int64 expected = kAppends - kReadable + i;
+    EXPECT_EQ(kStartMs + expected * Timer::kSecondMs, timestamps_[i]);
+    EXPECT_EQ(-expected, values_[0][i]);
+    EXPECT_EQ(expected, values_[1][i]);
+  }
+
+  // Anything older comes from the one-minute tier.
+  Query(kStartMs + (kAppends - kReadable - 1) * Timer::kSecondMs,
+        kStartMs + kAppends * Timer::kSecondMs, 0);
+  ASSERT_EQ(1, timestamps_.size());
+  EXPECT_EQ(kStartMs + 10 * Timer::kMinuteMs, timestamps_[0]);
+  EXPECT_EQ(600, values_[1][0]);
+  EXPECT_EQ(kStartMs, store_->OldestTimestampMs());
+}
+
+TEST_F(StatisticsTimeSeriesTest, CoarseTier) {
+  MakeStore(Timer::kMinuteMs);
+  // Two hours of samples every 10 seconds.
+  for (int i = 0; i < 720; ++i) {
+    Append(kStartMs + i * 10 * Timer::kSecondMs, i, 0);
+  }
+  // At this rate the fine tier's rows only reach back a quarter of an hour,
+  // so a query for the last half-hour is answered by the one-minute tier.
+  int64 end_ms = kStartMs + 719 * 10 * Timer::kSecondMs;
+  Query(end_ms - 30 * Timer::kMinuteMs, end_ms, 0);
+  ASSERT_EQ(30, timestamps_.size());
+  for (int i = 1; i < 30; ++i) {
+    EXPECT_EQ(Timer::kMinuteMs, timestamps_[i] - timestamps_[i - 1]);
+    EXPECT_EQ(6, values_[1][i] - values_[1][i - 1]);
+  }
+
+  // A query for the last 30 seconds uses the fine tier.
+  Query(end_ms - 30 * Timer::kSecondMs, end_ms, 0);
+  ASSERT_EQ(4, timestamps_.size());
+  EXPECT_EQ(716, values_[1][0]);
+  EXPECT_EQ(719, values_[1][3]);
+}
+
+TEST_F(StatisticsTimeSeriesTest, LargeDeltasClamped) {
+  MakeStore(Timer::kHourMs);
+  const int64 kBig = 3 * static_cast<int64>(kint32max);
+  Append(kStartMs, 0, 0);
+  Append(kStartMs + Timer::kSecondMs, kBig, -kBig);
+  for (int i = 2; i < 6; ++i) {
+    Append(kStartMs + i * Timer::kSecondMs, kBig, -kBig);
+  }
+  Query(kStartMs, kStartMs + 5 * Timer::kSecondMs, 0);
+  ASSERT_EQ(6, timestamps_.size());
+  EXPECT_EQ(kint32max, values_[1][1]);
+  EXPECT_EQ(static_cast<int64>(kint32min), values_[0][1]);
+  // Caught up after three rows.
+  EXPECT_EQ(kBig, values_[1][3]);
+  EXPECT_EQ(kBig, values_[1][5]);
+  EXPECT_EQ(-kBig, values_[0][5]);
+}
+
+}  // namespace
+
+}  // namespace net_instaweb
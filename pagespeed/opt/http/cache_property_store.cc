@@ -19,7 +19,9 @@
 #include "pagespeed/opt/http/cache_property_store.h"
 
 #include <algorithm>
+#include <map>
 #include <utility>
+#include <vector>
 
 #include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
@@ -29,6 +31,7 @@
 #include "pagespeed/kernel/base/shared_string.h"
 #include "pagespeed/kernel/base/stl_util.h"
 #include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/cache/cache_stats.h"
 #include "pagespeed/opt/http/property_cache.pb.h"
 #include "pagespeed/opt/logging/log_record.h"
@@ -73,7 +76,8 @@ class CachePropertyStoreGetCallback : public PropertyStoreGetCallback {
   void SetStateInPropertyPage(
       const PropertyCache::Cohort* cohort,
       CacheInterface::KeyState state,
-      bool valid) {
+      bool valid,
+      int64 latency_ms) {
     ScopedMutex lock(mutex());
     if (page() == NULL) {
       return;
@@ -84,6 +88,7 @@ class CachePropertyStoreGetCallback : public PropertyStoreGetCallback {
         valid,
         state);
     page()->SetCacheState(cohort, state);
+    page()->RecordCohortLookupLatencyMs(cohort, latency_ms);
   }
 
  private:
@@ -92,9 +97,6 @@ class CachePropertyStoreGetCallback : public PropertyStoreGetCallback {
 
 // Tracks multiple cache lookups.  When they are all complete, page->Done() is
 // called.
-//
-// TODO(pulkitg): Use CacheInterface::MultiGet() instead of using
-// CacheInterface::Get() for each cohort.
 class CachePropertyStoreCallbackCollector {
  public:
   CachePropertyStoreCallbackCollector(
@@ -136,10 +138,13 @@ class CachePropertyStoreCacheCallback : public CacheInterface::Callback {
   CachePropertyStoreCacheCallback(
       const PropertyCache::Cohort* cohort,
       CachePropertyStoreGetCallback* property_store_callback,
-      CachePropertyStoreCallbackCollector* callback_collector)
+      CachePropertyStoreCallbackCollector* callback_collector,
+      Timer* timer)
       : cohort_(cohort),
         property_store_callback_(property_store_callback),
-        callback_collector_(callback_collector) {
+        callback_collector_(callback_collector),
+        timer_(timer),
+        start_ms_(timer->NowMs()) {
   }
   virtual ~CachePropertyStoreCacheCallback() {}
 
@@ -174,7 +179,8 @@ class CachePropertyStoreCacheCallback : public CacheInterface::Callback {
         }
       }
     }
-    property_store_callback_->SetStateInPropertyPage(cohort_, state, valid);
+    property_store_callback_->SetStateInPropertyPage(
+        cohort_, state, valid, timer_->NowMs() - start_ms_);
     callback_collector_->Done(valid);
     delete this;
   }
@@ -183,10 +189,20 @@ class CachePropertyStoreCacheCallback : public CacheInterface::Callback {
   const PropertyCache::Cohort* cohort_;
   CachePropertyStoreGetCallback* property_store_callback_;
   CachePropertyStoreCallbackCollector* callback_collector_;
+  Timer* timer_;
+  int64 start_ms_;
 
   DISALLOW_COPY_AND_ASSIGN(CachePropertyStoreCacheCallback);
 };
 
+// A cohort lookup, held until the lookups of all the pages in a MultiGet
+// are known.
+struct CohortLookup {
+  CacheStats* cache;
+  GoogleString key;
+  CacheInterface::Callback* callback;
+};
+
 }  // namespace
 
 GoogleString CachePropertyStore::CacheKey(
@@ -210,35 +226,85 @@ void CachePropertyStore::Get(
     PropertyPage* page,
     BoolCallback* done,
     AbstractPropertyStoreGetCallback** callback) {
-  if (cohort_list.empty()) {
-    *callback = NULL;
-    done->Run(true);
-    return;
+  GetRequestVector requests(1);
+  GetRequest* request = &requests[0];
+  request->url = url;
+  request->options_signature_hash = options_signature_hash;
+  request->cache_key_suffix = cache_key_suffix;
+  request->cohort_list = cohort_list;
+  request->page = page;
+  request->done = done;
+  request->callback = callback;
+  MultiGet(requests);
+}
+
+void CachePropertyStore::MultiGet(const GetRequestVector& requests) {
+  // Gather the lookups for every cohort of every page, grouped by the cache
+  // beneath each cohort's CacheStats, before issuing any of them.
+  typedef std::map<CacheInterface*, std::vector<CohortLookup> > LookupMap;
+  LookupMap lookups;
+  for (int i = 0, n = requests.size(); i < n; ++i) {
+    const GetRequest& request = requests[i];
+    if (request.cohort_list.empty()) {
+      *request.callback = NULL;
+      request.done->Run(true);
+      continue;
+    }
+    CachePropertyStoreGetCallback* property_store_get_callback =
+        new CachePropertyStoreGetCallback(
+            thread_system_->NewMutex(),
+            request.page,
+            enable_get_cancellation(),
+            request.done,
+            timer_);
+    *request.callback = property_store_get_callback;
+    CachePropertyStoreCallbackCollector* collector =
+        new CachePropertyStoreCallbackCollector(
+            property_store_get_callback,
+            request.cohort_list.size(),
+            thread_system_->NewMutex());
+    for (int j = 0, m = request.cohort_list.size(); j < m; ++j) {
+      const PropertyCache::Cohort* cohort = request.cohort_list[j];
+      CohortCacheMap::iterator cohort_itr =
+          cohort_cache_map_.find(cohort->name());
+      CHECK(cohort_itr != cohort_cache_map_.end());
+      CohortLookup lookup;
+      lookup.cache = cohort_itr->second;
+      lookup.key = CacheKey(request.url, request.options_signature_hash,
+                            request.cache_key_suffix, cohort);
+      lookup.callback = new CachePropertyStoreCacheCallback(
+          cohort, property_store_get_callback, collector, timer_);
+      lookups[lookup.cache->Backend()].push_back(lookup);
+    }
   }
-  CachePropertyStoreGetCallback* property_store_get_callback =
-      new CachePropertyStoreGetCallback(
-          thread_system_->NewMutex(),
-          page,
-          enable_get_cancellation(),
-          done,
-          timer_);
-  *callback = property_store_get_callback;
-  CachePropertyStoreCallbackCollector* collector =
-      new CachePropertyStoreCallbackCollector(
-          property_store_get_callback,
-          cohort_list.size(),
-          thread_system_->NewMutex());
-  for (int j = 0, n = cohort_list.size(); j < n; ++j) {
-    const PropertyCache::Cohort* cohort = cohort_list[j];
-    CohortCacheMap::iterator cohort_itr =
-        cohort_cache_map_.find(cohort->name());
-    CHECK(cohort_itr != cohort_cache_map_.end());
-    const GoogleString cache_key = CacheKey(
-        url, options_signature_hash, cache_key_suffix, cohort);
-    cohort_itr->second->Get(
-        cache_key,
-        new CachePropertyStoreCacheCallback(
-            cohort, property_store_get_callback, collector));
+
+  // Cohorts sharing a cache are looked up with one MultiGet, so that caches
+  // which batch (e.g. memcached, or anything behind a CacheBatcher) can
+  // serve them in one round trip.  Each lookup is still counted in its own
+  // cohort's statistics.
+  for (LookupMap::iterator p = lookups.begin(), e = lookups.end();
+       p != e; ++p) {
+    std::vector<CohortLookup>& cache_lookups = p->second;
+    if (cache_lookups.size() == 1) {
+      CohortLookup& lookup = cache_lookups[0];
+      lookup.cache->Get(lookup.key, lookup.callback);
+      continue;
+    }
+    CacheInterface::MultiGetRequest* request =
+        new CacheInterface::MultiGetRequest;
+    for (int i = 0, n = cache_lookups.size(); i < n; ++i) {
+      CohortLookup& lookup = cache_lookups[i];
+      CacheInterface::Callback* callback =
+          lookup.cache->WrapBackendLookup(lookup.key, lookup.callback);
+      if (callback != NULL) {
+        request->push_back(CacheInterface::KeyCallback(lookup.key, callback));
+      }
+    }
+    if (request->empty()) {
+      delete request;
+    } else {
+      p->first->MultiGet(request);
+    }
   }
 }
 
@@ -269,11 +335,11 @@ void CachePropertyStore::AddCohortWithCache(
     const GoogleString& cohort, CacheInterface* cache) {
   std::pair<CohortCacheMap::iterator, bool> insertions =
       cohort_cache_map_.insert(
-        make_pair(cohort, static_cast<CacheInterface*>(NULL)));
+        make_pair(cohort, static_cast<CacheStats*>(NULL)));
   CHECK(insertions.second) << cohort << " is added twice.";
   // Create a new CacheStats for every cohort so that we can track cache
   // statistics independently for every cohort.
-  CacheInterface* cache_stats = new CacheStats(
+  CacheStats* cache_stats = new CacheStats(
         PropertyCache::GetStatsPrefix(cohort), cache, timer_, stats_);
   insertions.first->second = cache_stats;
 }
@@ -20,7 +20,8 @@
 // PropertyPage.
 // There is a CacheInterface object for every cohort which is stored in
 // CohortCacheMap and read/write for a cohort happens on its respective
-// CacheInterface object.
+// CacheInterface object.  Lookups of cohorts whose CacheInterface objects
+// share a backend are combined into a single MultiGet.
 
 #ifndef PAGESPEED_OPT_HTTP_CACHE_PROPERTY_STORE_H_
 #define PAGESPEED_OPT_HTTP_CACHE_PROPERTY_STORE_H_
@@ -37,6 +38,7 @@
 
 namespace net_instaweb {
 
+class CacheStats;
 class PropertyCacheValues;
 class Statistics;
 class ThreadSystem;
@@ -68,6 +70,10 @@ class CachePropertyStore : public PropertyStore {
                    BoolCallback* done,
                    AbstractPropertyStoreGetCallback** callback);
 
+  // Looks up the cohorts of all the requests together, with one MultiGet for
+  // each cache backend.
+  virtual void MultiGet(const GetRequestVector& requests);
+
   // Write to cache.
   virtual void Put(const GoogleString& url,
                    const GoogleString& options_signature_hash,
@@ -104,7 +110,7 @@ class CachePropertyStore : public PropertyStore {
 
  private:
   GoogleString cache_key_prefix_;
-  typedef std::map<GoogleString, CacheInterface*> CohortCacheMap;
+  typedef std::map<GoogleString, CacheStats*> CohortCacheMap;
   CohortCacheMap cohort_cache_map_;
   CacheInterface* default_cache_;
   Timer* timer_;
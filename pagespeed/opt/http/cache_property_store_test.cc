@@ -22,12 +22,14 @@
 
 #include <cstddef>
 
+#include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/callback.h"
 #include "pagespeed/kernel/base/gtest.h"
 #include "pagespeed/kernel/base/mock_timer.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
 #include "pagespeed/kernel/base/shared_string.h"
+#include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/cache/lru_cache.h"
 #include "pagespeed/kernel/util/platform.h"
@@ -43,6 +45,7 @@ namespace {
 const size_t kMaxCacheSize = 200;
 const char kCohortName1[] = "cohort1";
 const char kCohortName2[] = "cohort2";
+const char kCohortName3[] = "cohort3";
 const char kUrl[] = "www.test.com/sample.html";
 const char kParsableContent[] =
     "value { name: 'prop1' value: 'value1' }";
@@ -50,6 +53,41 @@ const char kNonParsableContent[] = "random";
 const char kOptionsSignatureHash[] = "hash";
 const char kCacheKeySuffix[] = "CacheKeySuffix";
 
+// Passes everything through to an LRUCache, counting the calls to MultiGet.
+class MultiGetCountingCache : public CacheInterface {
+ public:
+  MultiGetCountingCache() : cache_(kMaxCacheSize), num_multi_gets_(0),
+                            num_multi_get_keys_(0) {}
+  virtual ~MultiGetCountingCache() {}
+
+  virtual void Get(const GoogleString& key, Callback* callback) {
+    cache_.Get(key, callback);
+  }
+  virtual void MultiGet(MultiGetRequest* request) {
+    ++num_multi_gets_;
+    num_multi_get_keys_ += request->size();
+    CacheInterface::MultiGet(request);
+  }
+  virtual void Put(const GoogleString& key, SharedString* value) {
+    cache_.Put(key, value);
+  }
+  virtual void Delete(const GoogleString& key) { cache_.Delete(key); }
+  virtual GoogleString Name() const { return "MultiGetCountingCache"; }
+  virtual bool IsBlocking() const { return true; }
+  virtual bool IsHealthy() const { return true; }
+  virtual void ShutDown() {}
+
+  int num_multi_gets() const { return num_multi_gets_; }
+  int num_multi_get_keys() const { return num_multi_get_keys_; }
+
+ private:
+  LRUCache cache_;
+  int num_multi_gets_;
+  int num_multi_get_keys_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiGetCountingCache);
+};
+
 }  // namespace
 
 class CachePropertyStoreTest : public testing::Test {
@@ -285,6 +323,51 @@ TEST_F(CachePropertyStoreTest, TestPropertyCacheKeyMethod) {
   EXPECT_EQ(expected, cache_key);
 }
 
+TEST_F(CachePropertyStoreTest, TestMultiReadBatchesCohortsPerBackend) {
+  MultiGetCountingCache second_cache;
+  PropertyCache::InitCohortStats(kCohortName2, &stats_);
+  PropertyCache::InitCohortStats(kCohortName3, &stats_);
+  const PropertyCache::Cohort* cohort2 =
+      property_cache_.AddCohort(kCohortName2);
+  const PropertyCache::Cohort* cohort3 =
+      property_cache_.AddCohort(kCohortName3);
+  cache_property_store_.AddCohortWithCache(kCohortName2, &second_cache);
+  cache_property_store_.AddCohortWithCache(kCohortName3, &second_cache);
+  cohort_list_.push_back(cohort2);
+  cohort_list_.push_back(cohort3);
+
+  PropertyCacheValues values;
+  values.ParseFromString(kParsableContent);
+  cache_property_store_.Put(kUrl, kOptionsSignatureHash, kCacheKeySuffix,
+                            cohort2, &values, NULL);
+  lru_cache_.ClearStats();
+
+  // Read a page and its fallback page together.
+  MockPropertyPage page(thread_system_.get(), &property_cache_, kUrl,
+                        kOptionsSignatureHash, kCacheKeySuffix);
+  MockPropertyPage fallback_page(thread_system_.get(), &property_cache_,
+                                 "www.test.com/", kOptionsSignatureHash,
+                                 kCacheKeySuffix);
+  PropertyCache::PageReadVector reads;
+  reads.push_back(PropertyCache::PageRead(&page, &cohort_list_));
+  reads.push_back(PropertyCache::PageRead(&fallback_page, &cohort_list_));
+  property_cache_.MultiReadWithCohorts(reads);
+
+  // The four lookups of the cohorts in the second cache go out together.
+  EXPECT_EQ(1, second_cache.num_multi_gets());
+  EXPECT_EQ(4, second_cache.num_multi_get_keys());
+  EXPECT_EQ(2, lru_cache_.num_misses());
+
+  EXPECT_TRUE(page.called());
+  EXPECT_TRUE(page.valid());
+  EXPECT_EQ(CacheInterface::kNotFound, page.GetCacheState(cohort_));
+  EXPECT_EQ(CacheInterface::kAvailable, page.GetCacheState(cohort2));
+  EXPECT_EQ(CacheInterface::kNotFound, page.GetCacheState(cohort3));
+  EXPECT_TRUE(fallback_page.called());
+  EXPECT_FALSE(fallback_page.valid());
+  EXPECT_EQ(CacheInterface::kNotFound, fallback_page.GetCacheState(cohort2));
+}
+
 TEST_F(CachePropertyStoreTest, TestPutHandlesNonNullCallback) {
   PropertyCacheValues values;
   values.ParseFromString(kParsableContent);
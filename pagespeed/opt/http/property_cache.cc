@@ -209,14 +209,38 @@ void PropertyCache::ReadWithCohorts(const CohortVector& cohort_list,
   page->Read(cohort_list);
 }
 
+void PropertyCache::MultiReadWithCohorts(const PageReadVector& reads) const {
+  PropertyStore::GetRequestVector requests;
+  requests.reserve(reads.size());
+  for (int i = 0, n = reads.size(); i < n; ++i) {
+    PropertyPage* page = reads[i].page;
+    const CohortVector& cohort_list = *reads[i].cohort_list;
+    if (!enabled_ || cohort_list.empty()) {
+      page->Abort();
+      continue;
+    }
+    page->StartRead(cohort_list);
+    requests.push_back(PropertyStore::GetRequest());
+    PropertyStore::GetRequest* request = &requests.back();
+    request->url = page->url_;
+    request->options_signature_hash = page->options_signature_hash_;
+    request->cache_key_suffix = page->cache_key_suffix_;
+    request->cohort_list = cohort_list;
+    request->page = page;
+    request->done = NewCallback(page, &PropertyPage::CallDone);
+    request->callback = &page->property_store_callback_;
+  }
+  if (!requests.empty()) {
+    property_store_->MultiGet(requests);
+  }
+}
+
 void PropertyPage::Abort() {
   CallDone(false);
 }
 
 void PropertyPage::Read(const PropertyCache::CohortVector& cohort_list) {
-  DCHECK(!cohort_list.empty());
-  DCHECK(property_store_callback_ == NULL);
-  SetupCohorts(cohort_list);
+  StartRead(cohort_list);
   property_cache_->property_store()->Get(
       url_,
       options_signature_hash_,
@@ -227,6 +251,45 @@ void PropertyPage::Read(const PropertyCache::CohortVector& cohort_list) {
       &property_store_callback_);
 }
 
+void PropertyPage::StartRead(const PropertyCache::CohortVector& cohort_list) {
+  DCHECK(!cohort_list.empty());
+  DCHECK(property_store_callback_ == NULL);
+  SetupCohorts(cohort_list);
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    read_span_ = trace->BeginSpan("PropertyPage::Read", SpanTrace::kRootSpan);
+    trace->AddTag(read_span_, "page_type",
+                  (page_type_ == kPropertyCachePerOriginPage) ? "origin" :
+                  (page_type_ == kPropertyCacheFallbackPage) ? "fallback" :
+                  "page");
+    trace->AddTag(read_span_, "cohorts",
+                  IntegerToString(cohort_list.size()));
+  }
+}
+
+void PropertyPage::CallDone(bool success) {
+  SpanTrace* trace = span_trace();
+  if (trace != NULL) {
+    trace->AddTag(read_span_, "success", success ? "true" : "false");
+    trace->EndSpan(read_span_);
+  }
+  was_read_ = true;
+  Done(success);
+}
+
+void PropertyPage::RecordCohortLookupLatencyMs(
+    const PropertyCache::Cohort* cohort, int64 latency_ms) {
+  if (request_context_.get() != NULL) {
+    request_context_->mutable_timing_info()->SetPropertyCacheCohortLatencyMs(
+        cohort->name(), latency_ms);
+  }
+}
+
+SpanTrace* PropertyPage::span_trace() {
+  return (request_context_.get() == NULL) ? NULL :
+      request_context_->span_trace();
+}
+
 bool PropertyValue::IsStable(int mutations_per_1000_threshold) const {
   // We allocate a 64-bit mask to record whether recent calls to Write
   // actually changed the data.  So although we keep a total number of
@@ -322,7 +385,8 @@ PropertyPage::PropertyPage(
       was_read_(false),
       property_cache_(property_cache),
       property_store_callback_(NULL),
-      page_type_(page_type) {
+      page_type_(page_type),
+      read_span_(SpanTrace::kNoSpan) {
 }
 
 PropertyPage::~PropertyPage() {
@@ -98,6 +98,7 @@
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/ref_counted_ptr.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/cache/cache_interface.h"
@@ -198,6 +199,15 @@ class PropertyCache {
 
   typedef std::vector<const Cohort*> CohortVector;
 
+  // A page for MultiReadWithCohorts to read, and the cohorts to read for it.
+  struct PageRead {
+    PageRead(PropertyPage* page_in, const CohortVector* cohort_list_in)
+        : page(page_in), cohort_list(cohort_list_in) {}
+    PropertyPage* page;
+    const CohortVector* cohort_list;
+  };
+  typedef std::vector<PageRead> PageReadVector;
+
   // Does not take ownership of the property_store, timer, stats, or threads
   // objects.
   PropertyCache(PropertyStore* property_store,
@@ -216,6 +226,11 @@ class PropertyCache {
   void ReadWithCohorts(const CohortVector& cohort_list,
                        PropertyPage* property_page) const;
 
+  // Reads several pages as ReadWithCohorts would, but with a single call to
+  // the PropertyStore, so that it can look up the cohorts of all the pages
+  // (say, a page and its fallback page) together.
+  void MultiReadWithCohorts(const PageReadVector& reads) const;
+
   // Returns all the cohorts from cache.
   const CohortVector GetAllCohorts() const { return cohort_list_; }
 
@@ -408,6 +423,11 @@ class PropertyPage : public AbstractPropertyPage {
   // Returns the type of the page.
   PageType page_type() { return page_type_; }
 
+  // Records how long the property store took to look up cohort in the
+  // timing info of the request this page is read for.
+  void RecordCohortLookupLatencyMs(const PropertyCache::Cohort* cohort,
+                                   int64 latency_ms);
+
   // Returns true if cohort present in the PropertyPage.
   bool IsCohortPresent(const PropertyCache::Cohort* cohort);
 
@@ -441,15 +461,21 @@ class PropertyPage : public AbstractPropertyPage {
   virtual void Done(bool success) = 0;
 
  private:
+  friend class PropertyCache;
+
   void SetupCohorts(const PropertyCache::CohortVector& cohort_list);
 
+  // Prepares to read the cohorts in cohort_list, which the caller must then
+  // look up in the property store.
+  void StartRead(const PropertyCache::CohortVector& cohort_list);
+
   // Returns true if for the given cohort any property is deleted.
   bool HasPropertyValueDeleted(const PropertyCache::Cohort* cohort);
 
-  void CallDone(bool success) {
-    was_read_ = true;
-    Done(success);
-  }
+  void CallDone(bool success);
+
+  // The trace of the request this page is read for, if it's being traced.
+  SpanTrace* span_trace();
 
   typedef std::map<GoogleString, PropertyValue*> PropertyMap;
 
@@ -480,6 +506,7 @@ class PropertyPage : public AbstractPropertyPage {
   // PropertyPage.
   AbstractPropertyStoreGetCallback* property_store_callback_;
   PageType page_type_;
+  SpanTrace::SpanId read_span_;
 
   DISALLOW_COPY_AND_ASSIGN(PropertyPage);
 };
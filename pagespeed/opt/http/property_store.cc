@@ -39,6 +39,14 @@ PropertyStore::PropertyStore()
 PropertyStore::~PropertyStore() {
 }
 
+void PropertyStore::MultiGet(const GetRequestVector& requests) {
+  for (int i = 0, n = requests.size(); i < n; ++i) {
+    const GetRequest& request = requests[i];
+    Get(request.url, request.options_signature_hash, request.cache_key_suffix,
+        request.cohort_list, request.page, request.done, request.callback);
+  }
+}
+
 void PropertyStoreGetCallback::InitStats(Statistics* statistics) {
   fast_finish_lookup_latency_ms_ =
       statistics->AddHistogram("PropertyStoreLatencyAfterFastFinishCalledMs");
@@ -21,6 +21,8 @@
 #ifndef PAGESPEED_OPT_HTTP_PROPERTY_STORE_H_
 #define PAGESPEED_OPT_HTTP_PROPERTY_STORE_H_
 
+#include <vector>
+
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/callback.h"
 #include "pagespeed/kernel/base/scoped_ptr.h"
@@ -41,6 +43,19 @@ class Timer;
 class PropertyStore {
  public:
   typedef Callback1<bool> BoolCallback;
+
+  // The arguments of one Get, for MultiGet.
+  struct GetRequest {
+    GoogleString url;
+    GoogleString options_signature_hash;
+    GoogleString cache_key_suffix;
+    PropertyCache::CohortVector cohort_list;
+    PropertyPage* page;
+    BoolCallback* done;
+    AbstractPropertyStoreGetCallback** callback;
+  };
+  typedef std::vector<GetRequest> GetRequestVector;
+
   PropertyStore();
   virtual ~PropertyStore();
 
@@ -62,6 +77,11 @@ class PropertyStore {
       BoolCallback* done,
       AbstractPropertyStoreGetCallback** callback) = 0;
 
+  // Makes each of the lookups in requests as Get would, but lets the store
+  // combine them; e.g. to look up a page and its fallback page in one round
+  // trip.  The default implementation calls Get for each request in turn.
+  virtual void MultiGet(const GetRequestVector& requests);
+
   // Write to storage system for the given key.
   // Callback done can be NULL. BoolCallback done will be called with true if
   // Insert operation is successful.
@@ -21,6 +21,7 @@
 #include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/request_trace.h"
+#include "pagespeed/kernel/base/span_trace.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/http/http_options.h"
 #include "pagespeed/opt/logging/log_record.h"
@@ -75,6 +76,10 @@ RequestContext::~RequestContext() {
   // RequestContexts are reference counted, and doing work in the dtor will
   // result in actions being taken at unpredictable times, leading to difficult
   // to diagnose performance and correctness bugs.
+  //
+  // Recording a sampled SpanTrace is diagnostic, and is done here so that it
+  // includes work that outlives the response, such as detached rewrites.
+  span_trace_.reset(NULL);
 }
 
 RequestContextPtr RequestContext::NewTestRequestContextWithTimer(
@@ -100,6 +105,10 @@ void RequestContext::set_root_trace_context(RequestTrace* x) {
   root_trace_context_.reset(x);
 }
 
+void RequestContext::set_span_trace(SpanTrace* x) {
+  span_trace_.reset(x);
+}
+
 AbstractLogRecord* RequestContext::log_record() {
   DCHECK(log_record_.get() != NULL);
   return log_record_.get();
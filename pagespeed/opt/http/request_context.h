@@ -36,6 +36,7 @@ class AbstractLogRecord;
 class AbstractMutex;
 class RequestContext;
 class RequestTrace;
+class SpanTrace;
 class ThreadSystem;
 class Timer;
 
@@ -91,6 +92,14 @@ class RequestContext : public RefCounted<RequestContext> {
   // Takes ownership of the given context.
   void set_root_trace_context(RequestTrace* x);
 
+  // The structured trace of the work done for this request, or NULL if the
+  // request is not being traced; see ServerContext::MaybeStartSpanTrace.
+  // The trace is recorded when the last reference to the context is dropped.
+  SpanTrace* span_trace() const { return span_trace_.get(); }
+  // Takes ownership of the given trace.  This must be called before the
+  // context is shared with other threads.
+  void set_span_trace(SpanTrace* x);
+
   // Creates a new RequestTrace associated with a request depending on the
   // root user request; e.g., a subresource fetch for an HTML page.
   //
@@ -244,6 +253,9 @@ class RequestContext : public RefCounted<RequestContext> {
   // Logs tracing events associated with the root request.
   scoped_ptr<RequestTrace> root_trace_context_;
 
+  // Structured trace of a sampled request.
+  scoped_ptr<SpanTrace> span_trace_;
+
   // Log for recording background rewritings.
   scoped_ptr<AbstractLogRecord> background_rewrite_log_record_;
 
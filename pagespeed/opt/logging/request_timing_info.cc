@@ -18,8 +18,13 @@
 
 #include "pagespeed/opt/logging/request_timing_info.h"
 
+#include <map>
+#include <utility>
+
 #include "base/logging.h"
 #include "pagespeed/kernel/base/abstract_mutex.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
 #include "pagespeed/kernel/base/timer.h"
 
 namespace net_instaweb {
@@ -98,6 +103,20 @@ void RequestTimingInfo::SetL2HTTPCacheLatencyMs(int64 latency_ms) {
   SetValueIfGEZero(latency_ms, &l2http_cache_latency_ms_);
 }
 
+void RequestTimingInfo::SetPropertyCacheCohortLatencyMs(StringPiece cohort,
+                                                        int64 latency_ms) {
+  if (latency_ms < 0) {
+    return;
+  }
+  ScopedMutex l(mu_);
+  std::pair<std::map<GoogleString, int64>::iterator, bool> insertion =
+      pcache_cohort_latency_ms_.insert(
+          std::make_pair(cohort.as_string(), latency_ms));
+  if (!insertion.second && insertion.first->second < latency_ms) {
+    insertion.first->second = latency_ms;
+  }
+}
+
 int64 RequestTimingInfo::GetElapsedMs() const {
   DCHECK_GE(init_ts_ms_, 0);
   return NowMs() - init_ts_ms_;
@@ -195,4 +214,16 @@ bool RequestTimingInfo::GetL2HTTPCacheLatencyMs(
   return SetValueIfGEZero(l2http_cache_latency_ms_, latency_ms);
 }
 
+bool RequestTimingInfo::GetPropertyCacheCohortLatencyMs(
+    StringPiece cohort, int64* latency_ms) const {
+  ScopedMutex l(mu_);
+  std::map<GoogleString, int64>::const_iterator p =
+      pcache_cohort_latency_ms_.find(cohort.as_string());
+  if (p == pcache_cohort_latency_ms_.end()) {
+    return false;
+  }
+  *latency_ms = p->second;
+  return true;
+}
+
 }  // namespace net_instaweb
@@ -19,7 +19,11 @@
 #ifndef PAGESPEED_OPT_LOGGING_REQUEST_TIMING_INFO_H_
 #define PAGESPEED_OPT_LOGGING_REQUEST_TIMING_INFO_H_
 
+#include <map>
+
 #include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
 
 namespace net_instaweb {
 
@@ -88,6 +92,11 @@ class RequestTimingInfo {
   void SetHTTPCacheLatencyMs(int64 latency_ms);
   void SetL2HTTPCacheLatencyMs(int64 latency_ms);
 
+  // Records the latency of the property cache lookup of the named cohort.
+  // When a cohort is looked up for several pages (e.g. a page and its
+  // fallback), the slowest lookup is kept.
+  void SetPropertyCacheCohortLatencyMs(StringPiece cohort, int64 latency_ms);
+
   // Milliseconds since Init.
   int64 GetElapsedMs() const;
 
@@ -116,6 +125,10 @@ class RequestTimingInfo {
   bool GetHTTPCacheLatencyMs(int64* latency_ms) const;
   bool GetL2HTTPCacheLatencyMs(int64* latency_ms) const;
 
+  // Property cache lookup latency for the named cohort.
+  bool GetPropertyCacheCohortLatencyMs(StringPiece cohort,
+                                       int64* latency_ms) const;
+
   // Milliseconds from request start to fetch start.
   bool GetTimeToStartFetchMs(int64* elapsed_ms) const;
 
@@ -173,6 +186,7 @@ class RequestTimingInfo {
   // Latencies.
   int64 http_cache_latency_ms_;
   int64 l2http_cache_latency_ms_;
+  std::map<GoogleString, int64> pcache_cohort_latency_ms_;
 
   DISALLOW_COPY_AND_ASSIGN(RequestTimingInfo);
 };
@@ -215,6 +215,33 @@ TEST(RequestTimingInfoTest, CacheLatency) {
   EXPECT_EQ(2, latency_ms);
 }
 
+TEST(RequestTimingInfoTest, PropertyCacheCohortLatency) {
+  NullMutex mutex;
+  RequestTimingInfo timing_info(NULL, &mutex);
+
+  int64 latency_ms;
+  ASSERT_FALSE(timing_info.GetPropertyCacheCohortLatencyMs("dom",
+                                                           &latency_ms));
+  timing_info.SetPropertyCacheCohortLatencyMs("dom", 3);
+  timing_info.SetPropertyCacheCohortLatencyMs("beacon", 1);
+  ASSERT_TRUE(timing_info.GetPropertyCacheCohortLatencyMs("dom",
+                                                          &latency_ms));
+  EXPECT_EQ(3, latency_ms);
+  ASSERT_TRUE(timing_info.GetPropertyCacheCohortLatencyMs("beacon",
+                                                          &latency_ms));
+  EXPECT_EQ(1, latency_ms);
+
+  // The slowest lookup of a cohort is kept.
+  timing_info.SetPropertyCacheCohortLatencyMs("dom", 2);
+  timing_info.SetPropertyCacheCohortLatencyMs("beacon", 4);
+  ASSERT_TRUE(timing_info.GetPropertyCacheCohortLatencyMs("dom",
+                                                          &latency_ms));
+  EXPECT_EQ(3, latency_ms);
+  ASSERT_TRUE(timing_info.GetPropertyCacheCohortLatencyMs("beacon",
+                                                          &latency_ms));
+  EXPECT_EQ(4, latency_ms);
+}
+
 }  // namespace
 
 }  // namespace net_instaweb
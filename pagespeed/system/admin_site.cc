@@ -27,6 +27,7 @@
 #include "net/instaweb/rewriter/public/rewrite_options.h"
 #include "net/instaweb/rewriter/public/rewrite_query.h"
 #include "net/instaweb/rewriter/public/server_context.h"
+#include "pagespeed/system/span_trace_buffer.h"
 #include "pagespeed/system/system_cache_path.h"
 #include "pagespeed/system/system_caches.h"
 #include "pagespeed/system/system_rewrite_options.h"
@@ -34,6 +35,7 @@
 #include "net/instaweb/util/public/property_store.h"
 #include "pagespeed/kernel/base/cache_interface.h"
 #include "pagespeed/kernel/base/callback.h"
+#include "pagespeed/kernel/base/cost_tracker.h"
 #include "pagespeed/kernel/base/message_handler.h"
 #include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/string.h"
@@ -71,6 +73,59 @@ extern const char* JS_statistics_js_opt;
 
 namespace {
 
+// Writes an HTML table of the costs accumulated by tracker, with column
+// headings that link back to this page re-sorted by that column.
+void WriteCostTable(StringPiece title, CostTracker* tracker,
+                    CostTracker::SortOrder order, AsyncFetch* fetch,
+                    MessageHandler* handler) {
+  static const struct {
+    const char* heading;
+    CostTracker::SortOrder order;
+  } kColumns[] = {
+    {"Name", CostTracker::kByName},
+    {"Calls", CostTracker::kByCalls},
+    {"Events", CostTracker::kByEvents},
+    {"CPU ms", CostTracker::kByCpu},
+    {"Wall ms", CostTracker::kByWall},
+    {"Max wall ms", CostTracker::kByMaxWall},
+  };
+  CostTracker::CostVector costs;
+  tracker->GetCosts(order, &costs);
+
+  fetch->Write(StrCat("<h3>", title, "</h3>\n<table>\n<tr>"), handler);
+  for (int i = 0, n = arraysize(kColumns); i < n; ++i) {
+    if (kColumns[i].order == order) {
+      fetch->Write(StrCat("<th>", kColumns[i].heading, " &#9660;</th>"),
+                   handler);
+    } else {
+      fetch->Write(StrCat("<th><a href='?cost_sort=",
+                          CostTracker::SortOrderName(kColumns[i].order), "'>",
+                          kColumns[i].heading, "</a></th>"),
+                   handler);
+    }
+  }
+  fetch->Write("<th>CPU us/call</th></tr>\n", handler);
+
+  GoogleString escaped;
+  for (int i = 0, n = costs.size(); i < n; ++i) {
+    const CostTracker::Cost& cost = costs[i].second;
+    HtmlKeywords::Escape(costs[i].first, &escaped);
+    fetch->Write(StrCat(
+        "<tr><td>", escaped,
+        "</td><td>", Integer64ToString(cost.calls),
+        "</td><td>", Integer64ToString(cost.events),
+        "</td><td>", Integer64ToString(cost.cpu_us / Timer::kMsUs),
+        "</td><td>", Integer64ToString(cost.wall_us / Timer::kMsUs)),
+                 handler);
+    fetch->Write(StrCat(
+        "</td><td>", Integer64ToString(cost.max_wall_us / Timer::kMsUs),
+        "</td><td>", Integer64ToString(cost.cpu_us / cost.calls),
+        "</td></tr>\n"),
+                 handler);
+  }
+  fetch->Write("</table>\n", handler);
+}
+
 struct Tab {
   const char* label;
   const char* title;
@@ -262,9 +317,30 @@ void AdminSite::StatisticsJsonHandler(AsyncFetch* fetch, Statistics* stats) {
   fetch->Done(true);
 }
 
+void AdminSite::SpanTraceJsonHandler(AsyncFetch* fetch,
+                                     SpanTraceBuffer* span_trace_buffer) {
+  if (span_trace_buffer == NULL) {
+    fetch->response_headers()->SetStatusAndReason(HttpStatus::kNotFound);
+    fetch->response_headers()->Add(HttpAttributes::kContentType, "text/plain");
+    fetch->Write("Request tracing is off.  Set SpanTraceBufferSize and "
+                 "SpanTraceSamplePercent to enable it.\n", message_handler_);
+    fetch->Done(true);
+    return;
+  }
+  fetch->response_headers()->SetStatusAndReason(HttpStatus::kOK);
+  fetch->response_headers()->Add(HttpAttributes::kContentType,
+                                 kContentTypeJson.mime_type());
+  // The trace viewer loads traces from files, so offer this as a download.
+  fetch->response_headers()->Add(HttpAttributes::kContentDisposition,
+                                 "attachment; filename=pagespeed_trace.json");
+  fetch->Done(span_trace_buffer->DumpChromeTrace(fetch, message_handler_));
+}
+
 void AdminSite::StatisticsHandler(const RewriteOptions& options,
-                                  AdminSource source, AsyncFetch* fetch,
-                                  Statistics* stats) {
+                                  AdminSource source,
+                                  const QueryParams& query_params,
+                                  ServerContext* server_context,
+                                  AsyncFetch* fetch, Statistics* stats) {
   GoogleString head_markup = StrCat(
       "<style>", CSS_statistics_css, "</style>\n");
   AdminHtml admin_html("statistics", head_markup, source, fetch,
@@ -280,6 +356,16 @@ void AdminSite::StatisticsHandler(const RewriteOptions& options,
   fetch->Write(StrCat("<script type='text/javascript'>", statistics_js,
                       "\npagespeed.Statistics.Start();</script>\n"),
                message_handler_);
+
+  if (server_context->html_filter_costs() != NULL) {
+    const GoogleString* sort_param = query_params.Lookup1Escaped("cost_sort");
+    CostTracker::SortOrder order = CostTracker::ParseSortOrder(
+        (sort_param == NULL) ? "" : *sort_param);
+    WriteCostTable("HTML filter costs", server_context->html_filter_costs(),
+                   order, fetch, message_handler_);
+    WriteCostTable("Resource rewrite costs", server_context->rewrite_costs(),
+                   order, fetch, message_handler_);
+  }
 }
 
 void AdminSite::GraphsHandler(const RewriteOptions& options,
@@ -705,7 +791,8 @@ void AdminSite::AdminPage(
     CacheInterface* metadata_cache, PropertyCache* page_property_cache,
     ServerContext* server_context, Statistics* statistics, Statistics* stats,
     SystemRewriteOptions* global_system_rewrite_options,
-    const SystemRewriteOptions* spdy_config) {
+    const SystemRewriteOptions* spdy_config,
+    SpanTraceBuffer* span_trace_buffer) {
   // The handler is "pagespeed_admin", so we must dispatch off of
   // the remainder of the URL.  For
   // "http://example.com/pagespeed_admin/foo?a=b" we want to pull out
@@ -746,7 +833,8 @@ void AdminSite::AdminPage(
   } else {
     StringPiece leaf = stripped_gurl.LeafSansQuery();
     if ((leaf == "statistics") || (leaf.empty())) {
-      StatisticsHandler(*options, kPageSpeedAdmin, fetch, stats);
+      StatisticsHandler(*options, kPageSpeedAdmin, query_params,
+                        server_context, fetch, stats);
     } else if (leaf == "stats_json") {
       StatisticsJsonHandler(fetch, stats);
     } else if (leaf == "graphs") {
@@ -768,6 +856,8 @@ void AdminSite::AdminPage(
                   page_property_cache, server_context);
     } else if (leaf == "histograms") {
       PrintHistograms(kPageSpeedAdmin, fetch, stats);
+    } else if (leaf == "trace_json") {
+      SpanTraceJsonHandler(fetch, span_trace_buffer);
     } else {
       fetch->response_headers()->SetStatusAndReason(HttpStatus::kNotFound);
       fetch->response_headers()->Add(HttpAttributes::kContentType, "text/html");
@@ -818,7 +908,8 @@ void AdminSite::StatisticsPage(
                 http_cache, metadata_cache, page_property_cache,
                 server_context);
   } else {
-    StatisticsHandler(*options, kStatistics, fetch, stats);
+    StatisticsHandler(*options, kStatistics, query_params, server_context,
+                      fetch, stats);
   }
 }
 
@@ -32,6 +32,7 @@ class PropertyCache;
 class QueryParams;
 class RewriteOptions;
 class ServerContext;
+class SpanTraceBuffer;
 class StaticAssetManager;
 class Statistics;
 class SystemCachePath;
@@ -74,7 +75,8 @@ class AdminSite {
 
   // Handle a request for /pagespeed_admin/*, which is a launching
   // point for all the administrator pages including stats,
-  // message-histogram, console, etc.
+  // message-histogram, console, etc.  span_trace_buffer may be NULL if
+  // request tracing is off.
   void AdminPage(bool is_global, const GoogleUrl& stripped_gurl,
                  const QueryParams& query_params,
                  const RewriteOptions* options,
@@ -86,7 +88,8 @@ class AdminSite {
                  ServerContext* server_context, Statistics* statistics,
                  Statistics* stats,
                  SystemRewriteOptions* global_system_rewrite_options,
-                 const SystemRewriteOptions* spdy_config);
+                 const SystemRewriteOptions* spdy_config,
+                 SpanTraceBuffer* span_trace_buffer);
 
   // Handle a request for the legacy /*_pagespeed_statistics page, which also
   // serves as a launching point for a subset of the admin pages.  Because the
@@ -119,7 +122,12 @@ class AdminSite {
   //
   // In systems without a spdy-specific config, spdy_config should be
   // null.
+  //
+  // If server_context is tracking filter costs, they are shown in tables
+  // below the statistics, ordered by the "cost_sort" query parameter.
   void StatisticsHandler(const RewriteOptions& options, AdminSource source,
+                         const QueryParams& query_params,
+                         ServerContext* server_context,
                          AsyncFetch* fetch, Statistics* stats);
 
   // Responds to 'fetch' with data used on statistics page and graphs page
@@ -157,6 +165,11 @@ class AdminSite {
   void PrintHistograms(AdminSource source, AsyncFetch* fetch,
                        Statistics* stats);
 
+  // Serves the recently sampled request traces as JSON for the Chrome trace
+  // viewer (chrome://tracing).
+  void SpanTraceJsonHandler(AsyncFetch* fetch,
+                            SpanTraceBuffer* span_trace_buffer);
+
   void PurgeHandler(StringPiece url, SystemCachePath* cache_path,
                     AsyncFetch* fetch);
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pagespeed/system/span_trace_buffer.h"
+
+#include "pagespeed/kernel/base/statistics.h"
+#include "pagespeed/kernel/base/string.h"
+#include "pagespeed/kernel/base/string_util.h"
+#include "pagespeed/kernel/base/string_writer.h"
+#include "pagespeed/kernel/base/writer.h"
+#include "pagespeed/kernel/sharedmem/shared_circular_buffer.h"
+
+namespace net_instaweb {
+
+namespace {
+
+const char kSpanTracesRecorded[] = "span_traces_recorded";
+const char kSpanTracesDropped[] = "span_traces_dropped";
+
+// Traces are recorded as process 0 and renumbered when dumped.
+const char kRecordedPidPrefix[] = "{\"pid\":0,";
+
+}  // namespace
+
+SpanTraceBuffer::SpanTraceBuffer(SharedCircularBuffer* buffer,
+                                 Statistics* stats)
+    : buffer_(buffer),
+      traces_recorded_(stats->GetVariable(kSpanTracesRecorded)),
+      traces_dropped_(stats->GetVariable(kSpanTracesDropped)) {
+}
+
+SpanTraceBuffer::~SpanTraceBuffer() {
+}
+
+void SpanTraceBuffer::InitStats(Statistics* stats) {
+  stats->AddVariable(kSpanTracesRecorded);
+  stats->AddVariable(kSpanTracesDropped);
+}
+
+void SpanTraceBuffer::RecordTrace(const SpanTrace& trace) {
+  GoogleString record;
+  trace.AppendChromeTraceEvents(0, &record);
+  record.push_back('\n');
+  if (buffer_->TryWrite(record)) {
+    traces_recorded_->Add(1);
+  } else {
+    traces_dropped_->Add(1);
+  }
+}
+
+bool SpanTraceBuffer::DumpChromeTrace(Writer* writer,
+                                      MessageHandler* handler) {
+  GoogleString records;
+  StringWriter records_writer(&records);
+  if (!buffer_->DumpRecords('\n', &records_writer, handler)) {
+    return false;
+  }
+  StringPieceVector lines;
+  SplitStringPieceToVector(records, "\n", &lines, true /* omit_empty */);
+
+  bool ret = writer->Write("{\"traceEvents\":[", handler);
+  GoogleString events;
+  for (int i = 0, n = lines.size(); i < n; ++i) {
+    lines[i].CopyToString(&events);
+    GlobalReplaceSubstring(kRecordedPidPrefix,
+                           StrCat("{\"pid\":", IntegerToString(i + 1), ","),
+                           &events);
+    if (i != 0) {
+      ret &= writer->Write(",\n", handler);
+    }
+    ret &= writer->Write(events, handler);
+  }
+  ret &= writer->Write("]}\n", handler);
+  return ret;
+}
+
+}  // namespace net_instaweb
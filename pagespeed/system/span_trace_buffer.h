@@ -0,0 +1,61 @@
+/*
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PAGESPEED_SYSTEM_SPAN_TRACE_BUFFER_H_
+#define PAGESPEED_SYSTEM_SPAN_TRACE_BUFFER_H_
+
+#include "pagespeed/kernel/base/basictypes.h"
+#include "pagespeed/kernel/base/span_trace.h"
+
+namespace net_instaweb {
+
+class MessageHandler;
+class SharedCircularBuffer;
+class Statistics;
+class Variable;
+class Writer;
+
+// Records completed request traces into a SharedCircularBuffer, one line of
+// Chrome trace events per request, so that the most recent traces from all
+// the server's processes can be retrieved from the admin pages.  Recording
+// never waits: if another process holds the buffer's lock the trace is
+// dropped and counted.
+class SpanTraceBuffer : public SpanTraceSink {
+ public:
+  // Takes ownership of neither buffer nor stats.
+  SpanTraceBuffer(SharedCircularBuffer* buffer, Statistics* stats);
+  virtual ~SpanTraceBuffer();
+
+  static void InitStats(Statistics* stats);
+
+  virtual void RecordTrace(const SpanTrace& trace);
+
+  // Writes the buffered traces as a Chrome trace-viewer JSON document, with
+  // each request shown as a separate process.  Returns false if the buffer
+  // could not be read.
+  bool DumpChromeTrace(Writer* writer, MessageHandler* handler);
+
+ private:
+  SharedCircularBuffer* buffer_;
+  Variable* traces_recorded_;
+  Variable* traces_dropped_;
+
+  DISALLOW_COPY_AND_ASSIGN(SpanTraceBuffer);
+};
+
+}  // namespace net_instaweb
+
+#endif  // PAGESPEED_SYSTEM_SPAN_TRACE_BUFFER_H_
@@ -24,15 +24,22 @@
 #include "pagespeed/kernel/base/abstract_mutex.h"
 #include "pagespeed/kernel/base/basictypes.h"
 #include "pagespeed/kernel/base/callback.h"
+#include "pagespeed/kernel/base/file_system.h"
+#include "pagespeed/kernel/base/function.h"
 #include "pagespeed/kernel/base/message_handler.h"
+#include "pagespeed/kernel/base/null_message_handler.h"
+#include "pagespeed/kernel/base/statistics.h"
 #include "pagespeed/kernel/base/thread_system.h"
+#include "pagespeed/kernel/base/timer.h"
 #include "pagespeed/kernel/cache/cache_interface.h"
+#include "pagespeed/kernel/cache/cache_snapshot.h"
 #include "pagespeed/kernel/cache/cache_stats.h"
 #include "pagespeed/kernel/cache/file_cache.h"
 #include "pagespeed/kernel/cache/lru_cache.h"
 #include "pagespeed/kernel/cache/purge_context.h"
 #include "pagespeed/kernel/cache/threadsafe_cache.h"
 #include "pagespeed/kernel/sharedmem/shared_mem_lock_manager.h"
+#include "pagespeed/kernel/thread/slow_worker.h"
 #include "pagespeed/kernel/util/file_system_lock_manager.h"
 
 namespace net_instaweb {
@@ -40,6 +47,20 @@ namespace net_instaweb {
 const char SystemCachePath::kFileCache[] = "file_cache";
 const char SystemCachePath::kLruCache[] = "lru_cache";
 
+const char SystemCachePath::kLruSnapshotEntriesRestored[] =
+    "lru_cache_snapshot_entries_restored";
+const char SystemCachePath::kLruSnapshotRestoreMs[] =
+    "lru_cache_snapshot_restore_ms";
+const char SystemCachePath::kLruSnapshotsWritten[] =
+    "lru_cache_snapshots_written";
+
+namespace {
+
+// Name of the LRU cache snapshot file within the file cache path.
+const char kLruSnapshotName[] = "lru_cache.snapshot";
+
+}  // namespace
+
 // The SystemCachePath encapsulates a cache-sharing model where a user specifies
 // a file-cache path per virtual-host.  With each file-cache object we keep
 // a locking mechanism and an optional per-process LRUCache.
@@ -53,6 +74,8 @@ SystemCachePath::SystemCachePath(const StringPiece& path,
       lock_manager_(NULL),
       file_cache_backend_(NULL),
       lru_cache_(NULL),
+      lru_cache_backend_(NULL),
+      lru_mutex_(NULL),
       file_cache_(NULL),
       clean_interval_explicitly_set_(
           config->has_file_cache_clean_interval_ms()),
@@ -60,7 +83,9 @@ SystemCachePath::SystemCachePath(const StringPiece& path,
       clean_inode_limit_explicitly_set_(
           config->has_file_cache_clean_inode_limit()),
       options_(config),
-      mutex_(factory->thread_system()->NewMutex()) {
+      mutex_(factory->thread_system()->NewMutex()),
+      snapshot_worker_(NULL),
+      next_lru_snapshot_ms_(0) {
   if (config->use_shared_mem_locking()) {
     shared_mem_lock_manager_.reset(new SharedMemLockManager(
         shm_runtime, LockManagerSegmentName(),
@@ -88,13 +113,14 @@ SystemCachePath::SystemCachePath(const StringPiece& path,
     LRUCache* lru_cache = new LRUCache(
         config->lru_cache_kb_per_process() * 1024);
     factory->TakeOwnership(lru_cache);
+    lru_cache_backend_ = lru_cache;
 
     // We only add the threadsafe-wrapper to the LRUCache.  The FileCache
     // is naturally thread-safe because it's got no writable member variables.
     // And surrounding that slower-running class with a mutex would likely
     // cause contention.
-    ThreadsafeCache* ts_cache =
-        new ThreadsafeCache(lru_cache, factory->thread_system()->NewMutex());
+    lru_mutex_ = factory->thread_system()->NewMutex();
+    ThreadsafeCache* ts_cache = new ThreadsafeCache(lru_cache, lru_mutex_);
     factory->TakeOwnership(ts_cache);
 #if CACHE_STATISTICS
     lru_cache_ = new CacheStats(kLruCache, ts_cache, factory->timer(),
@@ -109,6 +135,12 @@ SystemCachePath::SystemCachePath(const StringPiece& path,
 SystemCachePath::~SystemCachePath() {
 }
 
+void SystemCachePath::InitStats(Statistics* statistics) {
+  statistics->AddVariable(kLruSnapshotEntriesRestored);
+  statistics->AddVariable(kLruSnapshotRestoreMs);
+  statistics->AddVariable(kLruSnapshotsWritten);
+}
+
 void SystemCachePath::MergeConfig(const SystemRewriteOptions* config) {
   FileCache::CachePolicy* policy = file_cache_backend_->mutable_cache_policy();
 
@@ -192,6 +224,8 @@ void SystemCachePath::ChildInit(SlowWorker* cache_clean_worker) {
   if (file_cache_backend_ != NULL) {
     file_cache_backend_->set_worker(cache_clean_worker);
   }
+  snapshot_worker_ = cache_clean_worker;
+  RestoreLruSnapshot();
 
   GoogleString cache_flush_filename = options_->cache_flush_filename();
   if (cache_flush_filename.empty()) {
@@ -248,12 +282,99 @@ GoogleString SystemCachePath::LockManagerSegmentName() const {
   return StrCat(path_, "/named_locks");
 }
 
+GoogleString SystemCachePath::LruSnapshotFilename() const {
+  StringPiece path(options_->file_cache_path());
+  return StrCat(path, path.ends_with("/") ? "" : "/", kLruSnapshotName);
+}
+
+void SystemCachePath::RestoreLruSnapshot() {
+  if ((lru_cache_backend_ == NULL) ||
+      (options_->lru_cache_snapshot_interval_sec() < 0)) {
+    return;
+  }
+  Timer* timer = factory_->timer();
+  int64 start_ms = timer->NowMs();
+  int64 interval_ms =
+      options_->lru_cache_snapshot_interval_sec() * Timer::kSecondMs;
+  if (interval_ms > 0) {
+    ScopedMutex lock(mutex_.get());
+    next_lru_snapshot_ms_ = start_ms + interval_ms;
+  }
+
+  // There is no snapshot on the very first start, so don't complain if the
+  // file is missing.
+  GoogleString filename = LruSnapshotFilename();
+  GoogleString image;
+  NullMessageHandler null_handler;
+  if (!factory_->file_system()->ReadFile(filename.c_str(), &image,
+                                         &null_handler)) {
+    return;
+  }
+  CacheSnapshotReader reader(image);
+  if (!reader.valid()) {
+    factory_->message_handler()->Message(
+        kWarning, "Ignoring unreadable LRU cache snapshot %s",
+        filename.c_str());
+    return;
+  }
+  int num_entries;
+  {
+    ScopedMutex lock(lru_mutex_);
+    num_entries = lru_cache_backend_->RestoreSnapshot(&reader);
+  }
+  Statistics* statistics = factory_->statistics();
+  statistics->GetVariable(kLruSnapshotEntriesRestored)->Add(num_entries);
+  statistics->GetVariable(kLruSnapshotRestoreMs)->Add(
+      timer->NowMs() - start_ms);
+}
+
+void SystemCachePath::WriteLruSnapshot() {
+  // snapshot_worker_ is only set once ChildInit has run, so this skips
+  // unplugged paths, which never serve requests.
+  if ((lru_cache_backend_ == NULL) || (snapshot_worker_ == NULL) ||
+      (options_->lru_cache_snapshot_interval_sec() < 0)) {
+    return;
+  }
+  // The image is built under the lock, but written out after releasing it
+  // so that lookups are only held up for the copy.
+  CacheSnapshotWriter snapshot;
+  {
+    ScopedMutex lock(lru_mutex_);
+    lru_cache_backend_->AddToSnapshot(&snapshot);
+  }
+  if (factory_->file_system()->WriteFileAtomic(
+          LruSnapshotFilename(), snapshot.image(),
+          factory_->message_handler())) {
+    factory_->statistics()->GetVariable(kLruSnapshotsWritten)->Add(1);
+  }
+}
+
 void SystemCachePath::FlushCacheIfNecessary() {
   if (options_->enabled()) {
     purge_context_->PollFileSystem();
   }
 }
 
+void SystemCachePath::MaybeWriteLruSnapshot() {
+  int64 interval_ms =
+      options_->lru_cache_snapshot_interval_sec() * Timer::kSecondMs;
+  if ((interval_ms > 0) && (snapshot_worker_ != NULL)) {
+    int64 now_ms = factory_->timer()->NowMs();
+    bool write_snapshot = false;
+    {
+      ScopedMutex lock(mutex_.get());
+      if (now_ms >= next_lru_snapshot_ms_) {
+        next_lru_snapshot_ms_ = now_ms + interval_ms;
+        write_snapshot = true;
+      }
+    }
+    if (write_snapshot) {
+      snapshot_worker_->RunIfNotBusy(
+          MakeFunction(this, &SystemCachePath::WriteLruSnapshot));
+    }
+  }
+}
+
 void SystemCachePath::AddServerContext(SystemServerContext* server_context) {
   ScopedMutex lock(mutex_.get());
   server_context_set_.insert(server_context);
@@ -33,6 +33,7 @@ class AbstractSharedMem;
 class CacheInterface;
 class FileCache;
 class FileSystemLockManager;
+class LRUCache;
 class MessageHandler;
 class NamedLockManager;
 class PurgeContext;
@@ -40,6 +41,7 @@ class PurgeSet;
 class RewriteDriverFactory;
 class SharedMemLockManager;
 class SlowWorker;
+class Statistics;
 class SystemServerContext;
 class SystemRewriteOptions;
 
@@ -52,12 +54,19 @@ class SystemCachePath {
   static const char kFileCache[];
   static const char kLruCache[];
 
+  // Statistics for LRU cache snapshots.
+  static const char kLruSnapshotEntriesRestored[];
+  static const char kLruSnapshotRestoreMs[];
+  static const char kLruSnapshotsWritten[];
+
   SystemCachePath(const StringPiece& path,
                   const SystemRewriteOptions* config,
                   RewriteDriverFactory* factory,
                   AbstractSharedMem* shm_runtime);
   ~SystemCachePath();
 
+  static void InitStats(Statistics* statistics);
+
   // Per-process in-memory LRU, with any stats/thread safety wrappers, or NULL.
   CacheInterface* lru_cache() { return lru_cache_; }
 
@@ -92,6 +101,15 @@ class SystemCachePath {
   // the EnableCachePurge method is set.
   void FlushCacheIfNecessary();
 
+  // Writes the contents of the per-process LRU cache to the file cache path,
+  // if LRUCacheSnapshotIntervalSec is enabled, so that the next process to
+  // start up with this path begins with a warm cache.  Called on shutdown.
+  void WriteLruSnapshot();
+
+  // Starts a WriteLruSnapshot on the cache-cleaning worker if a periodic
+  // snapshot is due.  Called on every request, so cheap when it is not.
+  void MaybeWriteLruSnapshot();
+
   PurgeContext* purge_context() { return purge_context_.get(); }
 
  private:
@@ -99,6 +117,8 @@ class SystemCachePath {
 
   void FallBackToFileBasedLocking();
   GoogleString LockManagerSegmentName() const;
+  GoogleString LruSnapshotFilename() const;
+  void RestoreLruSnapshot();
 
   // Merge a value taken from a config file against the value already
   // initialized in a cache policy, reporting a Warning if they were
@@ -133,6 +153,8 @@ class SystemCachePath {
   NamedLockManager* lock_manager_;
   FileCache* file_cache_backend_;  // owned by file_cache_
   CacheInterface* lru_cache_;
+  LRUCache* lru_cache_backend_;  // owned by factory_
+  AbstractMutex* lru_mutex_;     // owned by lru_cache_
   CacheInterface* file_cache_;
   bool clean_interval_explicitly_set_;
   bool clean_size_explicitly_set_;
@@ -143,6 +165,10 @@ class SystemCachePath {
 
   scoped_ptr<AbstractMutex> mutex_;
   ServerContextSet server_context_set_ GUARDED_BY(mutex_);
+
+  // Periodic LRU snapshots are written on the cache-cleaning worker.
+  SlowWorker* snapshot_worker_;
+  int64 next_lru_snapshot_ms_ GUARDED_BY(mutex_);
 };
 
 // CACHE_STATISTICS is #ifdef'd to facilitate experiments with whether
@@ -88,6 +88,13 @@ void SystemCaches::ShutDown(MessageHandler* message_handler) {
   // to access FileCache and similar objects we're about to blow away.
   if (!is_root_process_) {
     slow_worker_->ShutDown();
+
+    // Now that no periodic snapshot can be in progress, save the LRU caches
+    // for the next process to start from.
+    for (PathCacheMap::iterator p = path_cache_map_.begin(),
+             e = path_cache_map_.end(); p != e; ++p) {
+      p->second->WriteLruSnapshot();
+    }
   }
 
   // Take down any memcached threads.  Note that this may block
@@ -337,6 +344,14 @@ void SystemCaches::SetupPcacheCohorts(ServerContext* server_context,
 
   cohort = server_context->AddCohort(RewriteDriver::kDomCohort, pcache);
   server_context->set_dom_cohort(cohort);
+
+  // Every cohort costs a cache lookup per page, so this one is only added
+  // where it will be used.
+  if (server_context->global_options()->adaptive_rewrite_deadline()) {
+    cohort = server_context->AddCohort(
+        RewriteDriver::kAdaptiveRewriteDeadlineCohort, pcache);
+    server_context->set_adaptive_rewrite_deadline_cohort(cohort);
+  }
 }
 
 void SystemCaches::SetupCaches(ServerContext* server_context,
@@ -619,6 +634,7 @@ void SystemCaches::InitStats(Statistics* statistics) {
   CacheStats::InitStats(kMemcachedBlocking, statistics);
   CompressedCache::InitStats(statistics);
   PurgeContext::InitStats(statistics);
+  SystemCachePath::InitStats(statistics);
 }
 
 void SystemCaches::PrintCacheStats(StatFlags flags, GoogleString* out) {
@@ -980,6 +980,40 @@ TEST_F(SystemCachesTest, LruCacheSettings) {
   EXPECT_EQ(500, http_write_through->cache1_limit());
 }
 
+TEST_F(SystemCachesTest, LruCacheSnapshot) {
+  options_->set_file_cache_path(kCachePath);
+  options_->set_use_shared_mem_locking(false);
+  options_->set_lru_cache_kb_per_process(100);
+  options_->set_lru_cache_snapshot_interval_sec(0);
+  options_->set_default_shared_memory_cache_kb(0);
+  PrepareWithConfig(options_.get());
+
+  SystemCachePath* cache_path = system_caches_->GetCache(options_.get());
+  SharedString value("value");
+  cache_path->lru_cache()->Put("key", &value);
+  cache_path->WriteLruSnapshot();
+  EXPECT_EQ(1, statistics()->GetVariable(
+      SystemCachePath::kLruSnapshotsWritten)->Get());
+
+  // A process starting up on the same path begins with the saved entry.
+  SystemCaches restarted(factory(), shared_mem_.get(), kThreadLimit);
+  restarted.RegisterConfig(options_.get());
+  restarted.RootInit();
+  restarted.ChildInit();
+  LRUCache* lru_cache = dynamic_cast<LRUCache*>(
+      SkipWrappers(restarted.GetCache(options_.get())->lru_cache()));
+  ASSERT_TRUE(lru_cache != NULL);
+  EXPECT_EQ(static_cast<size_t>(1), lru_cache->num_elements());
+  EXPECT_EQ(1, statistics()->GetVariable(
+      SystemCachePath::kLruSnapshotEntriesRestored)->Get());
+
+  // Shutting down saves a fresh snapshot.
+  restarted.StopCacheActivity();
+  restarted.ShutDown(factory()->message_handler());
+  EXPECT_EQ(2, statistics()->GetVariable(
+      SystemCachePath::kLruSnapshotsWritten)->Get());
+}
+
 TEST_F(SystemCachesTest, StatsStringMinimal) {
   // The format is rather dependent on the implementation so we don't check it,
   // but we do care that it at least doesn't crash.
@@ -35,6 +35,7 @@
 #include "net/instaweb/rewriter/public/static_asset_manager.h"
 #include "pagespeed/system/in_place_resource_recorder.h"
 #include "pagespeed/system/serf_url_async_fetcher.h"
+#include "pagespeed/system/span_trace_buffer.h"
 #include "pagespeed/system/system_caches.h"
 #include "pagespeed/system/system_rewrite_options.h"
 #include "pagespeed/system/system_server_context.h"
@@ -77,7 +78,10 @@ const char kNumExpensiveRewriteThreads[] = "NumExpensiveRewriteThreads";
 const char kForceCaching[] = "ForceCaching";
 const char kListOutstandingUrlsOnError[] = "ListOutstandingUrlsOnError";
 const char kMessageBufferSize[] = "MessageBufferSize";
+const char kSpanTraceBufferSize[] = "SpanTraceBufferSize";
+const char kSpanTraceSamplePercent[] = "SpanTraceSamplePercent";
 const char kTrackOriginalContentLength[] = "TrackOriginalContentLength";
+const char kTrackFilterCosts[] = "TrackFilterCosts";
 const char kCreateSharedMemoryMetadataCache[] =
     "CreateSharedMemoryMetadataCache";
 
@@ -93,7 +97,10 @@ SystemRewriteDriverFactory::SystemRewriteDriverFactory(
       is_root_process_(true),
       hostname_identifier_(StrCat(hostname, ":", IntegerToString(port))),
       message_buffer_size_(0),
+      span_trace_buffer_size_(0),
+      span_trace_sample_percent_(0),
       track_original_content_length_(false),
+      track_filter_costs_(false),
       list_outstanding_urls_on_error_(false),
       static_asset_prefix_("/pagespeed_static/"),
       system_thread_system_(thread_system),
@@ -191,8 +198,11 @@ void SystemRewriteDriverFactory::InitStats(Statistics* statistics) {
   SystemCaches::InitStats(statistics);
   PropertyCache::InitCohortStats(RewriteDriver::kBeaconCohort, statistics);
   PropertyCache::InitCohortStats(RewriteDriver::kDomCohort, statistics);
+  PropertyCache::InitCohortStats(
+      RewriteDriver::kAdaptiveRewriteDeadlineCohort, statistics);
   InPlaceResourceRecorder::InitStats(statistics);
   RateController::InitStats(statistics);
+  SpanTraceBuffer::InitStats(statistics);
 
   statistics->AddVariable(kShutdownCount);
 }
@@ -267,6 +277,11 @@ void SystemRewriteDriverFactory::ChildInit() {
 
   caches_->ChildInit();
 
+  if (span_trace_shared_buffer_.get() != NULL) {
+    span_trace_buffer_.reset(new SpanTraceBuffer(
+        span_trace_shared_buffer_.get(), statistics()));
+  }
+
   // Static asset config is process-global.
   const SystemRewriteOptions* conf =
       SystemRewriteOptions::DynamicCast(default_options());
@@ -306,6 +321,17 @@ void SystemRewriteDriverFactory::SharedCircularBufferInit(bool is_root) {
       SetCircularBuffer(shared_circular_buffer_.get());
      }
   }
+  if (shared_mem_runtime() != NULL && (span_trace_buffer_size_ != 0) &&
+      (span_trace_sample_percent_ != 0)) {
+    span_trace_shared_buffer_.reset(new SharedCircularBuffer(
+        shared_mem_runtime(),
+        span_trace_buffer_size_,
+        filename_prefix().as_string(),
+        StrCat(hostname_identifier(), ".span_trace")));
+    if (!span_trace_shared_buffer_->InitSegment(is_root, message_handler())) {
+      span_trace_shared_buffer_.reset(NULL);
+    }
+  }
 }
 
 RewriteOptions::OptionSettingResult
@@ -327,7 +353,10 @@ SystemRewriteDriverFactory::ParseAndSetOption1(StringPiece option,
   } else if (StringCaseEqual(option, kForceCaching) ||
              StringCaseEqual(option, kListOutstandingUrlsOnError) ||
              StringCaseEqual(option, kMessageBufferSize) ||
-             StringCaseEqual(option, kTrackOriginalContentLength)) {
+             StringCaseEqual(option, kSpanTraceBufferSize) ||
+             StringCaseEqual(option, kSpanTraceSamplePercent) ||
+             StringCaseEqual(option, kTrackOriginalContentLength) ||
+             StringCaseEqual(option, kTrackFilterCosts)) {
     if (!process_scope) {
       // msg is only printed to the user on error, so warnings must be logged.
       handler->Message(
@@ -367,6 +396,9 @@ SystemRewriteDriverFactory::ParseAndSetOption1(StringPiece option,
   } else if (StringCaseEqual(option, kTrackOriginalContentLength)) {
     set_track_original_content_length(is_on);
     return parsed_as_bool;
+  } else if (StringCaseEqual(option, kTrackFilterCosts)) {
+    set_track_filter_costs(is_on);
+    return parsed_as_bool;
   }
 
   // Others take a positive integer.
@@ -383,6 +415,18 @@ SystemRewriteDriverFactory::ParseAndSetOption1(StringPiece option,
   } else if (StringCaseEqual(option, kMessageBufferSize)) {
     set_message_buffer_size(int_value);
     return parsed_as_int;
+  } else if (StringCaseEqual(option, kSpanTraceBufferSize)) {
+    set_span_trace_buffer_size(int_value);
+    return parsed_as_int;
+  } else if (StringCaseEqual(option, kSpanTraceSamplePercent)) {
+    // Unlike the sizes above, 0 is valid here: it turns sampling off.
+    if (!RewriteOptions::ParseFromString(arg, &int_value) ||
+        int_value < 0 || int_value > 100) {
+      *msg = "must be a percentage between 0 and 100";
+      return RewriteOptions::kOptionValueInvalid;
+    }
+    set_span_trace_sample_percent(int_value);
+    return RewriteOptions::kOptionOk;
   }
 
   LOG(FATAL) << "Unknown options should have been handled in scope checking.";
@@ -509,6 +553,9 @@ void SystemRewriteDriverFactory::ShutDown() {
     if (shared_circular_buffer_ != NULL) {
       shared_circular_buffer_->GlobalCleanup(&handler);
     }
+    if (span_trace_shared_buffer_ != NULL) {
+      span_trace_shared_buffer_->GlobalCleanup(&handler);
+    }
   }
 }
 
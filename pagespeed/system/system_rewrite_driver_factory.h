@@ -41,6 +41,7 @@ class QueuedWorkerPool;
 class ServerContext;
 class SharedCircularBuffer;
 class SharedMemStatistics;
+class SpanTraceBuffer;
 class StaticAssetManager;
 class Statistics;
 class SystemCaches;
@@ -184,6 +185,17 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
     message_buffer_size_ = x;
   }
 
+  // Size of the shared buffer holding recent request traces, and the
+  // percentage of HTML requests traced into it.  Tracing is off unless both
+  // are set.
+  void set_span_trace_buffer_size(int x) { span_trace_buffer_size_ = x; }
+  void set_span_trace_sample_percent(int x) { span_trace_sample_percent_ = x; }
+  int span_trace_sample_percent() const { return span_trace_sample_percent_; }
+
+  // The sink for sampled request traces, or NULL if tracing is off.  Only
+  // available after ChildInit.
+  SpanTraceBuffer* span_trace_buffer() { return span_trace_buffer_.get(); }
+
   // Finds a fetcher for the settings in this config, sharing with
   // existing fetchers if possible, otherwise making a new one (and
   // its required thread).
@@ -198,6 +210,11 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
     return track_original_content_length_;
   }
 
+  // Accumulates the CPU and wall time of each HTML filter and resource
+  // rewriter, shown on the statistics admin page.
+  void set_track_filter_costs(bool x) { track_filter_costs_ = x; }
+  bool track_filter_costs() const { return track_filter_costs_; }
+
   // When Serf gets a system error during polling, to avoid spamming
   // the log we just print the number of outstanding fetch URLs.  To
   // debug this it's useful to print the complete set of URLs, in
@@ -329,6 +346,8 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
   StringVector local_shm_stats_segment_names_;
   scoped_ptr<AbstractSharedMem> shared_mem_runtime_;
   scoped_ptr<SharedCircularBuffer> shared_circular_buffer_;
+  scoped_ptr<SharedCircularBuffer> span_trace_shared_buffer_;
+  scoped_ptr<SpanTraceBuffer> span_trace_buffer_;
 
   bool statistics_frozen_;
   bool is_root_process_;
@@ -342,10 +361,16 @@ class SystemRewriteDriverFactory : public RewriteDriverFactory {
   // /pagespeed_messages (or /mod_pagespeed_messages, /ngx_pagespeed_messages)
   int message_buffer_size_;
 
+  // Size of the shared circular buffer of request traces shown in the
+  // trace admin page, and the percentage of HTML requests to trace.
+  int span_trace_buffer_size_;
+  int span_trace_sample_percent_;
+
   // Manages all our caches & lock managers.
   scoped_ptr<SystemCaches> caches_;
 
   bool track_original_content_length_;
+  bool track_filter_costs_;
   bool list_outstanding_urls_on_error_;
 
   // Fetchers are expensive--they each cost a thread.  Instead of allocating one
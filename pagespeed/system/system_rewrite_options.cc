@@ -146,6 +146,12 @@ void SystemRewriteOptions::AddProperties() {
                     RewriteOptions::kLruCacheKbPerProcess,
                     "Set the total size, in KB, of the per-process in-memory "
                         "LRU cache", true);
+  AddSystemProperty(-1, &SystemRewriteOptions::lru_cache_snapshot_interval_sec_,
+                    "alcs", RewriteOptions::kLruCacheSnapshotIntervalSec,
+                    "Save the per-process in-memory LRU cache to the file "
+                        "cache path every this many seconds and on shutdown, "
+                        "and reload it on startup.  0 saves only on "
+                        "shutdown; -1 disables snapshots", true);
   AddSystemProperty("", &SystemRewriteOptions::cache_flush_filename_, "acff",
                     RewriteOptions::kCacheFlushFilename,
                     "Name of file to check for timestamp updates used to flush "
@@ -85,6 +85,12 @@ class SystemRewriteOptions : public RewriteOptions {
   void set_lru_cache_kb_per_process(int64 x) {
     set_option(x, &lru_cache_kb_per_process_);
   }
+  int64 lru_cache_snapshot_interval_sec() const {
+    return lru_cache_snapshot_interval_sec_.value();
+  }
+  void set_lru_cache_snapshot_interval_sec(int64 x) {
+    set_option(x, &lru_cache_snapshot_interval_sec_);
+  }
   bool use_shared_mem_locking() const {
     return use_shared_mem_locking_.value();
   }
@@ -397,6 +403,7 @@ class SystemRewriteOptions : public RewriteOptions {
   Option<int64> file_cache_clean_size_kb_;
   Option<int64> lru_cache_byte_limit_;
   Option<int64> lru_cache_kb_per_process_;
+  Option<int64> lru_cache_snapshot_interval_sec_;
   Option<int64> statistics_logging_interval_ms_;
   // If cache_flush_poll_interval_sec_<=0 then we turn off polling for
   // cache-flushes.
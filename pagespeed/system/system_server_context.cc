@@ -25,6 +25,7 @@
 #include "net/instaweb/rewriter/public/rewrite_stats.h"
 #include "pagespeed/system/add_headers_fetcher.h"
 #include "pagespeed/system/loopback_route_fetcher.h"
+#include "pagespeed/system/span_trace_buffer.h"
 #include "pagespeed/system/system_cache_path.h"
 #include "pagespeed/system/system_caches.h"
 #include "pagespeed/system/system_request_context.h"
@@ -39,6 +40,7 @@
 #include "pagespeed/kernel/base/string.h"
 #include "pagespeed/kernel/base/thread_system.h"
 #include "pagespeed/kernel/base/timer.h"
+#include "pagespeed/kernel/http/query_params.h"
 #include "pagespeed/kernel/sharedmem/shared_mem_statistics.h"
 
 namespace net_instaweb {
@@ -68,7 +70,8 @@ SystemServerContext::SystemServerContext(
       local_statistics_(NULL),
       hostname_identifier_(StrCat(hostname, ":", IntegerToString(port))),
       system_caches_(NULL),
-      cache_path_(NULL) {
+      cache_path_(NULL),
+      span_trace_buffer_(NULL) {
   global_system_rewrite_options()->set_description(hostname_identifier_);
 }
 
@@ -87,13 +90,17 @@ void SystemServerContext::SetCachePath(SystemCachePath* cache_path) {
 // If we haven't checked the timestamp of $FILE_PREFIX/cache.flush in the past
 // cache_flush_poll_interval_sec_ seconds do so, and if the timestamp has
 // expired then update the cache_invalidation_timestamp in global_options,
-// thus flushing the cache.
+// thus flushing the cache.  Also writes a periodic snapshot of the LRU cache
+// when one is due.
 void SystemServerContext::FlushCacheIfNecessary() {
   if (global_system_rewrite_options()->enable_cache_purge()) {
     cache_path_->FlushCacheIfNecessary();
   } else {
     CheckLegacyGlobalCacheFlushFile();
   }
+  if (cache_path_ != NULL) {
+    cache_path_->MaybeWriteLruSnapshot();
+  }
 }
 
 void SystemServerContext::CheckLegacyGlobalCacheFlushFile() {
@@ -283,7 +290,13 @@ void SystemServerContext::ChildInit(SystemRewriteDriverFactory* factory) {
     // an optional read/writer lock for this purpose.
     global_options()->set_cache_invalidation_timestamp_mutex(
         thread_system()->NewRWLock());
+    if (factory->track_filter_costs()) {
+      EnableCostTracking();
+    }
     factory->InitServerContext(this);
+    span_trace_buffer_ = factory->span_trace_buffer();
+    set_span_trace_sink(span_trace_buffer_,
+                        factory->span_trace_sample_percent());
 
     html_rewrite_time_us_histogram_ = statistics()->GetHistogram(
         kHtmlRewriteTimeUsHistogram);
@@ -360,13 +373,15 @@ void SystemServerContext::StatisticsHandler(
     const RewriteOptions& options,
     bool is_global_request,
     AdminSite::AdminSource source,
+    const QueryParams& query_params,
     AsyncFetch* fetch) {
   if (!use_per_vhost_statistics_) {
     is_global_request = true;
   }
   Statistics* stats = is_global_request ? factory()->statistics()
       : statistics();
-  admin_site_->StatisticsHandler(options, source, fetch, stats);
+  admin_site_->StatisticsHandler(options, source, query_params, this,
+                                 fetch, stats);
 }
 
 void SystemServerContext::ConsoleJsonHandler(
@@ -426,7 +441,7 @@ void SystemServerContext::AdminPage(
                          filesystem_metadata_cache(), http_cache(),
                          metadata_cache(), page_property_cache(), this,
                          statistics(), stats,  global_system_rewrite_options(),
-                         spdy_config);
+                         spdy_config, span_trace_buffer_);
 }
 
 void SystemServerContext::StatisticsPage(bool is_global,
@@ -40,6 +40,7 @@ class RewriteDriverFactory;
 class RewriteOptions;
 class RewriteStats;
 class SharedMemStatistics;
+class SpanTraceBuffer;
 class Statistics;
 class SystemCachePath;
 class SystemCaches;
@@ -188,7 +189,8 @@ class SystemServerContext : public ServerContext {
   // Handler for /mod_pagespeed_statistics and
   // /ngx_pagespeed_statistics, as well as
   // /...pagespeed__global_statistics.  If the latter,
-  // is_global_request should be true.
+  // is_global_request should be true.  query_params are the request's, which
+  // may choose how the filter cost tables are sorted.
   //
   // Returns NULL on success, otherwise the returned error string
   // should be passed along to the user and the contents of writer and
@@ -197,7 +199,8 @@ class SystemServerContext : public ServerContext {
   // In systems without a spdy-specific config, spdy_config should be
   // null.
   void StatisticsHandler(const RewriteOptions& options, bool is_global_request,
-                         AdminSite::AdminSource source, AsyncFetch* fetch);
+                         AdminSite::AdminSource source,
+                         const QueryParams& query_params, AsyncFetch* fetch);
 
   // Print details fo the SPDY configuration.
   void PrintSpdyConfig(AdminSite::AdminSource source, AsyncFetch* fetch);
@@ -267,6 +270,10 @@ class SystemServerContext : public ServerContext {
 
   SystemCachePath* cache_path_;
 
+  // Recent sampled request traces, shown by the admin site; owned by the
+  // factory, and NULL when tracing is off.
+  SpanTraceBuffer* span_trace_buffer_;
+
   DISALLOW_COPY_AND_ASSIGN(SystemServerContext);
 };
 
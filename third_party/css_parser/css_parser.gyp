@@ -83,6 +83,8 @@
       'cflags': ['-funsigned-char', '-Wno-sign-compare', '-Wno-return-type'],
       'sources': [
         '<(css_parser_root)/string_using.h',
+        '<(css_parser_root)/webutil/css/arena.cc',
+        '<(css_parser_root)/webutil/css/arena.h',
         '<(css_parser_root)/webutil/css/identifier.cc',
         '<(css_parser_root)/webutil/css/identifier.h',
         '<(css_parser_root)/webutil/css/media.cc',
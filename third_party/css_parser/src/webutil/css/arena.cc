@@ -0,0 +1,99 @@
+/**
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "webutil/css/arena.h"
+
+#include <new>
+
+namespace Css {
+
+namespace {
+
+// Every ArenaAllocated node is preceded by a header recording the arena it
+// lives in, or NULL if it lives on the heap.
+union NodeHeader {
+  Arena* arena;
+  double align;  // Keeps the node which follows suitably aligned.
+};
+
+NodeHeader* HeaderOf(void* p) {
+  return static_cast<NodeHeader*>(p) - 1;
+}
+
+}  // namespace
+
+Arena::Arena()
+    : next_(NULL),
+      end_(NULL),
+      num_allocations_(0),
+      bytes_allocated_(0) {
+}
+
+Arena::~Arena() {
+  for (int i = 0, n = blocks_.size(); i < n; ++i) {
+    delete[] blocks_[i];
+  }
+}
+
+void* Arena::Allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  ++num_allocations_;
+  bytes_allocated_ += size;
+  if (size > kBlockSize / 4) {
+    // Big allocations get a block of their own, so they don't waste the
+    // rest of the current one.
+    char* block = new char[size];
+    blocks_.push_back(block);
+    return block;
+  }
+  if (static_cast<size_t>(end_ - next_) < size) {
+    next_ = new char[kBlockSize];
+    end_ = next_ + kBlockSize;
+    blocks_.push_back(next_);
+  }
+  void* result = next_;
+  next_ += size;
+  return result;
+}
+
+void* ArenaAllocated::operator new(size_t size) {
+  return operator new(size, static_cast<Arena*>(NULL));
+}
+
+void* ArenaAllocated::operator new(size_t size, Arena* arena) {
+  size += sizeof(NodeHeader);
+  NodeHeader* header = static_cast<NodeHeader*>(
+      (arena == NULL) ? ::operator new(size) : arena->Allocate(size));
+  header->arena = arena;
+  return header + 1;
+}
+
+void ArenaAllocated::operator delete(void* p) {
+  if (p == NULL) {
+    return;
+  }
+  NodeHeader* header = HeaderOf(p);
+  if (header->arena == NULL) {
+    ::operator delete(header);
+  }
+  // Otherwise the memory goes back when the arena is destroyed.
+}
+
+void ArenaAllocated::operator delete(void* p, Arena* arena) {
+  operator delete(p);
+}
+
+}  // namespace Css
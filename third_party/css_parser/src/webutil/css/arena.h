@@ -0,0 +1,80 @@
+/**
+ * Copyright 2015 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WEBUTIL_CSS_ARENA_H__
+#define WEBUTIL_CSS_ARENA_H__
+
+#include <cstddef>
+#include <vector>
+
+#include "base/css_macros.h"
+
+namespace Css {
+
+// A bump allocator for parse trees.  Memory is carved out of large blocks
+// and is only returned to the system, all at once, when the Arena is
+// destroyed.  A stylesheet has thousands of small nodes, nearly all of
+// which are freed together when the stylesheet goes away, so this saves a
+// malloc and a free per node.
+//
+// Not thread-safe.
+class Arena {
+ public:
+  Arena();
+  ~Arena();
+
+  // Returns size bytes, suitably aligned for any parse-tree node.
+  void* Allocate(size_t size);
+
+  // Number of Allocate() calls and bytes handed out so far.
+  int num_allocations() const { return num_allocations_; }
+  size_t bytes_allocated() const { return bytes_allocated_; }
+  int num_blocks() const { return blocks_.size(); }
+
+ private:
+  static const size_t kBlockSize = 32 * 1024;
+  static const size_t kAlignment = 8;
+
+  std::vector<char*> blocks_;
+  char* next_;  // Next free byte in the current block.
+  char* end_;   // End of the current block.
+  int num_allocations_;
+  size_t bytes_allocated_;
+
+  DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// Base class for parse-tree nodes which may be allocated in an Arena.
+//
+// new (arena) T(...) places the node in arena, or on the heap if arena is
+// NULL.  Plain new T(...) always uses the heap.  Either way, nodes are
+// freed with delete as usual: deleting a node that lives in an arena runs
+// its destructor, and the arena reclaims its memory when the arena itself
+// is destroyed.  So trees may freely mix arena and heap nodes, e.g. when a
+// rewriter replaces a parsed value with a new one, but the arena must
+// outlive every node allocated in it.
+class ArenaAllocated {
+ public:
+  static void* operator new(size_t size);
+  static void* operator new(size_t size, Arena* arena);
+  static void operator delete(void* p);
+  // Only called if a constructor throws.
+  static void operator delete(void* p, Arena* arena);
+};
+
+}  // namespace Css
+
+#endif  // WEBUTIL_CSS_ARENA_H__
@@ -79,6 +79,7 @@ Parser::Parser(const char* utf8text, const char* textend)
       end_(textend),
       quirks_mode_(true),
       preservation_mode_(false),
+      arena_(NULL),
       max_function_depth_(kDefaultMaxFunctionDepth),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
@@ -90,6 +91,7 @@ Parser::Parser(const char* utf8text)
       end_(utf8text + strlen(utf8text)),
       quirks_mode_(true),
       preservation_mode_(false),
+      arena_(NULL),
       max_function_depth_(kDefaultMaxFunctionDepth),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
@@ -101,6 +103,7 @@ Parser::Parser(StringPiece s)
       end_(s.end()),
       quirks_mode_(true),
       preservation_mode_(false),
+      arena_(NULL),
       max_function_depth_(kDefaultMaxFunctionDepth),
       errors_seen_mask_(kNoError),
       unparseable_sections_seen_mask_(kNoError) {
@@ -626,16 +629,53 @@ Value* Parser::ParseStringValue() {
   Tracer trace(__func__, this);
 
   const char* oldin = in_;
-  UnicodeText string_contents = ParseString<delim>();
-  StringPiece verbatim_bytes(oldin, in_ - oldin);
-  Value* value = new Value(Value::STRING, string_contents);
+  Value* value = NULL;
+  if (arena_ != NULL) {
+    value = ParseUnescapedStringValue<delim>();
+  }
+  if (value == NULL) {
+    UnicodeText string_contents = ParseString<delim>();
+    value = new(arena_) Value(Value::STRING, string_contents);
+  }
   if (preservation_mode_) {
-    value->set_bytes_in_original_buffer(verbatim_bytes);
+    SetBytesInOriginalBuffer(StringPiece(oldin, in_ - oldin), value);
   }
 
   return value;
 }
 
+template <char delim>
+Value* Parser::ParseUnescapedStringValue() {
+  Tracer trace(__func__, this);
+
+  SkipSpace();
+  DCHECK_LT(in_, end_);
+  DCHECK_EQ(*in_, delim);
+  const char* begin = in_ + 1;
+  const char* end = begin;
+  // Non-ASCII bytes are left to ParseString, which validates them.
+  while (end < end_ && *end != delim && *end != '\\' && *end != '\n' &&
+         IsAscii(*end)) {
+    end++;
+  }
+  if (end == end_ || *end != delim) {
+    return NULL;
+  }
+  in_ = end + 1;
+  Value* value = new(arena_) Value(Value::STRING, UnicodeText());
+  value->alias_string_value(StringPiece(begin, end - begin));
+  return value;
+}
+
+void Parser::SetBytesInOriginalBuffer(const StringPiece& verbatim,
+                                      Value* value) {
+  if (arena_ != NULL) {
+    value->alias_bytes_in_original_buffer(verbatim);
+  } else {
+    value->set_bytes_in_original_buffer(verbatim);
+  }
+}
+
 // Parse a CSS number, including unit or percent sign.
 Value* Parser::ParseNumber() {
   Tracer trace(__func__, this);
@@ -673,20 +713,20 @@ Value* Parser::ParseNumber() {
   StringPiece verbatim_bytes(begin, in_ - begin);
   Value* value;
   if (Done()) {
-    value = new Value(num, Value::NO_UNIT);
+    value = new(arena_) Value(num, Value::NO_UNIT);
   } else if (*in_ == '%') {
     in_++;
-    value = new Value(num, Value::PERCENT);
+    value = new(arena_) Value(num, Value::PERCENT);
   } else if (StartsIdent(*in_)) {
-    value = new Value(num, ParseIdent());
+    value = new(arena_) Value(num, ParseIdent());
   } else {
-    value = new Value(num, Value::NO_UNIT);
+    value = new(arena_) Value(num, Value::NO_UNIT);
   }
 
   if (preservation_mode_) {
     // Store verbatim bytes so that we can reconstruct this with exactly the
     // same precision.
-    value->set_bytes_in_original_buffer(verbatim_bytes);
+    SetBytesInOriginalBuffer(verbatim_bytes, value);
   }
 
   return value;
@@ -792,7 +832,7 @@ HtmlColor Parser::ParseColor() {
 // Both commas and spaces are allowed as separators and are remembered.
 FunctionParameters* Parser::ParseFunction(int max_function_depth) {
   Tracer trace(__func__, this);
-  scoped_ptr<FunctionParameters> params(new FunctionParameters);
+  scoped_ptr<FunctionParameters> params(new(arena_) FunctionParameters);
 
   SkipSpace();
   // Separator before next value. Initial value doesn't matter.
@@ -887,7 +927,7 @@ Value* Parser::ParseRgbColor() {
       break;
 
     if (*in_ == ')')
-      return new Value(HtmlColor(rgb[0], rgb[1], rgb[2]));
+      return new(arena_) Value(HtmlColor(rgb[0], rgb[1], rgb[2]));
 
     DCHECK_EQ(',', *in_);
     in_++;
@@ -935,7 +975,7 @@ Value* Parser::ParseUrl() {
   }
   SkipSpace();
   if (!Done() && *in_ == ')')
-    return new Value(Value::URI, s);
+    return new(arena_) Value(Value::URI, s);
 
   return NULL;
 }
@@ -951,7 +991,7 @@ Value* Parser::ParseAnyExpectingColor() {
   const char* oldin = in_;
   HtmlColor c = ParseColor();
   if (c.IsDefined()) {
-    toret = new Value(c);
+    toret = new(arena_) Value(c);
   } else {
     in_ = oldin;  // no valid color.  rollback.
     toret = ParseAny();
@@ -1006,14 +1046,14 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
     case '#': {
       HtmlColor color = ParseColor();
       if (color.IsDefined())
-        toret = new Value(color);
+        toret = new(arena_) Value(color);
       else
         toret = NULL;
       break;
     }
     case ',':
       // TODO(sligocki): Add other possible value tokens like DELIM.
-      toret = new Value(Value::COMMA);
+      toret = new(arena_) Value(Value::COMMA);
       in_++;
       break;
     case '+':
@@ -1042,7 +1082,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
             scoped_ptr<FunctionParameters> params(
                 ParseFunction(max_function_depth - 1));
             if (params.get() != NULL && params->size() == 4) {
-              toret = new Value(Value::RECT, params.release());
+              toret = new(arena_) Value(Value::RECT, params.release());
             } else {
               ReportParsingError(kFunctionError, "Could not parse parameters "
                                  "for function rect");
@@ -1051,7 +1091,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
             scoped_ptr<FunctionParameters> params(
                 ParseFunction(max_function_depth - 1));
             if (params.get() != NULL) {
-              toret = new Value(id, params.release());
+              toret = new(arena_) Value(id, params.release());
             } else {
               ReportParsingError(kFunctionError, StringPrintf(
                   "Could not parse function parameters for function %s",
@@ -1068,7 +1108,7 @@ Value* Parser::ParseAnyWithFunctionDepth(int max_function_depth) {
         }
         SkipPastDelimiter(')');
       } else {
-        toret = new Value(Identifier(id));
+        toret = new(arena_) Value(Identifier(id));
       }
       break;
     }
@@ -1111,13 +1151,13 @@ Values* Parser::ParseValues(Property::Prop prop) {
   Tracer trace(__func__, this);
 
   SkipSpace();
-  if (Done()) return new Values();
+  if (Done()) return new(arena_) Values();
   DCHECK_LT(in_, end_);
 
   // If expecting_color is true, color values are expected.
   bool expecting_color = IsPropExpectingColor(prop);
 
-  scoped_ptr<Values> values(new Values);
+  scoped_ptr<Values> values(new(arena_) Values);
   // Note: We skip over all blocks and at-keywords and only parse "any"s.
   //   value : [ any | block | ATKEYWORD S* ]+;
   // TODO(sligocki): According to the spec, if we cannot parse one of the
@@ -1366,7 +1406,7 @@ bool Parser::ParseFontFamily(Values* values) {
           family.push_back(static_cast<char32>(' '));
           family.append(v->GetIdentifierText());
         }
-        values->push_back(new Value(Identifier(family)));
+        values->push_back(new(arena_) Value(Identifier(family)));
         break;
       }
       default:
@@ -1400,7 +1440,7 @@ Values* Parser::ParseFont() {
   if (Done()) return NULL;
   DCHECK_LT(in_, end_);
 
-  scoped_ptr<Values> values(new Values);
+  scoped_ptr<Values> values(new(arena_) Values);
 
   if (!SkipToNextAny())
     return NULL;
@@ -1433,11 +1473,11 @@ Values* Parser::ParseFont() {
     }
   }
 
-  scoped_ptr<Value> font_style(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_variant(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_weight(new Value(Identifier::NORMAL));
-  scoped_ptr<Value> font_size(new Value(Identifier::MEDIUM));
-  scoped_ptr<Value> line_height(new Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_style(new(arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_variant(new(arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_weight(new(arena_) Value(Identifier::NORMAL));
+  scoped_ptr<Value> font_size(new(arena_) Value(Identifier::MEDIUM));
+  scoped_ptr<Value> line_height(new(arena_) Value(Identifier::NORMAL));
   scoped_ptr<Value> font_family;
 
   // parse style, variant and weight
@@ -1640,10 +1680,10 @@ Declarations* Parser::ParseRawDeclarations() {
   Tracer trace(__func__, this);
 
   SkipSpace();
-  if (Done()) return new Declarations();
+  if (Done()) return new(arena_) Declarations();
   DCHECK_LT(in_, end_);
 
-  Declarations* declarations = new Declarations();
+  Declarations* declarations = new(arena_) Declarations();
   while (in_ < end_) {
     // decl_start is saved so that we may pass through verbatim text
     // in case declaration could not be parsed correctly.
@@ -1683,7 +1723,7 @@ Declarations* Parser::ParseRawDeclarations() {
             vals.reset(ParseFont());
             break;
           case Property::FONT_FAMILY:
-            vals.reset(new Values());
+            vals.reset(new(arena_) Values());
             if (!ParseFontFamily(vals.get()) || vals->empty()) {
               vals.reset(NULL);
             }
@@ -1740,7 +1780,7 @@ Declarations* Parser::ParseRawDeclarations() {
         // For example: "foo: bar !important really;" is not valid.
         if (Done() || *in_ == ';' || *in_ == '}') {
           declarations->push_back(
-              new Declaration(prop, vals.release(), important));
+              new(arena_) Declaration(prop, vals.release(), important));
         } else {
           ReportParsingError(kDeclarationError, StringPrintf(
               "Unexpected char %c at end of declaration", *in_));
@@ -1769,7 +1809,8 @@ Declarations* Parser::ParseRawDeclarations() {
         // serialized back out in case it was actually meaningful even though
         // we could not understand it.
         StringPiece bytes_in_original_buffer(decl_start, in_ - decl_start);
-        declarations->push_back(new Declaration(bytes_in_original_buffer));
+        declarations->push_back(
+            new(arena_) Declaration(bytes_in_original_buffer));
         // All errors that occurred sinse we started this declaration are
         // demoted to unparseable sections now that we've saved the dummy
         // element.
@@ -1782,7 +1823,7 @@ Declarations* Parser::ParseRawDeclarations() {
 }
 
 Declarations* Parser::ExpandDeclarations(Declarations* orig_declarations) {
-  scoped_ptr<Declarations> new_declarations(new Declarations);
+  scoped_ptr<Declarations> new_declarations(new(arena_) Declarations);
   for (int j = 0; j < orig_declarations->size(); ++j) {
     // new_declarations takes ownership of declaration.
     Declaration* declaration = orig_declarations->at(j);
@@ -1970,7 +2011,7 @@ SimpleSelectors* Parser::ParseSimpleSelectors(bool expecting_combinator) {
     }
 
   scoped_ptr<SimpleSelectors> selectors(
-      new SimpleSelectors(combinator));
+      new(arena_) SimpleSelectors(combinator));
 
   SkipSpace();
   if (Done()) return NULL;
@@ -2001,8 +2042,8 @@ Selectors* Parser::ParseSelectors() {
   // selectors.
   bool success = true;
 
-  scoped_ptr<Selectors> selectors(new Selectors());
-  Selector* selector = new Selector();
+  scoped_ptr<Selectors> selectors(new(arena_) Selectors());
+  Selector* selector = new(arena_) Selector();
   selectors->push_back(selector);
 
   // The first simple selector sequence in a chain of simple selector
@@ -2018,7 +2059,7 @@ Selectors* Parser::ParseSelectors() {
           ReportParsingError(kSelectorError,
                              "Could not parse ruleset: unexpected ,");
         } else {
-          selector = new Selector();
+          selector = new(arena_) Selector();
           selectors->push_back(selector);
         }
         in_++;
@@ -2157,7 +2198,7 @@ Ruleset* Parser::ParseRuleset() {
   const char* start_pos = in_;
   const uint64 start_errors_seen_mask = errors_seen_mask_;
 
-  scoped_ptr<Ruleset> ruleset(new Ruleset());
+  scoped_ptr<Ruleset> ruleset(new(arena_) Ruleset());
   scoped_ptr<Selectors> selectors(ParseSelectors());
 
   if (Done()) {
@@ -2175,7 +2216,8 @@ Ruleset* Parser::ParseRuleset() {
   if (selectors.get() == NULL) {
     ReportParsingError(kSelectorError, "Failed to parse selector");
     if (preservation_mode_) {
-      selectors.reset(new Selectors(StringPiece(start_pos, in_ - start_pos)));
+      selectors.reset(new(arena_) Selectors(
+          StringPiece(start_pos, in_ - start_pos)));
       ruleset->set_selectors(selectors.release());
       // All errors that occurred sinse we started this declaration are
       // demoted to unparseable sections now that we've saved the dummy
@@ -2432,7 +2474,7 @@ Import* Parser::ParseImport() {
     return NULL;
   }
 
-  scoped_ptr<Import> import(new Import());
+  scoped_ptr<Import> import(new(arena_) Import());
   import->set_link(v->GetStringValue());
   SkipSpace();
   if (Done() || *in_ == ';') {
@@ -2454,7 +2496,7 @@ Import* Parser::ParseImport() {
 FontFace* Parser::ParseFontFace() {
   Tracer trace(__func__, this);
 
-  scoped_ptr<FontFace> font_face(new FontFace());
+  scoped_ptr<FontFace> font_face(new(arena_) FontFace());
   SkipSpace();
   if (Done()) {
     ReportParsingError(kAtRuleError, "Unexpected EOF in @font-face.");
@@ -2650,8 +2692,8 @@ void Parser::ParseStatement(const MediaQueries* media_queries,
       // we could not understand it.
       StringPiece bytes_in_original_buffer(oldin, in_ - oldin);
 
-      Ruleset* ruleset =
-          new Ruleset(new UnparsedRegion(bytes_in_original_buffer));
+      Ruleset* ruleset = new(arena_) Ruleset(
+          new(arena_) UnparsedRegion(bytes_in_original_buffer));
       if (media_queries != NULL) {
         ruleset->set_media_queries(media_queries->DeepCopy());
       }
@@ -2683,10 +2725,10 @@ Stylesheet* Parser::ParseRawStylesheet() {
   Tracer trace(__func__, this);
 
   SkipSpace();
-  if (Done()) return new Stylesheet();
+  if (Done()) return new(arena_) Stylesheet();
   DCHECK_LT(in_, end_);
 
-  Stylesheet* stylesheet = new Stylesheet();
+  Stylesheet* stylesheet = new(arena_) Stylesheet();
   while (in_ < end_) {
     switch (*in_) {
       // HTML-style comments are not allowed in CSS.
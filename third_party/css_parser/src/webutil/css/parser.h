@@ -26,6 +26,7 @@
 #include "strings/stringpiece.h"
 #include "testing/production_stub/public/gunit_prod.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/media.h"
 #include "webutil/css/property.h"  // while these CSS includes can be
 #include "webutil/css/selector.h"  // forward-declared, who is really
@@ -185,6 +186,14 @@ class Parser {
   bool preservation_mode() const { return preservation_mode_; }
   void set_preservation_mode(bool x) { preservation_mode_ = x; }
 
+  // If set (default NULL), the nodes of parse trees are allocated in arena
+  // rather than individually on the heap, and verbatim bytes and strings
+  // which needed no unescaping refer into the parsed text rather than being
+  // copied out of it.  Both arena and the parsed text must then outlive the
+  // returned tree.  Trees are still deleted as usual; see ArenaAllocated.
+  Arena* arena() const { return arena_; }
+  void set_arena(Arena* arena) { arena_ = arena; }
+
   // Maximum recursive function depth. How deeply should the parser parse
   // functions inside of functions. It is important to limit this to avoid
   // unbounded stack-frame depth on untrusted input. See b/17628553
@@ -385,6 +394,16 @@ class Parser {
   // which has bytes_in_original_buffer set.
   template<char delim> Value* ParseStringValue();
 
+  // Fast path of ParseStringValue used with an arena_.  If the string is
+  // terminated and has nothing to unescape, returns a STRING Value which
+  // refers to its contents in the parsed text.  Otherwise returns NULL and
+  // leaves in_ at the start of the string.
+  template<char delim> Value* ParseUnescapedStringValue();
+
+  // Stores verbatim in value, referring to the parsed text if we have an
+  // arena_ and copying it otherwise.
+  void SetBytesInOriginalBuffer(const StringPiece& verbatim, Value* value);
+
   // ParseNumber parses a number and an optional unit, consuming to
   // the end of the number or unit and returning a Value*.
   // Real numbers and integers are specified in decimal notation
@@ -604,6 +623,7 @@ class Parser {
   // stylesheet (including unparseable constructs such as proprietary CSS
   // and CSS hacks) so that they can be re-serialized precisely.
   bool preservation_mode_;
+  Arena* arena_;  // Not owned; may be NULL.
   int max_function_depth_;
 
   // errors_seen_mask_ is non-zero iff we failed to parse part of the CSS
@@ -656,7 +676,7 @@ class Parser {
 // A declaration consists of a property name (Property) and a list
 // of values (Values*).
 // It could also be important (font: 12pt Arial !important).
-class Declaration {
+class Declaration : public ArenaAllocated {
  public:
   // constructor.  We take ownership of v.
   Declaration(Property p, Values* v, bool important)
@@ -718,7 +738,8 @@ class Declaration {
 // Declarations, you are responsible for deleting them.
 // Also, be careful --- there's no virtual destructor, so this must be
 // deleted as a Declarations.
-class Declarations : public std::vector<Declaration*> {
+class Declarations : public std::vector<Declaration*>,
+                     public ArenaAllocated {
  public:
   Declarations() : std::vector<Declaration*>() { }
   ~Declarations();
@@ -736,7 +757,7 @@ class Declarations : public std::vector<Declaration*> {
 // parsed, so we simply collect the verbatim bytes from start to finish and
 // store them in an UnparsedRegion so that they can be re-emitted in
 // preservation mode.
-class UnparsedRegion {
+class UnparsedRegion : public ArenaAllocated {
  public:
   explicit UnparsedRegion(const StringPiece& bytes_in_original_buffer)
       : bytes_in_original_buffer_(bytes_in_original_buffer.data(),
@@ -764,7 +785,7 @@ class UnparsedRegion {
 // Unparsed regions between Rulesets can also be stored here in preservation
 // mode. For example, at-rules can be interspersed with Rulesets, for those
 // that we don't parse, they are stored in dummy Rulesets.
-class Ruleset {
+class Ruleset : public ArenaAllocated {
  public:
   // TODO(sligocki): Allow other parsed at-rules, like @page.
   enum Type { RULESET, UNPARSED_REGION, };
@@ -875,7 +896,7 @@ class Charsets : public std::vector<UnicodeText> {
   string ToString() const;
 };
 
-class Import {
+class Import : public ArenaAllocated {
  public:
   Import() {}
   ~Import() {}
@@ -904,7 +925,7 @@ class Imports : public std::vector<Css::Import*> {
   ~Imports();
 };
 
-class FontFace {
+class FontFace : public ArenaAllocated {
  public:
   FontFace() {}
   ~FontFace() {}
@@ -940,7 +961,7 @@ class FontFaces : public std::vector<Css::FontFace*> {
 
 // A stylesheet consists of a list of import information and a list of
 // rulesets.
-class Stylesheet {
+class Stylesheet : public ArenaAllocated {
  public:
   Stylesheet() : type_(AUTHOR) {}
 
@@ -2691,4 +2691,53 @@ TEST_F(ParserTest, ParseAnyParens) {
   EXPECT_STREQ(" 9 7)", p->in_);
 }
 
+TEST_F(ParserTest, Arena) {
+  const char kText[] =
+      ".a { content: 'Plain' 'Esc\\61ped'; width: 1.50px }\n"
+      "@media print { .b { content: \"x\"; color: red } }\n"
+      "@foo bar;\n";
+  Parser heap_parser(kText);
+  heap_parser.set_preservation_mode(true);
+  scoped_ptr<Stylesheet> heap_stylesheet(heap_parser.ParseRawStylesheet());
+
+  Arena arena;
+  Parser arena_parser(kText);
+  arena_parser.set_preservation_mode(true);
+  arena_parser.set_arena(&arena);
+  scoped_ptr<Stylesheet> stylesheet(arena_parser.ParseRawStylesheet());
+  EXPECT_EQ(heap_parser.errors_seen_mask(), arena_parser.errors_seen_mask());
+  EXPECT_EQ(heap_stylesheet->ToString(), stylesheet->ToString());
+  EXPECT_LT(0, arena.num_allocations());
+
+  // Strings with nothing to unescape, and verbatim bytes, refer into kText.
+  const Values& content = *stylesheet->ruleset(0).declaration(0).values();
+  ASSERT_EQ(2, content.size());
+  const char* plain = content.get(0)->GetStringValue().utf8_data();
+  EXPECT_TRUE(plain >= kText && plain < kText + sizeof(kText));
+  EXPECT_EQ("Plain", UnicodeTextToUTF8(content.get(0)->GetStringValue()));
+  const char* escaped = content.get(1)->GetStringValue().utf8_data();
+  EXPECT_FALSE(escaped >= kText && escaped < kText + sizeof(kText));
+  EXPECT_EQ("Escaped", UnicodeTextToUTF8(content.get(1)->GetStringValue()));
+  StringPiece verbatim = content.get(1)->bytes_in_original_buffer();
+  EXPECT_EQ("'Esc\\61ped'", verbatim.as_string());
+  EXPECT_TRUE(verbatim.data() >= kText &&
+              verbatim.data() < kText + sizeof(kText));
+
+  // Copies own their bytes.
+  Value copy(*content.get(0));
+  EXPECT_NE(plain, copy.GetStringValue().utf8_data());
+  EXPECT_EQ(content.get(0)->bytes_in_original_buffer(),
+            copy.bytes_in_original_buffer());
+  EXPECT_NE(content.get(0)->bytes_in_original_buffer().data(),
+            copy.bytes_in_original_buffer().data());
+
+  // Heap nodes can replace arena ones.
+  Values* width =
+      stylesheet->mutable_rulesets()[0]->mutable_declarations()[1]->
+      mutable_values();
+  delete (*width)[0];
+  (*width)[0] = new Value(2, Value::PX);
+  EXPECT_EQ("2px", width->get(0)->ToString());
+}
+
 }  // namespace Css
@@ -26,6 +26,7 @@
 #include "base/logging.h"
 #include "strings/stringpiece.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/string.h"
 #include "webutil/html/htmltagenum.h"
 #include "webutil/html/htmltagindex.h"
@@ -244,7 +245,8 @@ class SimpleSelector {
 // combinator() is NONE, F's combinator is CHILD, and G's combinator
 // is SIBLING.
 // ------------
-class SimpleSelectors : public std::vector<SimpleSelector*> {
+class SimpleSelectors : public std::vector<SimpleSelector*>,
+                        public ArenaAllocated {
  public:
   enum Combinator {
     NONE,         // first one in the chain
@@ -275,7 +277,7 @@ class SimpleSelectors : public std::vector<SimpleSelector*> {
 // combinators.  Each SimpleSelectors stores the combinator between
 // it and the previous one in the chain.
 // ------------
-class Selector: public std::vector<SimpleSelectors*> {
+class Selector: public std::vector<SimpleSelectors*>, public ArenaAllocated {
  public:
   Selector() { }
   ~Selector();
@@ -294,7 +296,7 @@ class Selector: public std::vector<SimpleSelectors*> {
 // When several selectors share the same declarations, they may be
 // grouped into a comma-separated list:
 // ------------
-class Selectors: public std::vector<Selector*> {
+class Selectors: public std::vector<Selector*>, public ArenaAllocated {
  public:
   Selectors() : is_dummy_(false) {}
   // Dummy Selectors
@@ -110,7 +110,9 @@ Value::Value(const Value& other)
     str_(other.str_),
     params_(new FunctionParameters),
     color_(other.color_),
-    bytes_in_original_buffer_(other.bytes_in_original_buffer_) {
+    bytes_in_original_buffer_storage_(
+        other.bytes_in_original_buffer_.as_string()),
+    bytes_in_original_buffer_(bytes_in_original_buffer_storage_) {
   if (other.params_.get() != NULL) {
     params_->Copy(*other.params_);
   }
@@ -124,7 +126,7 @@ Value& Value::operator=(const Value& other) {
   identifier_ = other.identifier_;
   str_ = other.str_;
   color_ = other.color_;
-  bytes_in_original_buffer_ = other.bytes_in_original_buffer_;
+  set_bytes_in_original_buffer(other.bytes_in_original_buffer_);
   if (other.params_.get() != NULL) {
     params_->Copy(*other.params_);
   } else {
@@ -28,6 +28,7 @@
 #include "base/scoped_ptr.h"
 #include "strings/stringpiece.h"
 #include "util/utf8/public/unicodetext.h"
+#include "webutil/css/arena.h"
 #include "webutil/css/identifier.h"
 #include "webutil/css/string.h"
 #include "webutil/html/htmlcolor.h"
@@ -50,7 +51,7 @@ class Values;
 // is set by the constructor and accessed with GetLexicalUnitType().
 // The values are also set by the constructor and accessed with the
 // various accessors.
-class Value {
+class Value : public ArenaAllocated {
  public:
   enum ValueType { NUMBER, URI, FUNCTION, RECT, COLOR, STRING, IDENT, COMMA,
                    UNKNOWN, DEFAULT };
@@ -144,7 +145,22 @@ class Value {
     return bytes_in_original_buffer_;
   }
   void set_bytes_in_original_buffer(const StringPiece& bytes) {
-    bytes.CopyToString(&bytes_in_original_buffer_);
+    bytes.CopyToString(&bytes_in_original_buffer_storage_);
+    bytes_in_original_buffer_ = bytes_in_original_buffer_storage_;
+  }
+  // Like set_bytes_in_original_buffer, but refers to bytes instead of copying
+  // them, so they must outlive this Value.  Copies of this Value get their
+  // own copy of the bytes.
+  void alias_bytes_in_original_buffer(const StringPiece& bytes) {
+    bytes_in_original_buffer_storage_.clear();
+    bytes_in_original_buffer_ = bytes;
+  }
+  // Makes the string value of a URI or STRING refer to utf8 instead of
+  // holding a copy of it, so it must outlive this Value.  Copies of this
+  // Value get their own copy of the string.
+  void alias_string_value(const StringPiece& utf8) {
+    DCHECK(type_ == URI || type_ == STRING);
+    str_.PointToUTF8(utf8.data(), utf8.size());
   }
 
  private:
@@ -156,7 +172,10 @@ class Value {
   scoped_ptr<FunctionParameters> params_;  // FUNCTION and RECT params
   HtmlColor color_;           // COLOR
 
-  string bytes_in_original_buffer_;
+  // Points either into bytes_in_original_buffer_storage_ or, if aliased,
+  // into the parsed document.
+  string bytes_in_original_buffer_storage_;
+  StringPiece bytes_in_original_buffer_;
 
   // kDimensionUnitText stores the name of each unit (see TextFromUnit)
   static const char* const kDimensionUnitText[];
@@ -167,7 +186,7 @@ class Value {
 // responsible for deleting them.
 // Also, be careful --- there's no virtual destructor, so this must be
 // deleted as a Values.
-class Values : public std::vector<Value*> {
+class Values : public std::vector<Value*>, public ArenaAllocated {
  public:
   Values() : std::vector<Value*>() { }
   ~Values();
@@ -193,7 +212,7 @@ class Values : public std::vector<Value*> {
 // are interpretted correctly. Only the original mix of spaces and commas.
 //
 // FunctionParameters will delete all of its stored Value*'s on destruction.
-class FunctionParameters {
+class FunctionParameters : public ArenaAllocated {
  public:
   enum Separator {
     COMMA_SEPARATED,